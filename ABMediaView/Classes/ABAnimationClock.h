@@ -0,0 +1,77 @@
+//
+//  ABAnimationClock.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <QuartzCore/QuartzCore.h>
+#import <UIKit/UIKit.h>
+
+/// Object whose animated image is advanced by the animation clock
+@protocol ABAnimationClockTarget <NSObject>
+
+/// Animated image whose frames are shown, nil while its frames are released
+- (UIImage *)animationClockImage;
+
+/// Determines whether the target can be seen, targets which can not are not advanced
+- (BOOL)isVisibleForAnimationClock;
+
+/// Shows a frame of the animated image
+- (void)animationClockDisplayFrame:(UIImage *)frame;
+
+/// Drops the decoded frames of the animated image while the target is paused, keeping the frame on screen
+- (void)animationClockReleaseFrames;
+
+/// Decodes the frames released by animationClockReleaseFrames again, once the target is visible
+- (void)animationClockRestoreFrames;
+
+@end
+
+/// A single display link which paces the frames of every animated image on screen. Targets which are not visible are paused, and frames which fall behind are skipped rather than queued.
+@interface ABAnimationClock : NSObject
+
+/// Shared clock for all mediaViews
++ (id)sharedManager;
+
+/// Frames per second the clock ticks at while a target is registered (defaults to 30)
+@property (nonatomic) NSInteger preferredFramesPerSecond;
+
+/// Number of registered targets
+@property (nonatomic, readonly) NSUInteger targetCount;
+
+/// Number of targets which were visible on the last tick
+@property (nonatomic, readonly) NSUInteger visibleTargetCount;
+
+/// Number of ticks since the statistics were reset
+@property (nonatomic, readonly) NSUInteger tickCount;
+
+/// Number of frames given to targets since the statistics were reset
+@property (nonatomic, readonly) NSUInteger displayedFrameCount;
+
+/// Number of frames passed over because a tick came late, since the statistics were reset
+@property (nonatomic, readonly) NSUInteger skippedFrameCount;
+
+/// Seconds spent in ticks since the statistics were reset
+@property (nonatomic, readonly) CFTimeInterval tickDuration;
+
+/// Starts advancing the frames of the target's animated image, from its first frame
+- (void)addTarget:(id<ABAnimationClockTarget>)target;
+
+/// Stops advancing the target
+- (void)removeTarget:(id<ABAnimationClockTarget>)target;
+
+/// Determines whether the target is registered
+- (BOOL)containsTarget:(id<ABAnimationClockTarget>)target;
+
+/// Advances every visible target to the frame due at the given media time, which is called by the display link
+- (void)tickAtTime:(CFTimeInterval)time;
+
+/// Releases the frames of every target which is not visible, which is called on memory warnings
+- (void)releasePausedFrames;
+
+/// Sets the tick and frame counts back to zero
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,272 @@
+//
+//  ABAnimationClock.m
+//  Pods
+//
+//
+//
+
+#import "ABAnimationClock.h"
+#import "ABCommons.h"
+
+/// Progress of a target through the frames of its animated image
+@interface ABAnimationClockEntry : NSObject
+
+/// Animated image the progress belongs to, held weakly so that released frames are not kept alive
+@property (weak, nonatomic) UIImage *image;
+
+/// Media time at which the first frame was shown
+@property (nonatomic) CFTimeInterval startTime;
+
+/// Index of the frame last shown, or NSNotFound if none has been shown since the target was paused
+@property (nonatomic) NSUInteger frameIndex;
+
+@end
+
+@implementation ABAnimationClockEntry
+
+@end
+
+@interface ABAnimationClock ()
+
+/// Registered targets, keyed weakly
+@property (strong, nonatomic) NSMapTable *targets;
+
+@property (strong, nonatomic) CADisplayLink *displayLink;
+
+@property (nonatomic, readwrite) NSUInteger visibleTargetCount;
+@property (nonatomic, readwrite) NSUInteger tickCount;
+@property (nonatomic, readwrite) NSUInteger displayedFrameCount;
+@property (nonatomic, readwrite) NSUInteger skippedFrameCount;
+@property (nonatomic, readwrite) CFTimeInterval tickDuration;
+
+@end
+
+@implementation ABAnimationClock
+
++ (id)sharedManager {
+    static ABAnimationClock *sharedMyManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedMyManager = [[self alloc] init];
+    });
+    return sharedMyManager;
+}
+
+- (id)init {
+    if (self = [super init]) {
+        _preferredFramesPerSecond = 30;
+        self.targets = [NSMapTable weakToStrongObjectsMapTable];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(releasePausedFrames)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self.displayLink invalidate];
+}
+
+#pragma mark - Target Methods
+
+- (NSUInteger)targetCount {
+    return [[self.targets keyEnumerator] allObjects].count;
+}
+
+- (void)addTarget:(id<ABAnimationClockTarget>)target {
+
+    if ([ABCommons isNull:target]) {
+        return;
+    }
+
+    ABAnimationClockEntry *entry = [[ABAnimationClockEntry alloc] init];
+    entry.frameIndex = NSNotFound;
+    [self.targets setObject:entry forKey:target];
+
+    [self startDisplayLink];
+}
+
+- (void)removeTarget:(id<ABAnimationClockTarget>)target {
+
+    if ([ABCommons isNull:target]) {
+        return;
+    }
+
+    [self.targets removeObjectForKey:target];
+
+    if (self.targetCount == 0) {
+        [self stopDisplayLink];
+    }
+
+}
+
+- (BOOL)containsTarget:(id<ABAnimationClockTarget>)target {
+
+    if ([ABCommons isNull:target]) {
+        return NO;
+    }
+
+    return [ABCommons notNull:[self.targets objectForKey:target]];
+}
+
+#pragma mark - Display Link Methods
+
+- (void)setPreferredFramesPerSecond:(NSInteger)preferredFramesPerSecond {
+    _preferredFramesPerSecond = MAX(preferredFramesPerSecond, (NSInteger)1);
+
+    if ([ABCommons notNull:self.displayLink]) {
+        [self applyFrameRate];
+    }
+
+}
+
+- (void)applyFrameRate {
+
+    if ([self.displayLink respondsToSelector:@selector(setPreferredFramesPerSecond:)]) {
+        self.displayLink.preferredFramesPerSecond = self.preferredFramesPerSecond;
+    } else {
+        self.displayLink.frameInterval = MAX(60 / self.preferredFramesPerSecond, (NSInteger)1);
+    }
+
+}
+
+- (void)startDisplayLink {
+
+    if ([ABCommons notNull:self.displayLink]) {
+        return;
+    }
+
+    self.displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(displayLinkDidFire:)];
+    [self applyFrameRate];
+
+    // Common modes keep GIFs moving while a feed is being scrolled
+    [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+}
+
+- (void)stopDisplayLink {
+    // The display link retains the clock, so it is invalidated rather than paused once there is nothing to advance
+    [self.displayLink invalidate];
+    self.displayLink = nil;
+}
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink {
+    [self tickAtTime:displayLink.timestamp];
+
+    if (self.targetCount == 0) {
+        [self stopDisplayLink];
+    }
+
+}
+
+#pragma mark - Tick Methods
+
+- (void)tickAtTime:(CFTimeInterval)time {
+    CFTimeInterval tickStart = CACurrentMediaTime();
+    NSUInteger visibleTargetCount = 0;
+
+    // Targets may add or remove themselves while they are being advanced
+    for (id<ABAnimationClockTarget> target in [[self.targets keyEnumerator] allObjects]) {
+        ABAnimationClockEntry *entry = [self.targets objectForKey:target];
+
+        if ([ABCommons isNull:entry]) {
+            continue;
+        }
+
+        if (![target isVisibleForAnimationClock]) {
+            // A paused target shows whichever frame is due when it becomes visible, without counting the frames it missed as skipped
+            entry.frameIndex = NSNotFound;
+            continue;
+        }
+
+        visibleTargetCount++;
+
+        UIImage *image = [target animationClockImage];
+
+        if ([ABCommons isNull:image]) {
+            [target animationClockRestoreFrames];
+            continue;
+        }
+
+        [self advanceTarget:target entry:entry image:image atTime:time];
+    }
+
+    self.visibleTargetCount = visibleTargetCount;
+    self.tickCount++;
+    self.tickDuration += CACurrentMediaTime() - tickStart;
+}
+
+- (void)advanceTarget:(id<ABAnimationClockTarget>)target entry:(ABAnimationClockEntry *)entry image:(UIImage *)image atTime:(CFTimeInterval)time {
+    NSArray<UIImage *> *frames = image.images;
+    NSUInteger count = frames.count;
+
+    if (count == 0 || image.duration <= 0) {
+        return;
+    }
+
+    if (entry.image != image) {
+        entry.image = image;
+        entry.startTime = time;
+        entry.frameIndex = NSNotFound;
+    }
+
+    // The frame is chosen from the elapsed time, so a late tick jumps ahead instead of playing the frames it missed
+    NSTimeInterval elapsed = fmod(MAX(time - entry.startTime, 0), image.duration);
+    NSUInteger index = MIN((NSUInteger)(elapsed * count / image.duration), count - 1);
+
+    if (index == entry.frameIndex) {
+        return;
+    }
+
+    UIImage *frame = frames[index];
+
+    if (entry.frameIndex == NSNotFound) {
+        entry.frameIndex = index;
+        [target animationClockDisplayFrame:frame];
+        self.displayedFrameCount++;
+        return;
+    }
+
+    // Frames are repeated to hold them for their delay, so only changes of frame count as shown or skipped
+    NSUInteger changes = 0;
+
+    for (NSUInteger i = entry.frameIndex; i != index; i = (i + 1) % count) {
+
+        if (frames[(i + 1) % count] != frames[i]) {
+            changes++;
+        }
+
+    }
+
+    entry.frameIndex = index;
+
+    if (changes == 0) {
+        return;
+    }
+
+    self.skippedFrameCount += changes - 1;
+
+    [target animationClockDisplayFrame:frame];
+    self.displayedFrameCount++;
+}
+
+- (void)releasePausedFrames {
+
+    for (id<ABAnimationClockTarget> target in [[self.targets keyEnumerator] allObjects]) {
+
+        if (![target isVisibleForAnimationClock] && [ABCommons notNull:[target animationClockImage]]) {
+            [target animationClockReleaseFrames];
+        }
+
+    }
+
+}
+
+- (void)resetStatistics {
+    self.tickCount = 0;
+    self.displayedFrameCount = 0;
+    self.skippedFrameCount = 0;
+    self.tickDuration = 0;
+}
+
+@end
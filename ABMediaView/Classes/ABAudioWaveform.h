@@ -0,0 +1,57 @@
+//
+//  ABAudioWaveform.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+
+/// Error domain for audio which could not be summarized
+extern NSString *const ABAudioWaveformErrorDomain;
+
+@class ABAudioWaveform;
+
+/// Waveform loaded or built, waveform is nil if the audio could not be decoded
+typedef void (^AudioWaveformBlock)(ABAudioWaveform *waveform, NSError *error);
+
+/// Min/max/RMS summary of an audio file at several zoom levels. The audio is decoded once, and the summary is stored next to the file, so that it can be drawn straight away the next time the file is shown.
+@interface ABAudioWaveform : NSObject
+
+/// Audio file which was summarized
+@property (strong, nonatomic, readonly) NSURL *fileURL;
+
+/// Samples per second of the audio
+@property (nonatomic, readonly) double sampleRate;
+
+/// Number of samples summarized, with the channels mixed down to mono
+@property (nonatomic, readonly) uint64_t sampleCount;
+
+/// Duration of the audio in seconds
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+/// Number of zoom levels, from the finest buckets to a single bucket
+@property (nonatomic, readonly) NSUInteger levelCount;
+
+/// Location of the stored summary for an audio file, next to the file itself
++ (NSURL *)summaryURLForFileURL:(NSURL *)fileURL;
+
+/// Reads a summary written by summaryData, returns nil if it is malformed
++ (instancetype)waveformWithSummaryData:(NSData *)data fileURL:(NSURL *)fileURL;
+
+/// Reads the stored summary of a local audio file, or decodes the file and stores its summary when there is none or the file has changed. This blocks while decoding, so should be called off the main queue.
++ (instancetype)waveformForFileURL:(NSURL *)fileURL error:(NSError **)error;
+
+/// Calls waveformForFileURL:error: on a background queue, and the completion on the main queue
++ (void)loadWaveformForFileURL:(NSURL *)fileURL completion:(AudioWaveformBlock)completionBlock;
+
+/// Summary in its portable storage format
+- (NSData *)summaryData;
+
+/// Number of buckets at a zoom level
+- (NSUInteger)bucketCountAtLevel:(NSUInteger)level;
+
+/// Fills count bars covering the audio between two times with their minimum, maximum and RMS (any of which may be NULL), from the coarsest level which has a bucket for every bar. Returns the level read.
+- (NSUInteger)getPeaksFromTime:(NSTimeInterval)startTime toTime:(NSTimeInterval)endTime count:(NSUInteger)count min:(float *)min max:(float *)max rms:(float *)rms;
+
+@end
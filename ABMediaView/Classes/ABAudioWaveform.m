@@ -0,0 +1,270 @@
+//
+//  ABAudioWaveform.m
+//  Pods
+//
+//
+//
+
+#import "ABAudioWaveform.h"
+#import "ABWaveformSummary.h"
+#import "ABCommons.h"
+#import <AVFoundation/AVFoundation.h>
+
+NSString *const ABAudioWaveformErrorDomain = @"ABAudioWaveformErrorDomain";
+
+/// Path extension of the summary stored next to an audio file
+static NSString *const ABAudioWaveformPathExtension = @"abwaveform";
+
+/// Samples covered by each of the finest buckets, about 6ms at 44.1kHz
+static const uint32_t ABAudioWaveformBucketLength = 256;
+
+/// Most buckets at the finest level, long audio uses longer buckets so that its summary stays small
+static const uint64_t ABAudioWaveformMaximumBuckets = 1 << 17;
+
+/// Buckets of each level combined into one bucket of the next
+static const uint32_t ABAudioWaveformFanout = 4;
+
+static NSError *waveformError(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:ABAudioWaveformErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey : description}];
+}
+
+@interface ABAudioWaveform () {
+    ABWaveformPyramid _pyramid;
+}
+
+@property (strong, nonatomic, readwrite) NSURL *fileURL;
+
+@end
+
+@implementation ABAudioWaveform
+
+- (void)dealloc {
+    ABWaveformPyramidFree(&_pyramid);
+}
+
+#pragma mark - Loading Methods
+
++ (NSURL *)summaryURLForFileURL:(NSURL *)fileURL {
+    return [fileURL URLByAppendingPathExtension:ABAudioWaveformPathExtension];
+}
+
++ (instancetype)waveformWithSummaryData:(NSData *)data fileURL:(NSURL *)fileURL {
+    
+    if ([ABCommons isNull:data]) {
+        return nil;
+    }
+    
+    ABAudioWaveform *waveform = [[self alloc] init];
+    waveform.fileURL = fileURL;
+    
+    if (ABWaveformDecode(data.bytes, data.length, &waveform->_pyramid) != ABWaveformStatusOK) {
+        return nil;
+    }
+    
+    return waveform;
+}
+
++ (instancetype)waveformForFileURL:(NSURL *)fileURL error:(NSError **)error {
+    
+    if ([ABCommons isNull:fileURL] || !fileURL.isFileURL) {
+        if (error) *error = waveformError(ABWaveformStatusMalformed, @"Only local audio files can be summarized");
+        return nil;
+    }
+    
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:fileURL.path error:error];
+    
+    if ([ABCommons isNull:attributes]) {
+        return nil;
+    }
+    
+    uint64_t fileLength = [attributes fileSize];
+    int64_t modificationTime = (int64_t)llround([[attributes fileModificationDate] timeIntervalSince1970] * 1e6);
+    NSURL *summaryURL = [self summaryURLForFileURL:fileURL];
+    NSData *summaryData = [NSData dataWithContentsOfURL:summaryURL options:NSDataReadingMappedIfSafe error:nil];
+    ABAudioWaveform *waveform = [self waveformWithSummaryData:summaryData fileURL:fileURL];
+    
+    // A summary is only used for the file it was built from, a replaced file is decoded again even when its length is the same
+    if ([ABCommons notNull:waveform] && waveform->_pyramid.sourceLength == fileLength && waveform->_pyramid.sourceModificationTime == modificationTime) {
+        return waveform;
+    }
+    
+    waveform = [[self alloc] init];
+    waveform.fileURL = fileURL;
+    
+    if (![waveform decodeFileWithLength:fileLength modificationTime:modificationTime error:error]) {
+        return nil;
+    }
+    
+    // The summary is a cache, so failing to store it is not an error
+    [[waveform summaryData] writeToURL:summaryURL options:NSDataWritingAtomic error:nil];
+    
+    return waveform;
+}
+
++ (void)loadWaveformForFileURL:(NSURL *)fileURL completion:(AudioWaveformBlock)completionBlock {
+    static dispatch_queue_t decodeQueue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        // Decoding is serial and low priority, so that summaries never compete with playback
+        decodeQueue = dispatch_queue_create("ABAudioWaveform", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    });
+    
+    dispatch_async(decodeQueue, ^{
+        NSError *error = nil;
+        ABAudioWaveform *waveform = [ABAudioWaveform waveformForFileURL:fileURL error:&error];
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if(completionBlock) completionBlock(waveform, error);
+        });
+    });
+}
+
+/// Decodes the first audio track to 16-bit PCM and streams it through the summary builder
+- (BOOL)decodeFileWithLength:(uint64_t)fileLength modificationTime:(int64_t)modificationTime error:(NSError **)error {
+    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:self.fileURL options:nil];
+    AVAssetTrack *track = [[asset tracksWithMediaType:AVMediaTypeAudio] firstObject];
+    
+    if ([ABCommons isNull:track]) {
+        if (error) *error = waveformError(ABWaveformStatusEmpty, @"The file has no audio track");
+        return NO;
+    }
+    
+    AVAssetReader *reader = [AVAssetReader assetReaderWithAsset:asset error:error];
+    
+    if ([ABCommons isNull:reader]) {
+        return NO;
+    }
+    
+    NSDictionary *outputSettings = @{AVFormatIDKey : @(kAudioFormatLinearPCM),
+                                     AVLinearPCMBitDepthKey : @16,
+                                     AVLinearPCMIsFloatKey : @NO,
+                                     AVLinearPCMIsBigEndianKey : @NO,
+                                     AVLinearPCMIsNonInterleaved : @NO};
+    
+    AVAssetReaderTrackOutput *output = [AVAssetReaderTrackOutput assetReaderTrackOutputWithTrack:track outputSettings:outputSettings];
+    output.alwaysCopiesSampleData = NO;
+    [reader addOutput:output];
+    
+    if (![reader startReading]) {
+        if (error) *error = reader.error;
+        return NO;
+    }
+    
+    // Longer buckets are used for long audio, estimated from the duration before decoding
+    uint32_t bucketLength = ABAudioWaveformBucketLength;
+    double estimatedSampleRate = 44100;
+    CMAudioFormatDescriptionRef trackFormat = (__bridge CMAudioFormatDescriptionRef)[track.formatDescriptions firstObject];
+    
+    if (trackFormat != NULL && CMAudioFormatDescriptionGetStreamBasicDescription(trackFormat) != NULL) {
+        estimatedSampleRate = CMAudioFormatDescriptionGetStreamBasicDescription(trackFormat)->mSampleRate;
+    }
+    
+    double estimatedSamples = MAX(CMTimeGetSeconds(asset.duration), 0) * estimatedSampleRate;
+    
+    while (estimatedSamples / bucketLength > ABAudioWaveformMaximumBuckets && bucketLength < (1u << 24)) {
+        bucketLength *= 2;
+    }
+    
+    ABWaveformBuilder builder;
+    ABWaveformBuilderInit(&builder, bucketLength, ABAudioWaveformFanout);
+    
+    NSMutableData *scratch = [[NSMutableData alloc] init];
+    double sampleRate = estimatedSampleRate;
+    ABWaveformStatus status = ABWaveformStatusOK;
+    CMSampleBufferRef sampleBuffer = NULL;
+    
+    while (status == ABWaveformStatusOK && (sampleBuffer = [output copyNextSampleBuffer]) != NULL) {
+        CMBlockBufferRef blockBuffer = CMSampleBufferGetDataBuffer(sampleBuffer);
+        const AudioStreamBasicDescription *format = CMAudioFormatDescriptionGetStreamBasicDescription(CMSampleBufferGetFormatDescription(sampleBuffer));
+        
+        if (blockBuffer != NULL && format != NULL && format->mChannelsPerFrame > 0) {
+            size_t length = CMBlockBufferGetDataLength(blockBuffer);
+            size_t contiguousLength = 0;
+            char *bytes = NULL;
+            
+            // Block buffers are usually contiguous, and are only copied when they are not
+            if (CMBlockBufferGetDataPointer(blockBuffer, 0, &contiguousLength, NULL, &bytes) != kCMBlockBufferNoErr || contiguousLength < length) {
+                scratch.length = length;
+                CMBlockBufferCopyDataBytes(blockBuffer, 0, length, scratch.mutableBytes);
+                bytes = scratch.mutableBytes;
+            }
+            
+            sampleRate = format->mSampleRate;
+            status = ABWaveformBuilderAppendInt16(&builder, (const int16_t *)bytes, length / (sizeof(int16_t) * format->mChannelsPerFrame), format->mChannelsPerFrame);
+        }
+        
+        CFRelease(sampleBuffer);
+    }
+    
+    if (reader.status == AVAssetReaderStatusReading) {
+        [reader cancelReading];
+    }
+    
+    if (reader.status == AVAssetReaderStatusFailed) {
+        ABWaveformBuilderFree(&builder);
+        if (error) *error = reader.error;
+        return NO;
+    }
+    
+    if (status == ABWaveformStatusOK) {
+        status = ABWaveformBuilderFinish(&builder, (uint32_t)lround(sampleRate), fileLength, modificationTime, &_pyramid);
+    } else {
+        ABWaveformBuilderFree(&builder);
+    }
+    
+    if (status != ABWaveformStatusOK) {
+        ABWaveformPyramidFree(&_pyramid);
+        if (error) *error = waveformError(status, status == ABWaveformStatusEmpty ? @"The audio has no samples" : @"The audio could not be summarized");
+        return NO;
+    }
+    
+    return YES;
+}
+
+#pragma mark - Query Methods
+
+- (double)sampleRate {
+    return _pyramid.sampleRate;
+}
+
+- (uint64_t)sampleCount {
+    return _pyramid.sampleCount;
+}
+
+- (NSTimeInterval)duration {
+    return _pyramid.sampleRate > 0 ? (double)_pyramid.sampleCount / _pyramid.sampleRate : 0;
+}
+
+- (NSUInteger)levelCount {
+    return _pyramid.levelCount;
+}
+
+- (NSUInteger)bucketCountAtLevel:(NSUInteger)level {
+    return level < _pyramid.levelCount ? _pyramid.levels[level].bucketCount : 0;
+}
+
+- (NSData *)summaryData {
+    NSMutableData *data = [NSMutableData dataWithLength:ABWaveformEncodedLength(&_pyramid)];
+    
+    if (ABWaveformEncode(&_pyramid, data.mutableBytes, data.length) == 0) {
+        return nil;
+    }
+    
+    return data;
+}
+
+- (NSUInteger)getPeaksFromTime:(NSTimeInterval)startTime toTime:(NSTimeInterval)endTime count:(NSUInteger)count min:(float *)min max:(float *)max rms:(float *)rms {
+    
+    if (count == 0 || count > UINT32_MAX) {
+        return 0;
+    }
+    
+    double startSample = MAX(startTime, 0) * _pyramid.sampleRate;
+    double endSample = MAX(endTime, 0) * _pyramid.sampleRate;
+    uint64_t start = (uint64_t)MIN(startSample, (double)_pyramid.sampleCount);
+    uint64_t end = (uint64_t)MIN(endSample, (double)_pyramid.sampleCount);
+    
+    return ABWaveformPyramidPeaks(&_pyramid, start, end, (uint32_t)count, min, max, rms);
+}
+
+@end
@@ -0,0 +1,70 @@
+//
+//  ABBufferMonitor.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+
+/// A range of media time, in seconds, which has been loaded
+typedef struct {
+    NSTimeInterval start;
+    NSTimeInterval end;
+} ABBufferedRange;
+
+/// Keeps the loaded time ranges of a player item as a sorted set of disjoint intervals, estimates how fast media is being downloaded, and predicts when playback will run out of buffer
+@interface ABBufferMonitor : NSObject
+
+/// Number of disjoint ranges which are buffered
+@property (nonatomic, readonly) NSUInteger rangeCount;
+
+/// Total seconds of media which are buffered, across all ranges
+@property (nonatomic, readonly) NSTimeInterval totalBufferedTime;
+
+/// Estimated download throughput, in seconds of media loaded per second of wall-clock time
+@property (nonatomic, readonly) double throughput;
+
+/// Weight given to the newest throughput sample, from 0 to 1 (defaults to 0.3)
+@property (nonatomic) double smoothingFactor;
+
+/// Minimum wall-clock seconds between throughput samples (defaults to 0.25)
+@property (nonatomic) NSTimeInterval sampleInterval;
+
+/// Seconds by which the buffered ranges may fall short of the duration and still be considered complete (defaults to 0.1)
+@property (nonatomic) NSTimeInterval completionTolerance;
+
+/// Removes all ranges and throughput samples
+- (void)reset;
+
+/// Returns the buffered range at the given index, ranges are sorted by start time
+- (ABBufferedRange)rangeAtIndex:(NSUInteger)index;
+
+/// Inserts a range into the set, merging it with the ranges it overlaps or touches. Returns the seconds of media that were not buffered before.
+- (NSTimeInterval)addRangeFromTime:(NSTimeInterval)start toTime:(NSTimeInterval)end;
+
+/// Replaces the buffered ranges with the given ranges (which may be unsorted or overlapping), and records the newly loaded media as a throughput sample at the given wall-clock time
+- (void)updateWithRanges:(const ABBufferedRange *)ranges count:(NSUInteger)count atTime:(NSTimeInterval)timestamp;
+
+/// Replaces the buffered ranges with the 'loadedTimeRanges' of a player item (NSValues of CMTimeRange)
+- (void)updateWithLoadedTimeRanges:(NSArray<NSValue *> *)loadedTimeRanges atTime:(NSTimeInterval)timestamp;
+
+/// Records that nothing has been loaded up to the given wall-clock time, so that the throughput decays while a download is stalled
+- (void)advanceToTime:(NSTimeInterval)timestamp;
+
+/// Determines whether the given media time is buffered
+- (BOOL)containsTime:(NSTimeInterval)time;
+
+/// End of the buffered range which contains the given media time, or the time itself if it is not buffered
+- (NSTimeInterval)bufferedEndFromTime:(NSTimeInterval)time;
+
+/// Seconds of contiguous media buffered ahead of the given media time
+- (NSTimeInterval)bufferedAheadOfTime:(NSTimeInterval)time;
+
+/// Determines whether all of the media, from start to duration, is buffered
+- (BOOL)isFullyBufferedForDuration:(NSTimeInterval)duration;
+
+/// Predicted wall-clock seconds until playback from the given media time runs out of buffer, given the playback rate and the current throughput. Returns INFINITY when no stall is expected.
+- (NSTimeInterval)timeToStallFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration rate:(float)rate;
+
+@end
@@ -0,0 +1,344 @@
+//
+//  ABBufferMonitor.m
+//  Pods
+//
+//
+//
+
+#import "ABBufferMonitor.h"
+#import <CoreMedia/CoreMedia.h>
+
+/// Slack allowed when deciding whether a media time falls within a range
+static const NSTimeInterval ABBufferMonitorEpsilon = 0.001;
+
+static int compareRanges(const void *a, const void *b) {
+    NSTimeInterval startA = ((const ABBufferedRange *)a)->start;
+    NSTimeInterval startB = ((const ABBufferedRange *)b)->start;
+
+    if (startA < startB) return -1;
+    if (startA > startB) return 1;
+    return 0;
+}
+
+/// Seconds covered by both of two sorted lists of disjoint ranges
+static NSTimeInterval overlapOfRanges(const ABBufferedRange *a, NSUInteger countA, const ABBufferedRange *b, NSUInteger countB) {
+    NSTimeInterval overlap = 0;
+    NSUInteger i = 0, j = 0;
+
+    while (i < countA && j < countB) {
+        NSTimeInterval start = MAX(a[i].start, b[j].start);
+        NSTimeInterval end = MIN(a[i].end, b[j].end);
+
+        if (end > start) {
+            overlap += end - start;
+        }
+
+        if (a[i].end < b[j].end) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+
+    return overlap;
+}
+
+@interface ABBufferMonitor () {
+    /// Sorted, disjoint buffered ranges
+    ABBufferedRange *_ranges;
+    NSUInteger _count;
+    NSUInteger _capacity;
+
+    /// Seconds of media loaded since the last throughput sample
+    NSTimeInterval _pendingLoadedTime;
+
+    /// Wall-clock time of the last throughput sample, negative before the first update
+    NSTimeInterval _lastSampleTime;
+
+    /// Determines whether a throughput sample has been taken
+    BOOL _hasThroughputSample;
+}
+
+@end
+
+@implementation ABBufferMonitor
+
+- (id)init {
+    if (self = [super init]) {
+        self.smoothingFactor = 0.3;
+        self.sampleInterval = 0.25;
+        self.completionTolerance = 0.1;
+
+        [self reset];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_ranges);
+}
+
+- (void)reset {
+    _count = 0;
+    _totalBufferedTime = 0;
+    _throughput = 0;
+    _pendingLoadedTime = 0;
+    _lastSampleTime = -1;
+    _hasThroughputSample = NO;
+}
+
+- (NSUInteger)rangeCount {
+    return _count;
+}
+
+- (ABBufferedRange)rangeAtIndex:(NSUInteger)index {
+
+    if (index < _count) {
+        return _ranges[index];
+    }
+
+    ABBufferedRange empty = {0, 0};
+    return empty;
+}
+
+#pragma mark - Update Methods
+
+- (void)reserveCapacity:(NSUInteger)capacity {
+
+    if (capacity > _capacity) {
+        NSUInteger newCapacity = MAX(capacity, MAX(_capacity * 2, (NSUInteger)8));
+        _ranges = realloc(_ranges, newCapacity * sizeof(ABBufferedRange));
+        _capacity = newCapacity;
+    }
+
+}
+
+/// Index of the first range which ends at or after the given time
+- (NSUInteger)indexOfFirstRangeEndingAfter:(NSTimeInterval)time {
+    NSUInteger low = 0, high = _count;
+
+    while (low < high) {
+        NSUInteger mid = (low + high) / 2;
+
+        if (_ranges[mid].end < time) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+- (NSTimeInterval)addRangeFromTime:(NSTimeInterval)start toTime:(NSTimeInterval)end {
+
+    if (isnan(start) || isnan(end) || end <= start) {
+        return 0;
+    }
+
+    NSUInteger first = [self indexOfFirstRangeEndingAfter:start];
+    NSUInteger last = first;
+    NSTimeInterval covered = 0;
+    NSTimeInterval mergedStart = start;
+    NSTimeInterval mergedEnd = end;
+
+    while (last < _count && _ranges[last].start <= end) {
+        covered += MIN(end, _ranges[last].end) - MAX(start, _ranges[last].start);
+        mergedStart = MIN(mergedStart, _ranges[last].start);
+        mergedEnd = MAX(mergedEnd, _ranges[last].end);
+        last++;
+    }
+
+    NSUInteger merging = last - first;
+
+    if (merging == 0) {
+        [self reserveCapacity:_count + 1];
+        memmove(&_ranges[first + 1], &_ranges[first], (_count - first) * sizeof(ABBufferedRange));
+        _count++;
+    } else if (merging > 1) {
+        memmove(&_ranges[first + 1], &_ranges[last], (_count - last) * sizeof(ABBufferedRange));
+        _count -= merging - 1;
+    }
+
+    _ranges[first].start = mergedStart;
+    _ranges[first].end = mergedEnd;
+
+    NSTimeInterval added = (end - start) - covered;
+    _totalBufferedTime += added;
+
+    return added;
+}
+
+- (void)updateWithRanges:(const ABBufferedRange *)ranges count:(NSUInteger)count atTime:(NSTimeInterval)timestamp {
+    ABBufferedRange *sorted = malloc(MAX(count, (NSUInteger)1) * sizeof(ABBufferedRange));
+    NSUInteger sortedCount = 0;
+
+    for (NSUInteger i = 0; i < count; i++) {
+
+        if (!isnan(ranges[i].start) && !isnan(ranges[i].end) && ranges[i].end > ranges[i].start) {
+            sorted[sortedCount++] = ranges[i];
+        }
+
+    }
+
+    qsort(sorted, sortedCount, sizeof(ABBufferedRange), compareRanges);
+
+    // Merge overlapping and touching ranges in place
+    NSUInteger mergedCount = 0;
+    NSTimeInterval total = 0;
+
+    for (NSUInteger i = 0; i < sortedCount; i++) {
+
+        if (mergedCount > 0 && sorted[i].start <= sorted[mergedCount - 1].end) {
+            sorted[mergedCount - 1].end = MAX(sorted[mergedCount - 1].end, sorted[i].end);
+        } else {
+            sorted[mergedCount++] = sorted[i];
+        }
+
+    }
+
+    for (NSUInteger i = 0; i < mergedCount; i++) {
+        total += sorted[i].end - sorted[i].start;
+    }
+
+    // Only media which was not already buffered counts towards throughput, so evicted ranges and seeks do not skew the estimate
+    NSTimeInterval added = total - overlapOfRanges(sorted, mergedCount, _ranges, _count);
+
+    free(_ranges);
+    _ranges = sorted;
+    _count = mergedCount;
+    _capacity = MAX(count, (NSUInteger)1);
+    _totalBufferedTime = total;
+
+    [self recordLoadedTime:added atTime:timestamp];
+}
+
+- (void)updateWithLoadedTimeRanges:(NSArray<NSValue *> *)loadedTimeRanges atTime:(NSTimeInterval)timestamp {
+    NSUInteger count = loadedTimeRanges.count;
+    ABBufferedRange *ranges = malloc(MAX(count, (NSUInteger)1) * sizeof(ABBufferedRange));
+
+    for (NSUInteger i = 0; i < count; i++) {
+        CMTimeRange timeRange = [loadedTimeRanges[i] CMTimeRangeValue];
+        ranges[i].start = CMTimeGetSeconds(timeRange.start);
+        ranges[i].end = CMTimeGetSeconds(CMTimeRangeGetEnd(timeRange));
+    }
+
+    [self updateWithRanges:ranges count:count atTime:timestamp];
+
+    free(ranges);
+}
+
+- (void)advanceToTime:(NSTimeInterval)timestamp {
+    [self recordLoadedTime:0 atTime:timestamp];
+}
+
+- (void)recordLoadedTime:(NSTimeInterval)loadedTime atTime:(NSTimeInterval)timestamp {
+
+    if (_lastSampleTime < 0) {
+        // The first update only establishes when sampling begins, since it is unknown how long the initial ranges took to load
+        _lastSampleTime = timestamp;
+        return;
+    }
+
+    _pendingLoadedTime += MAX(loadedTime, 0);
+
+    NSTimeInterval elapsed = timestamp - _lastSampleTime;
+
+    if (elapsed < self.sampleInterval) {
+        return;
+    }
+
+    double sample = _pendingLoadedTime / elapsed;
+
+    if (_hasThroughputSample) {
+        _throughput = (self.smoothingFactor * sample) + ((1.0 - self.smoothingFactor) * _throughput);
+    } else {
+        _throughput = sample;
+        _hasThroughputSample = YES;
+    }
+
+    _pendingLoadedTime = 0;
+    _lastSampleTime = timestamp;
+}
+
+#pragma mark - Query Methods
+
+/// Index of the range which contains the given time, or NSNotFound
+- (NSUInteger)indexOfRangeContainingTime:(NSTimeInterval)time {
+    NSUInteger index = [self indexOfFirstRangeEndingAfter:time - ABBufferMonitorEpsilon];
+
+    if (index < _count && _ranges[index].start <= time + ABBufferMonitorEpsilon) {
+        return index;
+    }
+
+    return NSNotFound;
+}
+
+- (BOOL)containsTime:(NSTimeInterval)time {
+    return [self indexOfRangeContainingTime:time] != NSNotFound;
+}
+
+- (NSTimeInterval)bufferedEndFromTime:(NSTimeInterval)time {
+    NSUInteger index = [self indexOfRangeContainingTime:time];
+
+    if (index == NSNotFound) {
+        return time;
+    }
+
+    return MAX(_ranges[index].end, time);
+}
+
+- (NSTimeInterval)bufferedAheadOfTime:(NSTimeInterval)time {
+    return [self bufferedEndFromTime:time] - time;
+}
+
+- (BOOL)isFullyBufferedForDuration:(NSTimeInterval)duration {
+
+    if (_count == 0 || isnan(duration) || isinf(duration) || duration <= 0) {
+        return NO;
+    }
+
+    NSTimeInterval missing = MAX(_ranges[0].start, 0);
+
+    for (NSUInteger i = 1; i < _count && _ranges[i].start < duration; i++) {
+        missing += _ranges[i].start - _ranges[i - 1].end;
+    }
+
+    missing += MAX(duration - _ranges[_count - 1].end, 0);
+
+    return missing <= self.completionTolerance;
+}
+
+- (NSTimeInterval)timeToStallFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration rate:(float)rate {
+
+    if (rate <= 0 || isnan(time)) {
+        return INFINITY;
+    }
+
+    BOOL hasDuration = (!isnan(duration) && !isinf(duration) && duration > 0);
+    NSTimeInterval bufferedEnd = [self bufferedEndFromTime:time];
+
+    if (hasDuration && bufferedEnd >= duration - self.completionTolerance) {
+        return INFINITY;
+    }
+
+    if (_throughput >= rate) {
+        return INFINITY;
+    }
+
+    NSTimeInterval ahead = bufferedEnd - time;
+    NSTimeInterval timeToStall = ahead / (rate - _throughput);
+
+    // If the rest of the media finishes downloading before the playhead catches up, playback will not stall
+    if (hasDuration && _throughput > 0) {
+        NSTimeInterval timeToComplete = (duration - bufferedEnd) / _throughput;
+
+        if (timeToComplete <= timeToStall) {
+            return INFINITY;
+        }
+    }
+
+    return timeToStall;
+}
+
+@end
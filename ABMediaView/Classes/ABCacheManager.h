@@ -10,11 +10,16 @@
 #import <UIKit/UIKit.h>
 #import "UIImage+animatedGIF.h"
 #import <AVFoundation/AVFoundation.h>
+#import "ABMediaBuffer.h"
+#import "ABVideoMetadata.h"
+#import "ABAudioWaveform.h"
 
 typedef void (^ImageDataBlock)(UIImage *image, NSString *key, NSError *error);
 typedef void (^VideoDataBlock)(NSURL *videoPath, NSString *key, NSError *error);
 typedef void (^AudioDataBlock)(NSURL *audioPath, NSString *key, NSError *error);
 typedef void (^GIFDataBlock)(UIImage *gif, NSString *key, NSError *error);
+typedef void (^VideoMetadataDataBlock)(ABVideoMetadata *metadata, NSString *key, NSError *error);
+typedef void (^AudioWaveformDataBlock)(ABAudioWaveform *waveform, NSString *key, NSError *error);
 
 /// Different types of caches
 typedef NS_ENUM(NSInteger, CacheType) {
@@ -22,6 +27,8 @@ typedef NS_ENUM(NSInteger, CacheType) {
     VideoCache,
     AudioCache,
     GIFCache,
+    MetadataCache,
+    WaveformCache,
 };
 
 @interface ABCacheManager : NSObject
@@ -38,18 +45,30 @@ typedef NS_ENUM(NSInteger, CacheType) {
 /// Queue which holds requests for downloading audio
 @property (strong, nonatomic) NSCache *audioQueue;
 
-/// Cache which holds images
+/// Queue which holds requests for probing video metadata
+@property (strong, nonatomic) NSCache *metadataQueue;
+
+/// Queue which holds requests for summarizing audio waveforms
+@property (strong, nonatomic) NSCache *waveformQueue;
+
+/// Cache which holds images, as ABMediaBuffers costed by their bytes
 @property (strong, nonatomic) NSCache *imageCache;
 
 /// Cache which holds paths to videos on disk
 @property (strong, nonatomic) NSCache *videoCache;
 
-/// Cache which holds GIFs
+/// Cache which holds GIFs, as ABMediaBuffers costed by their bytes
 @property (strong, nonatomic) NSCache *gifCache;
 
 /// Cache which holds paths to audio on disk
 @property (strong, nonatomic) NSCache *audioCache;
 
+/// Cache which holds ABVideoMetadata probed from videos
+@property (strong, nonatomic) NSCache *metadataCache;
+
+/// Cache which holds ABAudioWaveforms of audio on disk
+@property (strong, nonatomic) NSCache *waveformCache;
+
 /// Determines whether media should be cached when downloaded
 @property (nonatomic) BOOL cacheMediaWhenDownloaded;
 
@@ -62,6 +81,9 @@ typedef NS_ENUM(NSInteger, CacheType) {
 /// Get object within cache (image, GIF, video or audio location)
 - (id)getCache:(CacheType)type objectForKey:(NSString *)key;
 
+/// Get the shared buffer within the image or GIF cache
+- (ABMediaBuffer *)getBuffer:(CacheType)type forKey:(NSString *)key;
+
 /// Class method for checking if an object is in the cache
 + (id)getCache:(CacheType)type objectForKey:(NSString *)key;
 
@@ -101,6 +123,12 @@ typedef NS_ENUM(NSInteger, CacheType) {
 /// Load audio and store in cache, or retrieve audio from cache if already stored
 + (void)loadAudioURL:(NSURL *)url completion:(AudioDataBlock)completionBlock;
 
+/// Probe the duration, dimensions, codecs and keyframes of a video from its moov box, and store them in the cache, or retrieve them from cache if already stored
++ (void)loadVideoMetadataURL:(NSURL *)url completion:(VideoMetadataDataBlock)completionBlock;
+
+/// Load the waveform summary stored next to an audio file on disk, or decode the file in the background and store its summary, and keep the waveform in the cache
++ (void)loadAudioWaveformURL:(NSURL *)fileURL completion:(AudioWaveformDataBlock)completionBlock;
+
 /// Load audio from the iPod music library directory
 + (void)loadMusicLibrary:(NSString *)urlString completion:(AudioDataBlock)completionBlock;
 
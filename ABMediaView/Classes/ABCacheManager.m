@@ -8,6 +8,9 @@
 
 #import "ABCacheManager.h"
 #import "ABCommons.h"
+#import "ABCompletionRegistry.h"
+#import "ABMediaBufferPool.h"
+#import "ABLoadTrace.h"
 
 @implementation ABCacheManager
 
@@ -32,17 +35,29 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
     if (self = [super init]) {
         // Initialize caches
         [self resetAllCaches];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(handleMemoryWarning)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
     }
     return self;
 }
 
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void)handleMemoryWarning {
+    // GIFs which are still on screen stay resident through their mediaViews, and are found again in the buffer pool
+    [self resetCache:GIFCache];
+}
+
 - (id)getCache:(CacheType)type objectForKey:(NSString *)key {
     
     if ([ABCommons notNull:key]) {
         
         switch (type) {
             case ImageCache:
-                return [self.imageCache objectForKey:key];
+                return [self getBuffer:type forKey:key].image;
                 break;
             case VideoCache:
                 return [self.videoCache objectForKey:key];
@@ -51,7 +66,13 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
                 return [self.audioCache objectForKey:key];
                 break;
             case GIFCache:
-                return [self.gifCache objectForKey:key];
+                return [self getBuffer:type forKey:key].image;
+                break;
+            case MetadataCache:
+                return [self.metadataCache objectForKey:key];
+                break;
+            case WaveformCache:
+                return [self.waveformCache objectForKey:key];
                 break;
                 
             default:
@@ -64,13 +85,58 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
     return nil;
 }
 
+- (ABMediaBuffer *)getBuffer:(CacheType)type forKey:(NSString *)key {
+    
+    if ([ABCommons notNull:key]) {
+        id object = nil;
+        
+        switch (type) {
+            case ImageCache:
+                object = [self.imageCache objectForKey:key];
+                break;
+            case GIFCache:
+                object = [self.gifCache objectForKey:key];
+                
+                // A GIF evicted from the cache may still be shown by a mediaView, and is kept rather than decoded again
+                if ([ABCommons isNull:object]) {
+                    object = [[ABMediaBufferPool sharedManager] bufferForKey:key];
+                    
+                    if ([ABCommons notNull:object]) {
+                        [self setCache:type object:object forKey:key];
+                    }
+                }
+                break;
+                
+            default:
+                break;
+        }
+        
+        // Images placed in the cache directly, rather than through setCache, are wrapped when they are first read
+        if ([object isKindOfClass:[UIImage class]]) {
+            object = [[ABMediaBufferPool sharedManager] bufferWithImage:object data:nil forKey:key];
+            [self setCache:type object:object forKey:key];
+        }
+        
+        return object;
+    }
+    
+    return nil;
+}
+
 - (void)setCache:(CacheType)type object:(id)object forKey:(NSString *)key {
     
     if ([ABCommons notNull:object] && [ABCommons notNull:key]) {
         
+        // Images and GIFs are kept as shared buffers, so the cache and every mediaView showing them hold the same bytes
+        ABMediaBuffer *buffer = nil;
+        
+        if (type == ImageCache || type == GIFCache) {
+            buffer = [object isKindOfClass:[ABMediaBuffer class]] ? object : [[ABMediaBufferPool sharedManager] bufferWithImage:object data:nil forKey:key];
+        }
+        
         switch (type) {
             case ImageCache:
-                [self.imageCache setObject:object forKey:key];
+                [self.imageCache setObject:buffer forKey:key cost:buffer.byteCount];
                 break;
             case VideoCache:
                 [self.videoCache setObject:object forKey:key];
@@ -79,7 +145,13 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
                 [self.audioCache setObject:object forKey:key];
                 break;
             case GIFCache:
-                [self.gifCache setObject:object forKey:key];
+                [self.gifCache setObject:buffer forKey:key cost:buffer.byteCount];
+                break;
+            case MetadataCache:
+                [self.metadataCache setObject:object forKey:key];
+                break;
+            case WaveformCache:
+                [self.waveformCache setObject:object forKey:key];
                 break;
             default:
                 
@@ -107,6 +179,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
             case GIFCache:
                 [self.gifCache removeObjectForKey:key];
                 break;
+            case MetadataCache:
+                [self.metadataCache removeObjectForKey:key];
+                break;
+            case WaveformCache:
+                [self.waveformCache removeObjectForKey:key];
+                break;
             
                 
             default:
@@ -135,6 +213,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
             case GIFCache:
                 return [self.gifQueue objectForKey:key];
                 break;
+            case MetadataCache:
+                return [self.metadataQueue objectForKey:key];
+                break;
+            case WaveformCache:
+                return [self.waveformQueue objectForKey:key];
+                break;
                 
             default:
                 return nil;
@@ -163,6 +247,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
             case GIFCache:
                 [self.gifQueue setObject:object forKey:key];
                 break;
+            case MetadataCache:
+                [self.metadataQueue setObject:object forKey:key];
+                break;
+            case WaveformCache:
+                [self.waveformQueue setObject:object forKey:key];
+                break;
                 
             default:
                 
@@ -190,6 +280,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
             case GIFCache:
                 [self.gifQueue removeObjectForKey:key];
                 break;
+            case MetadataCache:
+                [self.metadataQueue removeObjectForKey:key];
+                break;
+            case WaveformCache:
+                [self.waveformQueue removeObjectForKey:key];
+                break;
                 
             default:
                 
@@ -275,9 +371,15 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
     
         if ([ABCommons notNull:data]) {
             
-            UIImage *image = [UIImage animatedImageWithAnimatedGIFData:data];
+            // The same bytes shown by many mediaViews are only decoded once
+            ABMediaBuffer *buffer = [[ABMediaBufferPool sharedManager] bufferForData:data];
+            
+            if ([ABCommons isNull:buffer.image]) {
+                UIImage *image = [UIImage animatedImageWithAnimatedGIFData:data];
+                buffer = [ABCommons notNull:image] ? [[ABMediaBufferPool sharedManager] bufferWithImage:image data:data forKey:nil] : nil;
+            }
             
-            if(completionBlock) completionBlock(image, nil, nil);
+            if(completionBlock) completionBlock(buffer.image, nil, nil);
             
         } else {
             
@@ -317,6 +419,8 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
             
             if ([ABCommons notNull: fileImage]) {
                 
+                [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:fileImage error:nil];
+                
                 if(completionBlock) completionBlock(fileImage, urlString, nil);
                 
             }
@@ -330,23 +434,32 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
                         
                         NSURLSessionTask *task = [[NSURLSession sharedSession] dataTaskWithURL:url completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
                             
+                            UIImage *image = nil;
+                            
                             if (data) {
-                                UIImage *image = [UIImage imageWithData:data];
+                                image = [UIImage imageWithData:data];
+                            }
+                            
+                            dispatch_async(dispatch_get_main_queue(), ^{
                                 
                                 if (image) {
-                                    dispatch_async(dispatch_get_main_queue(), ^{
-                                        if ([ABCommons notNull:urlString] && [ABCommons notNull:image] && [[ABCacheManager sharedManager] cacheMediaWhenDownloaded]) {
-                                            [ABCacheManager setCache:type object:image forKey:urlString];
-                                        }
-                                        
-                                        [[ABCacheManager sharedManager] removeFromQueue:type forKey:urlString];
-                                        
-                                        if(completionBlock) completionBlock(image, urlString, nil);
-                                        
-                                    });
+                                    if ([ABCommons notNull:urlString] && [ABCommons notNull:image] && [[ABCacheManager sharedManager] cacheMediaWhenDownloaded]) {
+                                        [ABCacheManager setCache:type object:image forKey:urlString];
+                                    }
+                                    
+                                    [[ABCacheManager sharedManager] removeFromQueue:type forKey:urlString];
+                                    
+                                    [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:image error:nil];
+                                    
+                                    if(completionBlock) completionBlock(image, urlString, nil);
+                                } else {
+                                    // Waiters are told of the failure, and the image can be requested again
+                                    [[ABCacheManager sharedManager] removeFromQueue:type forKey:urlString];
+                                    
+                                    [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:nil error:error];
                                 }
                                 
-                            }
+                            });
                             
                         }];
                         
@@ -366,16 +479,22 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
 }
 
 + (void)loadVideo:(NSString *)urlString completion:(AudioDataBlock)completionBlock {
+    uint64_t loadTraceID = ABLoadTraceCurrentLoad();
+    ABLoadTraceBegin(loadTraceID, ABLoadTraceStageMainQueueHop);
+    
     dispatch_async(dispatch_get_main_queue(), ^{
+        ABLoadTraceEnd(loadTraceID, ABLoadTraceStageMainQueueHop);
         
         if ([ABCommons notNull:urlString]) {
             NSURL *url = [NSURL URLWithString:urlString];
             
-            [ABCacheManager loadVideoURL:url completion:^(NSURL *videoPath, NSString *key, NSError *error) {
-                
-                if(completionBlock) completionBlock(videoPath, key, error);
-                
-            }];
+            ABLoadTracePerform(loadTraceID, ^{
+                [ABCacheManager loadVideoURL:url completion:^(NSURL *videoPath, NSString *key, NSError *error) {
+                    
+                    if(completionBlock) completionBlock(videoPath, key, error);
+                    
+                }];
+            });
             
         }
         else {
@@ -386,7 +505,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
 }
 
 + (void)loadVideoURL:(NSURL *)url completion:(VideoDataBlock)completionBlock {
+    // Stages are keyed to the load which called, as it is no longer current once the blocks below run
+    uint64_t loadTraceID = ABLoadTraceCurrentLoad();
+    ABLoadTraceBegin(loadTraceID, ABLoadTraceStageMainQueueHop);
+    
     dispatch_async(dispatch_get_main_queue(), ^{
+        ABLoadTraceEnd(loadTraceID, ABLoadTraceStageMainQueueHop);
         CacheType type = VideoCache;
         
         if ([ABCommons notNull:url]) {
@@ -402,11 +526,18 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
                     
                 }
                 else {
+                    ABLoadTraceBegin(loadTraceID, ABLoadTraceStageDetectURL);
+                    
                     [ABCacheManager detectIfURL:url isValidForCacheType:type completion:^(BOOL isValidURL) {
+                        ABLoadTraceEnd(loadTraceID, ABLoadTraceStageDetectURL);
+                        
                         if (isValidURL) {
+                            ABLoadTraceBegin(loadTraceID, ABLoadTraceStageDownload);
+                            
                             //download the file in a seperate thread.
                             dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
                                 NSData *urlData = [NSData dataWithContentsOfURL:url];
+                                ABLoadTraceEnd(loadTraceID, ABLoadTraceStageDownload);
                                 
                                 if (urlData)
                                 {
@@ -428,9 +559,15 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
                                     }
                                     
                                     //saving is done on main thread
+                                    ABLoadTraceBegin(loadTraceID, ABLoadTraceStageMainQueueHop);
+                                    
                                     dispatch_async(dispatch_get_main_queue(), ^{
+                                        ABLoadTraceEnd(loadTraceID, ABLoadTraceStageMainQueueHop);
+                                        
                                         NSError * error = nil;
+                                        ABLoadTraceBegin(loadTraceID, ABLoadTraceStageFileWrite);
                                         BOOL success = [urlData writeToFile:filePath options:NSDataWritingAtomic error:&error];
+                                        ABLoadTraceEnd(loadTraceID, ABLoadTraceStageFileWrite);
 //                                        NSLog(@"Success = %d, error = %@", success, error);
                                         
                                         if (success) {
@@ -509,10 +646,10 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
             NSString *urlString = url.absoluteString;
             NSURL *filePath = [ABCacheManager getCache:type objectForKey:urlString];
             if ([ABCommons notNull: filePath]) {
-                [[NSNotificationCenter defaultCenter] postNotificationName:url.absoluteString object:nil];
-                
                 [[ABCacheManager sharedManager] removeFromQueue:type forKey:urlString];
                 
+                [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:filePath error:nil];
+                
                 if(completionBlock) completionBlock(filePath, urlString, nil);
                 
             } else {
@@ -551,7 +688,7 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
                                         if ([ABCommons notNull:urlString] && [ABCommons notNull:cachedURL]) {
                                             [ABCacheManager setCache:type object:cachedURL forKey:urlString];
                                             
-                                            [[NSNotificationCenter defaultCenter] postNotificationName:url.absoluteString object:nil];
+                                            [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:cachedURL error:nil];
                                         }
                                         
                                         
@@ -592,6 +729,93 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
     
 }
 
++ (void)loadVideoMetadataURL:(NSURL *)url completion:(VideoMetadataDataBlock)completionBlock {
+    dispatch_async(dispatch_get_main_queue(), ^{
+        CacheType type = MetadataCache;
+        
+        if ([ABCommons notNull:url]) {
+            NSString *urlString = url.absoluteString;
+            ABVideoMetadata *metadata = [ABCacheManager getCache:type objectForKey:urlString];
+            
+            if ([ABCommons notNull:metadata]) {
+                
+                [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:metadata error:nil];
+                
+                if(completionBlock) completionBlock(metadata, urlString, nil);
+                
+            } else if ([[ABCacheManager sharedManager] getQueue:type objectForKey:urlString] == nil) {
+                
+                [[ABCacheManager sharedManager] addQueue:type object:urlString forKey:urlString];
+                
+                [ABVideoMetadata probeURL:url completion:^(ABVideoMetadata *metadata, NSError *error) {
+                    
+                    // Metadata is small, so it is kept even when media is not cached
+                    if ([ABCommons notNull:metadata]) {
+                        [ABCacheManager setCache:type object:metadata forKey:urlString];
+                    }
+                    
+                    [[ABCacheManager sharedManager] removeFromQueue:type forKey:urlString];
+                    
+                    [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:metadata error:error];
+                    
+                    if(completionBlock) completionBlock(metadata, urlString, error);
+                    
+                }];
+                
+            }
+            
+        } else {
+            
+            if(completionBlock) completionBlock(nil, nil, nil);
+            
+        }
+        
+    });
+}
+
++ (void)loadAudioWaveformURL:(NSURL *)fileURL completion:(AudioWaveformDataBlock)completionBlock {
+    dispatch_async(dispatch_get_main_queue(), ^{
+        CacheType type = WaveformCache;
+        
+        if ([ABCommons notNull:fileURL] && fileURL.isFileURL) {
+            NSString *urlString = fileURL.absoluteString;
+            ABAudioWaveform *waveform = [ABCacheManager getCache:type objectForKey:urlString];
+            
+            if ([ABCommons notNull:waveform]) {
+                
+                [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:waveform error:nil];
+                
+                if(completionBlock) completionBlock(waveform, urlString, nil);
+                
+            } else if ([[ABCacheManager sharedManager] getQueue:type objectForKey:urlString] == nil) {
+                
+                [[ABCacheManager sharedManager] addQueue:type object:urlString forKey:urlString];
+                
+                [ABAudioWaveform loadWaveformForFileURL:fileURL completion:^(ABAudioWaveform *waveform, NSError *error) {
+                    
+                    if ([ABCommons notNull:waveform]) {
+                        [ABCacheManager setCache:type object:waveform forKey:urlString];
+                    }
+                    
+                    [[ABCacheManager sharedManager] removeFromQueue:type forKey:urlString];
+                    
+                    [[ABCompletionRegistry sharedManager] notifyType:type key:urlString object:waveform error:error];
+                    
+                    if(completionBlock) completionBlock(waveform, urlString, error);
+                    
+                }];
+                
+            }
+            
+        } else {
+            
+            if(completionBlock) completionBlock(nil, nil, nil);
+            
+        }
+        
+    });
+}
+
 + (void)loadMusicLibrary:(NSString *)urlString completion:(AudioDataBlock)completionBlock {
     dispatch_async(dispatch_get_main_queue(), ^{
         CacheType type = AudioCache;
@@ -794,11 +1018,13 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
     } else if (type == AudioDirectoryItems) {
         path = [NSHomeDirectory() stringByAppendingPathComponent:@"Documents/ABMedia/Audio/"];
         [[ABCacheManager sharedManager] resetCache: AudioCache];
+        [[ABCacheManager sharedManager] resetCache: WaveformCache];
     } else if (type == TempDirectoryItems) {
         path = [NSHomeDirectory() stringByAppendingPathComponent:@"tmp/"];
     } else {
         [[ABCacheManager sharedManager] resetCache: VideoCache];
         [[ABCacheManager sharedManager] resetCache: AudioCache];
+        [[ABCacheManager sharedManager] resetCache: WaveformCache];
     }
     
     NSArray *array = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:path error:nil];
@@ -852,6 +1078,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
         case GIFCache:
             return self.gifCache;
             break;
+        case MetadataCache:
+            return self.metadataCache;
+            break;
+        case WaveformCache:
+            return self.waveformCache;
+            break;
             
         default:
             return nil;
@@ -875,6 +1107,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
         case GIFCache:
             return self.gifQueue;
             break;
+        case MetadataCache:
+            return self.metadataQueue;
+            break;
+        case WaveformCache:
+            return self.waveformQueue;
+            break;
             
         default:
             return nil;
@@ -974,6 +1212,12 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
         case GIFCache:
             self.gifCache = [[NSCache alloc] init];
             break;
+        case MetadataCache:
+            self.metadataCache = [[NSCache alloc] init];
+            break;
+        case WaveformCache:
+            self.waveformCache = [[NSCache alloc] init];
+            break;
         case AudioCache:
             self.audioCache = [[NSCache alloc] init];
             break;
@@ -989,11 +1233,15 @@ typedef NS_ENUM(NSInteger, DirectoryItemType) {
     self.videoCache = [[NSCache alloc] init];
     self.audioCache = [[NSCache alloc] init];
     self.gifCache = [[NSCache alloc] init];
+    self.metadataCache = [[NSCache alloc] init];
+    self.waveformCache = [[NSCache alloc] init];
     
     self.imageQueue = [[NSCache alloc] init];
     self.videoQueue = [[NSCache alloc] init];
     self.audioQueue = [[NSCache alloc] init];
     self.gifQueue = [[NSCache alloc] init];
+    self.metadataQueue = [[NSCache alloc] init];
+    self.waveformQueue = [[NSCache alloc] init];
 }
 
 + (id)getCache:(CacheType)type objectForKey:(NSString *)key {
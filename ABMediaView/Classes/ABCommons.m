@@ -8,6 +8,101 @@
 
 #import "ABCommons.h"
 
+/// Steps of ABCommonsNormalizeText, which are applied together in a single pass
+typedef NS_OPTIONS(NSUInteger, ABTextNormalization) {
+    /// Removes whitespace and newlines from both ends
+    ABTextNormalizationTrim = 1 << 0,
+    /// Replaces runs of spaces with one space, and runs of newlines with one newline
+    ABTextNormalizationCollapse = 1 << 1,
+    /// Removes every space and newline
+    ABTextNormalizationRemoveSpaces = 1 << 2,
+    /// Removes everything but the letters a to z and A to Z
+    ABTextNormalizationLettersOnly = 1 << 3,
+};
+
+/// Number of characters normalized on the stack before a buffer is allocated
+static const NSUInteger ABCommonsStackCharacterCount = 256;
+
+/// Determines if the UTF-16 unit is in the whitespaceAndNewlineCharacterSet, checking ASCII without the set
+static inline BOOL ABCommonsIsWhitespace(unichar character) {
+    
+    if (character < 0x80) {
+        return (character == ' ' || (character >= '\t' && character <= '\r'));
+    }
+    
+    static CFCharacterSetRef whitespaceSet = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        whitespaceSet = CFCharacterSetGetPredefined(kCFCharacterSetWhitespaceAndNewline);
+    });
+    
+    return CFCharacterSetIsCharacterMember(whitespaceSet, character);
+}
+
+/// Applies the normalization steps in one pass over the UTF-16 units of the text, compacting them in place. Returns the text itself when nothing changed, so that clean titles are not copied.
+static NSString *ABCommonsNormalizeText(NSString *text, ABTextNormalization options) {
+    NSUInteger length = text.length;
+    
+    if (length == 0) {
+        return text;
+    }
+    
+    unichar stackCharacters[ABCommonsStackCharacterCount];
+    unichar *characters = (length <= ABCommonsStackCharacterCount) ? stackCharacters : malloc(length * sizeof(unichar));
+    [text getCharacters:characters range:NSMakeRange(0, length)];
+    
+    NSUInteger start = 0;
+    NSUInteger end = length;
+    
+    if (options & ABTextNormalizationTrim) {
+        
+        while (start < end && ABCommonsIsWhitespace(characters[start])) {
+            start++;
+        }
+        
+        while (end > start && ABCommonsIsWhitespace(characters[end - 1])) {
+            end--;
+        }
+        
+    }
+    
+    NSUInteger count = 0;
+    unichar previous = 0;
+    
+    for (NSUInteger i = start; i < end; i++) {
+        unichar character = characters[i];
+        BOOL isSpace = (character == ' ' || character == '\n');
+        
+        if (options & ABTextNormalizationLettersOnly) {
+            unichar lowercase = character | 0x20;
+            
+            if (character >= 0x80 || lowercase < 'a' || lowercase > 'z') {
+                continue;
+            }
+            
+        } else if (isSpace && (options & ABTextNormalizationRemoveSpaces)) {
+            continue;
+        } else if (isSpace && character == previous && (options & ABTextNormalizationCollapse)) {
+            continue;
+        }
+        
+        previous = character;
+        characters[count++] = character;
+    }
+    
+    NSString *normalized = text;
+    
+    if (count != length) {
+        normalized = [[NSString alloc] initWithCharacters:characters length:count];
+    }
+    
+    if (characters != stackCharacters) {
+        free(characters);
+    }
+    
+    return normalized;
+}
+
 @implementation ABCommons
 
 #pragma mark - Conditional Oriented
@@ -68,14 +163,13 @@
 #pragma mark - String Modification Oriented
 
 + (NSString *)removeSpecialCharacters:(NSString *)text {
-    NSCharacterSet *notAllowedChars = [[NSCharacterSet characterSetWithCharactersInString:@"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"] invertedSet];
-    return  [[text componentsSeparatedByCharactersInSet:notAllowedChars] componentsJoinedByString:@""];
+    return ABCommonsNormalizeText(text, ABTextNormalizationLettersOnly);
 }
 
 + (NSString *)trimWhiteSpace:(NSString *)text {
     
     if ([ABCommons notNull:text]) {
-        text = [text stringByTrimmingCharactersInSet: [NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        text = ABCommonsNormalizeText(text, ABTextNormalizationTrim);
     }
     
     return text;
@@ -84,15 +178,7 @@
 + (NSString *)trimMultiSpace:(NSString *)text {
     
     if ([ABCommons notNull:text]) {
-        
-        while ([text containsString:@"  "]) {
-            text = [text stringByReplacingOccurrencesOfString:@"  " withString:@" "];
-        }
-        
-        while ([text containsString:@"\n\n"]) {
-            text = [text stringByReplacingOccurrencesOfString:@"\n\n" withString:@"\n"];
-        }
-        
+        text = ABCommonsNormalizeText(text, ABTextNormalizationCollapse);
     }
     
     return text;
@@ -101,25 +187,31 @@
 + (NSString *)trimWhiteAndMultiSpace:(NSString *)text {
     
     if ([ABCommons notNull:text]) {
-        text = [ABCommons trimWhiteSpace:text];
-        text = [ABCommons trimMultiSpace:text];
+        text = ABCommonsNormalizeText(text, ABTextNormalizationTrim | ABTextNormalizationCollapse);
     }
     
     return text;
 }
 
 + (NSString *)removeSpaces:(NSString *)text {
-    text = [self trimWhiteAndMultiSpace:text];
-    text = [text stringByReplacingOccurrencesOfString:@" " withString:@""];
-    text = [text stringByReplacingOccurrencesOfString:@"\n" withString:@""];
-    return text;
+    return ABCommonsNormalizeText(text, ABTextNormalizationTrim | ABTextNormalizationRemoveSpaces);
 }
 
 + (BOOL)isValidEntry:(NSString *)text {
     
-    if ([ABCommons notNull:text]) {
+    if ([ABCommons isNull:text]) {
+        return NO;
+    }
+    
+    // Removing spaces leaves something exactly when there is a character which is not whitespace, so the first one found decides without building a string
+    CFStringRef string = (__bridge CFStringRef)text;
+    CFStringInlineBuffer buffer;
+    CFIndex length = CFStringGetLength(string);
+    CFStringInitInlineBuffer(string, &buffer, CFRangeMake(0, length));
+    
+    for (CFIndex i = 0; i < length; i++) {
         
-        if ([ABCommons notBlank:[ABCommons removeSpaces:text]]) {
+        if (!ABCommonsIsWhitespace(CFStringGetCharacterFromInlineBuffer(&buffer, i))) {
             return YES;
         }
         
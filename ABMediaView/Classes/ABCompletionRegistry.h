@@ -0,0 +1,35 @@
+//
+//  ABCompletionRegistry.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import "ABCacheManager.h"
+
+/// Called with the waiter which subscribed, and the object loaded for the key (nil if loading failed). Handlers should not capture the waiter strongly.
+typedef void (^ABCompletionHandler)(id waiter, id object, NSError *error);
+
+/// Delivers the results of cache loads to the objects waiting on them, keyed by cache type and key. Waiters are held weakly, so subscriptions are dropped when a waiter is deallocated. Must be used on the main queue.
+@interface ABCompletionRegistry : NSObject
+
+/// Shared Manager for Completion Registry
++ (id)sharedManager;
+
+/// Subscribes the waiter to the next load of the key. A waiter has at most one subscription per cache type, so subscribing again (e.g. when a view is reused) replaces the previous one.
+- (void)addWaiter:(id)waiter forType:(CacheType)type key:(NSString *)key handler:(ABCompletionHandler)handler;
+
+/// Drops the waiter's subscription for the cache type
+- (void)removeWaiter:(id)waiter forType:(CacheType)type;
+
+/// Drops all of the waiter's subscriptions
+- (void)removeWaiter:(id)waiter;
+
+/// Calls the handler of every live waiter subscribed to the key, and drops their subscriptions. Returns the number of waiters notified.
+- (NSUInteger)notifyType:(CacheType)type key:(NSString *)key object:(id)object error:(NSError *)error;
+
+/// Number of live waiters subscribed to the key
+- (NSUInteger)waiterCountForType:(CacheType)type key:(NSString *)key;
+
+@end
@@ -0,0 +1,233 @@
+//
+//  ABCompletionRegistry.m
+//  Pods
+//
+//
+//
+
+#import "ABCompletionRegistry.h"
+#import "ABCommons.h"
+
+/// Smallest number of subscriptions a key holds before dead ones are pruned
+static const NSUInteger ABCompletionRegistryMinimumPruneThreshold = 32;
+
+/// A waiter's subscription to the load of a key
+@interface ABCompletionSubscription : NSObject
+
+@property (weak, nonatomic) id waiter;
+
+@property (copy, nonatomic) ABCompletionHandler handler;
+
+/// Determines if the subscription was replaced or removed, it is dropped from its key lazily
+@property (nonatomic) BOOL cancelled;
+
+@end
+
+@implementation ABCompletionSubscription
+
+@end
+
+/// Subscriptions to a single key
+@interface ABCompletionWaitList : NSObject
+
+@property (strong, nonatomic) NSMutableArray<ABCompletionSubscription *> *subscriptions;
+
+/// Count at which dead and cancelled subscriptions are next pruned
+@property (nonatomic) NSUInteger pruneThreshold;
+
+@end
+
+@implementation ABCompletionWaitList
+
+- (id)init {
+    if (self = [super init]) {
+        self.subscriptions = [[NSMutableArray alloc] init];
+        self.pruneThreshold = ABCompletionRegistryMinimumPruneThreshold;
+    }
+    return self;
+}
+
+- (void)addSubscription:(ABCompletionSubscription *)subscription {
+    
+    // Pruning when the list doubles keeps adds amortized constant, even when waiters are never notified
+    if (self.subscriptions.count >= self.pruneThreshold) {
+        NSIndexSet *dead = [self.subscriptions indexesOfObjectsPassingTest:^BOOL(ABCompletionSubscription *obj, NSUInteger idx, BOOL *stop) {
+            return obj.cancelled || [ABCommons isNull:obj.waiter];
+        }];
+        
+        [self.subscriptions removeObjectsAtIndexes:dead];
+        self.pruneThreshold = MAX(self.subscriptions.count * 2, ABCompletionRegistryMinimumPruneThreshold);
+    }
+    
+    [self.subscriptions addObject:subscription];
+}
+
+@end
+
+@interface ABCompletionRegistry ()
+
+/// Wait lists keyed by cache key, one dictionary per cache type
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, NSMutableDictionary<NSString *, ABCompletionWaitList *> *> *waitLists;
+
+/// Subscriptions of each waiter keyed by cache type, with the waiters held weakly
+@property (strong, nonatomic) NSMapTable *subscriptionsByWaiter;
+
+@end
+
+@implementation ABCompletionRegistry
+
++ (id)sharedManager {
+    static ABCompletionRegistry *sharedMyManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedMyManager = [[self alloc] init];
+    });
+    return sharedMyManager;
+}
+
+- (id)init {
+    if (self = [super init]) {
+        self.waitLists = [[NSMutableDictionary alloc] init];
+        self.subscriptionsByWaiter = [NSMapTable weakToStrongObjectsMapTable];
+    }
+    return self;
+}
+
+- (NSMutableDictionary<NSString *, ABCompletionWaitList *> *)waitListsForType:(CacheType)type {
+    NSMutableDictionary *waitLists = self.waitLists[@(type)];
+    
+    if ([ABCommons isNull:waitLists]) {
+        waitLists = [[NSMutableDictionary alloc] init];
+        self.waitLists[@(type)] = waitLists;
+    }
+    
+    return waitLists;
+}
+
+- (void)addWaiter:(id)waiter forType:(CacheType)type key:(NSString *)key handler:(ABCompletionHandler)handler {
+    
+    if ([ABCommons isNull:waiter] || [ABCommons isNull:key] || [ABCommons isNull:handler]) {
+        return;
+    }
+    
+    [self removeWaiter:waiter forType:type];
+    
+    ABCompletionSubscription *subscription = [[ABCompletionSubscription alloc] init];
+    subscription.waiter = waiter;
+    subscription.handler = handler;
+    
+    NSMutableDictionary *waitLists = [self waitListsForType:type];
+    ABCompletionWaitList *waitList = waitLists[key];
+    
+    if ([ABCommons isNull:waitList]) {
+        waitList = [[ABCompletionWaitList alloc] init];
+        waitLists[key] = waitList;
+    }
+    
+    [waitList addSubscription:subscription];
+    
+    NSMutableDictionary *subscriptions = [self.subscriptionsByWaiter objectForKey:waiter];
+    
+    if ([ABCommons isNull:subscriptions]) {
+        subscriptions = [[NSMutableDictionary alloc] init];
+        [self.subscriptionsByWaiter setObject:subscriptions forKey:waiter];
+    }
+    
+    subscriptions[@(type)] = subscription;
+}
+
+- (void)removeWaiter:(id)waiter forType:(CacheType)type {
+    
+    if ([ABCommons isNull:waiter]) {
+        return;
+    }
+    
+    NSMutableDictionary *subscriptions = [self.subscriptionsByWaiter objectForKey:waiter];
+    ABCompletionSubscription *subscription = subscriptions[@(type)];
+    
+    if ([ABCommons notNull:subscription]) {
+        // Cancelled in place, so removal does not scan the other waiters on the key
+        subscription.cancelled = YES;
+        subscription.handler = nil;
+        
+        [subscriptions removeObjectForKey:@(type)];
+    }
+    
+    if ([ABCommons notNull:subscriptions] && subscriptions.count == 0) {
+        [self.subscriptionsByWaiter removeObjectForKey:waiter];
+    }
+    
+}
+
+- (void)removeWaiter:(id)waiter {
+    
+    if ([ABCommons isNull:waiter]) {
+        return;
+    }
+    
+    NSMutableDictionary *subscriptions = [self.subscriptionsByWaiter objectForKey:waiter];
+    
+    for (ABCompletionSubscription *subscription in subscriptions.allValues) {
+        subscription.cancelled = YES;
+        subscription.handler = nil;
+    }
+    
+    [self.subscriptionsByWaiter removeObjectForKey:waiter];
+}
+
+- (NSUInteger)notifyType:(CacheType)type key:(NSString *)key object:(id)object error:(NSError *)error {
+    
+    if ([ABCommons isNull:key]) {
+        return 0;
+    }
+    
+    NSMutableDictionary *waitLists = self.waitLists[@(type)];
+    ABCompletionWaitList *waitList = waitLists[key];
+    
+    if ([ABCommons isNull:waitList]) {
+        return 0;
+    }
+    
+    // Removed before the handlers run, so that a handler can subscribe to the key again
+    [waitLists removeObjectForKey:key];
+    
+    NSUInteger notified = 0;
+    
+    for (ABCompletionSubscription *subscription in waitList.subscriptions) {
+        id waiter = subscription.waiter;
+        ABCompletionHandler handler = subscription.handler;
+        
+        if (subscription.cancelled || [ABCommons isNull:waiter] || [ABCommons isNull:handler]) {
+            continue;
+        }
+        
+        [self removeWaiter:waiter forType:type];
+        
+        handler(waiter, object, error);
+        notified++;
+    }
+    
+    return notified;
+}
+
+- (NSUInteger)waiterCountForType:(CacheType)type key:(NSString *)key {
+    
+    if ([ABCommons isNull:key]) {
+        return 0;
+    }
+    
+    ABCompletionWaitList *waitList = self.waitLists[@(type)][key];
+    NSUInteger count = 0;
+    
+    for (ABCompletionSubscription *subscription in waitList.subscriptions) {
+        
+        if (!subscription.cancelled && [ABCommons notNull:subscription.waiter]) {
+            count++;
+        }
+        
+    }
+    
+    return count;
+}
+
+@end
@@ -0,0 +1,105 @@
+//
+//  ABGestureLayout.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/// Distance kept between a minimized mediaView and the edges of the screen
+extern const CGFloat ABGestureLayoutMinimizedMargin;
+
+/// Everything the geometry of a fullscreen mediaView depends on. A layout only needs to be built again when one of these changes.
+typedef struct {
+    /// Bounds of the screen, in either orientation
+    CGSize screenSize;
+    BOOL isLandscape;
+    CGFloat topBuffer;
+    CGFloat bottomBuffer;
+    CGFloat minimizedWidthRatio;
+    CGFloat minimizedAspectRatio;
+} ABGestureLayoutMetrics;
+
+/// Geometry of a mediaView at one point of the minimize or dismiss gesture
+typedef struct {
+    CGRect frame;
+
+    /// Offset of the gesture, clamped to the distance it covers
+    CGFloat offset;
+
+    /// Fraction of the gesture which has been completed, from 0 to 1
+    CGFloat progress;
+
+    /// Alpha of the mediaView itself
+    CGFloat alpha;
+
+    /// Alpha of the border shown around a minimized mediaView
+    CGFloat borderAlpha;
+
+    /// Alpha of the play indicator, close button and top overlay, before each decides whether it is shown at all
+    CGFloat overlayAlpha;
+} ABGestureLayoutState;
+
+/// Returns YES if two sets of metrics give the same layout
+BOOL ABGestureLayoutMetricsEqual(ABGestureLayoutMetrics metrics, ABGestureLayoutMetrics otherMetrics);
+
+/// Frames, alphas and overlay positions of a fullscreen mediaView while it is minimized or dismissed. The ends of each gesture are computed once for a set of metrics, so each pan event only interpolates between them, without querying the screen or allocating.
+@interface ABGestureLayout : NSObject
+
+/// Metrics the layout was built for
+@property (nonatomic, readonly) ABGestureLayoutMetrics metrics;
+
+/// Determines if the layout is for a landscape screen
+@property (nonatomic, readonly) BOOL isLandscape;
+
+/// Length of the short side of the screen, which is the width of a fullscreen mediaView in portrait
+@property (nonatomic, readonly) CGFloat superviewWidth;
+
+/// Length of the long side of the screen
+@property (nonatomic, readonly) CGFloat superviewHeight;
+
+/// Width of a minimized mediaView
+@property (nonatomic, readonly) CGFloat minViewWidth;
+
+/// Height of a minimized mediaView
+@property (nonatomic, readonly) CGFloat minViewHeight;
+
+/// Vertical offset of a minimized mediaView
+@property (nonatomic, readonly) CGFloat maxViewOffset;
+
+/// Frame of the mediaView when fullscreen
+@property (nonatomic, readonly) CGRect fullscreenFrame;
+
+/// Frame of the mediaView when minimized to the bottom right corner
+@property (nonatomic, readonly) CGRect minimizedFrame;
+
+/// Height of the top overlay
+@property (nonatomic, readonly) CGFloat topOverlayHeight;
+
+/// Distance of the details label from the top of the mediaView
+@property (nonatomic, readonly) CGFloat detailsTopOffset;
+
+/// Origin of the close button
+@property (nonatomic, readonly) CGPoint closeButtonOrigin;
+
+/// Builds the layout for a set of metrics
+- (instancetype)initWithMetrics:(ABGestureLayoutMetrics)metrics;
+
+/// Distance of the title label from the top of the mediaView, which is lower when there are no details below it
+- (CGFloat)titleTopOffsetWithDetails:(BOOL)hasDetails;
+
+/// Length of the sides of the play indicator for a mediaView of the given size
+- (CGFloat)playIndicatorSizeForViewSize:(CGSize)viewSize;
+
+/// State of the mediaView when it has been dragged down to the given offset from the top of the screen, shrinking towards its minimized frame
+- (ABGestureLayoutState)minimizingStateAtOffset:(CGFloat)offset;
+
+/// State of a minimized mediaView when it has been dragged right to the given horizontal origin, fading out as it leaves the screen
+- (ABGestureLayoutState)dismissingStateAtOriginX:(CGFloat)originX;
+
+/// State of the mediaView when it has been dragged down to the given offset from the top of the screen, sliding off the bottom without shrinking
+- (ABGestureLayoutState)swipeDismissingStateAtOffset:(CGFloat)offset;
+
+@end
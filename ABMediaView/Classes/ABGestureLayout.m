@@ -0,0 +1,174 @@
+//
+//  ABGestureLayout.m
+//  Pods
+//
+//
+//
+
+#import "ABGestureLayout.h"
+
+const CGFloat ABGestureLayoutMinimizedMargin = 12.0f;
+
+BOOL ABGestureLayoutMetricsEqual(ABGestureLayoutMetrics metrics, ABGestureLayoutMetrics otherMetrics) {
+    return (CGSizeEqualToSize(metrics.screenSize, otherMetrics.screenSize) &&
+            metrics.isLandscape == otherMetrics.isLandscape &&
+            metrics.topBuffer == otherMetrics.topBuffer &&
+            metrics.bottomBuffer == otherMetrics.bottomBuffer &&
+            metrics.minimizedWidthRatio == otherMetrics.minimizedWidthRatio &&
+            metrics.minimizedAspectRatio == otherMetrics.minimizedAspectRatio);
+}
+
+/// Clamps a fraction of a gesture between 0 and 1
+static inline CGFloat ABGestureLayoutClamp(CGFloat progress) {
+    
+    if (progress > 1) {
+        return 1;
+    } else if (progress < 0 || isnan(progress)) {
+        return 0;
+    }
+    
+    return progress;
+}
+
+@interface ABGestureLayout ()
+
+/// Change in the frame from fullscreen to minimized, which minimizing interpolates along
+@property (nonatomic) CGRect minimizingDelta;
+
+/// Reciprocal of maxViewOffset, or 0 if the mediaView can not be minimized on this screen
+@property (nonatomic) CGFloat inverseMaxViewOffset;
+
+/// Horizontal origin at which dismissing a minimized mediaView begins
+@property (nonatomic) CGFloat dismissingOriginX;
+
+/// Reciprocal of the distance over which a dismissed mediaView fades out
+@property (nonatomic) CGFloat inverseDismissingDistance;
+
+/// Reciprocal of superviewHeight
+@property (nonatomic) CGFloat inverseSuperviewHeight;
+
+@end
+
+@implementation ABGestureLayout
+
+- (instancetype)initWithMetrics:(ABGestureLayoutMetrics)metrics {
+    self = [super init];
+    
+    if (self) {
+        _metrics = metrics;
+        _isLandscape = metrics.isLandscape;
+        
+        _superviewWidth = MIN(metrics.screenSize.width, metrics.screenSize.height);
+        _superviewHeight = MAX(metrics.screenSize.width, metrics.screenSize.height);
+        _minViewWidth = _superviewWidth * metrics.minimizedWidthRatio;
+        _minViewHeight = _minViewWidth * metrics.minimizedAspectRatio;
+        _maxViewOffset = _superviewHeight - (_minViewHeight + ABGestureLayoutMinimizedMargin + metrics.bottomBuffer);
+        
+        _fullscreenFrame = CGRectMake(0, 0, _superviewWidth, _superviewHeight);
+        _minimizedFrame = CGRectMake(_superviewWidth - _minViewWidth - ABGestureLayoutMinimizedMargin, _maxViewOffset, _minViewWidth, _minViewHeight);
+        
+        self.minimizingDelta = CGRectMake(_minimizedFrame.origin.x - _fullscreenFrame.origin.x,
+                                          _minimizedFrame.origin.y - _fullscreenFrame.origin.y,
+                                          _minimizedFrame.size.width - _fullscreenFrame.size.width,
+                                          _minimizedFrame.size.height - _fullscreenFrame.size.height);
+        
+        self.inverseMaxViewOffset = (_maxViewOffset > 0) ? 1.0f / _maxViewOffset : 0;
+        self.dismissingOriginX = _minimizedFrame.origin.x;
+        self.inverseDismissingDistance = (_minViewWidth > ABGestureLayoutMinimizedMargin) ? 1.0f / (_minViewWidth - ABGestureLayoutMinimizedMargin) : 0;
+        self.inverseSuperviewHeight = (_superviewHeight > 0) ? 1.0f / _superviewHeight : 0;
+        
+        // The status bar is hidden in landscape, so the overlay no longer needs to clear it
+        CGFloat topBuffer = metrics.isLandscape ? 0 : metrics.topBuffer;
+        
+        _topOverlayHeight = 50.0f + topBuffer;
+        _detailsTopOffset = 8.0f + topBuffer + 18.0f;
+        _closeButtonOrigin = CGPointMake(0, topBuffer);
+    }
+    
+    return self;
+}
+
+- (CGFloat)titleTopOffsetWithDetails:(BOOL)hasDetails {
+    CGFloat topBuffer = self.isLandscape ? 0 : self.metrics.topBuffer;
+    
+    return 8.0f + topBuffer + (hasDetails ? 0 : 8.0f);
+}
+
+- (CGFloat)playIndicatorSizeForViewSize:(CGSize)viewSize {
+    
+    if (self.superviewWidth <= 0) {
+        return 30.0f;
+    }
+    
+    CGFloat side = self.isLandscape ? viewSize.height : viewSize.width;
+    
+    return 30.0f + (30.0f * (side / self.superviewWidth));
+}
+
+- (ABGestureLayoutState)minimizingStateAtOffset:(CGFloat)offset {
+    CGFloat progress = ABGestureLayoutClamp(offset * self.inverseMaxViewOffset);
+    CGRect delta = self.minimizingDelta;
+    
+    ABGestureLayoutState state;
+    state.frame = CGRectMake(self.fullscreenFrame.origin.x + progress * delta.origin.x,
+                             self.fullscreenFrame.origin.y + progress * delta.origin.y,
+                             self.fullscreenFrame.size.width + progress * delta.size.width,
+                             self.fullscreenFrame.size.height + progress * delta.size.height);
+    
+    // The ends are exact, so a finished gesture lands on the same frames as the animations which settle it
+    if (progress >= 1) {
+        state.frame = self.minimizedFrame;
+    } else if (progress <= 0) {
+        state.frame = self.fullscreenFrame;
+    }
+    
+    state.offset = progress * self.maxViewOffset;
+    state.progress = progress;
+    state.alpha = 1;
+    state.borderAlpha = progress;
+    state.overlayAlpha = 1 - progress;
+    
+    return state;
+}
+
+- (ABGestureLayoutState)dismissingStateAtOriginX:(CGFloat)originX {
+    CGFloat ratio = (originX - self.dismissingOriginX) * self.inverseDismissingDistance;
+    
+    ABGestureLayoutState state;
+    state.frame = self.minimizedFrame;
+    state.offset = self.maxViewOffset;
+    state.borderAlpha = 1;
+    state.overlayAlpha = 0;
+    
+    if (ratio >= 1) {
+        state.frame.origin.x = self.superviewWidth;
+        state.progress = 1;
+        state.alpha = 0;
+    } else if (ratio < 0 || isnan(ratio)) {
+        state.progress = 0;
+        state.alpha = 1;
+    } else {
+        state.frame.origin.x = originX;
+        state.progress = ratio;
+        state.alpha = 1 - ratio;
+    }
+    
+    return state;
+}
+
+- (ABGestureLayoutState)swipeDismissingStateAtOffset:(CGFloat)offset {
+    CGFloat progress = ABGestureLayoutClamp(offset * self.inverseSuperviewHeight);
+    
+    ABGestureLayoutState state;
+    state.frame = self.fullscreenFrame;
+    state.frame.origin.y = progress * self.superviewHeight;
+    state.offset = state.frame.origin.y;
+    state.progress = progress;
+    state.alpha = 1;
+    state.borderAlpha = 0;
+    state.overlayAlpha = 1 - progress;
+    
+    return state;
+}
+
+@end
@@ -10,12 +10,16 @@
 #import <Foundation/Foundation.h>
 #import <QuartzCore/QuartzCore.h>
 #import "ABCommons.h"
+#import "ABTextMeasurementCache.h"
 
 @interface ABLabel ()
 
 /// Recognizer that recognizes tap events on the label
 @property (strong, nonatomic) UITapGestureRecognizer *tapRecognizer;
 
+/// Determines if the label was given attributed text, which is measured by UILabel rather than the shared measurement cache
+@property (nonatomic) BOOL hasAttributedText;
+
 @end
 
 @implementation ABLabel
@@ -57,8 +61,42 @@
     label.shadowOffset = CGSizeMake(0, 1);
 }
 
+#pragma mark - Measurement Methods
+
+- (CGSize)intrinsicContentSize {
+    
+    if (self.hasAttributedText) {
+        return [super intrinsicContentSize];
+    }
+    
+    // Titles and times are laid out again on every layout pass, so their sizes come from the cache shared by every label
+    return [[ABTextMeasurementCache sharedManager] sizeOfText:self.text font:self.font width:self.preferredMaxLayoutWidth numberOfLines:self.numberOfLines];
+}
+
+- (CGSize)sizeThatFits:(CGSize)size {
+    
+    if (self.hasAttributedText) {
+        return [super sizeThatFits:size];
+    }
+    
+    return [[ABTextMeasurementCache sharedManager] sizeOfText:self.text font:self.font width:size.width numberOfLines:self.numberOfLines];
+}
+
 #pragma mark - Custom Accessor Methods
 
+- (void)setText:(NSString *)text {
+    [super setText:text];
+    
+    // Set after UILabel, in case it stores plain text through setAttributedText:
+    self.hasAttributedText = NO;
+}
+
+- (void)setAttributedText:(NSAttributedString *)attributedText {
+    [super setAttributedText:attributedText];
+    
+    self.hasAttributedText = YES;
+}
+
 - (void)setTouchUpInside:(BOOL)touchUpInside {
     _touchUpInside = touchUpInside;
     
@@ -0,0 +1,109 @@
+//
+//  ABLoadTrace.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+
+/// Stage of loading a video, from setting its url to its first frame playing
+typedef NS_ENUM(NSUInteger, ABLoadTraceStage) {
+    /// From setting the videoURL to the first frame playing
+    ABLoadTraceStageLoad = 0,
+    /// Request made by the cache manager to check the content type of a url
+    ABLoadTraceStageDetectURL,
+    /// Wait for a block dispatched to the main queue to run
+    ABLoadTraceStageMainQueueHop,
+    /// Download of the video in the background, before it is written to the cache
+    ABLoadTraceStageDownload,
+    /// Write of the downloaded video to the cache directory
+    ABLoadTraceStageFileWrite,
+    /// From observing the status of the player item to it becoming ready or failing
+    ABLoadTraceStageItemStatus,
+    /// Time the loading animation is shown, from its timer being scheduled to being stopped
+    ABLoadTraceStageLoadingAnimation,
+    /// From adding the periodic time observer to its first tick
+    ABLoadTraceStageFirstTick,
+    ABLoadTraceStageCount
+};
+
+/// Point of a stage which an event marks
+typedef NS_ENUM(uint32_t, ABLoadTracePhase) {
+    ABLoadTracePhaseBegin = 0,
+    ABLoadTracePhaseEnd,
+    /// The stage was abandoned, so it is left out of the report
+    ABLoadTracePhaseCancel,
+};
+
+/// Events kept for each thread, after which the oldest are overwritten
+extern const NSUInteger ABLoadTraceBufferCapacity;
+
+/// Returns a new identifier for a load, which its events are keyed by
+uint64_t ABLoadTraceNewLoad(void);
+
+/// Monotonic time in nanoseconds, which events are stamped with
+uint64_t ABLoadTraceNow(void);
+
+/// Records an event into the ring buffer of the calling thread without locking. Only the first event of a thread allocates, and events of load 0 are ignored, so loads which are not traced cost a single comparison.
+void ABLoadTraceRecord(uint64_t loadID, ABLoadTraceStage stage, ABLoadTracePhase phase, uint64_t timestamp);
+
+/// Records the beginning of a stage at the current time
+void ABLoadTraceBegin(uint64_t loadID, ABLoadTraceStage stage);
+
+/// Records the end of a stage at the current time
+void ABLoadTraceEnd(uint64_t loadID, ABLoadTraceStage stage);
+
+/// Records that a stage was abandoned at the current time
+void ABLoadTraceCancel(uint64_t loadID, ABLoadTraceStage stage);
+
+/// Load which the calling thread is working on, or 0. Lets code which is not given a load, such as the cache manager, key its events to the load which called it.
+uint64_t ABLoadTraceCurrentLoad(void);
+
+/// Runs the block with the load as the current load of the calling thread
+void ABLoadTracePerform(uint64_t loadID, void (^block)(void));
+
+/// Durations of one stage across every traced load
+@interface ABLoadTraceStageSummary : NSObject
+
+@property (nonatomic, readonly) ABLoadTraceStage stage;
+
+/// Name of the stage, as it appears in the exported trace
+@property (strong, nonatomic, readonly) NSString *name;
+
+/// Number of times the stage was completed
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Number of times the stage was abandoned
+@property (nonatomic, readonly) NSUInteger cancelledCount;
+
+/// Median duration in seconds
+@property (nonatomic, readonly) NSTimeInterval p50;
+
+/// 95th percentile duration in seconds
+@property (nonatomic, readonly) NSTimeInterval p95;
+
+/// Longest duration in seconds
+@property (nonatomic, readonly) NSTimeInterval max;
+
+@end
+
+/// Reads the events recorded by every thread. Recording never waits on reading, so events overwritten while they are read are dropped.
+@interface ABLoadTrace : NSObject
+
+/// Name of a stage, as it appears in the exported trace
++ (NSString *)nameForStage:(ABLoadTraceStage)stage;
+
+/// Trace Event Format JSON of the recorded events, which opens in chrome://tracing and Perfetto. Each stage of a load is an async slice with the load in its args, as stages of one load overlap without nesting.
++ (NSData *)chromeTraceData;
+
+/// Summaries of each stage which has been completed or abandoned, in the order of ABLoadTraceStage
++ (NSArray<ABLoadTraceStageSummary *> *)stageSummaries;
+
+/// Table of the p50 and p95 duration of each stage, in milliseconds
++ (NSString *)report;
+
+/// Drops every recorded event
++ (void)reset;
+
+@end
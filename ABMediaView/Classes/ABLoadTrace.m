@@ -0,0 +1,447 @@
+//
+//  ABLoadTrace.m
+//  Pods
+//
+//
+//
+
+#import "ABLoadTrace.h"
+#import <mach/mach_time.h>
+#import <pthread.h>
+#import <stdatomic.h>
+#import <stdlib.h>
+
+#define ABLoadTraceEventsPerBuffer 1024
+
+const NSUInteger ABLoadTraceBufferCapacity = ABLoadTraceEventsPerBuffer;
+
+/// One recorded event, stamped with the thread which recorded it
+typedef struct {
+    uint64_t loadID;
+    uint64_t timestamp;
+    uint64_t threadID;
+    uint32_t stage;
+    uint32_t phase;
+} ABLoadTraceEvent;
+
+/// Slot of a ring buffer. Its fields are atomic, so that a reader racing the owner reads stale or new values rather than undefined ones, and the sequence tells it which.
+typedef struct {
+    /// Twice the index of the event in the slot, plus one while the event is being written, or plus two once it has been written
+    _Atomic uint64_t sequence;
+    
+    _Atomic uint64_t loadID;
+    _Atomic uint64_t timestamp;
+    _Atomic uint64_t threadID;
+    _Atomic uint32_t stage;
+    _Atomic uint32_t phase;
+} ABLoadTraceSlot;
+
+/// Ring of events written by the one thread which owns it, and read by any thread
+typedef struct ABLoadTraceBuffer {
+    ABLoadTraceSlot slots[ABLoadTraceEventsPerBuffer];
+    
+    /// Number of events ever written, published after each event is written
+    _Atomic uint64_t head;
+    
+    /// Number of events which were written before the last reset, and are no longer read
+    _Atomic uint64_t resetHead;
+    
+    /// Determines if a thread owns the buffer. Buffers of exited threads are adopted by new threads, rather than freed while they may be read.
+    _Atomic int owned;
+    
+    /// Identifier of the owning thread
+    uint64_t threadID;
+    
+    /// Load the owning thread is working on
+    uint64_t currentLoad;
+    
+    struct ABLoadTraceBuffer *next;
+} ABLoadTraceBuffer;
+
+/// Every buffer ever allocated. Buffers are only ever pushed, so the list can be walked without locking.
+static _Atomic(ABLoadTraceBuffer *) ABLoadTraceBuffers = NULL;
+
+static _Atomic uint64_t ABLoadTraceLastLoad = 0;
+
+/// Identifier of the main thread, which is named in the exported trace
+static _Atomic uint64_t ABLoadTraceMainThreadID = 0;
+
+/// Key of the buffer owned by each thread, which releases it when the thread exits
+static pthread_key_t ABLoadTraceBufferKey;
+
+static void ABLoadTraceReleaseBuffer(void *value) {
+    ABLoadTraceBuffer *buffer = value;
+    buffer->currentLoad = 0;
+    atomic_store_explicit(&buffer->owned, 0, memory_order_release);
+}
+
+static void ABLoadTraceCreateKey(void) {
+    pthread_key_create(&ABLoadTraceBufferKey, ABLoadTraceReleaseBuffer);
+}
+
+static ABLoadTraceBuffer *ABLoadTraceThreadBuffer(BOOL create) {
+    static pthread_once_t onceToken = PTHREAD_ONCE_INIT;
+    pthread_once(&onceToken, ABLoadTraceCreateKey);
+    
+    ABLoadTraceBuffer *buffer = pthread_getspecific(ABLoadTraceBufferKey);
+    
+    if (buffer != NULL || !create) {
+        return buffer;
+    }
+    
+    // Adopt the buffer of a thread which has exited before allocating another
+    for (buffer = atomic_load_explicit(&ABLoadTraceBuffers, memory_order_acquire); buffer != NULL; buffer = buffer->next) {
+        int expected = 0;
+        
+        if (atomic_compare_exchange_strong_explicit(&buffer->owned, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+            break;
+        }
+    
+    }
+    
+    if (buffer == NULL) {
+        buffer = calloc(1, sizeof(ABLoadTraceBuffer));
+        
+        if (buffer == NULL) {
+            return NULL;
+        }
+        
+        atomic_init(&buffer->owned, 1);
+        
+        ABLoadTraceBuffer *first = atomic_load_explicit(&ABLoadTraceBuffers, memory_order_relaxed);
+        
+        do {
+            buffer->next = first;
+        } while (!atomic_compare_exchange_weak_explicit(&ABLoadTraceBuffers, &first, buffer, memory_order_release, memory_order_relaxed));
+    }
+    
+    pthread_threadid_np(NULL, &buffer->threadID);
+    buffer->currentLoad = 0;
+    
+    if (pthread_main_np()) {
+        atomic_store_explicit(&ABLoadTraceMainThreadID, buffer->threadID, memory_order_relaxed);
+    }
+    
+    pthread_setspecific(ABLoadTraceBufferKey, buffer);
+    
+    return buffer;
+}
+
+uint64_t ABLoadTraceNewLoad(void) {
+    return atomic_fetch_add_explicit(&ABLoadTraceLastLoad, 1, memory_order_relaxed) + 1;
+}
+
+uint64_t ABLoadTraceNow(void) {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+void ABLoadTraceRecord(uint64_t loadID, ABLoadTraceStage stage, ABLoadTracePhase phase, uint64_t timestamp) {
+    
+    if (loadID == 0) {
+        return;
+    }
+    
+    ABLoadTraceBuffer *buffer = ABLoadTraceThreadBuffer(YES);
+    
+    if (buffer == NULL) {
+        return;
+    }
+    
+    // Only the owning thread moves the head, so it is read without ordering and published once the event is written
+    uint64_t index = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    ABLoadTraceSlot *slot = &buffer->slots[index % ABLoadTraceEventsPerBuffer];
+    
+    // Mark the slot as being written before any of its fields change, so a reader copying the event it held sees the sequence move and drops its copy
+    atomic_store_explicit(&slot->sequence, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    atomic_store_explicit(&slot->loadID, loadID, memory_order_relaxed);
+    atomic_store_explicit(&slot->timestamp, timestamp, memory_order_relaxed);
+    atomic_store_explicit(&slot->threadID, buffer->threadID, memory_order_relaxed);
+    atomic_store_explicit(&slot->stage, (uint32_t)stage, memory_order_relaxed);
+    atomic_store_explicit(&slot->phase, phase, memory_order_relaxed);
+    
+    atomic_store_explicit(&slot->sequence, 2 * index + 2, memory_order_release);
+    atomic_store_explicit(&buffer->head, index + 1, memory_order_release);
+}
+
+void ABLoadTraceBegin(uint64_t loadID, ABLoadTraceStage stage) {
+    
+    if (loadID != 0) {
+        ABLoadTraceRecord(loadID, stage, ABLoadTracePhaseBegin, ABLoadTraceNow());
+    }
+
+}
+
+void ABLoadTraceEnd(uint64_t loadID, ABLoadTraceStage stage) {
+    
+    if (loadID != 0) {
+        ABLoadTraceRecord(loadID, stage, ABLoadTracePhaseEnd, ABLoadTraceNow());
+    }
+
+}
+
+void ABLoadTraceCancel(uint64_t loadID, ABLoadTraceStage stage) {
+    
+    if (loadID != 0) {
+        ABLoadTraceRecord(loadID, stage, ABLoadTracePhaseCancel, ABLoadTraceNow());
+    }
+
+}
+
+uint64_t ABLoadTraceCurrentLoad(void) {
+    ABLoadTraceBuffer *buffer = ABLoadTraceThreadBuffer(NO);
+    
+    return (buffer != NULL) ? buffer->currentLoad : 0;
+}
+
+void ABLoadTracePerform(uint64_t loadID, void (^block)(void)) {
+    ABLoadTraceBuffer *buffer = ABLoadTraceThreadBuffer(loadID != 0);
+    
+    if (buffer == NULL) {
+        if (block) block();
+        return;
+    }
+    
+    uint64_t previousLoad = buffer->currentLoad;
+    buffer->currentLoad = loadID;
+    
+    if (block) block();
+    
+    buffer->currentLoad = previousLoad;
+}
+
+static int ABLoadTraceCompareEvents(const void *event, const void *otherEvent) {
+    uint64_t timestamp = ((const ABLoadTraceEvent *)event)->timestamp;
+    uint64_t otherTimestamp = ((const ABLoadTraceEvent *)otherEvent)->timestamp;
+    
+    return (timestamp > otherTimestamp) - (timestamp < otherTimestamp);
+}
+
+/// Copies the events of every thread, ordered by time
+static NSData *ABLoadTraceSnapshot(void) {
+    NSMutableData *events = [NSMutableData data];
+    
+    for (ABLoadTraceBuffer *buffer = atomic_load_explicit(&ABLoadTraceBuffers, memory_order_acquire); buffer != NULL; buffer = buffer->next) {
+        uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        uint64_t resetHead = atomic_load_explicit(&buffer->resetHead, memory_order_relaxed);
+        uint64_t start = (head > ABLoadTraceEventsPerBuffer) ? head - ABLoadTraceEventsPerBuffer : 0;
+        start = MAX(start, resetHead);
+        
+        if (start >= head) {
+            continue;
+        }
+        
+        for (uint64_t index = start; index < head; index++) {
+            ABLoadTraceSlot *slot = &buffer->slots[index % ABLoadTraceEventsPerBuffer];
+            uint64_t written = 2 * index + 2;
+            
+            // The owner may have lapped the slot already, or may lap it while it is copied, in which case the sequence no longer matches and the copy is dropped
+            if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != written) {
+                continue;
+            }
+            
+            ABLoadTraceEvent event;
+            event.loadID = atomic_load_explicit(&slot->loadID, memory_order_relaxed);
+            event.timestamp = atomic_load_explicit(&slot->timestamp, memory_order_relaxed);
+            event.threadID = atomic_load_explicit(&slot->threadID, memory_order_relaxed);
+            event.stage = atomic_load_explicit(&slot->stage, memory_order_relaxed);
+            event.phase = atomic_load_explicit(&slot->phase, memory_order_relaxed);
+            
+            atomic_thread_fence(memory_order_acquire);
+            
+            if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != written) {
+                continue;
+            }
+            
+            [events appendBytes:&event length:sizeof(ABLoadTraceEvent)];
+        }
+        
+    }
+    
+    qsort(events.mutableBytes, events.length / sizeof(ABLoadTraceEvent), sizeof(ABLoadTraceEvent), ABLoadTraceCompareEvents);
+    
+    return events;
+}
+
+@interface ABLoadTraceStageSummary ()
+
+@property (nonatomic, readwrite) ABLoadTraceStage stage;
+@property (strong, nonatomic, readwrite) NSString *name;
+@property (nonatomic, readwrite) NSUInteger count;
+@property (nonatomic, readwrite) NSUInteger cancelledCount;
+@property (nonatomic, readwrite) NSTimeInterval p50;
+@property (nonatomic, readwrite) NSTimeInterval p95;
+@property (nonatomic, readwrite) NSTimeInterval max;
+
+@end
+
+@implementation ABLoadTraceStageSummary
+
+@end
+
+@implementation ABLoadTrace
+
++ (NSString *)nameForStage:(ABLoadTraceStage)stage {
+    
+    switch (stage) {
+        case ABLoadTraceStageLoad:
+            return @"load";
+        case ABLoadTraceStageDetectURL:
+            return @"detectURL";
+        case ABLoadTraceStageMainQueueHop:
+            return @"mainQueueHop";
+        case ABLoadTraceStageDownload:
+            return @"download";
+        case ABLoadTraceStageFileWrite:
+            return @"fileWrite";
+        case ABLoadTraceStageItemStatus:
+            return @"itemStatus";
+        case ABLoadTraceStageLoadingAnimation:
+            return @"loadingAnimation";
+        case ABLoadTraceStageFirstTick:
+            return @"firstTick";
+        default:
+            return @"unknown";
+    }
+
+}
+
++ (NSData *)chromeTraceData {
+    NSData *snapshot = ABLoadTraceSnapshot();
+    const ABLoadTraceEvent *events = snapshot.bytes;
+    NSUInteger eventCount = snapshot.length / sizeof(ABLoadTraceEvent);
+    
+    NSMutableArray *traceEvents = [NSMutableArray arrayWithCapacity:eventCount + 1];
+    uint64_t mainThreadID = atomic_load_explicit(&ABLoadTraceMainThreadID, memory_order_relaxed);
+    
+    if (mainThreadID != 0) {
+        [traceEvents addObject:@{@"name" : @"thread_name", @"ph" : @"M", @"pid" : @1, @"tid" : @(mainThreadID), @"args" : @{@"name" : @"Main Thread"}}];
+    }
+    
+    for (NSUInteger i = 0; i < eventCount; i++) {
+        const ABLoadTraceEvent *event = &events[i];
+        NSMutableDictionary *args = [NSMutableDictionary dictionaryWithObject:@(event->loadID) forKey:@"load"];
+        
+        if (event->phase == ABLoadTracePhaseCancel) {
+            args[@"cancelled"] = @YES;
+        }
+        
+        // Each stage of a load gets its own async id, so that the overlapping stages of a load are each matched to their own slice
+        [traceEvents addObject:@{@"name" : [ABLoadTrace nameForStage:event->stage],
+                                 @"cat" : @"ABMediaView",
+                                 @"ph" : (event->phase == ABLoadTracePhaseBegin) ? @"b" : @"e",
+                                 @"id" : [NSString stringWithFormat:@"%llu.%u", event->loadID, event->stage],
+                                 @"ts" : @(event->timestamp / 1000.0),
+                                 @"pid" : @1,
+                                 @"tid" : @(event->threadID),
+                                 @"args" : args}];
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{@"traceEvents" : traceEvents, @"displayTimeUnit" : @"ms"} options:0 error:nil];
+}
+
++ (NSArray<ABLoadTraceStageSummary *> *)stageSummaries {
+    NSData *snapshot = ABLoadTraceSnapshot();
+    const ABLoadTraceEvent *events = snapshot.bytes;
+    NSUInteger eventCount = snapshot.length / sizeof(ABLoadTraceEvent);
+    
+    // Begin times of the stages which are open, keyed by load and stage. A stage which runs more than once in a load is matched first in, first out.
+    NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *openStages = [NSMutableDictionary dictionary];
+    NSMutableArray<NSMutableArray<NSNumber *> *> *durations = [NSMutableArray arrayWithCapacity:ABLoadTraceStageCount];
+    NSUInteger cancelledCounts[ABLoadTraceStageCount] = {0};
+    
+    for (NSUInteger stage = 0; stage < ABLoadTraceStageCount; stage++) {
+        [durations addObject:[NSMutableArray array]];
+    }
+    
+    for (NSUInteger i = 0; i < eventCount; i++) {
+        const ABLoadTraceEvent *event = &events[i];
+        
+        if (event->stage >= ABLoadTraceStageCount) {
+            continue;
+        }
+        
+        NSString *key = [NSString stringWithFormat:@"%llu.%u", event->loadID, event->stage];
+        NSMutableArray<NSNumber *> *beginTimes = openStages[key];
+        
+        if (event->phase == ABLoadTracePhaseBegin) {
+            
+            if (beginTimes == nil) {
+                beginTimes = [NSMutableArray array];
+                openStages[key] = beginTimes;
+            }
+            
+            [beginTimes addObject:@(event->timestamp)];
+            continue;
+        }
+        
+        // Ends without a recorded beginning, which was overwritten or dropped by a reset, are left out
+        if (beginTimes.count == 0) {
+            continue;
+        }
+        
+        uint64_t beginTime = beginTimes.firstObject.unsignedLongLongValue;
+        [beginTimes removeObjectAtIndex:0];
+        
+        if (event->phase == ABLoadTracePhaseCancel) {
+            cancelledCounts[event->stage]++;
+        } else {
+            [durations[event->stage] addObject:@((event->timestamp - beginTime) / (double)NSEC_PER_SEC)];
+        }
+    
+    }
+    
+    NSMutableArray<ABLoadTraceStageSummary *> *summaries = [NSMutableArray array];
+    
+    for (NSUInteger stage = 0; stage < ABLoadTraceStageCount; stage++) {
+        NSArray<NSNumber *> *sorted = [durations[stage] sortedArrayUsingSelector:@selector(compare:)];
+        
+        if (sorted.count == 0 && cancelledCounts[stage] == 0) {
+            continue;
+        }
+        
+        ABLoadTraceStageSummary *summary = [[ABLoadTraceStageSummary alloc] init];
+        summary.stage = stage;
+        summary.name = [ABLoadTrace nameForStage:stage];
+        summary.count = sorted.count;
+        summary.cancelledCount = cancelledCounts[stage];
+        
+        if (sorted.count > 0) {
+            // Nearest rank, so each percentile is a duration which was measured
+            summary.p50 = sorted[(sorted.count * 50 + 99) / 100 - 1].doubleValue;
+            summary.p95 = sorted[(sorted.count * 95 + 99) / 100 - 1].doubleValue;
+            summary.max = sorted.lastObject.doubleValue;
+        }
+        
+        [summaries addObject:summary];
+    }
+    
+    return summaries;
+}
+
++ (NSString *)report {
+    NSMutableString *report = [NSMutableString stringWithFormat:@"%-18s %8s %10s %10s %10s %10s\n", "stage", "count", "cancelled", "p50 ms", "p95 ms", "max ms"];
+    
+    for (ABLoadTraceStageSummary *summary in [ABLoadTrace stageSummaries]) {
+        [report appendFormat:@"%-18s %8lu %10lu %10.2f %10.2f %10.2f\n", summary.name.UTF8String, (unsigned long)summary.count, (unsigned long)summary.cancelledCount, summary.p50 * 1000, summary.p95 * 1000, summary.max * 1000];
+    }
+    
+    return report;
+}
+
++ (void)reset {
+    
+    for (ABLoadTraceBuffer *buffer = atomic_load_explicit(&ABLoadTraceBuffers, memory_order_acquire); buffer != NULL; buffer = buffer->next) {
+        atomic_store_explicit(&buffer->resetHead, atomic_load_explicit(&buffer->head, memory_order_acquire), memory_order_relaxed);
+    }
+
+}
+
+@end
@@ -0,0 +1,671 @@
+//
+//  ABMP4Parser.c
+//  Pods
+//
+//
+//
+
+#include "ABMP4Parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// Deepest nesting of boxes which is descended into (moov/trak/mdia/minf/stbl)
+#define ABMP4MaximumDepth 8
+
+/// Most tracks kept from a single moov box
+#define ABMP4MaximumTracks 256
+
+typedef struct {
+    uint32_t type;
+    uint64_t size;
+    uint32_t headerSize;
+} ABMP4Box;
+
+/// Tables of a track which are only known once the whole trak box has been read
+typedef struct {
+    const uint8_t *timeToSample;
+    uint32_t timeToSampleCount;
+    const uint8_t *syncSamples;
+    uint32_t syncSampleCount;
+    const uint8_t *compositionOffsets;
+    uint32_t compositionOffsetCount;
+    const uint8_t *edits;
+    uint32_t editCount;
+    uint32_t editVersion;
+    uint32_t sampleEntryWidth;
+    uint32_t sampleEntryHeight;
+} ABMP4TrackTables;
+
+static uint16_t read16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t read32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t read64(const uint8_t *p) {
+    return ((uint64_t)read32(p) << 32) | read32(p + 4);
+}
+
+/// Reads a box header from the available bytes. Returns 1 when read, 0 when more bytes are needed, and -1 when the header is invalid. A size of 0 (to the end of the enclosing space) is left for the caller to resolve.
+static int readBoxHeader(const uint8_t *p, size_t available, ABMP4Box *box) {
+
+    if (available < 8) {
+        return 0;
+    }
+
+    box->size = read32(p);
+    box->type = read32(p + 4);
+    box->headerSize = 8;
+
+    if (box->size == 1) {
+
+        if (available < 16) {
+            return 0;
+        }
+
+        box->size = read64(p + 8);
+        box->headerSize = 16;
+    }
+
+    if (box->size != 0 && box->size < box->headerSize) {
+        return -1;
+    }
+
+    return 1;
+}
+
+#pragma mark - Scanning
+
+void ABMP4ScanInit(ABMP4Scan *scan, uint64_t fileLength) {
+    memset(scan, 0, sizeof(*scan));
+    scan->fileLength = fileLength;
+}
+
+ABMP4Status ABMP4ScanWindow(ABMP4Scan *scan, const uint8_t *window, size_t length, uint64_t windowOffset) {
+
+    for (;;) {
+
+        if (scan->fileLength > 0 && scan->nextOffset >= scan->fileLength) {
+            return ABMP4StatusNotFound;
+        }
+
+        if (window == NULL || scan->nextOffset < windowOffset || scan->nextOffset - windowOffset >= length) {
+            return ABMP4StatusNeedData;
+        }
+
+        size_t position = (size_t)(scan->nextOffset - windowOffset);
+        size_t available = length - position;
+        ABMP4Box box;
+        int result = readBoxHeader(window + position, available, &box);
+
+        if (result < 0) {
+            return ABMP4StatusMalformed;
+        }
+
+        if (result == 0) {
+
+            // Fewer bytes than a box header left in the file is trailing padding
+            if (scan->fileLength > 0 && scan->fileLength - scan->nextOffset < 16 && available >= scan->fileLength - scan->nextOffset) {
+                return ABMP4StatusNotFound;
+            }
+
+            return ABMP4StatusNeedData;
+        }
+
+        uint64_t remaining = scan->fileLength > 0 ? scan->fileLength - scan->nextOffset : 0;
+
+        if (box.size == 0) {
+
+            // The last box runs to the end of the file, so a moov box can not follow it
+            if (box.type != ABMP4FourCC('m', 'o', 'o', 'v')) {
+                return ABMP4StatusNotFound;
+            }
+
+            if (remaining == 0) {
+                return ABMP4StatusMalformed;
+            }
+
+            box.size = remaining;
+        }
+
+        if (remaining > 0 && box.size > remaining) {
+            return box.type == ABMP4FourCC('m', 'o', 'o', 'v') ? ABMP4StatusMalformed : ABMP4StatusNotFound;
+        }
+
+        scan->boxCount++;
+
+        if (box.type == ABMP4FourCC('f', 't', 'y', 'p') && available >= box.headerSize + 4 && box.size >= box.headerSize + 4) {
+            scan->majorBrand = read32(window + position + box.headerSize);
+        }
+
+        if (box.type == ABMP4FourCC('m', 'o', 'o', 'v')) {
+            scan->moovOffset = scan->nextOffset;
+            scan->moovSize = box.size;
+            return ABMP4StatusOK;
+        }
+
+        if (scan->nextOffset + box.size < scan->nextOffset) {
+            return ABMP4StatusMalformed;
+        }
+
+        scan->nextOffset += box.size;
+    }
+
+}
+
+#pragma mark - Parsing
+
+static int compareSampleNumbers(const void *a, const void *b) {
+    uint32_t numberA = *(const uint32_t *)a;
+    uint32_t numberB = *(const uint32_t *)b;
+
+    if (numberA < numberB) return -1;
+    if (numberA > numberB) return 1;
+    return 0;
+}
+
+static int compareTimes(const void *a, const void *b) {
+    double timeA = *(const double *)a;
+    double timeB = *(const double *)b;
+
+    if (timeA < timeB) return -1;
+    if (timeA > timeB) return 1;
+    return 0;
+}
+
+/// Reads where the edit list starts presenting the media, as the time in the media of the first edit and the time in seconds before it which is left empty. Only the first edit which presents media is followed, as later edits are rare outside of edited QuickTime movies.
+static void readEdits(const ABMP4TrackTables *tables, uint32_t movieTimescale, int64_t *mediaTime, double *emptyDuration) {
+    *mediaTime = 0;
+    *emptyDuration = 0;
+
+    uint64_t entrySize = tables->editVersion == 1 ? 20 : 12;
+
+    for (uint32_t i = 0; i < tables->editCount; i++) {
+        const uint8_t *entry = tables->edits + i * entrySize;
+        uint64_t segmentDuration = tables->editVersion == 1 ? read64(entry) : read32(entry);
+        int64_t time = tables->editVersion == 1 ? (int64_t)read64(entry + 8) : (int32_t)read32(entry + 4);
+
+        // A media time of -1 is an empty edit, which delays the start of the media
+        if (time == -1) {
+
+            if (movieTimescale > 0) {
+                *emptyDuration += (double)segmentDuration / movieTimescale;
+            }
+
+            continue;
+        }
+
+        if (time >= 0) {
+            *mediaTime = time;
+        }
+
+        return;
+    }
+
+}
+
+/// Converts the sync sample numbers of a track into presentation times, walking the time-to-sample and composition offset tables once. Seeks are made in presentation time, so the decode time of each keyframe is shifted by its composition offset and by the edit list, as encoders which reorder frames delay every frame and edit the delay back out.
+static ABMP4Status resolveKeyframes(ABMP4Track *track, const ABMP4TrackTables *tables, uint32_t movieTimescale) {
+
+    if (tables->syncSamples == NULL || tables->syncSampleCount == 0 || track->timescale == 0) {
+        return ABMP4StatusOK;
+    }
+
+    uint32_t count = tables->syncSampleCount;
+    uint32_t *numbers = malloc(count * sizeof(uint32_t));
+    double *times = malloc(count * sizeof(double));
+
+    if (numbers == NULL || times == NULL) {
+        free(numbers);
+        free(times);
+        return ABMP4StatusNoMemory;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        numbers[i] = read32(tables->syncSamples + i * 4);
+    }
+
+    // Sync samples are meant to be stored in order, but are sorted in case they are not
+    qsort(numbers, count, sizeof(uint32_t), compareSampleNumbers);
+
+    int64_t mediaTime;
+    double emptyDuration;
+    readEdits(tables, movieTimescale, &mediaTime, &emptyDuration);
+
+    uint64_t firstSample = 1;
+    uint64_t firstTime = 0;
+    uint32_t entry = 0;
+    uint64_t firstOffsetSample = 1;
+    uint32_t offsetEntry = 0;
+    uint32_t resolved = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t number = numbers[i];
+
+        if (number == 0) {
+            continue;
+        }
+
+        while (entry < tables->timeToSampleCount) {
+            uint64_t entrySamples = read32(tables->timeToSample + entry * 8);
+
+            if (number < firstSample + entrySamples) {
+                break;
+            }
+
+            firstTime += entrySamples * read32(tables->timeToSample + entry * 8 + 4);
+            firstSample += entrySamples;
+            entry++;
+        }
+
+        // Sync samples past the end of the time-to-sample table do not exist
+        if (entry >= tables->timeToSampleCount) {
+            break;
+        }
+
+        while (offsetEntry < tables->compositionOffsetCount && number >= firstOffsetSample + read32(tables->compositionOffsets + offsetEntry * 8)) {
+            firstOffsetSample += read32(tables->compositionOffsets + offsetEntry * 8);
+            offsetEntry++;
+        }
+
+        // Offsets are signed in version 1 of the table, and are read as signed in version 0 too, as many encoders write negative offsets there
+        int64_t offset = offsetEntry < tables->compositionOffsetCount ? (int32_t)read32(tables->compositionOffsets + offsetEntry * 8 + 4) : 0;
+
+        uint64_t delta = read32(tables->timeToSample + entry * 8 + 4);
+        uint64_t decodeTime = firstTime + (number - firstSample) * delta;
+
+        // Shifted in floating point, as times from a corrupt file could overflow
+        double time = ((double)decodeTime + (double)offset - (double)mediaTime) / track->timescale;
+
+        // Keyframes which the edit list cuts are decoded for the first frame which is shown, so they are seeked to at its time
+        if (time < 0) {
+            time = 0;
+        }
+
+        times[resolved++] = emptyDuration + time;
+    }
+
+    free(numbers);
+
+    // Composition offsets may reorder keyframes, and keyframes cut by the edit list share the first time
+    qsort(times, resolved, sizeof(double), compareTimes);
+
+    uint32_t unique = 0;
+
+    for (uint32_t i = 0; i < resolved; i++) {
+
+        if (unique == 0 || times[i] > times[unique - 1]) {
+            times[unique++] = times[i];
+        }
+
+    }
+
+    if (unique == 0) {
+        free(times);
+        times = NULL;
+    }
+
+    track->keyframeTimes = times;
+    track->keyframeCount = unique;
+
+    return ABMP4StatusOK;
+}
+
+static void parseMovieHeader(const uint8_t *p, uint64_t length, ABMP4Metadata *metadata) {
+
+    if (length < 4) {
+        return;
+    }
+
+    if (p[0] == 1 && length >= 32) {
+        metadata->timescale = read32(p + 20);
+        metadata->duration = read64(p + 24);
+
+        if (metadata->duration == UINT64_MAX) {
+            metadata->duration = 0;
+        }
+    } else if (p[0] == 0 && length >= 20) {
+        metadata->timescale = read32(p + 12);
+        metadata->duration = read32(p + 16);
+
+        if (metadata->duration == UINT32_MAX) {
+            metadata->duration = 0;
+        }
+    }
+
+}
+
+static void parseTrackHeader(const uint8_t *p, uint64_t length, ABMP4Track *track) {
+
+    if (length < 4) {
+        return;
+    }
+
+    uint64_t matrixOffset;
+
+    if (p[0] == 1 && length >= 96) {
+        track->trackID = read32(p + 20);
+        matrixOffset = 52;
+    } else if (p[0] == 0 && length >= 84) {
+        track->trackID = read32(p + 12);
+        matrixOffset = 40;
+    } else {
+        return;
+    }
+
+    const uint8_t *matrix = p + matrixOffset;
+    double width = read32(matrix + 36) / 65536.0;
+    double height = read32(matrix + 40) / 65536.0;
+
+    // A matrix without scale on the diagonal is rotated by 90 or 270 degrees, so the displayed size is swapped
+    if (read32(matrix) == 0 && read32(matrix + 16) == 0 && read32(matrix + 4) != 0 && read32(matrix + 12) != 0) {
+        track->width = height;
+        track->height = width;
+    } else {
+        track->width = width;
+        track->height = height;
+    }
+
+}
+
+static void parseMediaHeader(const uint8_t *p, uint64_t length, ABMP4Track *track) {
+
+    if (length < 4) {
+        return;
+    }
+
+    if (p[0] == 1 && length >= 32) {
+        track->timescale = read32(p + 20);
+        track->duration = read64(p + 24);
+
+        if (track->duration == UINT64_MAX) {
+            track->duration = 0;
+        }
+    } else if (p[0] == 0 && length >= 20) {
+        track->timescale = read32(p + 12);
+        track->duration = read32(p + 16);
+
+        if (track->duration == UINT32_MAX) {
+            track->duration = 0;
+        }
+    }
+
+}
+
+static void parseSampleDescription(const uint8_t *p, uint64_t length, ABMP4TrackTables *tables, ABMP4Track *track) {
+
+    if (length < 16 || read32(p + 4) == 0) {
+        return;
+    }
+
+    track->codec = read32(p + 12);
+
+    // Visual sample entries store their coded size after 24 bytes of reserved and predefined fields
+    uint64_t entrySize = read32(p + 8);
+
+    if (entrySize >= 36 && entrySize <= length - 8) {
+        tables->sampleEntryWidth = read16(p + 8 + 32);
+        tables->sampleEntryHeight = read16(p + 8 + 34);
+    }
+
+}
+
+/// Reads the entry count of a table, and checks that the entries of the given size fit in the box
+static uint32_t tableEntryCount(const uint8_t *p, uint64_t length, uint64_t entrySize) {
+
+    if (length < 8) {
+        return 0;
+    }
+
+    uint64_t count = read32(p + 4);
+
+    return (count <= (length - 8) / entrySize) ? (uint32_t)count : 0;
+}
+
+static ABMP4Status parseBoxes(const uint8_t *p, uint64_t length, int depth, ABMP4Metadata *metadata, ABMP4Track *track, ABMP4TrackTables *tables);
+
+static ABMP4Status parseTrack(const uint8_t *p, uint64_t length, int depth, ABMP4Metadata *metadata) {
+
+    if (metadata->trackCount >= ABMP4MaximumTracks) {
+        return ABMP4StatusOK;
+    }
+
+    ABMP4Track *tracks = realloc(metadata->tracks, (metadata->trackCount + 1) * sizeof(ABMP4Track));
+
+    if (tracks == NULL) {
+        return ABMP4StatusNoMemory;
+    }
+
+    metadata->tracks = tracks;
+
+    ABMP4Track *track = &tracks[metadata->trackCount++];
+    ABMP4TrackTables tables;
+
+    memset(track, 0, sizeof(*track));
+    memset(&tables, 0, sizeof(tables));
+
+    ABMP4Status status = parseBoxes(p, length, depth, metadata, track, &tables);
+
+    if (status != ABMP4StatusOK) {
+        return status;
+    }
+
+    if (track->width == 0 && track->height == 0) {
+        track->width = tables.sampleEntryWidth;
+        track->height = tables.sampleEntryHeight;
+    }
+
+    if (track->sampleCount == 0) {
+
+        for (uint32_t i = 0; i < tables.timeToSampleCount; i++) {
+            track->sampleCount += read32(tables.timeToSample + i * 8);
+        }
+
+    }
+
+    return resolveKeyframes(track, &tables, metadata->timescale);
+}
+
+static ABMP4Status parseBoxes(const uint8_t *p, uint64_t length, int depth, ABMP4Metadata *metadata, ABMP4Track *track, ABMP4TrackTables *tables) {
+
+    if (depth > ABMP4MaximumDepth) {
+        return ABMP4StatusMalformed;
+    }
+
+    uint64_t offset = 0;
+
+    while (offset < length) {
+        ABMP4Box box;
+        int result = readBoxHeader(p + offset, (size_t)(length - offset), &box);
+
+        if (result <= 0) {
+            return ABMP4StatusMalformed;
+        }
+
+        if (box.size == 0) {
+            box.size = length - offset;
+        }
+
+        if (box.size > length - offset) {
+            return ABMP4StatusMalformed;
+        }
+
+        const uint8_t *payload = p + offset + box.headerSize;
+        uint64_t payloadLength = box.size - box.headerSize;
+        ABMP4Status status = ABMP4StatusOK;
+
+        switch (box.type) {
+            case ABMP4FourCC('m', 'v', 'h', 'd'):
+                parseMovieHeader(payload, payloadLength, metadata);
+                break;
+            case ABMP4FourCC('t', 'r', 'a', 'k'):
+
+                if (track == NULL) {
+                    status = parseTrack(payload, payloadLength, depth + 1, metadata);
+                }
+
+                break;
+            case ABMP4FourCC('e', 'd', 't', 's'):
+            case ABMP4FourCC('m', 'd', 'i', 'a'):
+            case ABMP4FourCC('m', 'i', 'n', 'f'):
+            case ABMP4FourCC('s', 't', 'b', 'l'):
+
+                if (track != NULL) {
+                    status = parseBoxes(payload, payloadLength, depth + 1, metadata, track, tables);
+                }
+
+                break;
+            case ABMP4FourCC('t', 'k', 'h', 'd'):
+
+                if (track != NULL) {
+                    parseTrackHeader(payload, payloadLength, track);
+                }
+
+                break;
+            case ABMP4FourCC('m', 'd', 'h', 'd'):
+
+                if (track != NULL) {
+                    parseMediaHeader(payload, payloadLength, track);
+                }
+
+                break;
+            case ABMP4FourCC('h', 'd', 'l', 'r'):
+
+                if (track != NULL && payloadLength >= 12) {
+                    track->handlerType = read32(payload + 8);
+                }
+
+                break;
+            case ABMP4FourCC('s', 't', 's', 'd'):
+
+                if (track != NULL) {
+                    parseSampleDescription(payload, payloadLength, tables, track);
+                }
+
+                break;
+            case ABMP4FourCC('s', 't', 't', 's'):
+
+                if (tables != NULL) {
+                    tables->timeToSampleCount = tableEntryCount(payload, payloadLength, 8);
+                    tables->timeToSample = payload + 8;
+                }
+
+                break;
+            case ABMP4FourCC('s', 't', 's', 's'):
+
+                if (tables != NULL) {
+                    tables->syncSampleCount = tableEntryCount(payload, payloadLength, 4);
+                    tables->syncSamples = payload + 8;
+                }
+
+                break;
+            case ABMP4FourCC('c', 't', 't', 's'):
+
+                if (tables != NULL) {
+                    tables->compositionOffsetCount = tableEntryCount(payload, payloadLength, 8);
+                    tables->compositionOffsets = payload + 8;
+                }
+
+                break;
+            case ABMP4FourCC('e', 'l', 's', 't'):
+
+                if (tables != NULL && payloadLength >= 4) {
+                    tables->editVersion = payload[0];
+                    tables->editCount = tableEntryCount(payload, payloadLength, payload[0] == 1 ? 20 : 12);
+                    tables->edits = payload + 8;
+                }
+
+                break;
+            case ABMP4FourCC('s', 't', 's', 'z'):
+            case ABMP4FourCC('s', 't', 'z', '2'):
+
+                if (track != NULL && payloadLength >= 12) {
+                    track->sampleCount = read32(payload + 8);
+                }
+
+                break;
+            default:
+                break;
+        }
+
+        if (status != ABMP4StatusOK) {
+            return status;
+        }
+
+        offset += box.size;
+    }
+
+    return ABMP4StatusOK;
+}
+
+ABMP4Status ABMP4ParseMoov(const uint8_t *moov, size_t length, ABMP4Metadata *metadata) {
+    memset(metadata, 0, sizeof(*metadata));
+
+    ABMP4Box box;
+
+    if (moov == NULL || readBoxHeader(moov, length, &box) <= 0 || box.type != ABMP4FourCC('m', 'o', 'o', 'v')) {
+        return ABMP4StatusMalformed;
+    }
+
+    if (box.size == 0) {
+        box.size = length;
+    }
+
+    if (box.size > length) {
+        return ABMP4StatusMalformed;
+    }
+
+    return parseBoxes(moov + box.headerSize, box.size - box.headerSize, 0, metadata, NULL, NULL);
+}
+
+void ABMP4MetadataFree(ABMP4Metadata *metadata) {
+
+    if (metadata == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < metadata->trackCount; i++) {
+        free(metadata->tracks[i].keyframeTimes);
+    }
+
+    free(metadata->tracks);
+    memset(metadata, 0, sizeof(*metadata));
+}
+
+const ABMP4Track *ABMP4MetadataTrack(const ABMP4Metadata *metadata, uint32_t handlerType) {
+
+    for (uint32_t i = 0; i < metadata->trackCount; i++) {
+
+        if (metadata->tracks[i].handlerType == handlerType) {
+            return &metadata->tracks[i];
+        }
+
+    }
+
+    return NULL;
+}
+
+double ABMP4MetadataDuration(const ABMP4Metadata *metadata) {
+
+    if (metadata->timescale > 0 && metadata->duration > 0) {
+        return (double)metadata->duration / metadata->timescale;
+    }
+
+    double duration = 0;
+
+    for (uint32_t i = 0; i < metadata->trackCount; i++) {
+
+        if (metadata->tracks[i].timescale > 0) {
+            double trackDuration = (double)metadata->tracks[i].duration / metadata->tracks[i].timescale;
+
+            if (trackDuration > duration) {
+                duration = trackDuration;
+            }
+        }
+
+    }
+
+    return duration;
+}
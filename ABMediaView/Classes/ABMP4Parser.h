@@ -0,0 +1,114 @@
+//
+//  ABMP4Parser.h
+//  Pods
+//
+//
+//
+
+#ifndef ABMP4Parser_h
+#define ABMP4Parser_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Result of scanning or parsing an MP4/MOV file
+typedef enum {
+    ABMP4StatusOK = 0,
+    /// More bytes are needed, starting at the scan's nextOffset
+    ABMP4StatusNeedData,
+    /// The file ended without a moov box
+    ABMP4StatusNotFound,
+    /// A box is truncated or has an impossible size
+    ABMP4StatusMalformed,
+    ABMP4StatusNoMemory,
+} ABMP4Status;
+
+/// Progress through the top-level boxes of a file, while looking for its moov box
+typedef struct {
+    /// Offset of the next top-level box header to read
+    uint64_t nextOffset;
+
+    /// Length of the file, 0 if it is not known
+    uint64_t fileLength;
+
+    /// Offset and size of the moov box, once it has been found
+    uint64_t moovOffset;
+    uint64_t moovSize;
+
+    /// Major brand from the ftyp box, 0 if there is none
+    uint32_t majorBrand;
+
+    /// Number of top-level boxes stepped over
+    uint32_t boxCount;
+} ABMP4Scan;
+
+/// Track of a moov box
+typedef struct {
+    uint32_t trackID;
+
+    /// Handler type, such as 'vide' or 'soun'
+    uint32_t handlerType;
+
+    /// Format of the first sample description, such as 'avc1', 'hvc1' or 'mp4a'
+    uint32_t codec;
+
+    /// Units per second of the track's duration and sample times
+    uint32_t timescale;
+
+    /// Duration of the media in the track's timescale
+    uint64_t duration;
+
+    /// Display size in points from the track header, with rotation applied
+    double width;
+    double height;
+
+    /// Number of samples in the track
+    uint32_t sampleCount;
+
+    /// Presentation times in seconds of the sync samples, after their composition offsets and the track's edit list, sorted. NULL when the track has no sync sample table, which means every sample is a keyframe.
+    double *keyframeTimes;
+    uint32_t keyframeCount;
+} ABMP4Track;
+
+/// Metadata parsed from a moov box
+typedef struct {
+    /// Units per second of the movie's duration
+    uint32_t timescale;
+
+    /// Duration of the movie in its timescale
+    uint64_t duration;
+
+    ABMP4Track *tracks;
+    uint32_t trackCount;
+} ABMP4Metadata;
+
+/// Makes a four character code from its characters, such as ABMP4FourCC('m', 'o', 'o', 'v')
+#define ABMP4FourCC(a, b, c, d) (((uint32_t)(uint8_t)(a) << 24) | ((uint32_t)(uint8_t)(b) << 16) | ((uint32_t)(uint8_t)(c) << 8) | (uint32_t)(uint8_t)(d))
+
+/// Begins a scan from the start of a file, the file length may be 0 if it is not known
+void ABMP4ScanInit(ABMP4Scan *scan, uint64_t fileLength);
+
+/// Steps over the top-level boxes whose headers lie in a window of bytes starting at windowOffset in the file. Returns OK once the moov box is found, or NeedData with nextOffset set to where the next window should start.
+ABMP4Status ABMP4ScanWindow(ABMP4Scan *scan, const uint8_t *window, size_t length, uint64_t windowOffset);
+
+/// Parses a whole moov box, including its header. The metadata must be freed with ABMP4MetadataFree, even when parsing fails.
+ABMP4Status ABMP4ParseMoov(const uint8_t *moov, size_t length, ABMP4Metadata *metadata);
+
+/// Frees the tracks and keyframe tables of the metadata
+void ABMP4MetadataFree(ABMP4Metadata *metadata);
+
+/// Returns the first track with the given handler type, or NULL
+const ABMP4Track *ABMP4MetadataTrack(const ABMP4Metadata *metadata, uint32_t handlerType);
+
+/// Duration of the movie in seconds, falling back to the longest track when the movie header has none
+double ABMP4MetadataDuration(const ABMP4Metadata *metadata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ABMP4Parser_h */
@@ -0,0 +1,32 @@
+//
+//  ABMediaBuffer.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/// Immutable encoded bytes and decoded image of a piece of media. A buffer is shared by every mediaView and cache which shows the same media, and is created through the ABMediaBufferPool, which counts its bytes once however many holders it has.
+@interface ABMediaBuffer : NSObject
+
+/// Key which the buffer is registered under in the pool (a url, or a digest of the encoded bytes), nil if it is only shared by identity
+@property (strong, nonatomic, readonly) NSString *key;
+
+/// Encoded bytes of the media, nil if the media was not loaded from data
+@property (strong, nonatomic, readonly) NSData *data;
+
+/// Decoded image of the media, with all of its frames if it is animated
+@property (strong, nonatomic, readonly) UIImage *image;
+
+/// Bytes of decoded pixels held by the image, counting each distinct frame once
+@property (nonatomic, readonly) NSUInteger decodedByteCount;
+
+/// Encoded and decoded bytes held by the buffer
+@property (nonatomic, readonly) NSUInteger byteCount;
+
+/// Bytes of decoded pixels held by an image, counting each distinct frame once (animated GIFs repeat frames to honour their delays)
++ (NSUInteger)decodedByteCountOfImage:(UIImage *)image;
+
+@end
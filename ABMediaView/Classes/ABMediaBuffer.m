@@ -0,0 +1,59 @@
+//
+//  ABMediaBuffer.m
+//  Pods
+//
+//
+//
+
+#import "ABMediaBuffer.h"
+#import "ABMediaBufferPool.h"
+#import "ABCommons.h"
+
+@interface ABMediaBufferPool (Accounting)
+
+/// Called when a buffer is deallocated, so that its bytes are no longer counted as resident
+- (void)removeBufferForKey:(NSString *)key byteCount:(NSUInteger)byteCount;
+
+@end
+
+@implementation ABMediaBuffer
+
+- (id)initWithKey:(NSString *)key data:(NSData *)data image:(UIImage *)image {
+    if (self = [super init]) {
+        _key = [key copy];
+        _data = [data copy];
+        _image = image;
+        _decodedByteCount = [ABMediaBuffer decodedByteCountOfImage:image];
+        _byteCount = _decodedByteCount + _data.length;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[ABMediaBufferPool sharedManager] removeBufferForKey:_key byteCount:_byteCount];
+}
+
++ (NSUInteger)decodedByteCountOfImage:(UIImage *)image {
+    
+    if ([ABCommons isNull:image]) {
+        return 0;
+    }
+    
+    NSArray *frames = [ABCommons notNull:image.images] ? image.images : @[image];
+    NSHashTable *counted = [NSHashTable hashTableWithOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality];
+    NSUInteger byteCount = 0;
+    
+    for (UIImage *frame in frames) {
+        CGImageRef cgImage = frame.CGImage;
+        
+        if (cgImage != NULL && ![counted containsObject:(__bridge id)cgImage]) {
+            [counted addObject:(__bridge id)cgImage];
+            byteCount += CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage);
+        }
+        
+    }
+    
+    return byteCount;
+}
+
+@end
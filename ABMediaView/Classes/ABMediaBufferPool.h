@@ -0,0 +1,36 @@
+//
+//  ABMediaBufferPool.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+#import "ABMediaBuffer.h"
+
+/// Hands out shared ABMediaBuffers, so that the same media held by many mediaViews and caches is stored once. Buffers are held weakly and freed once their last holder releases them. Safe to use from any queue.
+@interface ABMediaBufferPool : NSObject
+
+/// Number of buffers which are alive
+@property (nonatomic, readonly) NSUInteger bufferCount;
+
+/// Unique bytes held by all live buffers, each buffer counted once however many holders it has
+@property (nonatomic, readonly) NSUInteger residentByteCount;
+
+/// Shared Manager for Media Buffer Pool
++ (id)sharedManager;
+
+/// Key identifying the contents of encoded bytes
++ (NSString *)keyForData:(NSData *)data;
+
+/// Returns the live buffer registered under the key, if any
+- (ABMediaBuffer *)bufferForKey:(NSString *)key;
+
+/// Returns a live buffer holding the same bytes as the data, if any
+- (ABMediaBuffer *)bufferForData:(NSData *)data;
+
+/// Returns a live buffer holding the image (or the same bytes as the data, decoded), creating and registering one if there is none. When the key is nil, buffers with data are keyed by their contents.
+- (ABMediaBuffer *)bufferWithImage:(UIImage *)image data:(NSData *)data forKey:(NSString *)key;
+
+@end
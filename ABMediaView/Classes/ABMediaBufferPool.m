@@ -0,0 +1,192 @@
+//
+//  ABMediaBufferPool.m
+//  Pods
+//
+//
+//
+
+#import "ABMediaBufferPool.h"
+#import "ABCommons.h"
+
+@interface ABMediaBuffer (Pool)
+
+- (id)initWithKey:(NSString *)key data:(NSData *)data image:(UIImage *)image;
+
+@end
+
+@interface ABMediaBufferPool () {
+    NSUInteger _bufferCount;
+    NSUInteger _residentByteCount;
+}
+
+/// Live buffers keyed by url or content key, held weakly
+@property (strong, nonatomic) NSMapTable *keyedBuffers;
+
+/// Live buffers keyed by the identity of their image, so the same image is never wrapped twice
+@property (strong, nonatomic) NSMapTable *imageBuffers;
+
+/// Live buffers keyed by the identity of their data, so that data which is already shared is found without hashing it
+@property (strong, nonatomic) NSMapTable *dataBuffers;
+
+@end
+
+@implementation ABMediaBufferPool
+
++ (id)sharedManager {
+    static ABMediaBufferPool *sharedMyManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedMyManager = [[self alloc] init];
+    });
+    return sharedMyManager;
+}
+
+- (id)init {
+    if (self = [super init]) {
+        NSPointerFunctionsOptions identity = NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality;
+        
+        self.keyedBuffers = [NSMapTable strongToWeakObjectsMapTable];
+        self.imageBuffers = [NSMapTable mapTableWithKeyOptions:identity valueOptions:NSPointerFunctionsWeakMemory];
+        self.dataBuffers = [NSMapTable mapTableWithKeyOptions:identity valueOptions:NSPointerFunctionsWeakMemory];
+    }
+    return self;
+}
+
++ (NSString *)keyForData:(NSData *)data {
+    
+    if ([ABCommons isNull:data]) {
+        return nil;
+    }
+    
+    // 64-bit FNV-1a over every byte, buffers found under the key are still compared byte for byte
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    uint64_t hash = 14695981039346656037ULL;
+    
+    for (NSUInteger i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    
+    return [NSString stringWithFormat:@"data:%016llx-%lu", hash, (unsigned long)length];
+}
+
+#pragma mark - Accounting Methods
+
+- (NSUInteger)bufferCount {
+    @synchronized (self) {
+        return _bufferCount;
+    }
+}
+
+- (NSUInteger)residentByteCount {
+    @synchronized (self) {
+        return _residentByteCount;
+    }
+}
+
+- (void)removeBufferForKey:(NSString *)key byteCount:(NSUInteger)byteCount {
+    @synchronized (self) {
+        _bufferCount--;
+        _residentByteCount -= byteCount;
+        
+        // A deallocating buffer reads as nil, unless the key has been registered to a newer buffer
+        if ([ABCommons notNull:key] && [self.keyedBuffers objectForKey:key] == nil) {
+            [self.keyedBuffers removeObjectForKey:key];
+        }
+    }
+}
+
+#pragma mark - Lookup Methods
+
+- (ABMediaBuffer *)bufferForKey:(NSString *)key {
+    
+    if ([ABCommons isNull:key]) {
+        return nil;
+    }
+    
+    @synchronized (self) {
+        return [self.keyedBuffers objectForKey:key];
+    }
+}
+
+- (ABMediaBuffer *)bufferForData:(NSData *)data {
+    
+    if ([ABCommons isNull:data]) {
+        return nil;
+    }
+    
+    @synchronized (self) {
+        ABMediaBuffer *buffer = [self.dataBuffers objectForKey:data];
+        
+        if ([ABCommons notNull:buffer]) {
+            return buffer;
+        }
+    }
+    
+    // Hashing happens outside of the lock, since it reads every byte
+    ABMediaBuffer *buffer = [self bufferForKey:[ABMediaBufferPool keyForData:data]];
+    
+    if ([ABCommons notNull:buffer] && [buffer.data isEqualToData:data]) {
+        return buffer;
+    }
+    
+    return nil;
+}
+
+- (ABMediaBuffer *)bufferWithImage:(UIImage *)image data:(NSData *)data forKey:(NSString *)key {
+    
+    if ([ABCommons isNull:image] && [ABCommons isNull:data]) {
+        return nil;
+    }
+    
+    ABMediaBuffer *existing = nil;
+    
+    if ([ABCommons notNull:image]) {
+        @synchronized (self) {
+            existing = [self.imageBuffers objectForKey:image];
+        }
+    } else if ([ABCommons notNull:data]) {
+        existing = [self bufferForData:data];
+    }
+    
+    if ([ABCommons notNull:existing]) {
+        return existing;
+    }
+    
+    if ([ABCommons notNull:data]) {
+        // An image decoded again from bytes which are already shared is dropped in favour of the shared one
+        existing = [self bufferForData:data];
+        
+        if ([ABCommons notNull:existing] && [ABCommons notNull:existing.image]) {
+            return existing;
+        }
+        
+        if ([ABCommons isNull:key]) {
+            key = [ABMediaBufferPool keyForData:data];
+        }
+    }
+    
+    ABMediaBuffer *buffer = [[ABMediaBuffer alloc] initWithKey:key data:data image:image];
+    
+    @synchronized (self) {
+        _bufferCount++;
+        _residentByteCount += buffer.byteCount;
+        
+        if ([ABCommons notNull:key]) {
+            [self.keyedBuffers setObject:buffer forKey:key];
+        }
+        
+        if ([ABCommons notNull:buffer.image]) {
+            [self.imageBuffers setObject:buffer forKey:buffer.image];
+        }
+        
+        if ([ABCommons notNull:buffer.data]) {
+            [self.dataBuffers setObject:buffer forKey:buffer.data];
+        }
+    }
+    
+    return buffer;
+}
+
+@end
@@ -0,0 +1,28 @@
+//
+//  ABMediaVariant.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/// One rendition of a video, which can be chosen from a ladder of variants
+@interface ABMediaVariant : NSObject
+
+/// URL endpoint for the variant
+@property (strong, nonatomic, readonly) NSString *url;
+
+/// Average bitrate of the variant, in bits per second
+@property (nonatomic, readonly) double bitrate;
+
+/// Size of the variant's video, in pixels (CGSizeZero if unknown)
+@property (nonatomic, readonly) CGSize resolution;
+
+/// Creates a variant with the given url, bitrate (bits per second) and resolution (pixels)
++ (instancetype)variantWithURL:(NSString *)url bitrate:(double)bitrate resolution:(CGSize)resolution;
+
+- (instancetype)initWithURL:(NSString *)url bitrate:(double)bitrate resolution:(CGSize)resolution;
+
+@end
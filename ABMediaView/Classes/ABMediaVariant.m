@@ -0,0 +1,32 @@
+//
+//  ABMediaVariant.m
+//  Pods
+//
+//
+//
+
+#import "ABMediaVariant.h"
+
+@implementation ABMediaVariant
+
++ (instancetype)variantWithURL:(NSString *)url bitrate:(double)bitrate resolution:(CGSize)resolution {
+    return [[self alloc] initWithURL:url bitrate:bitrate resolution:resolution];
+}
+
+- (instancetype)initWithURL:(NSString *)url bitrate:(double)bitrate resolution:(CGSize)resolution {
+    self = [super init];
+    
+    if (self) {
+        _url = [url copy];
+        _bitrate = bitrate;
+        _resolution = resolution;
+    }
+    
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p; %.0fbps; %.0fx%.0f; %@>", NSStringFromClass([self class]), self, self.bitrate, self.resolution.width, self.resolution.height, self.url];
+}
+
+@end
@@ -13,6 +13,11 @@
 @class ABPlayer;
 #import "ABTrackView.h"
 #import "UIImage+animatedGIF.h"
+#import "ABMediaVariant.h"
+#import "ABVariantSelector.h"
+#import "ABSeekCoalescer.h"
+#import "ABVideoMetadata.h"
+#import "ABAudioWaveform.h"
 @class ABLabel;
 
 /// Different types of directory items
@@ -117,6 +122,9 @@ extern const CGFloat ABBufferTabBar;
 /// Gif cached after loading
 @property (strong, nonatomic) UIImage *gifCache;
 
+/// Animated image being shown, whose frames are advanced by the shared animation clock. 'image' returns it too, although UIKit is only given its current frame.
+@property (strong, nonatomic, readonly) UIImage *animatedImage;
+
 #pragma mark - Interface properties
 /// Track which shows the progress of the video being played
 @property (strong, nonatomic) ABTrackView *track;
@@ -140,6 +148,24 @@ extern const CGFloat ABBufferTabBar;
 /// Automate caching for media
 @property (nonatomic) BOOL shouldCacheMedia;
 
+/// Prepare and preroll the player for the next mediaView in the queue while the current mediaView is presented, so that it starts playing as soon as it is presented
+@property (nonatomic) BOOL shouldPrerollQueuedMediaViews;
+
+/// Read the duration, dimensions and keyframes of a video from its moov box as soon as the videoURL is set, before it plays (enabled by default)
+@property (nonatomic) BOOL shouldProbeVideoMetadata;
+
+/// Show the first keyframe of a video as its poster when the mediaView is given no thumbnail, once its metadata has been probed
+@property (nonatomic) BOOL shouldGeneratePosterFrames;
+
+/// Advance the frames of every GIF from one shared clock, which pauses mediaViews that are off-screen, hidden or covered by the fullscreen mediaView (enabled by default)
+@property (nonatomic) BOOL shouldUseSharedAnimationClock;
+
+/// Summarize the waveform of audio once it is on disk, and draw it behind the progress track (enabled by default)
+@property (nonatomic) BOOL shouldGenerateAudioWaveforms;
+
+/// Record the stages of loading each video, from setting its url to its first frame playing, into the ABLoadTrace (disabled by default)
+@property (nonatomic) BOOL shouldTraceMediaLoads;
+
 /// Theme color which will show on the play button and progress track for videos
 @property (strong, nonatomic) UIColor *themeColor;
 
@@ -170,6 +196,9 @@ extern const CGFloat ABBufferTabBar;
 /// Determines whether the video occupies the full screen when displayed
 @property BOOL shouldDisplayFullscreen;
 
+/// Determines whether the player, with its buffer and playhead, is moved to the fullscreen mediaView when this mediaView is tapped, and moved back when it is dismissed (defaults to YES)
+@property (nonatomic) BOOL shouldHandoffMedia;
+
 /// Determines whether the content's original size is full screen. If you are looking to make it so that when a mediaView is selected from another view, that it opens up in full screen, then set the property 'shouldDisplayFullScreen'
 @property (readonly) BOOL isFullScreen;
 
@@ -260,6 +289,33 @@ extern const CGFloat ABBufferTabBar;
 /// Height of the mainWindow
 @property (nonatomic, readonly) CGFloat superviewHeight;
 
+/// Seconds between the presentation (or play request) of the mediaView and the first frame of its video playing, 0 until it has been measured
+@property (nonatomic, readonly) NSTimeInterval timeToFirstFrame;
+
+/// Predicted seconds until playback runs out of buffer, based on the buffered ranges ahead of the playhead and the download throughput. INFINITY when no stall is expected
+@property (nonatomic, readonly) NSTimeInterval timeToStall;
+
+/// Variants of the video which can be switched between, sorted by ascending bitrate (nil when a single videoURL is set)
+@property (strong, nonatomic, readonly) NSArray<ABMediaVariant *> *videoVariants;
+
+/// Variant of the video which is currently selected, its url is the videoURL
+@property (strong, nonatomic, readonly) ABMediaVariant *currentVariant;
+
+/// Decides which of the videoVariants to play, from the measured bandwidth, buffer level and size of the mediaView
+@property (strong, nonatomic) ABVariantSelector *variantSelector;
+
+/// Bandwidth measured while streaming the current variant, in bits per second
+@property (nonatomic, readonly) double measuredBandwidth;
+
+/// Coalesces the seeks made from the track, and measures their latency
+@property (strong, nonatomic, readonly) ABSeekCoalescer *seekCoalescer;
+
+/// Duration, dimensions, codecs and keyframes of the video, probed from its moov box before it plays. nil until probed, or if the video is not an MP4 or MOV.
+@property (strong, nonatomic, readonly) ABVideoMetadata *videoMetadata;
+
+/// Min/max/RMS summary of the downloaded audio, drawn behind the progress track. nil until summarized, or if the audio is not on disk.
+@property (strong, nonatomic, readonly) ABAudioWaveform *audioWaveform;
+
 #pragma mark - Initialization Methods
 
 /// Download the image, display the image, and give completion block
@@ -295,6 +351,12 @@ extern const CGFloat ABBufferTabBar;
 /// Download the video associated with this ABMediaView
 - (void)preloadVideo;
 
+/// Set a ladder of variants for the video, the variant which is played is selected adaptively and switched at safe points during playback
+- (void)setVideoVariants:(NSArray<ABMediaVariant *> *)videoVariants;
+
+/// Set a ladder of variants for the video, and the image that is displayed before the video is played
+- (void)setVideoVariants:(NSArray<ABMediaVariant *> *)videoVariants withThumbnailURL:(NSString *)thumbnailURL;
+
 /// Set the url where the audio can be downloaded from, as well as the url where the thumbnail image can be found
 - (void)setAudioURL:(NSString *)audioURL withThumbnailURL:(NSString *)thumbnailURL;
 
@@ -310,6 +372,9 @@ extern const CGFloat ABBufferTabBar;
 /// Download the audio associated with this ABMediaView
 - (void)preloadAudio;
 
+/// Load the asset for the video or audio associated with this ABMediaView, and preroll a player for it so that playback can begin immediately
+- (void)prerollMedia;
+
 #pragma mark - Shared Manager Methods
 /// Add a mediaView to the queue of mediaViews that will be displayed. If no mediaView is currently showing, this will display that new mediaView
 - (void)queueMediaView:(ABMediaView *)mediaView;
@@ -380,6 +445,18 @@ extern const CGFloat ABBufferTabBar;
 /// When the mediaView finishes playing a video, and whether it will loop
 - (void)mediaViewDidFinishVideo:(ABMediaView *)mediaView withLoop:(BOOL)willLoop;
 
+/// When the buffer or playhead of the mediaView changes, with the predicted seconds until playback runs out of buffer (INFINITY when no stall is expected)
+- (void)mediaView:(ABMediaView *)mediaView didUpdateTimeToStall:(NSTimeInterval)timeToStall;
+
+/// Called when the mediaView switches to another of its videoVariants
+- (void)mediaView:(ABMediaView *)mediaView didSwitchToVariant:(ABMediaVariant *)variant;
+
+/// Called when the metadata of the video has been probed, before it plays, so that its layout can be sized from the dimensions of the video
+- (void)mediaView:(ABMediaView *)mediaView didLoadVideoMetadata:(ABVideoMetadata *)metadata;
+
+/// Called when the waveform of the downloaded audio has been summarized, or read from the summary stored next to it
+- (void)mediaView:(ABMediaView *)mediaView didLoadAudioWaveform:(ABAudioWaveform *)waveform;
+
 /// Called when the mediaView has begun the presentation process
 - (void)mediaViewWillPresent:(ABMediaView *)mediaView;
 
@@ -12,6 +12,14 @@
 #import "ABVolumeManager.h"
 #import "ABCacheManager.h"
 #import "ABLabel.h"
+#import "ABPlayerPool.h"
+#import "ABBufferMonitor.h"
+#import "ABThumbnailStrip.h"
+#import "ABCompletionRegistry.h"
+#import "ABMediaBufferPool.h"
+#import "ABAnimationClock.h"
+#import "ABGestureLayout.h"
+#import "ABLoadTrace.h"
 
 const NSNotificationName ABMediaViewWillRotateNotification = @"ABMediaViewWillRotateNotification";
 const NSNotificationName ABMediaViewDidRotateNotification = @"ABMediaViewDidRotateNotification";
@@ -27,9 +35,15 @@ const CGFloat ABBufferTabBar = 49.0f;
 
 //NSString *const ABTestString = @"Hello World";
 
+/// Minimum seconds between variant switches which are not triggered by a safe point
+static const NSTimeInterval ABMediaViewVariantSwitchInterval = 5.0;
+
+/// Bandwidth last measured by any mediaView, used to select the first variant of a new mediaView
+static double ABMediaViewLastMeasuredBandwidth = 0;
+
 #pragma mark - Private Interface
 
-@interface ABMediaView () <ABLabelDelegate>
+@interface ABMediaView () <ABLabelDelegate, ABAnimationClockTarget>
 
 #pragma mark - UI Properties
 
@@ -82,23 +96,143 @@ const CGFloat ABBufferTabBar = 49.0f;
 /// Variable tracking offset of video
 @property (nonatomic) CGFloat offset;
 
-/// Number of seconds in the buffer
+/// Geometry of the minimize and dismiss gestures, built for the current screen, orientation and buffers
+@property (strong, nonatomic) ABGestureLayout *gestureLayout;
+
+/// Determines if the user is dragging the mediaView, during which the gestureLayout is not rebuilt
+@property (nonatomic) BOOL isSwiping;
+
+/// Media time at which the buffer containing the playhead ends
 @property (nonatomic) CGFloat bufferTime;
 
+/// Keeps track of the loaded time ranges and download throughput of the player item
+@property (strong, nonatomic) ABBufferMonitor *bufferMonitor;
+
+/// Predicted seconds until playback runs out of buffer
+@property (nonatomic, readwrite) NSTimeInterval timeToStall;
+
+/// Variants of the video, sorted by ascending bitrate
+@property (strong, nonatomic, readwrite) NSArray<ABMediaVariant *> *videoVariants;
+
+/// Variant of the video which is currently selected
+@property (strong, nonatomic, readwrite) ABMediaVariant *currentVariant;
+
+/// Bandwidth measured while streaming the current variant, in bits per second
+@property (nonatomic, readwrite) double measuredBandwidth;
+
+/// Determines if the bandwidth has been measured since the last variant switch
+@property (nonatomic) BOOL hasMeasuredCurrentVariant;
+
+/// Time of the last variant switch
+@property (nonatomic) CFTimeInterval variantSwitchTime;
+
+/// Coalesces the seeks made from the track
+@property (strong, nonatomic, readwrite) ABSeekCoalescer *seekCoalescer;
+
+/// Metadata probed from the moov box of the video
+@property (strong, nonatomic, readwrite) ABVideoMetadata *videoMetadata;
+
+/// Waveform summarized from the audioCache
+@property (strong, nonatomic, readwrite) ABAudioWaveform *audioWaveform;
+
+/// Shared buffer holding imageCache, so that the image is counted once however many mediaViews show it
+@property (strong, nonatomic) ABMediaBuffer *imageBuffer;
+
+/// Shared buffer holding gifCache, and the bytes of gifData once they have been decoded
+@property (strong, nonatomic) ABMediaBuffer *gifBuffer;
+
+/// Animated image being shown, whose frames are advanced by the shared animation clock
+@property (strong, nonatomic, readwrite) UIImage *animatedImage;
+
+/// Determines if the frames of the animated image were released while the mediaView was paused
+@property (nonatomic) BOOL releasedAnimationFrames;
+
+/// Determines if the released frames are being decoded again
+@property (nonatomic) BOOL isRestoringAnimationFrames;
+
+/// Inline mediaView which handed its player to this fullscreen mediaView, and gets it back on dismissal
+@property (weak, nonatomic) ABMediaView *handoffSource;
+
 /// Determines if the play has failed to play media
 @property (nonatomic) BOOL failedToPlayMedia;
 
+/// Token returned when adding the periodic time observer to the player
+@property (strong, nonatomic) id timeObserver;
+
+/// Time at which the mediaView was presented or asked to play, used to measure timeToFirstFrame
+@property (nonatomic) CFTimeInterval playRequestTime;
+
+/// Seconds between the presentation (or play request) of the mediaView and the first frame of its video playing
+@property (nonatomic, readwrite) NSTimeInterval timeToFirstFrame;
+
+/// Identifies the current load of the video in the ABLoadTrace, or 0 when it is not traced
+@property (nonatomic) uint64_t loadTraceID;
+
+/// Stages of the current load which have begun and not yet ended, as bits indexed by ABLoadTraceStage
+@property (nonatomic) NSUInteger openTraceStages;
+
 #pragma mark - Private Methods
 
 /// Remove observers for player
 - (void)removeObservers;
 
+/// Shows an image without notifying the delegate, handing animated images to the shared animation clock
+- (void)displayImage:(UIImage *)image;
+
+/// Image given to UIKit, which is the current frame while the shared animation clock advances an animated image
+- (UIImage *)displayedImage;
+
+/// Stops the shared animation clock from advancing the mediaView
+- (void)stopAnimationClock;
+
 /// Selector to play the video from the playRecognizer
 - (void)handleTapFromRecognizer;
 
 /// Loads the video, saves to disk, and decides whether to play the video
 - (void)loadVideoWithPlay:(BOOL)play withCompletion:(VideoDataCompletionBlock)completion;
 
+/// Asset for the video or audio, using the cached file on disk when available
+- (AVURLAsset *)assetForMedia;
+
+/// Sets the player for the mediaView, and registers the observers for its playback
+- (void)attachPlayer:(ABPlayer *)player play:(BOOL)play;
+
+/// Removes the player from the mediaView, and returns it to the ABPlayerPool
+- (void)detachPlayer;
+
+/// Removes the player from the mediaView without recycling it, and returns it
+- (ABPlayer *)takePlayer;
+
+/// Moves the player (or the player prepared for this mediaView) to the given fullscreen mediaView
+- (void)handoffMediaToMediaView:(ABMediaView *)mediaView;
+
+/// Moves the player and decoded media back to the mediaView they were handed off from. Returns NO if there is nothing to return.
+- (BOOL)returnMediaToHandoffSource;
+
+/// Registers the observers for the current item of the player
+- (void)observePlayerItem;
+
+/// Removes the observers for the current item of the player
+- (void)stopObservingPlayerItem;
+
+/// Size of the mediaView in pixels, as it will be displayed when fullscreen or minimized
+- (CGSize)variantViewSize;
+
+/// Selects a variant of the video for the current bandwidth, buffer and size, and switches to it
+- (void)updateVariantAllowingUpswitch:(BOOL)allowUpswitch;
+
+/// Makes the given variant the videoURL, replacing the item of the player at the current time if one is playing
+- (void)switchToVariant:(ABMediaVariant *)variant;
+
+/// Probes the metadata of the videoURL, and applies it once it loads
+- (void)loadVideoMetadata;
+
+/// Summarizes the waveform of the audioCache, and draws it on the track once it loads
+- (void)loadAudioWaveform;
+
+/// Prerolls the player for the mediaView at the front of the queue
+- (void)prerollNextMediaView;
+
 /// Show that the video is loading with animation
 - (void)loadVideoAnimate;
 
@@ -108,6 +242,18 @@ const CGFloat ABBufferTabBar = 49.0f;
 /// Update the frame of the playerLayer
 - (void)updatePlayerFrame;
 
+/// Rebuilds the gestureLayout if the screen, orientation, buffers or minimized size have changed since it was built
+- (void)updateGestureLayout;
+
+/// Records the beginning of a stage of the current load, unless the stage is already open
+- (void)beginTraceStage:(ABLoadTraceStage)stage;
+
+/// Records the end of a stage of the current load, if the stage is open
+- (void)endTraceStage:(ABLoadTraceStage)stage;
+
+/// Records every open stage of the current load as abandoned, and stops tracing the load
+- (void)stopTracingLoad;
+
 @end
 
 #pragma mark - Implementation
@@ -137,6 +283,10 @@ const CGFloat ABBufferTabBar = 49.0f;
     
     if (self) {
         self.mediaViewQueue = [[NSMutableArray alloc] init];
+        self.shouldPrerollQueuedMediaViews = YES;
+        self.shouldProbeVideoMetadata = YES;
+        self.shouldUseSharedAnimationClock = YES;
+        self.shouldGenerateAudioWaveforms = YES;
     }
     
     return self;
@@ -150,6 +300,11 @@ const CGFloat ABBufferTabBar = 49.0f;
 
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
+    
+    [self detachPlayer];
+    
+    // The pool does not retain the owners of prepared players, so a player prerolled for this mediaView is returned here
+    [[ABPlayerPool sharedManager] cancelPreparedPlayerForOwner:self];
 }
 
 - (void)layoutSubviews {
@@ -163,18 +318,16 @@ const CGFloat ABBufferTabBar = 49.0f;
         [self.track updateBarBackground];
     }
     
+    // While dragging, the layout built when the drag began is reused rather than querying the screen on every pan event
+    if (!self.isSwiping) {
+        [self updateGestureLayout];
+    }
+    
     CGRect playFrame = self.playIndicatorView.frame;
     CGRect closeFrame = self.closeButton.frame;
     
-    CGFloat playSize = 30.0f + (30.0f * (self.frame.size.width / self.superviewWidth));
-    
-    if ([ABCommons isLandscape]) {
-        playSize = 30.0f + (30.0f * (self.frame.size.height / self.superviewWidth));
-        closeFrame.origin = CGPointMake(0, 0);
-    }
-    else {
-        closeFrame.origin = CGPointMake(0, 0 + self.topBuffer);
-    }
+    CGFloat playSize = [self.gestureLayout playIndicatorSizeForViewSize:self.frame.size];
+    closeFrame.origin = self.gestureLayout.closeButtonOrigin;
     
     playFrame.size = CGSizeMake(playSize, playSize);
     closeFrame.size = CGSizeMake(50.0f, 50.0f);
@@ -203,7 +356,15 @@ const CGFloat ABBufferTabBar = 49.0f;
         [self setFullscreen:YES];
         self.imageCache = mediaView.imageCache;
         [self setImageURL:mediaView.imageURL];
-        [self setVideoURL:mediaView.videoURL];
+        self.variantSelector = mediaView.variantSelector;
+        self.measuredBandwidth = mediaView.measuredBandwidth;
+        
+        if ([ABCommons notNull:mediaView.videoVariants]) {
+            [self setVideoVariants:mediaView.videoVariants];
+        } else {
+            [self setVideoURL:mediaView.videoURL];
+        }
+        
         [self setAudioURL:mediaView.audioURL];
         [self setCustomPlayButton:mediaView.customPlayButton];
         [self setCustomMusicButton:mediaView.customMusicButton];
@@ -293,12 +454,18 @@ const CGFloat ABBufferTabBar = 49.0f;
 - (void)commonInit {
     self.themeColor = [UIColor cyanColor];
     
+    self.bufferMonitor = [[ABBufferMonitor alloc] init];
+    self.timeToStall = INFINITY;
+    self.variantSelector = [[ABVariantSelector alloc] init];
+    self.seekCoalescer = [[ABSeekCoalescer alloc] init];
+    
     self.minimizedWidthRatio = 0.5f;
     self.minimizedAspectRatio = ABMediaViewRatioPresetLandscape;
     
     [self setBorderAlpha:0.0f];
     self.layer.borderWidth = 1.0f;
     self.autoPlayAfterPresentation = YES;
+    self.shouldHandoffMedia = YES;
     
     [self registerForRotation];
     
@@ -499,11 +666,20 @@ const CGFloat ABBufferTabBar = 49.0f;
 }
 
 #pragma mark - Initialization Methods
+- (UIImage *)image {
+    // UIKit is only given the current frame of an animated image, but the image which was set is still returned
+    if ([ABCommons notNull:self.animatedImage]) {
+        return self.animatedImage;
+    }
+    
+    return [super image];
+}
+
 - (void)setImage:(UIImage *)image {
-    [super setImage:image];
+    [self displayImage:image];
     
     if ([self.delegate respondsToSelector:@selector(mediaView:didSetImage:)]) {
-        [self.delegate mediaView:self didSetImage:self.image];
+        [self.delegate mediaView:self didSetImage:image];
     }
 }
 
@@ -518,10 +694,11 @@ const CGFloat ABBufferTabBar = 49.0f;
         self.image = nil;
     }
     
+    // A reused mediaView should not receive the image it was waiting on before
+    [[ABCompletionRegistry sharedManager] removeWaiter:self forType:ImageCache];
+    
     if ([ABCommons notNull:self.imageURL]) {
         
-        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(updateImage) name:self.imageURL object:nil];
-        
         UIImage *fileImage = [ABCacheManager getCache:ImageCache objectForKey:imageURL];
         if ([ABCommons notNull: fileImage]) {
             self.imageCache = fileImage;
@@ -546,18 +723,25 @@ const CGFloat ABBufferTabBar = 49.0f;
                 }
             }
             else {
-                [ABCacheManager loadImage:imageURL completion:^(UIImage *image, NSString *key, NSError *error) {
-                    if (!self.isLongPressing || self.isFullScreen) {
-                        self.image = image;
-                    }
+                // Every mediaView waiting on the same url is updated when the image loads, even if another one started the download
+                [[ABCompletionRegistry sharedManager] addWaiter:self forType:ImageCache key:imageURL handler:^(ABMediaView *mediaView, UIImage *image, NSError *error) {
                     
-                    self.imageCache = image;
+                    if ([ABCommons notNull:image]) {
+                        
+                        if (!mediaView.isLongPressing || mediaView.isFullScreen) {
+                            mediaView.image = image;
+                        }
+                        
+                        mediaView.imageCache = image;
+                    }
                     
                     if ([ABCommons notNull:completion]) {
                         completion(image, error);
                     }
                 }];
                 
+                [ABCacheManager loadImage:imageURL completion:nil];
+                
             }
 
         }
@@ -574,8 +758,17 @@ const CGFloat ABBufferTabBar = 49.0f;
 
 - (void)setVideoURL:(NSString *)videoURL {
     _videoURL = videoURL;
+    _videoVariants = nil;
+    _currentVariant = nil;
     self.failedToPlayMedia = NO;
     
+    [self stopTracingLoad];
+    
+    if ([ABCommons notNull:videoURL] && [[ABMediaView sharedManager] shouldTraceMediaLoads]) {
+        self.loadTraceID = ABLoadTraceNewLoad();
+        [self beginTraceStage:ABLoadTraceStageLoad];
+    }
+    
     self.track.hidden = YES;
     [self.track setProgress: @0 withDuration: 0];
     [self.track setBuffer: @0 withDuration: 0];
@@ -596,11 +789,39 @@ const CGFloat ABBufferTabBar = 49.0f;
         }
     }
     
+    [self loadVideoMetadata];
+    
     if ([[ABMediaView sharedManager] shouldPreloadVideoAndAudio]) {
         [self preloadVideo];
     }
 }
 
+- (void)setVideoVariants:(NSArray<ABMediaVariant *> *)videoVariants {
+    NSArray *sortedVariants = [ABVariantSelector sortedVariants:videoVariants];
+    
+    if (sortedVariants.count == 0) {
+        [self setVideoURL:nil];
+        return;
+    }
+    
+    if (self.measuredBandwidth <= 0) {
+        self.measuredBandwidth = ABMediaViewLastMeasuredBandwidth;
+    }
+    
+    ABMediaVariant *variant = [self.variantSelector variantFromVariants:sortedVariants bandwidth:self.measuredBandwidth bufferLevel:0 viewSize:[self variantViewSize] currentVariant:nil];
+    
+    [self setVideoURL:variant.url];
+    
+    _videoVariants = sortedVariants;
+    _currentVariant = variant;
+    self.hasMeasuredCurrentVariant = NO;
+}
+
+- (void)setVideoVariants:(NSArray<ABMediaVariant *> *)videoVariants withThumbnailURL:(NSString *)thumbnailURL {
+    [self setImageURL:thumbnailURL];
+    [self setVideoVariants:videoVariants];
+}
+
 - (void)setVideoURL:(NSString *)videoURL withThumbnailURL:(NSString *)thumbnailURL {
     [self setImageURL:thumbnailURL];
     [self setVideoURL:videoURL];
@@ -768,7 +989,7 @@ const CGFloat ABBufferTabBar = 49.0f;
 }
 
 - (void)setGifData:(NSData *)gifData {
-    _gifData = gifData;
+    _gifData = [self sharedGifData:gifData];
     
     if ([ABCommons notNull:self.gifData]) {
         
@@ -786,7 +1007,7 @@ const CGFloat ABBufferTabBar = 49.0f;
 }
 
 - (void)setGifDataPress:(NSData *)gifData {
-    _gifData = gifData;
+    _gifData = [self sharedGifData:gifData];
     
     if ([ABCommons notNull:self.gifData]) {
         
@@ -811,12 +1032,39 @@ const CGFloat ABBufferTabBar = 49.0f;
     
 }
 
+/// Returns the bytes of an already decoded buffer with the same contents, so that equal data given to many mediaViews is only held once
+- (NSData *)sharedGifData:(NSData *)gifData {
+    ABMediaBuffer *buffer = [[ABMediaBufferPool sharedManager] bufferForData:gifData];
+    
+    if ([ABCommons notNull:buffer.data]) {
+        return buffer.data;
+    }
+    
+    return gifData;
+}
+
 #pragma mark - Shared Manager Methods
 
 - (void)queueMediaView: (ABMediaView *) mediaView {
     
     if ([ABCommons notNull:mediaView]) {
         [self.mediaViewQueue addObject:mediaView];
+        
+        if ([ABCommons notNull:self.currentMediaView]) {
+            [self prerollNextMediaView];
+        }
+    }
+    
+}
+
+- (void)prerollNextMediaView {
+    
+    if (self.shouldPrerollQueuedMediaViews && self.mediaViewQueue.count) {
+        ABMediaView *nextMediaView = [self.mediaViewQueue firstObject];
+        
+        if ([nextMediaView hasMedia] && [ABCommons isNull:nextMediaView.player]) {
+            [nextMediaView prerollMedia];
+        }
     }
     
 }
@@ -847,11 +1095,11 @@ const CGFloat ABBufferTabBar = 49.0f;
     
     if ([ABCommons notNull: [[ABMediaView sharedManager] currentMediaView]]) {
         [[[ABMediaView sharedManager] currentMediaView] dismissMediaViewAnimated:YES withCompletion:^(BOOL completed) {
-            [[ABMediaView sharedManager] removeFromQueue:mediaView];
+            [[ABMediaView sharedManager] dequeueMediaView:mediaView];
             [[ABMediaView sharedManager] handleMediaViewPresentation:mediaView animated:animated];
         }];
     } else {
-        [[ABMediaView sharedManager] removeFromQueue:mediaView];
+        [[ABMediaView sharedManager] dequeueMediaView:mediaView];
         [[ABMediaView sharedManager] handleMediaViewPresentation:mediaView animated:animated];
     }
     
@@ -863,6 +1111,9 @@ const CGFloat ABBufferTabBar = 49.0f;
         [mediaView.delegate mediaViewWillPresent:mediaView];
     }
     
+    mediaView.playRequestTime = CACurrentMediaTime();
+    mediaView.timeToFirstFrame = 0;
+    
     self.mainWindow = [[UIApplication sharedApplication] keyWindow];
     [self.mainWindow makeKeyAndVisible];
     
@@ -928,6 +1179,8 @@ const CGFloat ABBufferTabBar = 49.0f;
                 [mediaView handleTapFromRecognizer];
             }
             
+            [[ABMediaView sharedManager] prerollNextMediaView];
+            
         }];
     } else {
         mediaView.alpha = 0;
@@ -965,12 +1218,24 @@ const CGFloat ABBufferTabBar = 49.0f;
                 [mediaView handleTapFromRecognizer];
             }
             
+            [[ABMediaView sharedManager] prerollNextMediaView];
+            
         }];
     }
     
 }
 
 - (void)removeFromQueue:(ABMediaView *)mediaView {
+    // A mediaView removed from the queue will not be presented, so any player prerolled for it is let go
+    if ([ABCommons notNull:mediaView] && [self.mediaViewQueue containsObject:mediaView]) {
+        [[ABPlayerPool sharedManager] cancelPreparedPlayerForOwner:mediaView];
+    }
+    
+    [self dequeueMediaView:mediaView];
+}
+
+- (void)dequeueMediaView:(ABMediaView *)mediaView {
+    // Removes the mediaView from the queue for presentation, keeping any player prerolled for it
     if ([ABCommons notNull:mediaView] && self.mediaViewQueue.count) {
         [self.mediaViewQueue removeObject:mediaView];
     }
@@ -1005,11 +1270,11 @@ const CGFloat ABBufferTabBar = 49.0f;
             self.alpha = 0;
             
         } completion:^(BOOL finished) {
-            [self.player pause];
             
-            [self.playerLayer removeFromSuperlayer];
-            self.playerLayer = nil;
-            self.player = nil;
+            if (![self returnMediaToHandoffSource]) {
+                [self detachPlayer];
+            }
+            
             self.image = nil;
             [self removeFromSuperview];
             
@@ -1034,16 +1299,29 @@ const CGFloat ABBufferTabBar = 49.0f;
 
 - (void)resetMediaInView {
     self.failedToPlayMedia = NO;
+    [self stopTracingLoad];
     
     _imageURL = nil;
     _imageCache = nil;
+    _imageBuffer = nil;
     _videoCache = nil;
     _videoURL = nil;
+    _videoVariants = nil;
+    _currentVariant = nil;
+    _videoMetadata = nil;
+    self.seekCoalescer.keyframeTimes = nil;
     _gifURL = nil;
     _gifData = nil;
     _gifCache = nil;
+    _gifBuffer = nil;
     _audioURL = nil;
     _audioCache = nil;
+    _audioWaveform = nil;
+    self.track.waveform = nil;
+    
+    [self stopAnimationClock];
+    
+    [[ABCompletionRegistry sharedManager] removeWaiter:self];
     
     if ([ABCommons notNull:self.gifLongPressRecognizer]) {
         
@@ -1055,21 +1333,16 @@ const CGFloat ABBufferTabBar = 49.0f;
     
     self.track.hidden = YES;
     
-    [self removeObservers];
-    
-    if ([ABCommons notNull:self.player]) {
-        [self.player pause];
-    }
-    
-    self.player = nil;
-    
-    [self.playerLayer removeFromSuperlayer];
-    self.playerLayer = nil;
+    [[ABPlayerPool sharedManager] cancelPreparedPlayerForOwner:self];
+    [self detachPlayer];
     isLoadingVideo = false;
+    self.timeToFirstFrame = 0;
     
     self.image = nil;
     
     self.bufferTime = 0;
+    [self.bufferMonitor reset];
+    self.timeToStall = INFINITY;
     
     self.playIndicatorView.alpha = 0;
     self.closeButton.alpha = 0;
@@ -1122,6 +1395,14 @@ const CGFloat ABBufferTabBar = 49.0f;
 }
 
 - (void)removeObservers {
+    
+    if ([ABCommons notNull:self.timeObserver]) {
+        [self.player removeTimeObserver:self.timeObserver];
+        self.timeObserver = nil;
+    }
+    
+    [self stopObservingPlayerItem];
+    
     @try {
         [self.player removeObserver:self forKeyPath:@"currentItem.status"];
     } @catch(id anException){
@@ -1157,6 +1438,8 @@ const CGFloat ABBufferTabBar = 49.0f;
     
     // When rotation is enabled, then the positioning of the imageview which holds the AVPlayerLayer must be adjusted to accomodate this change.
     
+    self.gestureLayout = nil;
+    
     if (self.isFullScreen) {
         UIDeviceOrientation orientation = [[UIDevice currentDevice] orientation];
         
@@ -1236,6 +1519,38 @@ const CGFloat ABBufferTabBar = 49.0f;
     
 }
 
+- (void)observePlayerItem {
+    
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(playerItemDidReachEnd:)
+                                                 name:AVPlayerItemDidPlayToEndTimeNotification
+                                               object:[self.player currentItem]];
+    
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(loadVideoAnimate)
+                                                 name:AVPlayerItemPlaybackStalledNotification
+                                               object:[self.player currentItem]];
+    
+    [self.player.currentItem addObserver:self forKeyPath:@"status" options:0 context:nil];
+    
+    // A prerolled item may already be ready, in which case its status will not change
+    if (self.player.currentItem.status == AVPlayerItemStatusUnknown) {
+        [self beginTraceStage:ABLoadTraceStageItemStatus];
+    }
+    
+}
+
+- (void)stopObservingPlayerItem {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:AVPlayerItemDidPlayToEndTimeNotification object:nil];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:AVPlayerItemPlaybackStalledNotification object:nil];
+    
+    @try {
+        [self.player.currentItem removeObserver:self forKeyPath:@"status"];
+    } @catch(id anException){
+        //do nothing, not an observer
+    }
+}
+
 - (void)playerItemDidReachEnd:(NSNotification *)notification {
     // Loop video when end is reached
     
@@ -1249,6 +1564,9 @@ const CGFloat ABBufferTabBar = 49.0f;
     else if (self.allowLooping) {
         AVPlayerItem *p = [notification object];
         [p seekToTime:kCMTimeZero];
+        
+        // Looping back to the start is a safe point to change variants, as nothing ahead of the playhead is buffered
+        [self updateVariantAllowingUpswitch:YES];
     } else {
         [self.player pause];
         AVPlayerItem *p = [notification object];
@@ -1272,28 +1590,28 @@ const CGFloat ABBufferTabBar = 49.0f;
                         self.image = nil;
                     }
                     
-                    if (isnan(self.bufferTime)) {
-                        self.bufferTime = 0;
-                    }
+                    [self.bufferMonitor updateWithLoadedTimeRanges:self.player.currentItem.loadedTimeRanges atTime:CACurrentMediaTime()];
                     
-                    for (NSValue *time in self.player.currentItem.loadedTimeRanges) {
-                        CMTimeRange range;
-                        [time getValue:&range];
-                        
-                        if (CMTimeGetSeconds(range.duration) > self.bufferTime) {
-                            self.bufferTime = CMTimeGetSeconds(range.duration);
-                        }
-                        
+                    if ([ABCommons notNull:self.currentVariant] && self.bufferMonitor.throughput > 0) {
+                        // Seconds of media loaded per second, at the bitrate of the variant being loaded
+                        self.measuredBandwidth = self.bufferMonitor.throughput * self.currentVariant.bitrate;
+                        self.hasMeasuredCurrentVariant = YES;
+                        ABMediaViewLastMeasuredBandwidth = self.measuredBandwidth;
                     }
                     
                     float duration = CMTimeGetSeconds(self.player.currentItem.duration);
+                    NSTimeInterval playhead = CMTimeGetSeconds(self.player.currentTime);
+                    
+                    self.bufferTime = [self.bufferMonitor bufferedEndFromTime:playhead];
                     
                     [self.track setBuffer:[NSNumber numberWithFloat:self.bufferTime] withDuration:duration];
                     
-                    if (self.bufferTime == duration) {
+                    if ([self.bufferMonitor isFullyBufferedForDuration:duration]) {
                         [self cacheStreamedVideo];
                     }
                     
+                    [self updateTimeToStall];
+                    
                     if (self.showTrack) {
                         self.track.hidden = NO;
                     } else {
@@ -1333,6 +1651,7 @@ const CGFloat ABBufferTabBar = 49.0f;
             
             isLoadingVideo = false;
         } else if (object == self.player.currentItem && [keyPath isEqualToString:@"status"]) {
+            [self endTraceStage:ABLoadTraceStageItemStatus];
             
             if (self.player.currentItem.status == AVPlayerStatusReadyToPlay) {
                 self.failedToPlayMedia = NO;
@@ -1342,6 +1661,7 @@ const CGFloat ABBufferTabBar = 49.0f;
             } else if (self.player.currentItem.status == AVPlayerStatusFailed) {
                 NSLog(@"AVPlayer Error %@", self.player.currentItem.error);
                 self.failedToPlayMedia = YES;
+                [self stopTracingLoad];
                 
                 isLoadingVideo = false;
                 
@@ -1371,6 +1691,7 @@ const CGFloat ABBufferTabBar = 49.0f;
             } else if (self.player.currentItem.status == AVPlayerItemStatusUnknown) {
                 NSLog(@"AVPlayer Unknown");
                 self.failedToPlayMedia = YES;
+                [self stopTracingLoad];
                 
                 isLoadingVideo = false;
                 
@@ -1394,12 +1715,6 @@ const CGFloat ABBufferTabBar = 49.0f;
     
 }
 
-- (void)updateImage {
-    if ([ABCommons notNull:self.imageURL]) {
-        self.image = [ABCacheManager getCache:ImageCache objectForKey:self.imageURL];
-    }
-}
-
 #pragma mark - Gesture Methods
 
 - (void)handleSwipe: (UIPanGestureRecognizer *) gesture {
@@ -1424,16 +1739,19 @@ const CGFloat ABBufferTabBar = 49.0f;
             self.ySwipePosition = [gesture locationInView:self].y;
             self.xSwipePosition = [gesture locationInView:self].x;
             self.offset = self.frame.origin.y;
+            
+            [self updateGestureLayout];
+            self.isSwiping = YES;
         } else if (gesture.state == UIGestureRecognizerStateChanged) {
             
             if (self.isDismissable) {
                 [self handleSwipeDismissingForRecognizer:gesture];
             } else if (self.isMinimizable) {
                 
-                if (isMinimized && self.offset == self.maxViewOffset) {
+                if (isMinimized && self.offset == self.gestureLayout.maxViewOffset) {
                     CGPoint vel = [gesture velocityInView:self];
                     
-                    if (self.frame.origin.x > (self.superviewWidth - (self.minViewWidth + 12.0f))) {
+                    if (self.frame.origin.x > self.gestureLayout.minimizedFrame.origin.x) {
                         [self handleDismissingForRecognizer: gesture];
                     } else {
                         
@@ -1466,6 +1784,8 @@ const CGFloat ABBufferTabBar = 49.0f;
                    gesture.state == UIGestureRecognizerStateFailed ||
                    gesture.state == UIGestureRecognizerStateCancelled) {
             
+            self.isSwiping = NO;
+            
             if (self.isDismissable) {
                 self.userInteractionEnabled = NO;
                 
@@ -1546,7 +1866,7 @@ const CGFloat ABBufferTabBar = 49.0f;
                     [UIView animateWithDuration:0.25f delay:0.0f options:UIViewAnimationOptionCurveLinear animations:^{
                         
                         if (minimize) {
-                            self.frame = CGRectMake(self.superviewWidth - self.minViewWidth - 12.0f, self.maxViewOffset, self.minViewWidth, self.minViewHeight);
+                            self.frame = self.gestureLayout.minimizedFrame;
                             self.playIndicatorView.alpha = 0;
                             self.closeButton.alpha = 0;
                             self.topOverlay.alpha = 0;
@@ -1588,6 +1908,8 @@ const CGFloat ABBufferTabBar = 49.0f;
                             [self.delegate mediaViewDidEndMinimizing:self atMinimizedState:minimize];
                         }
                         
+                        [self updateVariantAllowingUpswitch:YES];
+                        
                         if (self.isLoadingVideo) {
                             [self loadVideoAnimate];
                         }
@@ -1602,37 +1924,17 @@ const CGFloat ABBufferTabBar = 49.0f;
 - (void)handleDismissingForRecognizer: (UIPanGestureRecognizer *) gesture {
     
     if (self.isFullScreen) {
-        CGRect frame = self.frame;
-        CGPoint origin = self.frame.origin;
         CGFloat difference = [gesture locationInView:self].x - self.xSwipePosition;
-        CGFloat tempOffset = self.frame.origin.x + difference;
-        CGFloat offsetRatio = (tempOffset - (self.superviewWidth - self.minViewWidth - 12.0f)) / (self.minViewWidth - 12.0f);
-        
-        if (offsetRatio >= 1) {
-            origin.y = self.maxViewOffset;
-            origin.x = self.superviewWidth;
-            self.offset = self.maxViewOffset;
-            self.alpha = 0;
-        } else if (offsetRatio < 0) {
-            origin.y = self.maxViewOffset;
-            origin.x = self.superviewWidth - (self.minViewWidth + 12.0f);
-            self.offset = self.maxViewOffset;
-            self.alpha = 1;
-        } else {
-            origin.y = self.maxViewOffset;
-            origin.x += difference;
-            self.offset = self.maxViewOffset;
-            self.alpha = (1 - offsetRatio);
-        }
+        ABGestureLayoutState state = [self.gestureLayout dismissingStateAtOriginX:self.frame.origin.x + difference];
         
-        frame.origin = origin;
+        self.offset = state.offset;
+        self.alpha = state.alpha;
         
-        [UIView animateWithDuration:0.0f animations:^{
-            self.frame = frame;
-            [self layoutSubviews];
+        // Only the origin changes while dismissing, so setting the frame needs no layout pass
+        [UIView performWithoutAnimation:^{
+            self.frame = state.frame;
         }];
         
-        
         self.ySwipePosition = [gesture locationInView:self].y;
         self.xSwipePosition = [gesture locationInView:self].x;
     }
@@ -1647,60 +1949,26 @@ const CGFloat ABBufferTabBar = 49.0f;
             [self.delegate mediaViewWillChangeDismissing:self];
         }
         
-        CGRect frame = self.frame;
-        CGPoint origin = self.frame.origin;
-        CGSize size = self.frame.size;
-        
-        //        [self logFrame:self.superview.frame withTag:@"Superview"];
-        //        [self logFrame:frame withTag:@"Subview"];
-        
         CGFloat difference = [gesture locationInView:self].y - self.ySwipePosition;
-        CGFloat tempOffset = self.offset + difference;
-        offsetPercentage = tempOffset / self.superviewHeight;
-        
-        if (offsetPercentage > 1) {
-            offsetPercentage = 1;
-        } else if (offsetPercentage < 0) {
-            offsetPercentage = 0;
-        }
+        ABGestureLayoutState state = [self.gestureLayout swipeDismissingStateAtOffset:self.offset + difference];
+        offsetPercentage = state.progress;
         
         if ([self.delegate respondsToSelector:@selector(mediaView:didChangeOffset:)]) {
             [self.delegate mediaView:self didChangeOffset:offsetPercentage];
         }
         
-        CGFloat testOrigin = offsetPercentage * self.superviewHeight;
-        
+        self.offset = state.offset;
+        [self setBorderAlpha:state.borderAlpha];
         
-        size.width = self.superviewWidth;
-        size.height = self.superviewHeight;
-        origin.x = 0;
-        
-        [self setBorderAlpha:0.0f];
+        [UIView performWithoutAnimation:^{
+            self.frame = state.frame;
+            [self layoutIfNeeded];
+        }];
         
-        if (testOrigin >= self.superviewHeight) {
-            origin.y = self.superviewHeight;
-            self.offset = self.superviewHeight;
-        } else if (testOrigin <= 0) {
-            origin.y = 0;
-            self.offset = 0.0f;
-        } else {
-            origin.y = testOrigin;
-            self.offset+= difference;
+        if ([self.delegate respondsToSelector:@selector(mediaViewDidChangeDismissing:)]) {
+            [self.delegate mediaViewDidChangeDismissing:self];
         }
         
-        frame.origin = origin;
-        frame.size = size;
-        
-        [UIView animateWithDuration:0.0f animations:^{
-            self.frame = frame;
-            [self layoutSubviews];
-            
-        } completion:^(BOOL finished) {
-            if ([self.delegate respondsToSelector:@selector(mediaViewDidChangeDismissing:)]) {
-                [self.delegate mediaViewDidChangeDismissing:self];
-            }
-        }];
-        
         self.ySwipePosition = [gesture locationInView:self].y;
         self.xSwipePosition = [gesture locationInView:self].x;
     }
@@ -1715,39 +1983,22 @@ const CGFloat ABBufferTabBar = 49.0f;
             [self.delegate mediaViewWillChangeMinimization:self];
         }
         
-        CGRect frame = self.frame;
-        CGPoint origin = self.frame.origin;
-        CGSize size = self.frame.size;
-        
-        //        [self logFrame:self.superview.frame withTag:@"Superview"];
-        //        [self logFrame:frame withTag:@"Subview"];
-        
         CGFloat difference = [gesture locationInView:self].y - self.ySwipePosition;
-        CGFloat tempOffset = self.offset + difference;
-        offsetPercentage = tempOffset / self.maxViewOffset;
-        
-        if (offsetPercentage > 1) {
-            offsetPercentage = 1;
-        } else if (offsetPercentage < 0) {
-            offsetPercentage = 0;
-        }
+        ABGestureLayoutState state = [self.gestureLayout minimizingStateAtOffset:self.offset + difference];
+        offsetPercentage = state.progress;
         
         if ([self.delegate respondsToSelector:@selector(mediaView:didChangeOffset:)]) {
             [self.delegate mediaView:self didChangeOffset:offsetPercentage];
         }
         
-        CGFloat testOrigin = offsetPercentage * self.maxViewOffset;
+        self.offset = state.offset;
+        [self setBorderAlpha:state.borderAlpha];
         
-        if (testOrigin >= self.maxViewOffset) {
-            origin.y = self.maxViewOffset;
-            size.width = self.minViewWidth;
-            size.height = self.minViewHeight;
-            origin.x = self.superviewWidth - size.width - 12.0f;
-            self.offset = self.maxViewOffset;
-            //            self.layer.cornerRadius = 1.5f;
-            [self setBorderAlpha:1.0f];
+        BOOL showsPlayIndicator = ((!self.isPlayingVideo || self.isLoadingVideo) && [self hasMedia]);
+        
+        if (state.progress >= 1) {
             
-            if ((!self.isPlayingVideo || self.isLoadingVideo) && [self hasMedia])  {
+            if (showsPlayIndicator)  {
                 self.playIndicatorView.alpha = 0;
             }
             
@@ -1755,75 +2006,48 @@ const CGFloat ABBufferTabBar = 49.0f;
             self.topOverlay.alpha = 0;
             self.titleLabel.alpha = 0;
             self.detailsLabel.alpha = 0;
-        } else if (testOrigin <= 0) {
-            origin.y = 0;
-            size.width = self.superviewWidth;
-            size.height = self.superviewHeight;
-            origin.x = 0;
-            self.offset = 0.0f;
+        } else if (state.progress <= 0) {
             self.layer.cornerRadius = 0;
-            [self setBorderAlpha:0.0f];
             
-            if ((!self.isPlayingVideo || self.isLoadingVideo) && [self hasMedia])  {
+            if (showsPlayIndicator)  {
                 self.playIndicatorView.alpha = 1.0f;
             }
             
             [self handleCloseButtonDisplay:self];
             [self handleTopOverlayDisplay:self];
         } else {
-            origin.y = testOrigin;
-            size.width = self.superviewWidth - (offsetPercentage * (self.superviewWidth - self.minViewWidth));
-            size.height = self.superviewHeight - (offsetPercentage * (self.superviewHeight - self.minViewHeight));
-            origin.x = self.superviewWidth - size.width - (offsetPercentage * 12.0f);
-            self.offset+= difference;
-            //            self.layer.cornerRadius = 1.5f * offsetPercentage;
-            [self setBorderAlpha:offsetPercentage];
             
-            if ((!self.isPlayingVideo || self.isLoadingVideo) && [self hasMedia])  {
-                self.playIndicatorView.alpha = (1-offsetPercentage);
+            if (showsPlayIndicator)  {
+                self.playIndicatorView.alpha = state.overlayAlpha;
             }
             
-            if (self.isFullScreen) {
-                UIDeviceOrientation orientation = [[UIDevice currentDevice] orientation];
-                
-                if (self.closeButtonHidden && self.isMinimizable && UIDeviceOrientationIsPortrait(orientation)) {
-                    self.closeButton.alpha = 0;
-                } else {
-                    self.closeButton.alpha = (1-offsetPercentage);
-                }
-                
-                if ([self isPlayingVideo] || ![self hasTitle:self]) {
-                    self.topOverlay.alpha = 0;
-                    self.titleLabel.alpha = 0;
-                    self.detailsLabel.alpha = 0;
-                } else {
-                    self.topOverlay.alpha = (1-offsetPercentage);
-                    self.titleLabel.alpha = (1-offsetPercentage);
-                    self.detailsLabel.alpha = (1-offsetPercentage);
-                }
-                
-            } else {
+            if (self.closeButtonHidden && self.isMinimizable && !self.gestureLayout.isLandscape) {
                 self.closeButton.alpha = 0;
+            } else {
+                self.closeButton.alpha = state.overlayAlpha;
+            }
+            
+            if ([self isPlayingVideo] || ![self hasTitle:self]) {
                 self.topOverlay.alpha = 0;
                 self.titleLabel.alpha = 0;
                 self.detailsLabel.alpha = 0;
+            } else {
+                self.topOverlay.alpha = state.overlayAlpha;
+                self.titleLabel.alpha = state.overlayAlpha;
+                self.detailsLabel.alpha = state.overlayAlpha;
             }
             
         }
         
-        frame.origin = origin;
-        frame.size = size;
-        
-        [UIView animateWithDuration:0.0f animations:^{
-            self.frame = frame;
-            [self layoutSubviews];
-            
-        } completion:^(BOOL finished) {
-            if ([self.delegate respondsToSelector:@selector(mediaViewDidChangeMinimization:)]) {
-                [self.delegate mediaViewDidChangeMinimization:self];
-            }
+        // Setting the frame marks the mediaView for layout when its size changes, which is then laid out once
+        [UIView performWithoutAnimation:^{
+            self.frame = state.frame;
+            [self layoutIfNeeded];
         }];
         
+        if ([self.delegate respondsToSelector:@selector(mediaViewDidChangeMinimization:)]) {
+            [self.delegate mediaViewDidChangeMinimization:self];
+        }
         
         self.ySwipePosition = [gesture locationInView:self].y;
         self.xSwipePosition = [gesture locationInView:self].x;
@@ -1932,7 +2156,13 @@ const CGFloat ABBufferTabBar = 49.0f;
     else {
         
         if (self.shouldDisplayFullscreen && !self.isFullScreen) {
-            [[ABMediaView sharedManager] presentMediaView:[[ABMediaView alloc] initWithMediaView:self]];
+            ABMediaView *mediaView = [[ABMediaView alloc] initWithMediaView:self];
+            
+            if (self.shouldHandoffMedia) {
+                [self handoffMediaToMediaView:mediaView];
+            }
+            
+            [[ABMediaView sharedManager] presentMediaView:mediaView];
         } else {
             
             if ([ABCommons notNull:self.player]) {
@@ -2025,9 +2255,24 @@ const CGFloat ABBufferTabBar = 49.0f;
 - (void)trackView:(ABTrackView *)trackView seekToTime:(float)time {
     
     if ([ABCommons notNull:self.player]) {
-        int32_t timeScale = self.player.currentItem.asset.duration.timescale;
-        CMTime timeCM = CMTimeMakeWithSeconds(time, timeScale);
-        [self.player seekToTime:timeCM toleranceBefore:kCMTimeZero toleranceAfter:kCMTimeZero];
+        [self.seekCoalescer seekToTime:time exact:YES];
+    }
+    
+}
+
+- (void)trackView:(ABTrackView *)trackView scrubToTime:(float)time {
+    
+    if ([ABCommons notNull:self.player]) {
+        [self.seekCoalescer seekToTime:time exact:NO];
+    }
+    
+}
+
+- (void)trackViewWillBeginScrubbing:(ABTrackView *)trackView {
+    
+    // The thumbnail strip is only built once the user scrubs, and is shared with other mediaViews playing the same video
+    if ([self hasVideo] && [ABCommons isNull:trackView.thumbnailStrip] && [ABCommons notNull:self.player.currentItem]) {
+        trackView.thumbnailStrip = [ABThumbnailStrip thumbnailStripForAsset:self.player.currentItem.asset key:self.videoURL];
     }
     
 }
@@ -2035,7 +2280,12 @@ const CGFloat ABBufferTabBar = 49.0f;
 #pragma mark - Custom Accessor Methods
 
 - (void)setGifCache:(UIImage *)gifCache {
-    _gifCache = gifCache;
+    self.gifBuffer = [[ABMediaBufferPool sharedManager] bufferWithImage:gifCache data:nil forKey:self.gifURL];
+    _gifCache = self.gifBuffer.image;
+    
+    if ([ABCommons notNull:self.gifBuffer.data] && [ABCommons notNull:self.gifData] && self.gifData != self.gifBuffer.data && [self.gifData isEqualToData:self.gifBuffer.data]) {
+        _gifData = self.gifBuffer.data;
+    }
     
     if ([ABCommons notNull:self.gifCache]) {
         
@@ -2047,7 +2297,8 @@ const CGFloat ABBufferTabBar = 49.0f;
 }
 
 - (void)setImageCache:(UIImage *)imageCache {
-    _imageCache = imageCache;
+    self.imageBuffer = [[ABMediaBufferPool sharedManager] bufferWithImage:imageCache data:nil forKey:self.imageURL];
+    _imageCache = self.imageBuffer.image;
     
     if ([ABCommons notNull:self.imageCache]) {
         
@@ -2080,6 +2331,8 @@ const CGFloat ABBufferTabBar = 49.0f;
         }
         
     }
+    
+    [self loadAudioWaveform];
 }
 
 - (void)setShowRemainingTime:(BOOL)showRemainingTime {
@@ -2260,6 +2513,7 @@ const CGFloat ABBufferTabBar = 49.0f;
     }
     
     _topBuffer = topBuffer;
+    self.gestureLayout = nil;
     
     [self updateTopOverlayHeight];
     
@@ -2318,6 +2572,7 @@ const CGFloat ABBufferTabBar = 49.0f;
 
 - (void)setBottomBuffer:(CGFloat)bottomBuffer {
     _bottomBuffer = bottomBuffer;
+    self.gestureLayout = nil;
     
     if (_bottomBuffer < 0) {
         self.bottomBuffer = 0;
@@ -2337,6 +2592,7 @@ const CGFloat ABBufferTabBar = 49.0f;
         _minimizedAspectRatio = minimizedAspectRatio;
     }
     
+    self.gestureLayout = nil;
 }
 
 - (void)setMinimizedWidthRatio:(CGFloat)minimizedWidthRatio {
@@ -2351,6 +2607,31 @@ const CGFloat ABBufferTabBar = 49.0f;
         _minimizedWidthRatio = maxWidthRatio;
     }
     
+    self.gestureLayout = nil;
+}
+
+- (ABGestureLayout *)gestureLayout {
+    
+    if ([ABCommons isNull:_gestureLayout]) {
+        [self updateGestureLayout];
+    }
+    
+    return _gestureLayout;
+}
+
+- (void)updateGestureLayout {
+    ABGestureLayoutMetrics metrics;
+    metrics.screenSize = [[UIScreen mainScreen] bounds].size;
+    metrics.isLandscape = [ABCommons isLandscape];
+    metrics.topBuffer = self.topBuffer;
+    metrics.bottomBuffer = self.bottomBuffer;
+    metrics.minimizedWidthRatio = self.minimizedWidthRatio;
+    metrics.minimizedAspectRatio = self.minimizedAspectRatio;
+    
+    if ([ABCommons isNull:_gestureLayout] || !ABGestureLayoutMetricsEqual(_gestureLayout.metrics, metrics)) {
+        _gestureLayout = [[ABGestureLayout alloc] initWithMetrics:metrics];
+    }
+    
 }
 
 - (CGFloat)superviewWidth {
@@ -2483,15 +2764,20 @@ const CGFloat ABBufferTabBar = 49.0f;
     
     if ([ABCommons notNull:self.videoURL]) {
         
-        if (self.fileFromDirectory) {
-            [ABCacheManager loadVideoURL:[NSURL fileURLWithPath:self.videoURL] completion:^(NSURL *videoPath, NSString *key, NSError *error) {
-                self.videoCache = videoPath;
-            }];
-        }else {
-            [ABCacheManager loadVideo:self.videoURL completion:^(NSURL *videoPath, NSString *key, NSError *error) {
-                self.videoCache = videoPath;
-            }];
-        }
+        // The cache manager keys its stages to the load which is current when it is called
+        ABLoadTracePerform(self.loadTraceID, ^{
+            
+            if (self.fileFromDirectory) {
+                [ABCacheManager loadVideoURL:[NSURL fileURLWithPath:self.videoURL] completion:^(NSURL *videoPath, NSString *key, NSError *error) {
+                    self.videoCache = videoPath;
+                }];
+            }else {
+                [ABCacheManager loadVideo:self.videoURL completion:^(NSURL *videoPath, NSString *key, NSError *error) {
+                    self.videoCache = videoPath;
+                }];
+            }
+            
+        });
         
     }
     
@@ -2525,142 +2811,341 @@ const CGFloat ABBufferTabBar = 49.0f;
         if (play) {
             [self loadVideoAnimate];
             isLoadingVideo = true;
+            
+            if (self.playRequestTime == 0) {
+                self.playRequestTime = CACurrentMediaTime();
+            }
         }
         
         [self removeObservers];
         
-        AVURLAsset *asset;
+        if ([ABCommons isNull:self.player] && ![[ABPlayerPool sharedManager] hasPreparedPlayerForOwner:self]) {
+            // The size of the mediaView is known by now, which it may not have been when the variants were set. A prepared player is kept, rather than switched away from.
+            [self updateVariantAllowingUpswitch:YES];
+        }
         
-        if ([ABCommons notNull:self.videoURL]) {
-            
-            if (self.fileFromDirectory) {
-                asset = [AVURLAsset URLAssetWithURL:[NSURL fileURLWithPath:self.videoURL] options:nil];
-            } else {
-                asset = [AVURLAsset URLAssetWithURL:[NSURL URLWithString:self.videoURL] options:nil];
-            }
-            
-            NSURL *filePath = [ABCacheManager getCache:VideoCache objectForKey:self.videoURL];
+        ABPlayer *player = [[ABPlayerPool sharedManager] takePreparedPlayerForOwner:self];
+        
+        if ([ABCommons isNull:player]) {
+            AVPlayerItem *playerItem = [AVPlayerItem playerItemWithAsset:[self assetForMedia]];
             
-            if ([ABCommons notNull:filePath]) {
-                self.videoCache = filePath;
-                AVURLAsset *cachedVideo = [AVURLAsset assetWithURL:self.videoCache];
-                
-                if ([ABCommons notNull:cachedVideo]) {
-                    asset = cachedVideo;
-                }
-                
-            }
-        } else if ([ABCommons notNull:self.audioURL]) {
-            asset = [AVURLAsset URLAssetWithURL:[NSURL URLWithString:self.audioURL] options:nil];
-            
-            NSURL *filePath = [ABCacheManager getCache:AudioCache objectForKey:self.audioURL];
-            
-            if ([ABCommons notNull:filePath]) {
-                self.audioCache = filePath;
-                AVURLAsset *cachedAudio = [AVURLAsset URLAssetWithURL:self.audioCache options:nil];
-                
-                if ([ABCommons notNull:cachedAudio]) {
-                    asset = cachedAudio;
-                }
-                
-            }
+            player = [[ABPlayerPool sharedManager] dequeuePlayerWithItem:playerItem];
         }
         
+        [self attachPlayer:player play:play];
         
-        AVPlayerItem *playerItem = [AVPlayerItem playerItemWithAsset:asset];
+    } else {
         
-        self.player = [[ABPlayer alloc] initWithPlayerItem:playerItem];
+        if ([ABCommons notNull:completion]) {
+            completion(nil, nil);
+        }
         
-        if ([ABCommons notNull:self.player]) {
+    }
+}
+
+- (AVURLAsset *)assetForMedia {
+    AVURLAsset *asset;
+    
+    if ([ABCommons notNull:self.videoURL]) {
+        
+        if (self.fileFromDirectory) {
+            asset = [AVURLAsset URLAssetWithURL:[NSURL fileURLWithPath:self.videoURL] options:nil];
+        } else {
+            asset = [AVURLAsset URLAssetWithURL:[NSURL URLWithString:self.videoURL] options:nil];
+        }
+        
+        NSURL *filePath = [ABCacheManager getCache:VideoCache objectForKey:self.videoURL];
+        
+        if ([ABCommons notNull:filePath]) {
+            self.videoCache = filePath;
+            AVURLAsset *cachedVideo = [AVURLAsset assetWithURL:self.videoCache];
             
-            self.player.actionAtItemEnd = AVPlayerActionAtItemEndNone;
+            if ([ABCommons notNull:cachedVideo]) {
+                asset = cachedVideo;
+            }
             
-            [[NSNotificationCenter defaultCenter] addObserver:self
-                                                     selector:@selector(playerItemDidReachEnd:)
-                                                         name:AVPlayerItemDidPlayToEndTimeNotification
-                                                       object:[self.player currentItem]];
+        }
+    } else if ([ABCommons notNull:self.audioURL]) {
+        asset = [AVURLAsset URLAssetWithURL:[NSURL URLWithString:self.audioURL] options:nil];
+        
+        NSURL *filePath = [ABCacheManager getCache:AudioCache objectForKey:self.audioURL];
+        
+        if ([ABCommons notNull:filePath]) {
+            self.audioCache = filePath;
+            AVURLAsset *cachedAudio = [AVURLAsset URLAssetWithURL:self.audioCache options:nil];
             
-            [[NSNotificationCenter defaultCenter] addObserver:self
-                                                     selector:@selector(loadVideoAnimate)
-                                                         name:AVPlayerItemPlaybackStalledNotification
-                                                       object:[self.player currentItem]];
+            if ([ABCommons notNull:cachedAudio]) {
+                asset = cachedAudio;
+            }
             
-            self.playerLayer = [AVPlayerLayer playerLayerWithPlayer:self.player];
-            self.player.actionAtItemEnd = AVPlayerActionAtItemEndNone;
-            self.playerLayer.videoGravity = [self videoGravity];
+        }
+    }
+    
+    return asset;
+}
+
+- (void)prerollMedia {
+    
+    if (![self hasMedia] || [ABCommons notNull:self.player] || [[ABPlayerPool sharedManager] hasPreparedPlayerForOwner:self]) {
+        return;
+    }
+    
+    AVURLAsset *asset = [self assetForMedia];
+    NSString *mediaURL = [self hasVideo] ? self.videoURL : self.audioURL;
+    
+    if ([ABCommons isNull:asset]) {
+        return;
+    }
+    
+    __weak __typeof(self)weakSelf = self;
+    [asset loadValuesAsynchronouslyForKeys:@[@"playable", @"duration", @"tracks"] completionHandler:^{
+        dispatch_async(dispatch_get_main_queue(), ^{
+            __strong __typeof(weakSelf)strongSelf = weakSelf;
             
-            self.playerLayer.frame = CGRectMake(0, 0, self.frame.size.width, self.frame.size.height);
+            if ([ABCommons isNull:strongSelf] || [ABCommons notNull:strongSelf.player]) {
+                return;
+            }
             
-            [(AVPlayerLayer *)self.layer setPlayer:self.player];
+            // The media may have changed while the asset was loading
+            NSString *currentURL = [strongSelf hasVideo] ? strongSelf.videoURL : strongSelf.audioURL;
             
-            if (play) {
-                [self.player play];
-                
-                [self handleTopOverlayDisplay:self];
-                
-                if (!self.failedToPlayMedia) {
-                    if ([self.delegate respondsToSelector:@selector(mediaViewDidPlayVideo:)]) {
-                        [self.delegate mediaViewDidPlayVideo:self];
-                    }
-                }
+            if (![currentURL isEqualToString:mediaURL] || [asset statusOfValueForKey:@"playable" error:nil] != AVKeyValueStatusLoaded) {
+                return;
             }
             
-            [self.player.currentItem addObserver:self forKeyPath:@"status" options:0 context:nil];
-            
-            [self.player addObserver:self
-                          forKeyPath:@"currentItem.loadedTimeRanges"
-                             options:NSKeyValueObservingOptionNew
-                             context:nil];
+            if ([[ABPlayerPool sharedManager] hasPreparedPlayerForOwner:strongSelf]) {
+                return;
+            }
             
-            [self.player addObserver:self
-                          forKeyPath:@"playbackBufferEmpty"
-                             options:NSKeyValueObservingOptionNew
-                             context:nil];
+            AVPlayerItem *playerItem = [AVPlayerItem playerItemWithAsset:asset];
+            ABPlayer *player = [[ABPlayerPool sharedManager] dequeuePlayerWithItem:playerItem];
             
-            [self.player addObserver:self
-                          forKeyPath:@"playbackLikelyToKeepUp"
-                             options:NSKeyValueObservingOptionNew
-                             context:nil];
+            [[ABPlayerPool sharedManager] setPreparedPlayer:player forOwner:strongSelf];
+        });
+    }];
+    
+}
+
+- (void)attachPlayer:(ABPlayer *)player play:(BOOL)play {
+    self.player = player;
+    
+    [self.bufferMonitor reset];
+    self.track.bufferMonitor = self.bufferMonitor;
+    
+    [self.seekCoalescer cancelPendingSeeks];
+    self.seekCoalescer.player = self.player;
+    
+    if ([ABCommons notNull:self.player]) {
+        
+        self.player.actionAtItemEnd = AVPlayerActionAtItemEndNone;
+        
+        [self observePlayerItem];
+        
+        self.playerLayer = [AVPlayerLayer playerLayerWithPlayer:self.player];
+        self.playerLayer.videoGravity = [self videoGravity];
+        
+        self.playerLayer.frame = CGRectMake(0, 0, self.frame.size.width, self.frame.size.height);
+        
+        [(AVPlayerLayer *)self.layer setPlayer:self.player];
+        
+        if (play) {
+            [self.player play];
             
-            [self.player addObserver:self
-                          forKeyPath:@"playbackBufferFull"
-                             options:NSKeyValueObservingOptionNew
-                             context:nil];
+            [self handleTopOverlayDisplay:self];
             
-            CMTime interval = CMTimeMake(10.0, NSEC_PER_SEC);
+            if (!self.failedToPlayMedia) {
+                if ([self.delegate respondsToSelector:@selector(mediaViewDidPlayVideo:)]) {
+                    [self.delegate mediaViewDidPlayVideo:self];
+                }
+            }
+        }
+        
+        [self.player addObserver:self
+                      forKeyPath:@"currentItem.loadedTimeRanges"
+                         options:NSKeyValueObservingOptionNew
+                         context:nil];
+        
+        [self.player addObserver:self
+                      forKeyPath:@"playbackBufferEmpty"
+                         options:NSKeyValueObservingOptionNew
+                         context:nil];
+        
+        [self.player addObserver:self
+                      forKeyPath:@"playbackLikelyToKeepUp"
+                         options:NSKeyValueObservingOptionNew
+                         context:nil];
+        
+        [self.player addObserver:self
+                      forKeyPath:@"playbackBufferFull"
+                         options:NSKeyValueObservingOptionNew
+                         context:nil];
+        
+        CMTime interval = CMTimeMake(10.0, NSEC_PER_SEC);
+        
+        [self beginTraceStage:ABLoadTraceStageFirstTick];
+        
+        __weak __typeof(self)weakSelf = self;
+        self.timeObserver = [self.player addPeriodicTimeObserverForInterval:interval queue:dispatch_get_main_queue() usingBlock:^(CMTime time) {
+            __strong __typeof(weakSelf)strongSelf = weakSelf;
             
-            __weak __typeof(self)weakSelf = self;
-            [self.player addPeriodicTimeObserverForInterval:interval queue:dispatch_get_main_queue() usingBlock:^(CMTime time) {
+            if ([ABCommons notNull: strongSelf.player.currentItem]) {
+                [strongSelf endTraceStage:ABLoadTraceStageFirstTick];
                 
-                if ([ABCommons notNull: weakSelf.player.currentItem]) {
-                    
-                    if (weakSelf.showTrack) {
-                        weakSelf.track.hidden = NO;
-                    } else {
-                        weakSelf.track.hidden = YES;
-                    }
-                    
-                    CGFloat progress = CMTimeGetSeconds(time);
-                    
-                    if (progress != 0 && [self.animateTimer isValid]) {
-                        isLoadingVideo = false;
-                        [weakSelf stopVideoAnimate];
-                        [weakSelf hideVideoAnimated: NO];
-                    }
-                    
-                    [weakSelf.track setProgress: [NSNumber numberWithFloat:CMTimeGetSeconds(time)] withDuration: CMTimeGetSeconds(weakSelf.player.currentItem.duration)];
+                if (strongSelf.showTrack) {
+                    strongSelf.track.hidden = NO;
+                } else {
+                    strongSelf.track.hidden = YES;
                 }
                 
-            }];
+                CGFloat progress = CMTimeGetSeconds(time);
+                
+                if (progress != 0 && strongSelf.playRequestTime != 0) {
+                    strongSelf.timeToFirstFrame = CACurrentMediaTime() - strongSelf.playRequestTime;
+                    strongSelf.playRequestTime = 0;
+                }
+                
+                if (progress != 0 && [strongSelf.animateTimer isValid]) {
+                    strongSelf->isLoadingVideo = false;
+                    [strongSelf stopVideoAnimate];
+                    [strongSelf hideVideoAnimated: NO];
+                }
+                
+                if (progress != 0 && strongSelf.loadTraceID != 0) {
+                    [strongSelf endTraceStage:ABLoadTraceStageLoad];
+                    [strongSelf stopTracingLoad];
+                }
+                
+                [strongSelf.track setProgress: [NSNumber numberWithFloat:CMTimeGetSeconds(time)] withDuration: CMTimeGetSeconds(strongSelf.player.currentItem.duration)];
+                
+                // Nothing is reported while a download is stalled, so the prediction is also refreshed as the playhead moves
+                [strongSelf.bufferMonitor advanceToTime:CACurrentMediaTime()];
+                [strongSelf updateTimeToStall];
+            }
+            
+        }];
+    }
+    
+}
+
+- (void)detachPlayer {
+    [[ABPlayerPool sharedManager] recyclePlayer:[self takePlayer]];
+}
+
+- (ABPlayer *)takePlayer {
+    
+    if ([ABCommons isNull:self.player]) {
+        return nil;
+    }
+    
+    ABPlayer *player = self.player;
+    
+    [self removeObservers];
+    
+    // The first tick which would stop the loading animation now fires on the mediaView which takes the player
+    if (self.isLoadingVideo || [self.animateTimer isValid]) {
+        isLoadingVideo = false;
+        [self stopVideoAnimate];
+        self.playIndicatorView.image = [self imageForPlayButton];
+        self.playIndicatorView.alpha = 1;
+    }
+
+    [self.seekCoalescer cancelPendingSeeks];
+    self.seekCoalescer.player = nil;
+    self.track.thumbnailStrip = nil;
+    
+    if ([(AVPlayerLayer *)self.layer player] == self.player) {
+        [(AVPlayerLayer *)self.layer setPlayer:nil];
+    }
+    
+    [self.playerLayer removeFromSuperlayer];
+    self.playerLayer = nil;
+    
+    self.player = nil;
+    
+    return player;
+}
+
+- (void)handoffMediaToMediaView:(ABMediaView *)mediaView {
+    
+    if ([ABCommons isNull:mediaView]) {
+        return;
+    }
+    
+    // The decoded image and GIF frames were already shared by reference in initWithMediaView:
+    mediaView.handoffSource = self;
+    
+    ABPlayer *player = nil;
+    
+    if ([ABCommons notNull:self.player] && self.player.currentItem.status != AVPlayerItemStatusFailed) {
+        player = [self takePlayer];
+        
+        if (player.rate != 0) {
+            [player pause];
+        }
+    } else {
+        player = [[ABPlayerPool sharedManager] takePreparedPlayerForOwner:self];
+    }
+    
+    if ([ABCommons isNull:player]) {
+        return;
+    }
+    
+    // The player is loaded with this mediaView's variant, so the fullscreen mediaView starts on it too
+    if ([ABCommons notNull:self.currentVariant] && [mediaView.videoVariants containsObject:self.currentVariant]) {
+        [mediaView switchToVariant:self.currentVariant];
+    }
+    
+    // The fullscreen mediaView takes the player, with its buffered item and playhead, when it starts playing
+    [[ABPlayerPool sharedManager] setPreparedPlayer:player forOwner:mediaView];
+}
+
+- (BOOL)returnMediaToHandoffSource {
+    ABMediaView *source = self.handoffSource;
+    self.handoffSource = nil;
+    
+    if ([ABCommons isNull:source] || [ABCommons notNull:source.player]) {
+        return NO;
+    }
+    
+    // Frames decoded while fullscreen are kept, so the mediaView does not decode them again
+    if ([ABCommons isNull:source.gifCache]) {
+        source.gifCache = self.gifCache;
+    }
+    
+    if ([ABCommons isNull:source.imageCache]) {
+        source.imageCache = self.imageCache;
+    }
+    
+    if ([ABCommons notNull:self.currentVariant] && [source.videoVariants containsObject:self.currentVariant]) {
+        [source switchToVariant:self.currentVariant];
+    }
+    
+    NSString *mediaURL = [self hasVideo] ? self.videoURL : self.audioURL;
+    NSString *sourceURL = [source hasVideo] ? source.videoURL : source.audioURL;
+    
+    if ([ABCommons isNull:mediaURL] || ![mediaURL isEqualToString:sourceURL]) {
+        return NO;
+    }
+    
+    if ([ABCommons notNull:self.player]) {
+        ABPlayer *player = [self takePlayer];
+        
+        if (player.rate != 0) {
+            [player pause];
         }
         
+        [source attachPlayer:player play:NO];
     } else {
+        ABPlayer *player = [[ABPlayerPool sharedManager] takePreparedPlayerForOwner:self];
         
-        if ([ABCommons notNull:completion]) {
-            completion(nil, nil);
+        if ([ABCommons isNull:player]) {
+            return NO;
         }
         
+        [[ABPlayerPool sharedManager] setPreparedPlayer:player forOwner:source];
     }
+    
+    return YES;
 }
 
 - (void)adjustSubviews {
@@ -2767,20 +3252,15 @@ const CGFloat ABBufferTabBar = 49.0f;
 - (void)updateTitleLabelOffsets:(BOOL)hasDetails {
     
     if ([ABCommons notNull:self.titleLabel]) {
-        CGFloat constant = 8.0f+self.topBuffer;
-        
-        if (!hasDetails) {
-            constant += 8.0f;
-        }
-        
-        if ([ABCommons isLandscape]) {
-            constant -= self.topBuffer;
-        }
+        CGFloat constant = [self.gestureLayout titleTopOffsetWithDetails:hasDetails];
         
         if ([ABCommons notNull:self.titleTopOffset]) {
-            [self layoutIfNeeded];
-            self.titleTopOffset.constant = constant;
-            [self layoutIfNeeded];
+            
+            // The caller lays out once after every offset is updated, and an unchanged constant needs no layout at all
+            if (self.titleTopOffset.constant != constant) {
+                self.titleTopOffset.constant = constant;
+            }
+            
         } else {
             self.titleTopOffset = [NSLayoutConstraint constraintWithItem:self.titleLabel
                                                                attribute:NSLayoutAttributeTop
@@ -2798,16 +3278,14 @@ const CGFloat ABBufferTabBar = 49.0f;
 - (void)updateDetailsLabelOffsets {
     
     if ([ABCommons notNull:self.titleLabel]) {
-        CGFloat constant = 8.0f+self.topBuffer;
-        
-        if ([ABCommons isLandscape]) {
-            constant -= self.topBuffer;
-        }
+        CGFloat constant = self.gestureLayout.detailsTopOffset;
         
         if ([ABCommons notNull:self.detailsTopOffset]) {
-            [self layoutIfNeeded];
-            self.detailsTopOffset.constant = constant+18.0f;
-            [self layoutIfNeeded];
+            
+            if (self.detailsTopOffset.constant != constant) {
+                self.detailsTopOffset.constant = constant;
+            }
+            
         } else {
             self.detailsTopOffset = [NSLayoutConstraint constraintWithItem:self.detailsLabel
                                                                  attribute:NSLayoutAttributeTop
@@ -2815,7 +3293,7 @@ const CGFloat ABBufferTabBar = 49.0f;
                                                                     toItem:self
                                                                  attribute:NSLayoutAttributeTop
                                                                 multiplier:1
-                                                                  constant:constant+18.0f];
+                                                                  constant:constant];
         }
     }
 }
@@ -2824,16 +3302,14 @@ const CGFloat ABBufferTabBar = 49.0f;
     
     if ([ABCommons notNull:self.topOverlay]) {
         
-        CGFloat height = 50.0f+self.topBuffer;
-        
-        if ([ABCommons isLandscape]) {
-            height -= self.topBuffer;
-        }
+        CGFloat height = self.gestureLayout.topOverlayHeight;
         
         if ([ABCommons notNull:self.topOverlayHeight]) {
-            [self layoutIfNeeded];
-            self.topOverlayHeight.constant = height;
-            [self layoutIfNeeded];
+            
+            if (self.topOverlayHeight.constant != height) {
+                self.topOverlayHeight.constant = height;
+            }
+            
         } else {
             self.topOverlayHeight = [NSLayoutConstraint constraintWithItem:self.topOverlay
                                                                  attribute:NSLayoutAttributeHeight
@@ -2994,10 +3470,236 @@ const CGFloat ABBufferTabBar = 49.0f;
     
 }
 
+- (void)updateTimeToStall {
+    
+    if ([ABCommons isNull:self.player.currentItem]) {
+        return;
+    }
+    
+    NSTimeInterval playhead = CMTimeGetSeconds(self.player.currentTime);
+    NSTimeInterval duration = CMTimeGetSeconds(self.player.currentItem.duration);
+    
+    NSTimeInterval timeToStall = [self.bufferMonitor timeToStallFromTime:playhead duration:duration rate:self.player.rate];
+    
+    BOOL didChange = (isinf(timeToStall) != isinf(self.timeToStall)) || fabs(timeToStall - self.timeToStall) >= 0.1;
+    
+    self.timeToStall = timeToStall;
+    
+    if (didChange && [self.delegate respondsToSelector:@selector(mediaView:didUpdateTimeToStall:)]) {
+        [self.delegate mediaView:self didUpdateTimeToStall:self.timeToStall];
+    }
+    
+    // Switching mid-playback discards the buffer, so it is only worth doing to a lower variant when a stall is predicted
+    if (!isinf(self.timeToStall) && self.hasMeasuredCurrentVariant && (CACurrentMediaTime() - self.variantSwitchTime) >= ABMediaViewVariantSwitchInterval) {
+        [self updateVariantAllowingUpswitch:NO];
+    }
+    
+}
+
+#pragma mark - Variant Methods
+
+- (CGSize)variantViewSize {
+    CGSize size = self.bounds.size;
+    
+    if (self.isFullScreen) {
+        
+        if (self.isMinimized) {
+            size = CGSizeMake(self.minViewWidth, self.minViewHeight);
+        } else {
+            size = CGSizeMake(self.superviewWidth, self.superviewHeight);
+        }
+        
+    }
+    
+    CGFloat scale = [UIScreen mainScreen].scale;
+    
+    return CGSizeMake(size.width * scale, size.height * scale);
+}
+
+- (void)updateVariantAllowingUpswitch:(BOOL)allowUpswitch {
+    
+    if (self.videoVariants.count < 2) {
+        return;
+    }
+    
+    NSTimeInterval bufferLevel = 0;
+    
+    if ([ABCommons notNull:self.player.currentItem]) {
+        bufferLevel = [self.bufferMonitor bufferedAheadOfTime:CMTimeGetSeconds(self.player.currentTime)];
+    }
+    
+    ABMediaVariant *variant = [self.variantSelector variantFromVariants:self.videoVariants bandwidth:self.measuredBandwidth bufferLevel:bufferLevel viewSize:[self variantViewSize] currentVariant:self.currentVariant];
+    
+    if (!allowUpswitch && variant.bitrate > self.currentVariant.bitrate) {
+        return;
+    }
+    
+    [self switchToVariant:variant];
+}
+
+#pragma mark - Metadata Methods
+
+- (NSURL *)videoMetadataURL {
+    
+    if (self.fileFromDirectory) {
+        return [NSURL fileURLWithPath:self.videoURL];
+    }
+    
+    // A video cached on disk is probed without touching the network
+    NSURL *filePath = [ABCacheManager getCache:VideoCache objectForKey:self.videoURL];
+    
+    if ([ABCommons notNull:filePath]) {
+        return filePath;
+    }
+    
+    return [NSURL URLWithString:self.videoURL];
+}
+
+- (void)loadVideoMetadata {
+    self.videoMetadata = nil;
+    self.seekCoalescer.keyframeTimes = nil;
+    
+    [[ABCompletionRegistry sharedManager] removeWaiter:self forType:MetadataCache];
+    
+    if (![[ABMediaView sharedManager] shouldProbeVideoMetadata] || [ABCommons isNull:self.videoURL]) {
+        return;
+    }
+    
+    NSURL *url = [self videoMetadataURL];
+    
+    if ([ABCommons isNull:url]) {
+        return;
+    }
+    
+    [[ABCompletionRegistry sharedManager] addWaiter:self forType:MetadataCache key:url.absoluteString handler:^(ABMediaView *mediaView, ABVideoMetadata *metadata, NSError *error) {
+        
+        if ([ABCommons notNull:metadata]) {
+            [mediaView didLoadVideoMetadata:metadata];
+        }
+        
+    }];
+    
+    [ABCacheManager loadVideoMetadataURL:url completion:nil];
+}
+
+- (void)didLoadVideoMetadata:(ABVideoMetadata *)metadata {
+    self.videoMetadata = metadata;
+    self.seekCoalescer.keyframeTimes = metadata.keyframeTimes;
+    
+    // The track shows the duration of the video before the player item has loaded it
+    if (self.track.duration <= 0 && metadata.duration > 0) {
+        [self.track setProgress:@0 withDuration:metadata.duration];
+    }
+    
+    if ([[ABMediaView sharedManager] shouldGeneratePosterFrames] && [ABCommons isNull:self.image] && [ABCommons isNull:self.imageURL] && [ABCommons isNull:self.gifURL] && [ABCommons isNull:self.gifData]) {
+        [self loadPosterFrame];
+    }
+    
+    if ([self.delegate respondsToSelector:@selector(mediaView:didLoadVideoMetadata:)]) {
+        [self.delegate mediaView:self didLoadVideoMetadata:metadata];
+    }
+    
+}
+
+- (void)loadAudioWaveform {
+    self.audioWaveform = nil;
+    self.track.waveform = nil;
+    
+    [[ABCompletionRegistry sharedManager] removeWaiter:self forType:WaveformCache];
+    
+    // Only audio on disk is summarized, streamed audio has nothing to read the samples from
+    if (![[ABMediaView sharedManager] shouldGenerateAudioWaveforms] || [ABCommons isNull:self.audioCache] || !self.audioCache.isFileURL) {
+        return;
+    }
+    
+    NSURL *fileURL = self.audioCache;
+    
+    [[ABCompletionRegistry sharedManager] addWaiter:self forType:WaveformCache key:fileURL.absoluteString handler:^(ABMediaView *mediaView, ABAudioWaveform *waveform, NSError *error) {
+        
+        if ([ABCommons notNull:waveform]) {
+            [mediaView didLoadAudioWaveform:waveform];
+        }
+        
+    }];
+    
+    [ABCacheManager loadAudioWaveformURL:fileURL completion:nil];
+}
+
+- (void)didLoadAudioWaveform:(ABAudioWaveform *)waveform {
+    self.audioWaveform = waveform;
+    self.track.waveform = waveform;
+    
+    if ([self.delegate respondsToSelector:@selector(mediaView:didLoadAudioWaveform:)]) {
+        [self.delegate mediaView:self didLoadAudioWaveform:waveform];
+    }
+    
+}
+
+- (void)loadPosterFrame {
+    NSString *videoURL = self.videoURL;
+    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:self.videoMetadata.url options:nil];
+    
+    // The poster comes from the same shared strip that is shown while scrubbing, so it is only generated once
+    ABThumbnailStrip *strip = [ABThumbnailStrip thumbnailStripForAsset:asset key:videoURL duration:self.videoMetadata.duration];
+    
+    __weak __typeof(self)weakSelf = self;
+    [strip thumbnailForTime:self.videoMetadata.keyframeTimes.firstObject.doubleValue requester:self completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        __strong __typeof(weakSelf)strongSelf = weakSelf;
+        
+        if ([ABCommons notNull:thumbnail] && [ABCommons isNull:strongSelf.image] && [strongSelf.videoURL isEqualToString:videoURL]) {
+            strongSelf.image = thumbnail;
+        }
+        
+    }];
+}
+
+- (void)switchToVariant:(ABMediaVariant *)variant {
+    
+    if ([ABCommons isNull:variant] || variant == self.currentVariant) {
+        return;
+    }
+    
+    _currentVariant = variant;
+    _videoURL = variant.url;
+    _videoCache = nil;
+    
+    // Keyframes differ between variants, so the new variant is probed before scrubbing snaps to them again
+    [self loadVideoMetadata];
+    
+    self.hasMeasuredCurrentVariant = NO;
+    self.variantSwitchTime = CACurrentMediaTime();
+    
+    if ([ABCommons isNull:self.player.currentItem]) {
+        // A player prepared for the previous variant would play the wrong url
+        [[ABPlayerPool sharedManager] cancelPreparedPlayerForOwner:self];
+    } else {
+        CMTime currentTime = self.player.currentTime;
+        
+        [self stopObservingPlayerItem];
+        
+        AVPlayerItem *playerItem = [AVPlayerItem playerItemWithAsset:[self assetForMedia]];
+        [self.player replaceCurrentItemWithPlayerItem:playerItem];
+        
+        [self observePlayerItem];
+        
+        [self.bufferMonitor reset];
+        self.bufferTime = 0;
+        
+        [self.seekCoalescer cancelPendingSeeks];
+        [self.seekCoalescer seekToTime:CMTimeGetSeconds(currentTime) exact:YES];
+    }
+    
+    if ([self.delegate respondsToSelector:@selector(mediaView:didSwitchToVariant:)]) {
+        [self.delegate mediaView:self didSwitchToVariant:variant];
+    }
+    
+}
+
 - (void)loadVideoAnimate {
     // Set video loader animation timer
     
-    [self stopVideoAnimate];
+    // Restarting the timer, such as on rotation, does not end the traced animation
+    [self.animateTimer invalidate];
     
     if (self.failedToPlayMedia) {
         self.playIndicatorView.alpha = 1.0f;
@@ -3006,6 +3708,7 @@ const CGFloat ABBufferTabBar = 49.0f;
         [self animateVideo];
         
         self.animateTimer = [NSTimer scheduledTimerWithTimeInterval:0.751f target:self selector:@selector(animateVideo) userInfo:nil repeats:YES];
+        [self beginTraceStage:ABLoadTraceStageLoadingAnimation];
     }
     
 }
@@ -3013,6 +3716,7 @@ const CGFloat ABBufferTabBar = 49.0f;
 - (void)stopVideoAnimate {
     // Stop animating video loader
     [self.animateTimer invalidate];
+    [self endTraceStage:ABLoadTraceStageLoadingAnimation];
 }
 
 - (void)hideVideoAnimated:(BOOL)animated {
@@ -3217,17 +3921,174 @@ const CGFloat ABBufferTabBar = 49.0f;
 }
 
 
-@end
+#pragma mark - Load Trace Methods
 
+- (void)beginTraceStage:(ABLoadTraceStage)stage {
+    NSUInteger stageBit = ((NSUInteger)1 << stage);
+    
+    if (self.loadTraceID != 0 && !(self.openTraceStages & stageBit)) {
+        self.openTraceStages |= stageBit;
+        ABLoadTraceBegin(self.loadTraceID, stage);
+    }
+    
+}
 
+- (void)endTraceStage:(ABLoadTraceStage)stage {
+    NSUInteger stageBit = ((NSUInteger)1 << stage);
+    
+    if (self.openTraceStages & stageBit) {
+        self.openTraceStages &= ~stageBit;
+        ABLoadTraceEnd(self.loadTraceID, stage);
+    }
+    
+}
 
+- (void)stopTracingLoad {
+    
+    for (ABLoadTraceStage stage = 0; stage < ABLoadTraceStageCount; stage++) {
+        
+        if (self.openTraceStages & ((NSUInteger)1 << stage)) {
+            ABLoadTraceCancel(self.loadTraceID, stage);
+        }
+        
+    }
+    
+    self.openTraceStages = 0;
+    self.loadTraceID = 0;
+}
 
+#pragma mark - Animation Clock Methods
 
+- (void)displayImage:(UIImage *)image {
+    self.releasedAnimationFrames = NO;
+    
+    if (image.images.count > 1 && [[ABMediaView sharedManager] shouldUseSharedAnimationClock]) {
+        // Only a single frame is given to UIKit, and the shared clock advances it while the mediaView is visible
+        self.animatedImage = image;
+        [super setImage:image.images.firstObject];
+        [[ABAnimationClock sharedManager] addTarget:self];
+    } else {
+        [self stopAnimationClock];
+        [super setImage:image];
+    }
+    
+}
 
+- (UIImage *)displayedImage {
+    return [super image];
+}
 
+- (void)stopAnimationClock {
+    self.animatedImage = nil;
+    self.releasedAnimationFrames = NO;
+    
+    if ([[ABAnimationClock sharedManager] containsTarget:self]) {
+        [[ABAnimationClock sharedManager] removeTarget:self];
+    }
+    
+}
 
+- (UIImage *)animationClockImage {
+    return self.animatedImage;
+}
 
+- (BOOL)isVisibleForAnimationClock {
+    UIWindow *window = self.window;
+    
+    if ([ABCommons isNull:window] || window.hidden || self.hidden || self.alpha < 0.01f) {
+        return NO;
+    }
+    
+    CGRect visibleRect = [self convertRect:self.bounds toView:nil];
+    
+    // Ancestors which are hidden, transparent or clip the mediaView out of their bounds, such as a scrolled feed, hide it as well
+    for (UIView *view = self.superview; [ABCommons notNull:view] && view != window; view = view.superview) {
+        
+        if (view.hidden || view.alpha < 0.01f) {
+            return NO;
+        }
+        
+        if (view.clipsToBounds) {
+            visibleRect = CGRectIntersection(visibleRect, [view convertRect:view.bounds toView:nil]);
+        }
+        
+    }
+    
+    visibleRect = CGRectIntersection(visibleRect, window.bounds);
+    
+    if (CGRectIsEmpty(visibleRect)) {
+        return NO;
+    }
+    
+    ABMediaView *presentedView = [[ABMediaView sharedManager] currentMediaView];
+    
+    if ([ABCommons notNull:presentedView] && presentedView != self && presentedView.window == window && !presentedView.isMinimized) {
+        
+        if (CGRectContainsRect([presentedView convertRect:presentedView.bounds toView:nil], visibleRect)) {
+            return NO;
+        }
+        
+    }
+    
+    return YES;
+}
+
+- (void)animationClockDisplayFrame:(UIImage *)frame {
+    [super setImage:frame];
+}
+
+- (void)animationClockReleaseFrames {
+    
+    // Only frames of the gif can be released, since they can be decoded again from its URL or data
+    if (self.animatedImage != self.gifCache || ([ABCommons isNull:self.gifURL] && [ABCommons isNull:self.gifData])) {
+        return;
+    }
+    
+    // The frame on screen is kept by UIKit, the others are freed once no other mediaView shows the gif
+    self.animatedImage = nil;
+    _gifCache = nil;
+    self.gifBuffer = nil;
+    self.releasedAnimationFrames = YES;
+}
 
+- (void)animationClockRestoreFrames {
+    
+    if (!self.releasedAnimationFrames || self.isRestoringAnimationFrames) {
+        return;
+    }
+    
+    self.isRestoringAnimationFrames = YES;
+    
+    GIFDataBlock restoreBlock = ^(UIImage *gif, NSString *key, NSError *error) {
+        self.isRestoringAnimationFrames = NO;
+        
+        // Another image may have been set while the frames were decoded
+        if (!self.releasedAnimationFrames) {
+            return;
+        }
+        
+        if ([ABCommons isNull:gif]) {
+            // The frame on screen is left in place rather than retrying on every tick
+            self.releasedAnimationFrames = NO;
+            [[ABAnimationClock sharedManager] removeTarget:self];
+            return;
+        }
+        
+        self.gifBuffer = [[ABMediaBufferPool sharedManager] bufferWithImage:gif data:nil forKey:self.gifURL];
+        _gifCache = self.gifBuffer.image;
+        
+        [self displayImage:self.gifCache];
+    };
+    
+    if ([ABCommons notNull:self.gifURL]) {
+        [ABCacheManager loadGIF:self.gifURL completion:restoreBlock];
+    } else {
+        [ABCacheManager loadGIFData:self.gifData completion:restoreBlock];
+    }
+    
+}
+
+@end
 
 
 
@@ -0,0 +1,44 @@
+//
+//  ABPlayerPool.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+@class ABPlayer;
+
+@interface ABPlayerPool : NSObject
+
+/// Maximum number of idle players that are kept around for reuse
+@property (nonatomic) NSUInteger maximumIdlePlayers;
+
+/// Number of idle players currently waiting to be reused
+@property (nonatomic, readonly) NSUInteger idlePlayerCount;
+
+/// Shared Manager for Player Pool
++ (id)sharedManager;
+
+/// Returns an idle player loaded with the given item, or a new player if none are idle
+- (ABPlayer *)dequeuePlayerWithItem:(AVPlayerItem *)item;
+
+/// Pauses the player, clears its item and keeps it for reuse if there is room in the pool
+- (void)recyclePlayer:(ABPlayer *)player;
+
+/// Keeps a player that has been prepared ahead of time for the given owner, and prerolls it once it is ready to play. The owner is not retained, and must cancel its prepared player when it is deallocated.
+- (void)setPreparedPlayer:(ABPlayer *)player forOwner:(id)owner;
+
+/// Returns the player prepared for the given owner, if any. Ownership of the player moves to the caller.
+- (ABPlayer *)takePreparedPlayerForOwner:(id)owner;
+
+/// Determines if a player has already been prepared for the given owner
+- (BOOL)hasPreparedPlayerForOwner:(id)owner;
+
+/// Recycles the player prepared for the given owner, if any
+- (void)cancelPreparedPlayerForOwner:(id)owner;
+
+/// Removes all idle players from the pool
+- (void)drain;
+
+@end
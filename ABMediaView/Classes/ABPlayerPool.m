@@ -0,0 +1,215 @@
+//
+//  ABPlayerPool.m
+//  Pods
+//
+//
+//
+
+#import "ABPlayerPool.h"
+#import "ABPlayer.h"
+#import "ABCommons.h"
+#import <UIKit/UIKit.h>
+
+static void *ABPlayerPoolStatusContext = &ABPlayerPoolStatusContext;
+
+@interface ABPlayerPool ()
+
+/// Players which are not in use and can be handed out again
+@property (strong, nonatomic) NSMutableArray *idlePlayers;
+
+/// Players prepared ahead of time, keyed by the pointer of their owner without retaining it, since a weak key which dies leaves its player behind
+@property (strong, nonatomic) NSMapTable *preparedPlayers;
+
+/// Players which are waiting to become ready before they are prerolled
+@property (strong, nonatomic) NSHashTable *pendingPrerolls;
+
+@end
+
+@implementation ABPlayerPool
+
++ (id)sharedManager {
+    static ABPlayerPool *sharedMyManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedMyManager = [[self alloc] init];
+    });
+    return sharedMyManager;
+}
+
+- (id)init {
+    if (self = [super init]) {
+        self.maximumIdlePlayers = 2;
+        self.idlePlayers = [[NSMutableArray alloc] init];
+        self.preparedPlayers = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality valueOptions:NSPointerFunctionsStrongMemory];
+        self.pendingPrerolls = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(drain)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - Reuse Methods
+
+- (NSUInteger)idlePlayerCount {
+    return self.idlePlayers.count;
+}
+
+- (ABPlayer *)dequeuePlayerWithItem:(AVPlayerItem *)item {
+    ABPlayer *player = [self.idlePlayers lastObject];
+
+    if ([ABCommons notNull:player]) {
+        [self.idlePlayers removeLastObject];
+        [player replaceCurrentItemWithPlayerItem:item];
+    } else {
+        player = [[ABPlayer alloc] initWithPlayerItem:item];
+    }
+
+    player.actionAtItemEnd = AVPlayerActionAtItemEndNone;
+
+    return player;
+}
+
+- (void)recyclePlayer:(ABPlayer *)player {
+
+    if ([ABCommons isNull:player]) {
+        return;
+    }
+
+    [self stopObservingPlayer:player];
+
+    if (player.rate != 0) {
+        [player pause];
+    }
+
+    [player cancelPendingPrerolls];
+    [player replaceCurrentItemWithPlayerItem:nil];
+
+    // A player which has failed can not be used to play another item
+    if (player.status == AVPlayerStatusFailed || player.error != nil) {
+        return;
+    }
+
+    if (self.idlePlayers.count < self.maximumIdlePlayers && ![self.idlePlayers containsObject:player]) {
+        [self.idlePlayers addObject:player];
+    }
+
+}
+
+- (void)drain {
+    [self.idlePlayers removeAllObjects];
+}
+
+#pragma mark - Preroll Methods
+
+- (void)setPreparedPlayer:(ABPlayer *)player forOwner:(id)owner {
+
+    if ([ABCommons isNull:owner]) {
+        return;
+    }
+
+    [self cancelPreparedPlayerForOwner:owner];
+
+    if ([ABCommons isNull:player]) {
+        return;
+    }
+
+    [self.preparedPlayers setObject:player forKey:owner];
+
+    if (player.status == AVPlayerStatusReadyToPlay) {
+        [self prerollPlayer:player];
+    } else {
+        [self.pendingPrerolls addObject:player];
+        [player addObserver:self forKeyPath:@"status" options:NSKeyValueObservingOptionNew context:ABPlayerPoolStatusContext];
+    }
+
+}
+
+- (ABPlayer *)takePreparedPlayerForOwner:(id)owner {
+
+    if ([ABCommons isNull:owner]) {
+        return nil;
+    }
+
+    ABPlayer *player = [self.preparedPlayers objectForKey:owner];
+
+    if ([ABCommons notNull:player]) {
+        [self.preparedPlayers removeObjectForKey:owner];
+        [self stopObservingPlayer:player];
+    }
+
+    return player;
+}
+
+- (BOOL)hasPreparedPlayerForOwner:(id)owner {
+
+    if ([ABCommons isNull:owner]) {
+        return NO;
+    }
+
+    return [ABCommons notNull:[self.preparedPlayers objectForKey:owner]];
+}
+
+- (void)cancelPreparedPlayerForOwner:(id)owner {
+    ABPlayer *player = [self takePreparedPlayerForOwner:owner];
+
+    if ([ABCommons notNull:player]) {
+        [self recyclePlayer:player];
+    }
+
+}
+
+- (void)prerollPlayer:(ABPlayer *)player {
+
+    // A player handed off mid-playback may still be playing, and can not be prerolled
+    if (player.currentItem.status == AVPlayerItemStatusFailed || player.rate != 0) {
+        return;
+    }
+
+    // Prerolling fills the decode pipeline, so that the first frame is available as soon as play is called
+    [player prerollAtRate:1.0f completionHandler:nil];
+}
+
+- (void)stopObservingPlayer:(ABPlayer *)player {
+
+    if ([self.pendingPrerolls containsObject:player]) {
+        [self.pendingPrerolls removeObject:player];
+
+        @try {
+            [player removeObserver:self forKeyPath:@"status" context:ABPlayerPoolStatusContext];
+        } @catch(id anException){
+            //do nothing, not an observer
+        }
+    }
+
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary<NSKeyValueChangeKey,id> *)change context:(void *)context {
+
+    if (context != ABPlayerPoolStatusContext) {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+        return;
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        ABPlayer *player = object;
+
+        if (![self.pendingPrerolls containsObject:player]) {
+            return;
+        }
+
+        if (player.status == AVPlayerStatusReadyToPlay) {
+            [self stopObservingPlayer:player];
+            [self prerollPlayer:player];
+        } else if (player.status == AVPlayerStatusFailed) {
+            [self stopObservingPlayer:player];
+        }
+    });
+
+}
+
+@end
@@ -0,0 +1,64 @@
+//
+//  ABSeekCoalescer.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+
+/// Performs a seek, and calls the completion when the seek finishes or is interrupted
+typedef void (^ABSeekHandler)(CMTime time, CMTime toleranceBefore, CMTime toleranceAfter, void (^completion)(BOOL finished));
+
+/// Coalesces the seeks made on a player, so that only one seek is in flight at a time and only the latest requested target is performed after it. Loose seeks are used while scrubbing, and exact seeks when the user lets go.
+@interface ABSeekCoalescer : NSObject
+
+/// Player which is seeked
+@property (weak, nonatomic) AVPlayer *player;
+
+/// Performs each seek, defaults to seeking the player. Can be replaced to drive seeks without a player.
+@property (copy, nonatomic) ABSeekHandler seekHandler;
+
+/// Seconds by which a loose seek may miss its target, so that it can land on a nearby keyframe (defaults to INFINITY, the nearest keyframe)
+@property (nonatomic) NSTimeInterval scrubTolerance;
+
+/// Sorted times in seconds of the video's keyframes, if known. Loose seeks snap to the nearest keyframe, and are dropped when they snap to the keyframe already being seeked to.
+@property (copy, nonatomic) NSArray<NSNumber *> *keyframeTimes;
+
+/// Determines if a seek is in flight
+@property (nonatomic, readonly) BOOL isSeeking;
+
+/// Target of the latest seek requested, in seconds
+@property (nonatomic, readonly) NSTimeInterval targetTime;
+
+/// Number of seeks which have been requested
+@property (nonatomic, readonly) NSUInteger requestedSeekCount;
+
+/// Number of seeks which have been performed on the player
+@property (nonatomic, readonly) NSUInteger performedSeekCount;
+
+/// Number of requested seeks which were replaced by a later target before being performed
+@property (nonatomic, readonly) NSUInteger coalescedSeekCount;
+
+/// Seconds taken by the last seek to finish
+@property (nonatomic, readonly) NSTimeInterval lastSeekLatency;
+
+/// Average seconds taken by the seeks which finished
+@property (nonatomic, readonly) NSTimeInterval averageSeekLatency;
+
+/// Longest seconds taken by a seek which finished
+@property (nonatomic, readonly) NSTimeInterval maximumSeekLatency;
+
+- (instancetype)initWithPlayer:(AVPlayer *)player;
+
+/// Seeks to the given time, or replaces the pending target if a seek is already in flight. Exact seeks decode from the previous keyframe to land on the time itself.
+- (void)seekToTime:(NSTimeInterval)time exact:(BOOL)exact;
+
+/// Drops the pending target, and ignores the seek in flight when it completes
+- (void)cancelPendingSeeks;
+
+/// Resets the seek counts and latencies
+- (void)resetStatistics;
+
+@end
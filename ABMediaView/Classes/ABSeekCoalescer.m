@@ -0,0 +1,199 @@
+//
+//  ABSeekCoalescer.m
+//  Pods
+//
+//
+//
+
+#import "ABSeekCoalescer.h"
+#import "ABCommons.h"
+#import <QuartzCore/QuartzCore.h>
+
+/// Timescale used for seek targets
+static const int32_t ABSeekCoalescerTimescale = 600;
+
+@interface ABSeekCoalescer ()
+
+/// Determines if a target is waiting for the seek in flight to complete
+@property (nonatomic) BOOL hasPendingSeek;
+
+/// Target waiting for the seek in flight to complete
+@property (nonatomic) NSTimeInterval pendingTime;
+
+/// Determines if the pending target should be seeked to exactly
+@property (nonatomic) BOOL pendingExact;
+
+/// Keyframe which the latest loose seek snapped to, NAN after an exact seek
+@property (nonatomic) NSTimeInterval snappedTime;
+
+/// Time at which the seek in flight was performed
+@property (nonatomic) CFTimeInterval seekStartTime;
+
+/// Incremented when seeks are cancelled, so that completions of earlier seeks are ignored
+@property (nonatomic) NSUInteger generation;
+
+/// Number of seeks which finished, used for the average latency
+@property (nonatomic) NSUInteger finishedSeekCount;
+
+/// Total seconds taken by seeks which finished
+@property (nonatomic) NSTimeInterval totalSeekLatency;
+
+@end
+
+@implementation ABSeekCoalescer
+
+- (instancetype)initWithPlayer:(AVPlayer *)player {
+    if (self = [super init]) {
+        self.player = player;
+        self.scrubTolerance = INFINITY;
+        self.snappedTime = NAN;
+    }
+    return self;
+}
+
+- (id)init {
+    return [self initWithPlayer:nil];
+}
+
+- (void)seekToTime:(NSTimeInterval)time exact:(BOOL)exact {
+    
+    if (isnan(time)) {
+        return;
+    }
+    
+    _requestedSeekCount++;
+    
+    if (!exact && self.keyframeTimes.count > 0) {
+        time = [self keyframeTimeNearestTime:time];
+        
+        // Scrubbing within the span of one keyframe would only decode the same frame again
+        if (time == self.snappedTime) {
+            _coalescedSeekCount++;
+            return;
+        }
+        
+        self.snappedTime = time;
+    } else {
+        self.snappedTime = NAN;
+    }
+    
+    _targetTime = time;
+    
+    if (self.isSeeking) {
+        
+        if (self.hasPendingSeek) {
+            _coalescedSeekCount++;
+        }
+        
+        self.hasPendingSeek = YES;
+        self.pendingTime = time;
+        self.pendingExact = exact;
+        return;
+    }
+    
+    [self performSeekToTime:time exact:exact];
+}
+
+- (NSTimeInterval)keyframeTimeNearestTime:(NSTimeInterval)time {
+    NSUInteger count = self.keyframeTimes.count;
+    NSUInteger index = [self.keyframeTimes indexOfObject:@(time) inSortedRange:NSMakeRange(0, count) options:NSBinarySearchingInsertionIndex usingComparator:^NSComparisonResult(NSNumber *obj1, NSNumber *obj2) {
+        return [obj1 compare:obj2];
+    }];
+    
+    if (index == 0) {
+        return self.keyframeTimes[0].doubleValue;
+    }
+    
+    if (index >= count) {
+        return self.keyframeTimes[count - 1].doubleValue;
+    }
+    
+    NSTimeInterval before = self.keyframeTimes[index - 1].doubleValue;
+    NSTimeInterval after = self.keyframeTimes[index].doubleValue;
+    
+    return (time - before <= after - time) ? before : after;
+}
+
+- (void)performSeekToTime:(NSTimeInterval)time exact:(BOOL)exact {
+    CMTime tolerance = kCMTimeZero;
+    
+    if (!exact) {
+        tolerance = isinf(self.scrubTolerance) ? kCMTimePositiveInfinity : CMTimeMakeWithSeconds(self.scrubTolerance, ABSeekCoalescerTimescale);
+    }
+    
+    _isSeeking = YES;
+    _performedSeekCount++;
+    self.seekStartTime = CACurrentMediaTime();
+    
+    NSUInteger generation = self.generation;
+    
+    __weak __typeof(self)weakSelf = self;
+    void (^completion)(BOOL finished) = ^(BOOL finished) {
+        
+        void (^complete)(void) = ^{
+            __strong __typeof(weakSelf)strongSelf = weakSelf;
+            
+            if ([ABCommons notNull:strongSelf] && strongSelf.generation == generation) {
+                [strongSelf seekDidFinish:finished];
+            }
+        };
+        
+        if ([NSThread isMainThread]) {
+            complete();
+        } else {
+            dispatch_async(dispatch_get_main_queue(), complete);
+        }
+        
+    };
+    
+    CMTime target = CMTimeMakeWithSeconds(time, ABSeekCoalescerTimescale);
+    
+    if ([ABCommons notNull:self.seekHandler]) {
+        self.seekHandler(target, tolerance, tolerance, completion);
+    } else if ([ABCommons notNull:self.player]) {
+        [self.player seekToTime:target toleranceBefore:tolerance toleranceAfter:tolerance completionHandler:completion];
+    } else {
+        completion(NO);
+    }
+    
+}
+
+- (void)seekDidFinish:(BOOL)finished {
+    _isSeeking = NO;
+    
+    if (finished) {
+        NSTimeInterval latency = CACurrentMediaTime() - self.seekStartTime;
+        
+        _lastSeekLatency = latency;
+        _maximumSeekLatency = MAX(self.maximumSeekLatency, latency);
+        self.totalSeekLatency += latency;
+        self.finishedSeekCount++;
+        _averageSeekLatency = self.totalSeekLatency / self.finishedSeekCount;
+    }
+    
+    if (self.hasPendingSeek) {
+        self.hasPendingSeek = NO;
+        [self performSeekToTime:self.pendingTime exact:self.pendingExact];
+    }
+    
+}
+
+- (void)cancelPendingSeeks {
+    self.generation++;
+    self.snappedTime = NAN;
+    self.hasPendingSeek = NO;
+    _isSeeking = NO;
+}
+
+- (void)resetStatistics {
+    _requestedSeekCount = 0;
+    _performedSeekCount = 0;
+    _coalescedSeekCount = 0;
+    _lastSeekLatency = 0;
+    _averageSeekLatency = 0;
+    _maximumSeekLatency = 0;
+    self.finishedSeekCount = 0;
+    self.totalSeekLatency = 0;
+}
+
+@end
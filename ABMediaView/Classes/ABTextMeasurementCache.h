@@ -0,0 +1,29 @@
+//
+//  ABTextMeasurementCache.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/// Sizes of measured text keyed by the text, font, width and number of lines, shared by every label. Must be used on the main queue.
+@interface ABTextMeasurementCache : NSObject
+
+/// Number of sizes returned from the cache
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/// Number of sizes which had to be measured
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/// Shared Manager for Text Measurement Cache
++ (id)sharedManager;
+
+/// Size of the text drawn in the font, wrapped to the width (CGFLOAT_MAX for a single unbounded line) and limited to numberOfLines (0 for no limit). Sizes are rounded up to whole points, as UILabel does.
+- (CGSize)sizeOfText:(NSString *)text font:(UIFont *)font width:(CGFloat)width numberOfLines:(NSInteger)numberOfLines;
+
+/// Removes every measured size, and resets the hit and miss counts
+- (void)resetCache;
+
+@end
@@ -0,0 +1,139 @@
+//
+//  ABTextMeasurementCache.m
+//  Pods
+//
+//
+//
+
+#import "ABTextMeasurementCache.h"
+#import "ABCommons.h"
+
+/// Most sizes kept before the cache starts evicting them
+static const NSUInteger ABTextMeasurementCacheCountLimit = 1000;
+
+/// Text, font, width and number of lines which a size was measured for
+@interface ABTextMeasurementKey : NSObject
+
+@property (copy, nonatomic) NSString *text;
+
+@property (strong, nonatomic) UIFont *font;
+
+@property (nonatomic) CGFloat width;
+
+@property (nonatomic) NSInteger numberOfLines;
+
+@end
+
+@implementation ABTextMeasurementKey
+
+- (NSUInteger)hash {
+    // Titles are measured at few widths, so the width is left to isEqual: rather than hashing a float
+    return self.text.hash ^ (self.font.hash * 31) ^ (NSUInteger)self.numberOfLines;
+}
+
+- (BOOL)isEqual:(id)object {
+    
+    if (self == object) {
+        return YES;
+    }
+    
+    if (![object isKindOfClass:[ABTextMeasurementKey class]]) {
+        return NO;
+    }
+    
+    ABTextMeasurementKey *key = object;
+    
+    return (self.width == key.width &&
+            self.numberOfLines == key.numberOfLines &&
+            [self.font isEqual:key.font] &&
+            [self.text isEqualToString:key.text]);
+}
+
+@end
+
+@interface ABTextMeasurementCache ()
+
+/// Sizes keyed by ABTextMeasurementKey, boxed as NSValues
+@property (strong, nonatomic) NSCache *sizeCache;
+
+/// Key which lookups are made with, so that a hit does not allocate a key. NSCache does not copy its keys, so only keys which are stored are allocated.
+@property (strong, nonatomic) ABTextMeasurementKey *lookupKey;
+
+@property (nonatomic, readwrite) NSUInteger hitCount;
+@property (nonatomic, readwrite) NSUInteger missCount;
+
+@end
+
+@implementation ABTextMeasurementCache
+
++ (id)sharedManager {
+    static ABTextMeasurementCache *sharedMyManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedMyManager = [[self alloc] init];
+    });
+    return sharedMyManager;
+}
+
+- (id)init {
+    if (self = [super init]) {
+        self.sizeCache = [[NSCache alloc] init];
+        self.sizeCache.countLimit = ABTextMeasurementCacheCountLimit;
+        self.lookupKey = [[ABTextMeasurementKey alloc] init];
+    }
+    return self;
+}
+
+- (CGSize)sizeOfText:(NSString *)text font:(UIFont *)font width:(CGFloat)width numberOfLines:(NSInteger)numberOfLines {
+    
+    if ([ABCommons isNull:text] || text.length == 0 || [ABCommons isNull:font]) {
+        return CGSizeZero;
+    }
+    
+    // A single line is never wrapped, so every width shares one measurement
+    if (numberOfLines == 1 || width <= 0) {
+        width = CGFLOAT_MAX;
+    }
+    
+    self.lookupKey.text = text;
+    self.lookupKey.font = font;
+    self.lookupKey.width = width;
+    self.lookupKey.numberOfLines = numberOfLines;
+    
+    NSValue *cachedSize = [self.sizeCache objectForKey:self.lookupKey];
+    self.lookupKey.text = nil;
+    self.lookupKey.font = nil;
+    
+    if ([ABCommons notNull:cachedSize]) {
+        self.hitCount++;
+        return cachedSize.CGSizeValue;
+    }
+    
+    self.missCount++;
+    
+    NSStringDrawingOptions options = (numberOfLines == 1) ? 0 : NSStringDrawingUsesLineFragmentOrigin;
+    CGRect bounds = [text boundingRectWithSize:CGSizeMake(width, CGFLOAT_MAX) options:options attributes:@{NSFontAttributeName : font} context:nil];
+    CGSize size = CGSizeMake(ceil(bounds.size.width), ceil(bounds.size.height));
+    
+    if (numberOfLines > 1) {
+        size.height = MIN(size.height, ceil(font.lineHeight * numberOfLines));
+    }
+    
+    ABTextMeasurementKey *key = [[ABTextMeasurementKey alloc] init];
+    key.text = text;
+    key.font = font;
+    key.width = width;
+    key.numberOfLines = numberOfLines;
+    
+    [self.sizeCache setObject:[NSValue valueWithCGSize:size] forKey:key];
+    
+    return size;
+}
+
+- (void)resetCache {
+    [self.sizeCache removeAllObjects];
+    self.hitCount = 0;
+    self.missCount = 0;
+}
+
+@end
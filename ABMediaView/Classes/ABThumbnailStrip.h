@@ -0,0 +1,69 @@
+//
+//  ABThumbnailStrip.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+#import <AVFoundation/AVFoundation.h>
+
+/// Thumbnail finished generating, or nil if it could not be generated
+typedef void (^ThumbnailCompletionBlock)(UIImage *thumbnail, NSTimeInterval time);
+
+/// Strip of preview thumbnails for a video, indexed by time. Thumbnails are generated lazily with their own image generator (never the player), landing on the keyframe nearest each slot, and cached once generated.
+@interface ABThumbnailStrip : NSObject
+
+/// Asset which the thumbnails are generated from
+@property (strong, nonatomic, readonly) AVAsset *asset;
+
+/// Duration of the asset in seconds, 0 until it has loaded
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+/// Seconds of video covered by each thumbnail
+@property (nonatomic, readonly) NSTimeInterval interval;
+
+/// Number of thumbnails in the strip, 0 until the duration has loaded
+@property (nonatomic, readonly) NSUInteger thumbnailCount;
+
+/// Maximum number of thumbnails in a strip (defaults to 100), longer videos have a wider interval
+@property (nonatomic) NSUInteger maximumThumbnailCount;
+
+/// Maximum size of each thumbnail, in pixels (defaults to 240x240)
+@property (nonatomic) CGSize maximumSize;
+
+/// Returns the strip for the given asset, shared between all callers using the same key
++ (instancetype)thumbnailStripForAsset:(AVAsset *)asset key:(NSString *)key;
+
+/// Returns the shared strip for the given asset, creating it with a duration which is already known (such as from ABVideoMetadata), or 0 to load it
++ (instancetype)thumbnailStripForAsset:(AVAsset *)asset key:(NSString *)key duration:(NSTimeInterval)duration;
+
+/// Creates a strip for the asset, and begins loading its duration
+- (instancetype)initWithAsset:(AVAsset *)asset;
+
+/// Creates a strip for an asset whose duration is already known
+- (instancetype)initWithAsset:(AVAsset *)asset duration:(NSTimeInterval)duration;
+
+/// Index of the thumbnail which covers the given time
+- (NSUInteger)indexForTime:(NSTimeInterval)time;
+
+/// Time in the middle of the slot covered by the thumbnail at the given index
+- (NSTimeInterval)timeForIndex:(NSUInteger)index;
+
+/// Returns the thumbnail covering the given time if it has already been generated
+- (UIImage *)cachedThumbnailForTime:(NSTimeInterval)time;
+
+/// Calls the completion on the main queue with the thumbnail covering the given time, generating it if needed. Only the latest requested slot waits behind the thumbnail being generated, so earlier requests made while scrubbing are dropped.
+- (void)thumbnailForTime:(NSTimeInterval)time completion:(ThumbnailCompletionBlock)completion;
+
+/// Requests a thumbnail on behalf of a requester, such as a track view, which is held weakly. Only the latest request of each requester waits behind the thumbnail being generated, so requesters sharing the strip do not drop each other's requests.
+- (void)thumbnailForTime:(NSTimeInterval)time requester:(id)requester completion:(ThumbnailCompletionBlock)completion;
+
+/// Drops the requests of the requester, keeping those of other requesters. The thumbnail being generated is only stopped when no other requester is waiting for it.
+- (void)cancelPendingThumbnailsForRequester:(id)requester;
+
+/// Stops generating thumbnails and drops every pending request, keeping the thumbnails already generated
+- (void)cancelPendingThumbnails;
+
+@end
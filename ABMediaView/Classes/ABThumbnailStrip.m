@@ -0,0 +1,362 @@
+//
+//  ABThumbnailStrip.m
+//  Pods
+//
+//
+//
+
+#import "ABThumbnailStrip.h"
+#import "ABCommons.h"
+
+/// Timescale used for thumbnail times
+static const int32_t ABThumbnailStripTimescale = 600;
+
+/// Shortest stretch of video covered by a thumbnail
+static const NSTimeInterval ABThumbnailStripMinimumInterval = 0.5;
+
+/// Request for a thumbnail, made on behalf of a requester which can cancel its own requests
+@interface ABThumbnailRequest : NSObject
+
+/// Object which made the request, held weakly so that requests of a deallocated requester are dropped
+@property (weak, nonatomic) id requester;
+
+/// Determines if the request was made with a requester, rather than shared by every caller
+@property (nonatomic) BOOL hasRequester;
+
+@property (nonatomic) NSTimeInterval time;
+
+@property (copy, nonatomic) ThumbnailCompletionBlock completion;
+
+@end
+
+@implementation ABThumbnailRequest
+
+- (BOOL)isMadeByRequester:(id)requester {
+    return requester == nil ? !self.hasRequester : (self.hasRequester && self.requester == requester);
+}
+
+- (BOOL)isAbandoned {
+    return self.hasRequester && [ABCommons isNull:self.requester];
+}
+
+@end
+
+@interface ABThumbnailStrip ()
+
+/// Generates the thumbnails, separately from any player
+@property (strong, nonatomic) AVAssetImageGenerator *imageGenerator;
+
+/// Generated thumbnails, keyed by index
+@property (strong, nonatomic) NSCache *thumbnails;
+
+/// Index of the thumbnail being generated, or NSNotFound
+@property (nonatomic) NSUInteger generatingIndex;
+
+/// Requests waiting for the thumbnail being generated
+@property (strong, nonatomic) NSMutableArray<ABThumbnailRequest *> *generatingRequests;
+
+/// Latest request of each requester which is waiting to be generated, in the order they were made
+@property (strong, nonatomic) NSMutableArray<ABThumbnailRequest *> *pendingRequests;
+
+/// Incremented when generation is cancelled, so that results of earlier requests are ignored
+@property (nonatomic) NSUInteger generation;
+
+@end
+
+@implementation ABThumbnailStrip
+
++ (NSCache *)sharedStrips {
+    static NSCache *sharedStrips = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedStrips = [[NSCache alloc] init];
+        sharedStrips.countLimit = 8;
+    });
+    return sharedStrips;
+}
+
++ (instancetype)thumbnailStripForAsset:(AVAsset *)asset key:(NSString *)key {
+    return [self thumbnailStripForAsset:asset key:key duration:0];
+}
+
++ (instancetype)thumbnailStripForAsset:(AVAsset *)asset key:(NSString *)key duration:(NSTimeInterval)duration {
+    
+    if ([ABCommons isNull:asset]) {
+        return nil;
+    }
+    
+    if ([ABCommons isNull:key]) {
+        return [[self alloc] initWithAsset:asset duration:duration];
+    }
+    
+    ABThumbnailStrip *strip = [[self sharedStrips] objectForKey:key];
+    
+    if ([ABCommons isNull:strip]) {
+        strip = [[self alloc] initWithAsset:asset duration:duration];
+        [[self sharedStrips] setObject:strip forKey:key];
+    }
+    
+    return strip;
+}
+
+- (instancetype)initWithAsset:(AVAsset *)asset {
+    return [self initWithAsset:asset duration:0];
+}
+
+- (instancetype)initWithAsset:(AVAsset *)asset duration:(NSTimeInterval)duration {
+    if (self = [super init]) {
+        _asset = asset;
+        _maximumThumbnailCount = 100;
+        
+        self.maximumSize = CGSizeMake(240, 240);
+        self.thumbnails = [[NSCache alloc] init];
+        self.thumbnails.countLimit = self.maximumThumbnailCount;
+        self.generatingIndex = NSNotFound;
+        self.generatingRequests = [[NSMutableArray alloc] init];
+        self.pendingRequests = [[NSMutableArray alloc] init];
+        
+        if ([ABCommons notNull:asset]) {
+            self.imageGenerator = [[AVAssetImageGenerator alloc] initWithAsset:asset];
+            self.imageGenerator.appliesPreferredTrackTransform = YES;
+            self.imageGenerator.maximumSize = self.maximumSize;
+        }
+        
+        if (duration > 0) {
+            [self updateWithDuration:duration];
+        } else if ([ABCommons notNull:asset]) {
+            [self loadDuration];
+        }
+    }
+    return self;
+}
+
+- (void)loadDuration {
+    AVAsset *asset = self.asset;
+    
+    __weak __typeof(self)weakSelf = self;
+    [asset loadValuesAsynchronouslyForKeys:@[@"duration"] completionHandler:^{
+        
+        if ([asset statusOfValueForKey:@"duration" error:nil] != AVKeyValueStatusLoaded) {
+            return;
+        }
+        
+        NSTimeInterval duration = CMTimeGetSeconds(asset.duration);
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            __strong __typeof(weakSelf)strongSelf = weakSelf;
+            
+            [strongSelf updateWithDuration:duration];
+            [strongSelf startPendingRequests];
+        });
+    }];
+}
+
+- (void)updateWithDuration:(NSTimeInterval)duration {
+    
+    if (isnan(duration) || isinf(duration) || duration <= 0) {
+        return;
+    }
+    
+    _duration = duration;
+    _interval = MAX(duration / MAX(self.maximumThumbnailCount, (NSUInteger)1), ABThumbnailStripMinimumInterval);
+    _thumbnailCount = (NSUInteger)ceil(duration / self.interval);
+    
+    // Any frame within the slot will do, so the generator can use the nearest keyframe rather than decoding up to an exact time
+    CMTime tolerance = CMTimeMakeWithSeconds(self.interval / 2.0, ABThumbnailStripTimescale);
+    self.imageGenerator.requestedTimeToleranceBefore = tolerance;
+    self.imageGenerator.requestedTimeToleranceAfter = tolerance;
+}
+
+- (void)setMaximumThumbnailCount:(NSUInteger)maximumThumbnailCount {
+    _maximumThumbnailCount = maximumThumbnailCount;
+    
+    self.thumbnails.countLimit = maximumThumbnailCount;
+    
+    if (self.duration > 0) {
+        [self cancelPendingThumbnails];
+        [self.thumbnails removeAllObjects];
+        [self updateWithDuration:self.duration];
+    }
+    
+}
+
+- (void)setMaximumSize:(CGSize)maximumSize {
+    _maximumSize = maximumSize;
+    
+    self.imageGenerator.maximumSize = maximumSize;
+}
+
+#pragma mark - Index Methods
+
+- (NSUInteger)indexForTime:(NSTimeInterval)time {
+    
+    if (self.thumbnailCount == 0 || isnan(time) || time <= 0) {
+        return 0;
+    }
+    
+    NSUInteger index = (NSUInteger)floor(time / self.interval);
+    
+    return MIN(index, self.thumbnailCount - 1);
+}
+
+- (NSTimeInterval)timeForIndex:(NSUInteger)index {
+    return MIN((index + 0.5) * self.interval, self.duration);
+}
+
+#pragma mark - Thumbnail Methods
+
+- (UIImage *)cachedThumbnailForTime:(NSTimeInterval)time {
+    
+    if (self.thumbnailCount == 0) {
+        return nil;
+    }
+    
+    return [self.thumbnails objectForKey:@([self indexForTime:time])];
+}
+
+- (void)thumbnailForTime:(NSTimeInterval)time completion:(ThumbnailCompletionBlock)completion {
+    [self thumbnailForTime:time requester:nil completion:completion];
+}
+
+- (void)thumbnailForTime:(NSTimeInterval)time requester:(id)requester completion:(ThumbnailCompletionBlock)completion {
+    
+    if ([ABCommons isNull:completion] || isnan(time)) {
+        return;
+    }
+    
+    ABThumbnailRequest *request = [[ABThumbnailRequest alloc] init];
+    request.requester = requester;
+    request.hasRequester = [ABCommons notNull:requester];
+    request.time = time;
+    request.completion = completion;
+    
+    // Only the latest request of each requester waits, so earlier requests made while scrubbing are dropped
+    [self removeRequestsByRequester:requester fromArray:self.pendingRequests];
+    [self startRequest:request];
+}
+
+- (void)startRequest:(ABThumbnailRequest *)request {
+    
+    if (self.thumbnailCount == 0) {
+        // Waits for the duration to load
+        [self.pendingRequests addObject:request];
+        return;
+    }
+    
+    NSUInteger index = [self indexForTime:request.time];
+    UIImage *thumbnail = [self.thumbnails objectForKey:@(index)];
+    
+    if ([ABCommons notNull:thumbnail]) {
+        request.completion(thumbnail, [self timeForIndex:index]);
+    } else if (index == self.generatingIndex) {
+        [self.generatingRequests addObject:request];
+    } else if (self.generatingIndex != NSNotFound) {
+        [self.pendingRequests addObject:request];
+    } else {
+        [self generateThumbnailAtIndex:index request:request];
+    }
+    
+}
+
+- (void)startPendingRequests {
+    
+    // Requests for thumbnails which are already cached complete straight away, so the next is started until one generates
+    while (self.thumbnailCount > 0 && self.generatingIndex == NSNotFound && self.pendingRequests.count > 0) {
+        ABThumbnailRequest *request = self.pendingRequests.firstObject;
+        [self.pendingRequests removeObjectAtIndex:0];
+        
+        if (![request isAbandoned]) {
+            [self startRequest:request];
+        }
+    }
+    
+}
+
+- (void)removeRequestsByRequester:(id)requester fromArray:(NSMutableArray<ABThumbnailRequest *> *)requests {
+    NSIndexSet *indexes = [requests indexesOfObjectsPassingTest:^BOOL(ABThumbnailRequest *request, NSUInteger idx, BOOL *stop) {
+        return [request isMadeByRequester:requester] || [request isAbandoned];
+    }];
+    
+    [requests removeObjectsAtIndexes:indexes];
+}
+
+- (void)generateThumbnailAtIndex:(NSUInteger)index request:(ABThumbnailRequest *)request {
+    self.generatingIndex = index;
+    [self.generatingRequests removeAllObjects];
+    [self.generatingRequests addObject:request];
+    
+    NSUInteger generation = self.generation;
+    NSValue *time = [NSValue valueWithCMTime:CMTimeMakeWithSeconds([self timeForIndex:index], ABThumbnailStripTimescale)];
+    
+    __weak __typeof(self)weakSelf = self;
+    [self.imageGenerator generateCGImagesAsynchronouslyForTimes:@[time] completionHandler:^(CMTime requestedTime, CGImageRef image, CMTime actualTime, AVAssetImageGeneratorResult result, NSError *error) {
+        UIImage *thumbnail = nil;
+        
+        if (result == AVAssetImageGeneratorSucceeded && image != NULL) {
+            thumbnail = [UIImage imageWithCGImage:image];
+        }
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            __strong __typeof(weakSelf)strongSelf = weakSelf;
+            
+            if ([ABCommons notNull:strongSelf] && strongSelf.generation == generation) {
+                [strongSelf didGenerateThumbnail:thumbnail atIndex:index];
+            }
+        });
+    }];
+}
+
+- (void)didGenerateThumbnail:(UIImage *)thumbnail atIndex:(NSUInteger)index {
+    
+    if ([ABCommons notNull:thumbnail]) {
+        [self.thumbnails setObject:thumbnail forKey:@(index)];
+    }
+    
+    NSArray<ABThumbnailRequest *> *requests = [self.generatingRequests copy];
+    
+    self.generatingIndex = NSNotFound;
+    [self.generatingRequests removeAllObjects];
+    
+    for (ABThumbnailRequest *request in requests) {
+        
+        if (![request isAbandoned]) {
+            request.completion(thumbnail, [self timeForIndex:index]);
+        }
+        
+    }
+    
+    [self startPendingRequests];
+}
+
+- (void)cancelPendingThumbnailsForRequester:(id)requester {
+    
+    if ([ABCommons isNull:requester]) {
+        return;
+    }
+    
+    [self removeRequestsByRequester:requester fromArray:self.pendingRequests];
+    [self removeRequestsByRequester:requester fromArray:self.generatingRequests];
+    
+    // The thumbnail being generated is only stopped once no other requester is waiting for it
+    if (self.generatingIndex != NSNotFound && self.generatingRequests.count == 0) {
+        [self stopGenerating];
+        [self startPendingRequests];
+    }
+    
+}
+
+- (void)cancelPendingThumbnails {
+    [self stopGenerating];
+    [self.pendingRequests removeAllObjects];
+}
+
+- (void)stopGenerating {
+    self.generation++;
+    
+    [self.imageGenerator cancelAllCGImageGeneration];
+    
+    self.generatingIndex = NSNotFound;
+    [self.generatingRequests removeAllObjects];
+}
+
+@end
@@ -10,6 +10,9 @@
 #import <Foundation/Foundation.h>
 #import <QuartzCore/QuartzCore.h>
 @class ABLabel;
+@class ABBufferMonitor;
+@class ABThumbnailStrip;
+@class ABAudioWaveform;
 
 @protocol ABTrackViewDelegate;
 
@@ -53,6 +56,21 @@
 /// Current buffer for streaming video
 @property (strong, nonatomic) NSNumber *buffer;
 
+/// Buffered ranges for streaming video. When set, the track shows each buffered range rather than a single buffer from the start
+@property (strong, nonatomic) ABBufferMonitor *bufferMonitor;
+
+/// Preview thumbnails for the video. When set, a thumbnail of the scrubbed time is shown above the track while scrubbing
+@property (strong, nonatomic) ABThumbnailStrip *thumbnailStrip;
+
+/// Waveform of the audio. When set, its peaks are drawn above the bar, and the part which has played is filled with the color of the progressView
+@property (strong, nonatomic) ABAudioWaveform *waveform;
+
+/// View which shows the preview thumbnail while scrubbing
+@property (strong, nonatomic) UIImageView *previewImageView;
+
+/// Determines if the user is scrubbing through the video
+@property (nonatomic, readonly) BOOL isScrubbing;
+
 /// Recognizes when a user is trying to scrub through video
 @property (strong, nonatomic) UIPanGestureRecognizer *scrubRecognizer;
 
@@ -86,7 +104,13 @@
 
 @optional
 
-/// Seek to a time
+/// Seek to a time exactly, called on a tap and when scrubbing ends
 - (void)trackView:(ABTrackView *)trackView seekToTime:(float)time;
 
+/// Seek to a time while the user is scrubbing, where keeping up with the finger matters more than accuracy. Falls back to trackView:seekToTime: if not implemented
+- (void)trackView:(ABTrackView *)trackView scrubToTime:(float)time;
+
+/// The user began scrubbing through the video
+- (void)trackViewWillBeginScrubbing:(ABTrackView *)trackView;
+
 @end
@@ -9,6 +9,37 @@
 #import "ABTrackView.h"
 #import "ABCommons.h"
 #import "ABLabel.h"
+#import "ABBufferMonitor.h"
+#import "ABThumbnailStrip.h"
+#import "ABAudioWaveform.h"
+
+@interface ABTrackView ()
+
+/// Layer which draws each of the buffered ranges within the bufferView
+@property (strong, nonatomic) CAShapeLayer *bufferRangesLayer;
+
+/// Layer which draws the peaks of the waveform
+@property (strong, nonatomic) CAShapeLayer *waveformLayer;
+
+/// Layer which draws the peaks of the waveform that have played, masked to the width of the progress
+@property (strong, nonatomic) CAShapeLayer *playedWaveformLayer;
+
+/// Mask which reveals the played peaks up to the progress
+@property (strong, nonatomic) CALayer *playedWaveformMask;
+
+/// Width the peaks of the waveform were last drawn for, so they are only summarized again when the track is resized
+@property (nonatomic) CGFloat waveformWidth;
+
+/// Time of the latest seek made while scrubbing, or -1 if none was made
+@property (nonatomic) float scrubTime;
+
+/// Time which the preview thumbnail is being shown for
+@property (nonatomic) float previewTime;
+
+/// Horizontal position which the preview thumbnail is being shown at
+@property (nonatomic) float previewPoint;
+
+@end
 
 @implementation ABTrackView
 
@@ -63,6 +94,28 @@
     
     [self addSubview:self.bufferView];
     
+    self.bufferRangesLayer = [CAShapeLayer layer];
+    self.bufferRangesLayer.fillColor = [[UIColor whiteColor] colorWithAlphaComponent:0.25f].CGColor;
+    self.bufferRangesLayer.hidden = YES;
+    
+    [self.bufferView.layer addSublayer:self.bufferRangesLayer];
+    
+    self.waveformLayer = [CAShapeLayer layer];
+    self.waveformLayer.fillColor = [[UIColor whiteColor] colorWithAlphaComponent:0.35f].CGColor;
+    self.waveformLayer.hidden = YES;
+    
+    [self.layer addSublayer:self.waveformLayer];
+    
+    self.playedWaveformMask = [CALayer layer];
+    self.playedWaveformMask.backgroundColor = [UIColor blackColor].CGColor;
+    self.playedWaveformMask.anchorPoint = CGPointZero;
+    
+    self.playedWaveformLayer = [CAShapeLayer layer];
+    self.playedWaveformLayer.mask = self.playedWaveformMask;
+    self.playedWaveformLayer.hidden = YES;
+    
+    [self.layer addSublayer:self.playedWaveformLayer];
+    
     self.progressView = [[UIView alloc] initWithFrame:CGRectMake(0, self.frame.size.height - _barHeight, 0, _barHeight)];
     self.progressView.backgroundColor = [UIColor cyanColor];
     
@@ -89,6 +142,18 @@
     
     [self addSubview:self.totalTimeLabel];
     
+    self.previewImageView = [[UIImageView alloc] initWithFrame:CGRectZero];
+    self.previewImageView.contentMode = UIViewContentModeScaleAspectFill;
+    self.previewImageView.clipsToBounds = YES;
+    self.previewImageView.layer.borderColor = [[UIColor whiteColor] colorWithAlphaComponent:0.8f].CGColor;
+    self.previewImageView.layer.borderWidth = 1.0f;
+    self.previewImageView.hidden = YES;
+    self.previewImageView.userInteractionEnabled = NO;
+    
+    [self addSubview:self.previewImageView];
+    
+    self.scrubTime = -1;
+    
     self.scrubRecognizer = [[UIPanGestureRecognizer alloc] initWithTarget:self action:@selector(handleScrub:)];
     self.scrubRecognizer.delegate = self;
     self.scrubRecognizer.delaysTouchesBegan = YES;
@@ -164,6 +229,8 @@
                 self.progressView.frame = CGRectMake(0, self.frame.size.height - _barHeight, width, _barHeight);
             }];
         }
+        
+        [self updatePlayedWaveform];
     }
     
 }
@@ -177,6 +244,14 @@
 
 - (void) updateBuffer {
     
+    if ([self showsBufferedRanges]) {
+        [self updateBufferedRanges];
+        return;
+    }
+    
+    self.bufferRangesLayer.hidden = YES;
+    self.bufferView.backgroundColor = [[UIColor whiteColor] colorWithAlphaComponent:0.25f];
+    
     if ([ABCommons notNull:self.buffer]) {
         CGFloat buff = self.buffer.floatValue;
         
@@ -202,23 +277,140 @@
     
 }
 
+- (BOOL)showsBufferedRanges {
+    return ([ABCommons notNull:self.bufferMonitor] && self.bufferMonitor.rangeCount > 0 && !isnan(self.duration) && self.duration > 0);
+}
+
+- (void)updateBufferedRanges {
+    CGFloat width = self.frame.size.width;
+    UIBezierPath *path = [UIBezierPath bezierPath];
+    
+    for (NSUInteger i = 0; i < self.bufferMonitor.rangeCount; i++) {
+        ABBufferedRange range = [self.bufferMonitor rangeAtIndex:i];
+        CGFloat startX = MAX(0, MIN(1, range.start / self.duration)) * width;
+        CGFloat endX = MAX(0, MIN(1, range.end / self.duration)) * width;
+        
+        if (endX > startX) {
+            [path appendPath:[UIBezierPath bezierPathWithRect:CGRectMake(startX, 0, endX - startX, _barHeight)]];
+        }
+    }
+    
+    self.bufferView.backgroundColor = [UIColor clearColor];
+    self.bufferView.frame = CGRectMake(0, self.frame.size.height - _barHeight, width, _barHeight);
+    
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
+    self.bufferRangesLayer.hidden = NO;
+    self.bufferRangesLayer.frame = self.bufferView.bounds;
+    self.bufferRangesLayer.path = path.CGPath;
+    [CATransaction commit];
+}
+
 - (void)updateBarBackground {
     [UIView animateWithDuration:0.1f animations:^{
         self.barBackgroundView.frame = CGRectMake(0, self.frame.size.height - _barHeight, self.frame.size.width, _barHeight);
         self.currentTimeLabel.frame = CGRectMake(8, self.frame.size.height - _barHeight - 20.0f, 120.0f, 20.0f);
         self.totalTimeLabel.frame = CGRectMake(self.frame.size.width - 128, self.frame.size.height - _barHeight - 20.0f, 120.0f, 20.0f);
     }];
+    
+    [self updateWaveform];
+}
+
+- (void)setWaveform:(ABAudioWaveform *)waveform {
+    _waveform = waveform;
+    self.waveformWidth = 0;
+    
+    [self updateWaveform];
 }
 
-- (void)seekToPoint:(float)point {
+- (void)updateWaveform {
+    CGFloat width = self.frame.size.width;
+    
+    if ([ABCommons isNull:self.waveform] || self.waveform.duration <= 0 || width <= 0) {
+        self.waveformLayer.hidden = YES;
+        self.playedWaveformLayer.hidden = YES;
+        return;
+    }
+    
+    CGFloat height = 16.0f;
+    CGRect frame = CGRectMake(0, self.frame.size.height - _barHeight - height - 4.0f, width, height);
+    
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
     
-    if (point <= self.bufferView.frame.size.width && self.canSeek) {
-        float ratio = point/self.frame.size.width;
+    // Summarizing the peaks only depends on the width, so moving the bar as it grows and shrinks only moves the layers
+    if (width != self.waveformWidth) {
+        self.waveformWidth = width;
+        
+        CGFloat spacing = 3.0f;
+        NSUInteger count = (NSUInteger)(width / spacing);
+        NSMutableData *minData = [NSMutableData dataWithLength:count * sizeof(float)];
+        NSMutableData *maxData = [NSMutableData dataWithLength:count * sizeof(float)];
+        float *min = minData.mutableBytes;
+        float *max = maxData.mutableBytes;
+        
+        [self.waveform getPeaksFromTime:0 toTime:self.waveform.duration count:count min:min max:max rms:NULL];
+        
+        UIBezierPath *path = [UIBezierPath bezierPath];
+        
+        for (NSUInteger i = 0; i < count; i++) {
+            CGFloat peak = MIN(1, MAX(fabsf(min[i]), fabsf(max[i])));
+            CGFloat peakHeight = MAX(1.0f, peak * height);
+            
+            [path appendPath:[UIBezierPath bezierPathWithRect:CGRectMake(i * spacing, (height - peakHeight) / 2.0f, spacing - 1.0f, peakHeight)]];
+        }
+        
+        self.waveformLayer.path = path.CGPath;
+        self.playedWaveformLayer.path = path.CGPath;
+    }
+    
+    self.waveformLayer.frame = frame;
+    self.playedWaveformLayer.frame = frame;
+    self.playedWaveformLayer.fillColor = self.progressView.backgroundColor.CGColor;
+    self.waveformLayer.hidden = NO;
+    self.playedWaveformLayer.hidden = NO;
+    
+    [CATransaction commit];
+    
+    [self updatePlayedWaveform];
+}
+
+- (void)updatePlayedWaveform {
+    
+    if (self.playedWaveformLayer.hidden) {
+        return;
+    }
+    
+    CGFloat ratio = 0;
+    
+    if ([ABCommons notNull:self.progress] && self.duration > 0 && !isnan(self.duration)) {
+        ratio = MAX(0, MIN(1, self.progress.floatValue / self.duration));
+    }
+    
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
+    self.playedWaveformMask.frame = CGRectMake(0, 0, ratio * self.playedWaveformLayer.bounds.size.width, self.playedWaveformLayer.bounds.size.height);
+    [CATransaction commit];
+}
+
+- (void)seekToPoint:(float)point exact:(BOOL)exact {
+    
+    float ratio = point/self.frame.size.width;
+    BOOL isBuffered = (point <= self.bufferView.frame.size.width);
+    
+    if ([self showsBufferedRanges]) {
+        isBuffered = [self.bufferMonitor containsTime:ratio * _duration];
+    }
+    
+    if (isBuffered && self.canSeek) {
         
         if (!isnan(_duration)) {
             float seekTime = ratio * _duration;
             
-            if ([self.delegate respondsToSelector:@selector(trackView:seekToTime:)]) {
+            if (!exact && [self.delegate respondsToSelector:@selector(trackView:scrubToTime:)]) {
+                self.scrubTime = seekTime;
+                [self.delegate trackView:self scrubToTime:seekTime];
+            } else if ([self.delegate respondsToSelector:@selector(trackView:seekToTime:)]) {
                 [self.delegate trackView:self seekToTime:seekTime];
             }
             
@@ -228,6 +420,61 @@
     
 }
 
+- (void)updatePreviewAtPoint:(float)point {
+    
+    if ([ABCommons isNull:self.thumbnailStrip] || isnan(_duration) || _duration <= 0) {
+        self.previewImageView.hidden = YES;
+        return;
+    }
+    
+    float ratio = MAX(0, MIN(1, point/self.frame.size.width));
+    
+    self.previewTime = ratio * _duration;
+    self.previewPoint = point;
+    
+    UIImage *thumbnail = [self.thumbnailStrip cachedThumbnailForTime:self.previewTime];
+    
+    if ([ABCommons notNull:thumbnail]) {
+        [self showPreview:thumbnail];
+        return;
+    }
+    
+    ABThumbnailStrip *strip = self.thumbnailStrip;
+    
+    __weak __typeof(self)weakSelf = self;
+    [strip thumbnailForTime:self.previewTime requester:self completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        __strong __typeof(weakSelf)strongSelf = weakSelf;
+        
+        if (!strongSelf.isScrubbing || strongSelf.thumbnailStrip != strip || [ABCommons isNull:thumbnail]) {
+            return;
+        }
+        
+        // The finger may have moved on while the thumbnail was generating
+        if ([strip indexForTime:time] == [strip indexForTime:strongSelf.previewTime]) {
+            [strongSelf showPreview:thumbnail];
+        }
+    }];
+    
+}
+
+- (void)showPreview:(UIImage *)thumbnail {
+    CGFloat width = 96.0f;
+    CGFloat height = width * (thumbnail.size.height / MAX(thumbnail.size.width, 1.0f));
+    CGFloat x = MAX(0, MIN(self.frame.size.width - width, self.previewPoint - (width / 2.0f)));
+    CGFloat y = self.frame.size.height - _barHeight - 28.0f - height;
+    
+    self.previewImageView.image = thumbnail;
+    self.previewImageView.frame = CGRectMake(x, y, width, height);
+    self.previewImageView.hidden = NO;
+}
+
+- (void)hidePreview {
+    self.previewImageView.hidden = YES;
+    self.previewImageView.image = nil;
+    
+    [self.thumbnailStrip cancelPendingThumbnailsForRequester:self];
+}
+
 - (void)turnOnSeek {
     self.canSeek = YES;
 }
@@ -245,8 +492,16 @@
     if (gesture.state == UIGestureRecognizerStateBegan) {
         self.barHeight = 6.0f;
         
+        _isScrubbing = YES;
+        self.scrubTime = -1;
+        
+        if ([self.delegate respondsToSelector:@selector(trackViewWillBeginScrubbing:)]) {
+            [self.delegate trackViewWillBeginScrubbing:self];
+        }
+        
         if (self.progressView.frame.size.height == 6.0f) {
-            [self seekToPoint:[gesture locationInView:self].x];
+            [self seekToPoint:[gesture locationInView:self].x exact:NO];
+            [self updatePreviewAtPoint:[gesture locationInView:self].x];
         } else {
             [UIView animateWithDuration:0.2f animations:^{
                 self.currentTimeLabel.alpha = 1;
@@ -263,7 +518,8 @@
     } else if (gesture.state == UIGestureRecognizerStateChanged) {
         if (self.progressView.frame.size.height == 6.0f) {
             
-            [self seekToPoint:[gesture locationInView:self].x];
+            [self seekToPoint:[gesture locationInView:self].x exact:NO];
+            [self updatePreviewAtPoint:[gesture locationInView:self].x];
         }
         
         [self.hideTimer invalidate];
@@ -272,6 +528,16 @@
              gesture.state == UIGestureRecognizerStateCancelled) {
         [self.hideTimer invalidate];
         
+        _isScrubbing = NO;
+        [self hidePreview];
+        
+        // Loose seeks land near the finger, so finish on the exact time that was scrubbed to
+        if (self.scrubTime >= 0 && [self.delegate respondsToSelector:@selector(trackView:seekToTime:)]) {
+            [self.delegate trackView:self seekToTime:self.scrubTime];
+        }
+        
+        self.scrubTime = -1;
+        
         self.hideTimer = [NSTimer scheduledTimerWithTimeInterval:1.5f target:self selector:@selector(hideTrack) userInfo:nil repeats:NO];
     }
     
@@ -281,7 +547,7 @@
     self.barHeight = 6.0f;
     
     if (self.progressView.frame.size.height == 6.0f) {
-        [self seekToPoint:[gesture locationInView:self].x];
+        [self seekToPoint:[gesture locationInView:self].x exact:YES];
     } else {
         [UIView animateWithDuration:0.2f animations:^{
             self.currentTimeLabel.alpha = 1;
@@ -0,0 +1,39 @@
+//
+//  ABVariantSelector.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+@class ABMediaVariant;
+
+/// Chooses which variant of a video to play, from the measured bandwidth, the seconds buffered ahead of the playhead and the size the video is displayed at. Selection does not depend on any player state, so it can be run against recorded bandwidth traces.
+@interface ABVariantSelector : NSObject
+
+/// Fraction of the measured bandwidth that a variant's bitrate may use (defaults to 0.8)
+@property (nonatomic) double bandwidthSafetyFactor;
+
+/// Bandwidth assumed before any has been measured, in bits per second (defaults to 1,500,000)
+@property (nonatomic) double initialBandwidth;
+
+/// Seconds of buffer required before switching to a higher bitrate (defaults to 10)
+@property (nonatomic) NSTimeInterval minimumBufferForUpswitch;
+
+/// Seconds of buffer above which a drop in bandwidth is ridden out instead of switching to a lower bitrate (defaults to 20)
+@property (nonatomic) NSTimeInterval minimumBufferForDownswitch;
+
+/// Seconds of buffer below which only half of the measured bandwidth is trusted (defaults to 3)
+@property (nonatomic) NSTimeInterval panicBufferLevel;
+
+/// Returns the given variants sorted by ascending bitrate
++ (NSArray<ABMediaVariant *> *)sortedVariants:(NSArray<ABMediaVariant *> *)variants;
+
+/// Returns the variant to play. Bandwidth is in bits per second (0 if not yet measured), buffer level in seconds, and view size in pixels (CGSizeZero to leave resolution uncapped). The current variant may be nil before playback starts.
+- (ABMediaVariant *)variantFromVariants:(NSArray<ABMediaVariant *> *)variants bandwidth:(double)bandwidth bufferLevel:(NSTimeInterval)bufferLevel viewSize:(CGSize)viewSize currentVariant:(ABMediaVariant *)currentVariant;
+
+/// Returns the lowest bitrate variant whose resolution covers the view size, which is the highest variant worth playing at that size
+- (ABMediaVariant *)resolutionCapFromVariants:(NSArray<ABMediaVariant *> *)variants viewSize:(CGSize)viewSize;
+
+@end
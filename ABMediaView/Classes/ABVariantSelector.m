@@ -0,0 +1,131 @@
+//
+//  ABVariantSelector.m
+//  Pods
+//
+//
+//
+
+#import "ABVariantSelector.h"
+#import "ABMediaVariant.h"
+#import "ABCommons.h"
+
+@implementation ABVariantSelector
+
+- (id)init {
+    if (self = [super init]) {
+        self.bandwidthSafetyFactor = 0.8;
+        self.initialBandwidth = 1500000;
+        self.minimumBufferForUpswitch = 10;
+        self.minimumBufferForDownswitch = 20;
+        self.panicBufferLevel = 3;
+    }
+    return self;
+}
+
++ (NSArray<ABMediaVariant *> *)sortedVariants:(NSArray<ABMediaVariant *> *)variants {
+    
+    if ([ABCommons isNull:variants]) {
+        return @[];
+    }
+    
+    return [variants sortedArrayUsingComparator:^NSComparisonResult(ABMediaVariant *variantA, ABMediaVariant *variantB) {
+        
+        if (variantA.bitrate < variantB.bitrate) {
+            return NSOrderedAscending;
+        } else if (variantA.bitrate > variantB.bitrate) {
+            return NSOrderedDescending;
+        }
+        
+        return NSOrderedSame;
+    }];
+}
+
+/// Index of the highest variant worth playing at the given size, in a ladder sorted by bitrate
+- (NSUInteger)capIndexInVariants:(NSArray<ABMediaVariant *> *)sorted viewSize:(CGSize)viewSize {
+    
+    if (viewSize.width <= 0 || viewSize.height <= 0) {
+        return sorted.count - 1;
+    }
+    
+    // The longer side of the view is compared to the longer side of the video, so that rotated views are not capped too low
+    CGFloat viewLong = MAX(viewSize.width, viewSize.height);
+    CGFloat viewShort = MIN(viewSize.width, viewSize.height);
+    
+    for (NSUInteger i = 0; i < sorted.count; i++) {
+        CGSize resolution = sorted[i].resolution;
+        
+        if (resolution.width <= 0 || resolution.height <= 0) {
+            // Variants of unknown resolution can not be capped
+            continue;
+        }
+        
+        if (MAX(resolution.width, resolution.height) >= viewLong && MIN(resolution.width, resolution.height) >= viewShort) {
+            return i;
+        }
+    }
+    
+    return sorted.count - 1;
+}
+
+- (ABMediaVariant *)resolutionCapFromVariants:(NSArray<ABMediaVariant *> *)variants viewSize:(CGSize)viewSize {
+    NSArray *sorted = [ABVariantSelector sortedVariants:variants];
+    
+    if (sorted.count == 0) {
+        return nil;
+    }
+    
+    return sorted[[self capIndexInVariants:sorted viewSize:viewSize]];
+}
+
+- (ABMediaVariant *)variantFromVariants:(NSArray<ABMediaVariant *> *)variants bandwidth:(double)bandwidth bufferLevel:(NSTimeInterval)bufferLevel viewSize:(CGSize)viewSize currentVariant:(ABMediaVariant *)currentVariant {
+    NSArray<ABMediaVariant *> *sorted = [ABVariantSelector sortedVariants:variants];
+    
+    if (sorted.count == 0) {
+        return nil;
+    }
+    
+    NSUInteger capIndex = [self capIndexInVariants:sorted viewSize:viewSize];
+    
+    double usableBandwidth = (bandwidth > 0) ? bandwidth : self.initialBandwidth;
+    usableBandwidth *= self.bandwidthSafetyFactor;
+    
+    if (currentVariant && bufferLevel < self.panicBufferLevel) {
+        usableBandwidth *= 0.5;
+    }
+    
+    // Highest variant, at or below the cap, which fits in the usable bandwidth
+    NSUInteger targetIndex = 0;
+    
+    for (NSUInteger i = 0; i <= capIndex; i++) {
+        
+        if (sorted[i].bitrate <= usableBandwidth) {
+            targetIndex = i;
+        }
+        
+    }
+    
+    NSUInteger currentIndex = currentVariant ? [sorted indexOfObject:currentVariant] : NSNotFound;
+    
+    if (currentIndex == NSNotFound) {
+        return sorted[targetIndex];
+    }
+    
+    if (currentIndex > capIndex) {
+        // The view has shrunk, so the extra resolution is wasted regardless of bandwidth
+        return sorted[MIN(targetIndex, capIndex)];
+    }
+    
+    if (targetIndex > currentIndex && bufferLevel < self.minimumBufferForUpswitch) {
+        // Not enough buffer to absorb a bandwidth estimate that turns out to be optimistic
+        return currentVariant;
+    }
+    
+    if (targetIndex < currentIndex && bufferLevel >= self.minimumBufferForDownswitch) {
+        // Enough buffer to ride out a short drop in bandwidth
+        return currentVariant;
+    }
+    
+    return sorted[targetIndex];
+}
+
+@end
@@ -0,0 +1,52 @@
+//
+//  ABVideoMetadata.h
+//  Pods
+//
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/// Error domain for failed metadata probes
+extern NSString *const ABVideoMetadataErrorDomain;
+
+@class ABVideoMetadata;
+
+/// Metadata probe finished, metadata is nil if the video could not be probed
+typedef void (^VideoMetadataBlock)(ABVideoMetadata *metadata, NSError *error);
+
+/// Duration, dimensions, codecs and keyframes of an MP4 or MOV video, read from its moov box alone. Remote videos are probed with Range requests for the top-level box headers and the moov box, so the media data itself is never downloaded, even when the moov box is at the end of the file.
+@interface ABVideoMetadata : NSObject
+
+/// Url which was probed
+@property (strong, nonatomic, readonly) NSURL *url;
+
+/// Duration of the video in seconds
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+/// Display size of the video track in points, with its rotation applied. CGSizeZero if there is no video track.
+@property (nonatomic, readonly) CGSize naturalSize;
+
+/// Four character code of the video codec, such as 'avc1' or 'hvc1'
+@property (strong, nonatomic, readonly) NSString *videoCodec;
+
+/// Four character code of the audio codec, such as 'mp4a'
+@property (strong, nonatomic, readonly) NSString *audioCodec;
+
+/// Major brand of the file, such as 'isom' or 'qt  '
+@property (strong, nonatomic, readonly) NSString *majorBrand;
+
+/// Sorted times in seconds of the video track's keyframes, nil when every frame is a keyframe
+@property (strong, nonatomic, readonly) NSArray<NSNumber *> *keyframeTimes;
+
+/// Number of bytes which were read to probe the video
+@property (nonatomic, readonly) NSUInteger bytesRead;
+
+/// Parses the metadata from a whole moov box, returns nil if it is malformed
++ (instancetype)metadataWithMoovData:(NSData *)moovData majorBrand:(uint32_t)majorBrand url:(NSURL *)url;
+
+/// Reads the metadata of a local or remote video, calling the completion on the main queue
++ (void)probeURL:(NSURL *)url completion:(VideoMetadataBlock)completionBlock;
+
+@end
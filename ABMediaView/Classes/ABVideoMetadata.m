@@ -0,0 +1,276 @@
+//
+//  ABVideoMetadata.m
+//  Pods
+//
+//
+//
+
+#import "ABVideoMetadata.h"
+#import "ABMP4Parser.h"
+#import "ABCommons.h"
+
+NSString *const ABVideoMetadataErrorDomain = @"ABVideoMetadataErrorDomain";
+
+/// Bytes requested for each window of top-level box headers, large enough to hold the moov box of most short videos
+static const NSUInteger ABVideoMetadataWindowLength = 64 * 1024;
+
+/// Largest moov box which is read, larger boxes are treated as malformed
+static const uint64_t ABVideoMetadataMaximumMoovLength = 32 * 1024 * 1024;
+
+/// Most windows read while looking for the moov box
+static const NSUInteger ABVideoMetadataMaximumWindows = 16;
+
+/// Bytes read from a file, starting at the window offset (which may differ from the offset requested, if a server ignores the Range header)
+typedef void (^ABVideoMetadataReadBlock)(NSData *data, uint64_t windowOffset, uint64_t fileLength, NSError *error);
+
+static NSString *fourCharacterCode(uint32_t code) {
+    
+    if (code == 0) {
+        return nil;
+    }
+    
+    char characters[5] = {(char)(code >> 24), (char)(code >> 16), (char)(code >> 8), (char)code, 0};
+    
+    return [[NSString alloc] initWithBytes:characters length:4 encoding:NSMacOSRomanStringEncoding];
+}
+
+static NSError *probeError(ABMP4Status status) {
+    NSString *description = @"The video could not be probed";
+    
+    if (status == ABMP4StatusNotFound) {
+        description = @"The video has no moov box";
+    } else if (status == ABMP4StatusMalformed) {
+        description = @"The video has a malformed box";
+    }
+    
+    return [NSError errorWithDomain:ABVideoMetadataErrorDomain code:status userInfo:@{NSLocalizedDescriptionKey : description}];
+}
+
+@interface ABVideoMetadata ()
+
+@property (nonatomic, readwrite) NSUInteger bytesRead;
+
+@end
+
+/// Reads the ranges of a single video needed to find and parse its moov box, one range at a time
+@interface ABVideoMetadataProbe : NSObject {
+    ABMP4Scan _scan;
+}
+
+@property (strong, nonatomic) NSURL *url;
+
+@property (copy, nonatomic) VideoMetadataBlock completion;
+
+@property (nonatomic) NSUInteger bytesRead;
+
+@property (nonatomic) NSUInteger windowCount;
+
+@end
+
+@implementation ABVideoMetadataProbe
+
+- (id)initWithURL:(NSURL *)url completion:(VideoMetadataBlock)completion {
+    if (self = [super init]) {
+        self.url = url;
+        self.completion = completion;
+        ABMP4ScanInit(&_scan, 0);
+    }
+    return self;
+}
+
+- (void)readRangeFromOffset:(uint64_t)offset length:(uint64_t)length completion:(ABVideoMetadataReadBlock)completion {
+    
+    if (self.url.isFileURL) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSError *error = nil;
+            NSFileHandle *handle = [NSFileHandle fileHandleForReadingFromURL:self.url error:&error];
+            
+            if ([ABCommons isNull:handle]) {
+                completion(nil, offset, 0, error);
+                return;
+            }
+            
+            uint64_t fileLength = [handle seekToEndOfFile];
+            [handle seekToFileOffset:MIN(offset, fileLength)];
+            NSData *data = [handle readDataOfLength:(NSUInteger)MIN(length, fileLength - MIN(offset, fileLength))];
+            [handle closeFile];
+            
+            completion(data, offset, fileLength, nil);
+        });
+        
+        return;
+    }
+    
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.url];
+    [request setValue:[NSString stringWithFormat:@"bytes=%llu-%llu", offset, offset + length - 1] forHTTPHeaderField:@"Range"];
+    
+    NSURLSessionTask *task = [[NSURLSession sharedSession] dataTaskWithRequest:request completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+        NSHTTPURLResponse *httpResponse = [response isKindOfClass:[NSHTTPURLResponse class]] ? (NSHTTPURLResponse *)response : nil;
+        
+        if ([ABCommons notNull:error] || [ABCommons isNull:data]) {
+            completion(nil, offset, 0, error);
+        } else if (httpResponse.statusCode == 206) {
+            // Content-Range is 'bytes start-end/length', with '*' when the length is unknown
+            NSString *contentRange = [httpResponse.allHeaderFields valueForKey:@"Content-Range"];
+            uint64_t fileLength = 0;
+            NSRange slash = [contentRange rangeOfString:@"/"];
+            
+            if ([ABCommons notNull:contentRange] && slash.location != NSNotFound) {
+                fileLength = (uint64_t)MAX([[contentRange substringFromIndex:slash.location + 1] longLongValue], 0);
+            }
+            
+            completion(data, offset, fileLength, nil);
+        } else if (httpResponse.statusCode == 200 || ([ABCommons isNull:httpResponse] && offset == 0)) {
+            // The server ignored the Range header and sent the whole file
+            completion(data, 0, data.length, nil);
+        } else {
+            completion(nil, offset, 0, [NSError errorWithDomain:ABVideoMetadataErrorDomain code:httpResponse.statusCode userInfo:@{NSLocalizedDescriptionKey : [NSHTTPURLResponse localizedStringForStatusCode:httpResponse.statusCode]}]);
+        }
+        
+    }];
+    
+    [task resume];
+}
+
+- (void)start {
+    uint64_t offset = _scan.nextOffset;
+    
+    [self readRangeFromOffset:offset length:ABVideoMetadataWindowLength completion:^(NSData *data, uint64_t windowOffset, uint64_t fileLength, NSError *error) {
+        
+        if ([ABCommons isNull:data] || data.length == 0) {
+            [self finishWithMetadata:nil error:error ?: probeError(ABMP4StatusNotFound)];
+            return;
+        }
+        
+        self.bytesRead += data.length;
+        self.windowCount++;
+        
+        if (self->_scan.fileLength == 0 && fileLength > 0) {
+            self->_scan.fileLength = fileLength;
+        }
+        
+        ABMP4Status status = ABMP4ScanWindow(&self->_scan, data.bytes, data.length, windowOffset);
+        
+        if (status == ABMP4StatusOK) {
+            [self readMoovFromWindow:data windowOffset:windowOffset];
+        } else if (status == ABMP4StatusNeedData && self.windowCount < ABVideoMetadataMaximumWindows && self->_scan.nextOffset > offset) {
+            [self start];
+        } else if (status == ABMP4StatusNeedData) {
+            // The window did not hold a whole box header, so the file ends here
+            [self finishWithMetadata:nil error:probeError(ABMP4StatusNotFound)];
+        } else {
+            [self finishWithMetadata:nil error:probeError(status)];
+        }
+        
+    }];
+    
+}
+
+- (void)readMoovFromWindow:(NSData *)window windowOffset:(uint64_t)windowOffset {
+    uint64_t moovOffset = _scan.moovOffset;
+    uint64_t moovLength = _scan.moovSize;
+    uint32_t majorBrand = _scan.majorBrand;
+    
+    if (moovLength > ABVideoMetadataMaximumMoovLength) {
+        [self finishWithMetadata:nil error:probeError(ABMP4StatusMalformed)];
+        return;
+    }
+    
+    // Files with the moov box at the start usually hold all of it in the first window
+    if (moovOffset >= windowOffset && moovOffset + moovLength <= windowOffset + window.length) {
+        NSData *moovData = [window subdataWithRange:NSMakeRange((NSUInteger)(moovOffset - windowOffset), (NSUInteger)moovLength)];
+        [self parseMoovData:moovData majorBrand:majorBrand];
+        return;
+    }
+    
+    [self readRangeFromOffset:moovOffset length:moovLength completion:^(NSData *data, uint64_t dataOffset, uint64_t fileLength, NSError *error) {
+        
+        if ([ABCommons isNull:data] || dataOffset > moovOffset || dataOffset + data.length < moovOffset + moovLength) {
+            [self finishWithMetadata:nil error:error ?: probeError(ABMP4StatusMalformed)];
+            return;
+        }
+        
+        self.bytesRead += data.length;
+        
+        NSData *moovData = [data subdataWithRange:NSMakeRange((NSUInteger)(moovOffset - dataOffset), (NSUInteger)moovLength)];
+        [self parseMoovData:moovData majorBrand:majorBrand];
+    }];
+    
+}
+
+- (void)parseMoovData:(NSData *)moovData majorBrand:(uint32_t)majorBrand {
+    ABVideoMetadata *metadata = [ABVideoMetadata metadataWithMoovData:moovData majorBrand:majorBrand url:self.url];
+    metadata.bytesRead = self.bytesRead;
+    
+    [self finishWithMetadata:metadata error:[ABCommons isNull:metadata] ? probeError(ABMP4StatusMalformed) : nil];
+}
+
+- (void)finishWithMetadata:(ABVideoMetadata *)metadata error:(NSError *)error {
+    VideoMetadataBlock completion = self.completion;
+    self.completion = nil;
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (completion) completion(metadata, error);
+    });
+}
+
+@end
+
+@implementation ABVideoMetadata
+
++ (instancetype)metadataWithMoovData:(NSData *)moovData majorBrand:(uint32_t)majorBrand url:(NSURL *)url {
+    ABMP4Metadata parsed;
+    ABMP4Status status = ABMP4ParseMoov(moovData.bytes, moovData.length, &parsed);
+    
+    if (status != ABMP4StatusOK) {
+        ABMP4MetadataFree(&parsed);
+        return nil;
+    }
+    
+    ABVideoMetadata *metadata = [[ABVideoMetadata alloc] init];
+    const ABMP4Track *video = ABMP4MetadataTrack(&parsed, ABMP4FourCC('v', 'i', 'd', 'e'));
+    const ABMP4Track *audio = ABMP4MetadataTrack(&parsed, ABMP4FourCC('s', 'o', 'u', 'n'));
+    
+    metadata->_url = url;
+    metadata->_duration = ABMP4MetadataDuration(&parsed);
+    metadata->_majorBrand = fourCharacterCode(majorBrand);
+    metadata->_naturalSize = CGSizeZero;
+    
+    if (video != NULL) {
+        metadata->_naturalSize = CGSizeMake(video->width, video->height);
+        metadata->_videoCodec = fourCharacterCode(video->codec);
+        
+        if (video->keyframeTimes != NULL) {
+            NSMutableArray *keyframeTimes = [[NSMutableArray alloc] initWithCapacity:video->keyframeCount];
+            
+            for (uint32_t i = 0; i < video->keyframeCount; i++) {
+                [keyframeTimes addObject:@(video->keyframeTimes[i])];
+            }
+            
+            metadata->_keyframeTimes = keyframeTimes;
+        }
+    }
+    
+    if (audio != NULL) {
+        metadata->_audioCodec = fourCharacterCode(audio->codec);
+    }
+    
+    ABMP4MetadataFree(&parsed);
+    
+    return metadata;
+}
+
++ (void)probeURL:(NSURL *)url completion:(VideoMetadataBlock)completionBlock {
+    
+    if ([ABCommons isNull:url]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completionBlock) completionBlock(nil, nil);
+        });
+        
+        return;
+    }
+    
+    [[[ABVideoMetadataProbe alloc] initWithURL:url completion:completionBlock] start];
+}
+
+@end
@@ -0,0 +1,618 @@
+//
+//  ABWaveformSummary.c
+//  Pods
+//
+//
+//
+
+#include "ABWaveformSummary.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Version of the storage format written by ABWaveformEncode
+#define ABWaveformVersion 2
+
+/// Bytes before the level table: magic, version, sample rate, level count, sample count, source length and source modification time
+#define ABWaveformHeaderLength 40
+
+/// Bytes of each entry in the level table, and of each bucket
+#define ABWaveformLevelEntryLength 8
+#define ABWaveformBucketLength 12
+
+/// Bytes of the trailing checksum
+#define ABWaveformChecksumLength 8
+
+/// Samples mixed from 16-bit frames at a time, before they are reduced
+#define ABWaveformMixChunk 1024
+
+typedef float ABWaveformFloat4 __attribute__((vector_size(16)));
+typedef int32_t ABWaveformInt4 __attribute__((vector_size(16)));
+
+#pragma mark - Kernels
+
+static inline ABWaveformFloat4 load4(const float *p) {
+    ABWaveformFloat4 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline ABWaveformFloat4 splat4(float value) {
+    ABWaveformFloat4 v = {value, value, value, value};
+    return v;
+}
+
+/// Lane-wise minimum, by selecting with the comparison mask since vector conditionals are not available to C
+static inline ABWaveformFloat4 min4(ABWaveformFloat4 a, ABWaveformFloat4 b) {
+    ABWaveformInt4 mask = (ABWaveformInt4)(a < b);
+    return (ABWaveformFloat4)(((ABWaveformInt4)a & mask) | ((ABWaveformInt4)b & ~mask));
+}
+
+static inline ABWaveformFloat4 max4(ABWaveformFloat4 a, ABWaveformFloat4 b) {
+    ABWaveformInt4 mask = (ABWaveformInt4)(a > b);
+    return (ABWaveformFloat4)(((ABWaveformInt4)a & mask) | ((ABWaveformInt4)b & ~mask));
+}
+
+void ABWaveformReduce(const float *samples, size_t count, float *min, float *max, float *sumOfSquares) {
+
+    if (count == 0) {
+        *min = 0;
+        *max = 0;
+        *sumOfSquares = 0;
+        return;
+    }
+
+    size_t i = 0;
+    float lowest = samples[0];
+    float highest = samples[0];
+    float squares = 0;
+
+    if (count >= 16) {
+        // Four independent accumulators of each kind keep the adds and compares from waiting on each other
+        ABWaveformFloat4 min0 = splat4(samples[0]), min1 = min0, min2 = min0, min3 = min0;
+        ABWaveformFloat4 max0 = min0, max1 = min0, max2 = min0, max3 = min0;
+        ABWaveformFloat4 sum0 = splat4(0), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+
+        for (; i + 16 <= count; i += 16) {
+            ABWaveformFloat4 a = load4(samples + i);
+            ABWaveformFloat4 b = load4(samples + i + 4);
+            ABWaveformFloat4 c = load4(samples + i + 8);
+            ABWaveformFloat4 d = load4(samples + i + 12);
+
+            min0 = min4(min0, a);
+            min1 = min4(min1, b);
+            min2 = min4(min2, c);
+            min3 = min4(min3, d);
+
+            max0 = max4(max0, a);
+            max1 = max4(max1, b);
+            max2 = max4(max2, c);
+            max3 = max4(max3, d);
+
+            sum0 += a * a;
+            sum1 += b * b;
+            sum2 += c * c;
+            sum3 += d * d;
+        }
+
+        ABWaveformFloat4 mins = min4(min4(min0, min1), min4(min2, min3));
+        ABWaveformFloat4 maxes = max4(max4(max0, max1), max4(max2, max3));
+        ABWaveformFloat4 sums = (sum0 + sum1) + (sum2 + sum3);
+
+        for (int lane = 0; lane < 4; lane++) {
+            lowest = mins[lane] < lowest ? mins[lane] : lowest;
+            highest = maxes[lane] > highest ? maxes[lane] : highest;
+            squares += sums[lane];
+        }
+    }
+
+    for (; i < count; i++) {
+        float sample = samples[i];
+        lowest = sample < lowest ? sample : lowest;
+        highest = sample > highest ? sample : highest;
+        squares += sample * sample;
+    }
+
+    *min = lowest;
+    *max = highest;
+    *sumOfSquares = squares;
+}
+
+void ABWaveformMixInt16(const int16_t *frames, size_t frameCount, uint32_t channelCount, float *samples) {
+
+    if (channelCount == 0) {
+        return;
+    }
+
+    // Plain loops over a fixed stride, which compilers vectorize for the common mono and stereo layouts
+    if (channelCount == 1) {
+        for (size_t i = 0; i < frameCount; i++) {
+            samples[i] = frames[i] * (1.0f / 32768.0f);
+        }
+    } else if (channelCount == 2) {
+        for (size_t i = 0; i < frameCount; i++) {
+            samples[i] = ((int32_t)frames[2 * i] + frames[2 * i + 1]) * (1.0f / 65536.0f);
+        }
+    } else {
+        float scale = 1.0f / (32768.0f * (float)channelCount);
+
+        for (size_t i = 0; i < frameCount; i++) {
+            int32_t sum = 0;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                sum += frames[i * channelCount + channel];
+            }
+
+            samples[i] = (float)sum * scale;
+        }
+    }
+
+}
+
+#pragma mark - Building
+
+void ABWaveformBuilderInit(ABWaveformBuilder *builder, uint32_t samplesPerBucket, uint32_t fanout) {
+    memset(builder, 0, sizeof(*builder));
+    builder->samplesPerBucket = samplesPerBucket > 0 ? samplesPerBucket : 1;
+    builder->fanout = fanout > 1 ? fanout : 2;
+}
+
+static int pushBucket(ABWaveformBuilder *builder) {
+
+    if (builder->bucketCount == builder->bucketCapacity) {
+
+        if (builder->bucketCapacity >= UINT32_MAX / 2) {
+            return 0;
+        }
+
+        uint32_t capacity = builder->bucketCapacity > 0 ? builder->bucketCapacity * 2 : 1024;
+        ABWaveformBucket *buckets = realloc(builder->buckets, (size_t)capacity * sizeof(ABWaveformBucket));
+
+        if (buckets == NULL) {
+            return 0;
+        }
+
+        builder->buckets = buckets;
+        builder->bucketCapacity = capacity;
+    }
+
+    ABWaveformBucket *bucket = &builder->buckets[builder->bucketCount++];
+    bucket->min = builder->pendingMin;
+    bucket->max = builder->pendingMax;
+    bucket->rms = (float)sqrt(builder->pendingSumOfSquares / builder->pendingCount);
+
+    builder->pendingCount = 0;
+    builder->pendingSumOfSquares = 0;
+
+    return 1;
+}
+
+ABWaveformStatus ABWaveformBuilderAppend(ABWaveformBuilder *builder, const float *samples, size_t count) {
+
+    if (builder->failed) {
+        return ABWaveformStatusNoMemory;
+    }
+
+    while (count > 0) {
+        size_t room = builder->samplesPerBucket - builder->pendingCount;
+        size_t take = count < room ? count : room;
+        float min, max, sumOfSquares;
+
+        ABWaveformReduce(samples, take, &min, &max, &sumOfSquares);
+
+        if (builder->pendingCount == 0) {
+            builder->pendingMin = min;
+            builder->pendingMax = max;
+        } else {
+            builder->pendingMin = min < builder->pendingMin ? min : builder->pendingMin;
+            builder->pendingMax = max > builder->pendingMax ? max : builder->pendingMax;
+        }
+
+        builder->pendingSumOfSquares += sumOfSquares;
+        builder->pendingCount += (uint32_t)take;
+        builder->sampleCount += take;
+
+        if (builder->pendingCount == builder->samplesPerBucket && !pushBucket(builder)) {
+            builder->failed = 1;
+            return ABWaveformStatusNoMemory;
+        }
+
+        samples += take;
+        count -= take;
+    }
+
+    return ABWaveformStatusOK;
+}
+
+ABWaveformStatus ABWaveformBuilderAppendInt16(ABWaveformBuilder *builder, const int16_t *frames, size_t frameCount, uint32_t channelCount) {
+
+    if (channelCount == 0) {
+        return ABWaveformStatusOK;
+    }
+
+    float samples[ABWaveformMixChunk];
+
+    while (frameCount > 0) {
+        size_t take = frameCount < ABWaveformMixChunk ? frameCount : ABWaveformMixChunk;
+
+        ABWaveformMixInt16(frames, take, channelCount, samples);
+
+        ABWaveformStatus status = ABWaveformBuilderAppend(builder, samples, take);
+
+        if (status != ABWaveformStatusOK) {
+            return status;
+        }
+
+        frames += take * channelCount;
+        frameCount -= take;
+    }
+
+    return ABWaveformStatusOK;
+}
+
+void ABWaveformBuilderFree(ABWaveformBuilder *builder) {
+    free(builder->buckets);
+    builder->buckets = NULL;
+    builder->bucketCount = 0;
+    builder->bucketCapacity = 0;
+}
+
+/// Samples covered by a bucket, given that only the last bucket of a level may be short
+static uint64_t samplesInBucket(const ABWaveformLevel *level, uint32_t index, uint64_t sampleCount) {
+    uint64_t start = (uint64_t)index * level->samplesPerBucket;
+
+    if (start >= sampleCount) {
+        return 0;
+    }
+
+    uint64_t remaining = sampleCount - start;
+
+    return remaining < level->samplesPerBucket ? remaining : level->samplesPerBucket;
+}
+
+ABWaveformStatus ABWaveformBuilderFinish(ABWaveformBuilder *builder, uint32_t sampleRate, uint64_t sourceLength, int64_t sourceModificationTime, ABWaveformPyramid *pyramid) {
+    memset(pyramid, 0, sizeof(*pyramid));
+
+    if (builder->failed) {
+        ABWaveformBuilderFree(builder);
+        return ABWaveformStatusNoMemory;
+    }
+
+    if (builder->pendingCount > 0 && !pushBucket(builder)) {
+        ABWaveformBuilderFree(builder);
+        return ABWaveformStatusNoMemory;
+    }
+
+    if (builder->sampleCount == 0) {
+        ABWaveformBuilderFree(builder);
+        return ABWaveformStatusEmpty;
+    }
+
+    pyramid->sampleRate = sampleRate;
+    pyramid->sampleCount = builder->sampleCount;
+    pyramid->sourceLength = sourceLength;
+    pyramid->sourceModificationTime = sourceModificationTime;
+
+    pyramid->levels[0].samplesPerBucket = builder->samplesPerBucket;
+    pyramid->levels[0].bucketCount = builder->bucketCount;
+    pyramid->levels[0].buckets = builder->buckets;
+    pyramid->levelCount = 1;
+
+    uint32_t fanout = builder->fanout;
+
+    builder->buckets = NULL;
+    builder->bucketCount = 0;
+    builder->bucketCapacity = 0;
+
+    while (pyramid->levelCount < ABWaveformMaximumLevels && pyramid->levels[pyramid->levelCount - 1].bucketCount > 1) {
+        const ABWaveformLevel *finer = &pyramid->levels[pyramid->levelCount - 1];
+
+        if (finer->samplesPerBucket > UINT32_MAX / fanout) {
+            break;
+        }
+
+        ABWaveformLevel *level = &pyramid->levels[pyramid->levelCount];
+        level->samplesPerBucket = finer->samplesPerBucket * fanout;
+        level->bucketCount = (finer->bucketCount + fanout - 1) / fanout;
+        level->buckets = malloc((size_t)level->bucketCount * sizeof(ABWaveformBucket));
+
+        if (level->buckets == NULL) {
+            level->bucketCount = 0;
+            return ABWaveformStatusNoMemory;
+        }
+
+        for (uint32_t i = 0; i < level->bucketCount; i++) {
+            uint32_t first = i * fanout;
+            uint32_t end = first + fanout < finer->bucketCount ? first + fanout : finer->bucketCount;
+            ABWaveformBucket combined = finer->buckets[first];
+            double sumOfSquares = 0;
+            uint64_t samples = 0;
+
+            // RMS is combined through each child's sum of squares, weighted by the samples it covers
+            for (uint32_t child = first; child < end; child++) {
+                const ABWaveformBucket *bucket = &finer->buckets[child];
+                uint64_t childSamples = samplesInBucket(finer, child, pyramid->sampleCount);
+
+                combined.min = bucket->min < combined.min ? bucket->min : combined.min;
+                combined.max = bucket->max > combined.max ? bucket->max : combined.max;
+                sumOfSquares += (double)bucket->rms * bucket->rms * (double)childSamples;
+                samples += childSamples;
+            }
+
+            combined.rms = samples > 0 ? (float)sqrt(sumOfSquares / (double)samples) : 0;
+            level->buckets[i] = combined;
+        }
+
+        pyramid->levelCount++;
+    }
+
+    return ABWaveformStatusOK;
+}
+
+void ABWaveformPyramidFree(ABWaveformPyramid *pyramid) {
+
+    for (uint32_t i = 0; i < ABWaveformMaximumLevels; i++) {
+        free(pyramid->levels[i].buckets);
+        pyramid->levels[i].buckets = NULL;
+        pyramid->levels[i].bucketCount = 0;
+    }
+
+    pyramid->levelCount = 0;
+}
+
+#pragma mark - Peaks
+
+uint32_t ABWaveformPyramidPeaks(const ABWaveformPyramid *pyramid, uint64_t startSample, uint64_t endSample, uint32_t barCount, float *min, float *max, float *rms) {
+
+    if (barCount == 0) {
+        return 0;
+    }
+
+    if (pyramid->levelCount == 0 || pyramid->levels[0].bucketCount == 0) {
+
+        for (uint32_t bar = 0; bar < barCount; bar++) {
+            if (min) min[bar] = 0;
+            if (max) max[bar] = 0;
+            if (rms) rms[bar] = 0;
+        }
+
+        return 0;
+    }
+
+    endSample = endSample < pyramid->sampleCount ? endSample : pyramid->sampleCount;
+    startSample = startSample < endSample ? startSample : endSample;
+
+    uint64_t span = endSample - startSample;
+    uint32_t levelIndex = 0;
+
+    while (levelIndex + 1 < pyramid->levelCount && span / pyramid->levels[levelIndex + 1].samplesPerBucket >= barCount) {
+        levelIndex++;
+    }
+
+    const ABWaveformLevel *level = &pyramid->levels[levelIndex];
+
+    for (uint32_t bar = 0; bar < barCount; bar++) {
+        uint64_t barStart = startSample + (span * bar) / barCount;
+        uint64_t barEnd = startSample + (span * (bar + 1)) / barCount;
+
+        uint64_t first = barStart / level->samplesPerBucket;
+        uint64_t end = (barEnd + level->samplesPerBucket - 1) / level->samplesPerBucket;
+
+        // A bar narrower than a bucket shows the bucket it falls in
+        if (first >= level->bucketCount) {
+            first = level->bucketCount - 1;
+        }
+
+        if (end <= first) {
+            end = first + 1;
+        }
+
+        if (end > level->bucketCount) {
+            end = level->bucketCount;
+        }
+
+        float lowest = level->buckets[first].min;
+        float highest = level->buckets[first].max;
+        double squares = 0;
+
+        for (uint64_t i = first; i < end; i++) {
+            const ABWaveformBucket *bucket = &level->buckets[i];
+            lowest = bucket->min < lowest ? bucket->min : lowest;
+            highest = bucket->max > highest ? bucket->max : highest;
+            squares += (double)bucket->rms * bucket->rms;
+        }
+
+        if (min) min[bar] = lowest;
+        if (max) max[bar] = highest;
+        if (rms) rms[bar] = (float)sqrt(squares / (double)(end - first));
+    }
+
+    return levelIndex;
+}
+
+#pragma mark - Storage
+
+static void write32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static void write64(uint8_t *p, uint64_t value) {
+    write32(p, (uint32_t)value);
+    write32(p + 4, (uint32_t)(value >> 32));
+}
+
+static void writeFloat(uint8_t *p, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write32(p, bits);
+}
+
+static uint32_t read32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read64(const uint8_t *p) {
+    return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+static float readFloat(const uint8_t *p) {
+    uint32_t bits = read32(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// FNV-1a hash of the bytes, stored after them to catch a truncated or damaged file
+static uint64_t checksum(const uint8_t *bytes, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+size_t ABWaveformEncodedLength(const ABWaveformPyramid *pyramid) {
+    size_t length = ABWaveformHeaderLength + (size_t)pyramid->levelCount * ABWaveformLevelEntryLength + ABWaveformChecksumLength;
+
+    for (uint32_t i = 0; i < pyramid->levelCount; i++) {
+        length += (size_t)pyramid->levels[i].bucketCount * ABWaveformBucketLength;
+    }
+
+    return length;
+}
+
+size_t ABWaveformEncode(const ABWaveformPyramid *pyramid, uint8_t *bytes, size_t length) {
+    size_t encodedLength = ABWaveformEncodedLength(pyramid);
+
+    if (length < encodedLength) {
+        return 0;
+    }
+
+    memcpy(bytes, "ABWF", 4);
+    write32(bytes + 4, ABWaveformVersion);
+    write32(bytes + 8, pyramid->sampleRate);
+    write32(bytes + 12, pyramid->levelCount);
+    write64(bytes + 16, pyramid->sampleCount);
+    write64(bytes + 24, pyramid->sourceLength);
+    write64(bytes + 32, (uint64_t)pyramid->sourceModificationTime);
+
+    uint8_t *p = bytes + ABWaveformHeaderLength;
+
+    for (uint32_t i = 0; i < pyramid->levelCount; i++) {
+        write32(p, pyramid->levels[i].samplesPerBucket);
+        write32(p + 4, pyramid->levels[i].bucketCount);
+        p += ABWaveformLevelEntryLength;
+    }
+
+    for (uint32_t i = 0; i < pyramid->levelCount; i++) {
+        const ABWaveformLevel *level = &pyramid->levels[i];
+
+        for (uint32_t j = 0; j < level->bucketCount; j++) {
+            writeFloat(p, level->buckets[j].min);
+            writeFloat(p + 4, level->buckets[j].max);
+            writeFloat(p + 8, level->buckets[j].rms);
+            p += ABWaveformBucketLength;
+        }
+    }
+
+    write64(p, checksum(bytes, (size_t)(p - bytes)));
+
+    return encodedLength;
+}
+
+ABWaveformStatus ABWaveformDecode(const uint8_t *bytes, size_t length, ABWaveformPyramid *pyramid) {
+    memset(pyramid, 0, sizeof(*pyramid));
+
+    if (length < ABWaveformHeaderLength + ABWaveformChecksumLength || memcmp(bytes, "ABWF", 4) != 0 || read32(bytes + 4) != ABWaveformVersion) {
+        return ABWaveformStatusMalformed;
+    }
+
+    uint32_t levelCount = read32(bytes + 12);
+    uint64_t sampleCount = read64(bytes + 16);
+
+    if (levelCount == 0 || levelCount > ABWaveformMaximumLevels || sampleCount == 0) {
+        return ABWaveformStatusMalformed;
+    }
+
+    size_t tableEnd = ABWaveformHeaderLength + (size_t)levelCount * ABWaveformLevelEntryLength;
+
+    if (length < tableEnd + ABWaveformChecksumLength) {
+        return ABWaveformStatusMalformed;
+    }
+
+    // Every size is checked against the sample count before any bucket is read, so the bucket counts can not overflow the length
+    uint64_t bucketBytes = 0;
+    uint32_t previousSamplesPerBucket = 0;
+
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const uint8_t *entry = bytes + ABWaveformHeaderLength + (size_t)i * ABWaveformLevelEntryLength;
+        uint32_t samplesPerBucket = read32(entry);
+        uint32_t bucketCount = read32(entry + 4);
+
+        if (samplesPerBucket <= previousSamplesPerBucket || sampleCount / samplesPerBucket + (sampleCount % samplesPerBucket != 0) != bucketCount) {
+            return ABWaveformStatusMalformed;
+        }
+
+        previousSamplesPerBucket = samplesPerBucket;
+        bucketBytes += (uint64_t)bucketCount * ABWaveformBucketLength;
+
+        if (bucketBytes > length) {
+            return ABWaveformStatusMalformed;
+        }
+    }
+
+    if ((uint64_t)tableEnd + bucketBytes + ABWaveformChecksumLength != length) {
+        return ABWaveformStatusMalformed;
+    }
+
+    size_t payloadLength = length - ABWaveformChecksumLength;
+
+    if (read64(bytes + payloadLength) != checksum(bytes, payloadLength)) {
+        return ABWaveformStatusMalformed;
+    }
+
+    pyramid->sampleRate = read32(bytes + 8);
+    pyramid->sampleCount = sampleCount;
+    pyramid->sourceLength = read64(bytes + 24);
+    pyramid->sourceModificationTime = (int64_t)read64(bytes + 32);
+
+    const uint8_t *p = bytes + tableEnd;
+
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const uint8_t *entry = bytes + ABWaveformHeaderLength + (size_t)i * ABWaveformLevelEntryLength;
+        ABWaveformLevel *level = &pyramid->levels[i];
+
+        level->samplesPerBucket = read32(entry);
+        level->buckets = malloc((size_t)read32(entry + 4) * sizeof(ABWaveformBucket));
+
+        if (level->buckets == NULL) {
+            ABWaveformPyramidFree(pyramid);
+            return ABWaveformStatusNoMemory;
+        }
+
+        level->bucketCount = read32(entry + 4);
+        pyramid->levelCount = i + 1;
+
+        for (uint32_t j = 0; j < level->bucketCount; j++) {
+            ABWaveformBucket *bucket = &level->buckets[j];
+            bucket->min = readFloat(p);
+            bucket->max = readFloat(p + 4);
+            bucket->rms = readFloat(p + 8);
+            p += ABWaveformBucketLength;
+
+            // Renderers rely on ordered, finite values
+            if (!isfinite(bucket->min) || !isfinite(bucket->max) || !isfinite(bucket->rms) || bucket->min > bucket->max || bucket->rms < 0) {
+                ABWaveformPyramidFree(pyramid);
+                return ABWaveformStatusMalformed;
+            }
+        }
+    }
+
+    return ABWaveformStatusOK;
+}
@@ -0,0 +1,123 @@
+//
+//  ABWaveformSummary.h
+//  Pods
+//
+//
+//
+
+#ifndef ABWaveformSummary_h
+#define ABWaveformSummary_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Most zoom levels kept in a summary
+#define ABWaveformMaximumLevels 16
+
+/// Result of building, encoding or decoding a waveform summary
+typedef enum {
+    ABWaveformStatusOK = 0,
+    /// No samples were given to the builder
+    ABWaveformStatusEmpty,
+    /// Encoded bytes are truncated, corrupt, or of an unknown version
+    ABWaveformStatusMalformed,
+    ABWaveformStatusNoMemory,
+} ABWaveformStatus;
+
+/// Extremes and loudness of a run of samples, which are between -1 and 1
+typedef struct {
+    float min;
+    float max;
+    float rms;
+} ABWaveformBucket;
+
+/// Buckets summarizing the samples at one zoom level
+typedef struct {
+    /// Samples covered by each bucket, the last bucket may cover fewer
+    uint32_t samplesPerBucket;
+    uint32_t bucketCount;
+    ABWaveformBucket *buckets;
+} ABWaveformLevel;
+
+/// Min/max/RMS pyramid of a mono signal, from the finest level (0) to a single bucket
+typedef struct {
+    /// Samples per second of the signal
+    uint32_t sampleRate;
+
+    /// Number of samples summarized
+    uint64_t sampleCount;
+
+    /// Byte length of the file the samples were decoded from, so that a summary of a replaced file can be told apart
+    uint64_t sourceLength;
+
+    /// Modification time of the file the samples were decoded from, in microseconds since 1970, as a file replaced by one of the same length is otherwise missed
+    int64_t sourceModificationTime;
+
+    ABWaveformLevel levels[ABWaveformMaximumLevels];
+    uint32_t levelCount;
+} ABWaveformPyramid;
+
+/// Streams samples into the finest level of a pyramid
+typedef struct {
+    uint32_t samplesPerBucket;
+    uint32_t fanout;
+    uint64_t sampleCount;
+
+    /// Bucket being filled, which has not reached samplesPerBucket yet
+    float pendingMin;
+    float pendingMax;
+    double pendingSumOfSquares;
+    uint32_t pendingCount;
+
+    ABWaveformBucket *buckets;
+    uint32_t bucketCount;
+    uint32_t bucketCapacity;
+
+    int failed;
+} ABWaveformBuilder;
+
+/// Reduces samples to their minimum, maximum and sum of squares, four lanes at a time. An empty run gives a minimum and maximum of 0.
+void ABWaveformReduce(const float *samples, size_t count, float *min, float *max, float *sumOfSquares);
+
+/// Averages the channels of interleaved signed 16-bit frames into mono samples between -1 and 1
+void ABWaveformMixInt16(const int16_t *frames, size_t frameCount, uint32_t channelCount, float *samples);
+
+/// Begins a pyramid whose finest buckets cover samplesPerBucket samples, and each coarser level combines fanout buckets of the level below
+void ABWaveformBuilderInit(ABWaveformBuilder *builder, uint32_t samplesPerBucket, uint32_t fanout);
+
+/// Adds mono samples to the pyramid
+ABWaveformStatus ABWaveformBuilderAppend(ABWaveformBuilder *builder, const float *samples, size_t count);
+
+/// Adds interleaved signed 16-bit frames to the pyramid, mixed down to mono
+ABWaveformStatus ABWaveformBuilderAppendInt16(ABWaveformBuilder *builder, const int16_t *frames, size_t frameCount, uint32_t channelCount);
+
+/// Builds the coarser levels and hands the pyramid over, leaving the builder empty. The pyramid must be freed with ABWaveformPyramidFree, even when building fails.
+ABWaveformStatus ABWaveformBuilderFinish(ABWaveformBuilder *builder, uint32_t sampleRate, uint64_t sourceLength, int64_t sourceModificationTime, ABWaveformPyramid *pyramid);
+
+/// Frees the buckets held by a builder which was not finished
+void ABWaveformBuilderFree(ABWaveformBuilder *builder);
+
+/// Frees the buckets of every level
+void ABWaveformPyramidFree(ABWaveformPyramid *pyramid);
+
+/// Summarizes the samples from startSample to endSample into barCount bars, reading the coarsest level which still has a bucket for every bar. Any of min, max or rms may be NULL. Returns the level read.
+uint32_t ABWaveformPyramidPeaks(const ABWaveformPyramid *pyramid, uint64_t startSample, uint64_t endSample, uint32_t barCount, float *min, float *max, float *rms);
+
+/// Number of bytes ABWaveformEncode writes for the pyramid
+size_t ABWaveformEncodedLength(const ABWaveformPyramid *pyramid);
+
+/// Writes the pyramid in its portable little-endian storage format. Returns the bytes written, or 0 if length is too small.
+size_t ABWaveformEncode(const ABWaveformPyramid *pyramid, uint8_t *bytes, size_t length);
+
+/// Reads a pyramid written by ABWaveformEncode, checking its sizes and checksum. The pyramid must be freed with ABWaveformPyramidFree, even when decoding fails.
+ABWaveformStatus ABWaveformDecode(const uint8_t *bytes, size_t length, ABWaveformPyramid *pyramid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ABWaveformSummary_h */
@@ -13,6 +13,25 @@
 #import "ABMediaView.h"
 #import "ABCacheManager.h"
 #import "ABCommons.h"
+#import "ABPlayerPool.h"
+#import "ABPlayer.h"
+#import "ABBufferMonitor.h"
+#import "ABMediaVariant.h"
+#import "ABVariantSelector.h"
+#import "ABSeekCoalescer.h"
+#import "ABThumbnailStrip.h"
+#import "ABCompletionRegistry.h"
+#import "ABMediaBuffer.h"
+#import "ABMediaBufferPool.h"
+#import "ABMP4Parser.h"
+#import "ABVideoMetadata.h"
+#import "ABAnimationClock.h"
+#import "ABWaveformSummary.h"
+#import "ABAudioWaveform.h"
+#import "ABGestureLayout.h"
+#import "ABTextMeasurementCache.h"
+#import "ABLabel.h"
+#import "ABLoadTrace.h"
 
 FOUNDATION_EXPORT double ABMediaViewVersionNumber;
 FOUNDATION_EXPORT const unsigned char ABMediaViewVersionString[];
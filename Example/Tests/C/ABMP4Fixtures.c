@@ -0,0 +1,41 @@
+//
+//  ABMP4Fixtures.c
+//  ABMediaViewTests
+//
+//  Writes the MP4 fixtures of the parser tests, which are committed so that they also seed the fuzz corpus. Run with `make fixtures`.
+//
+
+#include "ABTestMP4.h"
+#include <stdio.h>
+
+static int ABWriteFixture(const char *directory, const char *name, ABTestBytes file) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    FILE *output = fopen(path, "wb");
+    int written = output != NULL && fwrite(file.bytes, 1, file.length, output) == file.length;
+
+    if (output != NULL) {
+        fclose(output);
+    }
+
+    free(file.bytes);
+
+    if (!written) {
+        fprintf(stderr, "could not write %s\n", path);
+        return 0;
+    }
+
+    printf("Wrote %s\n", path);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *directory = argc > 1 ? argv[1] : "Fixtures";
+
+    // Two seconds of reordered video, the second file with its moov box last and half a second of empty edit before it
+    int written = ABWriteFixture(directory, "moov-start.mp4", ABTestReorderedMP4(60, 256, 0, 0, 1, 0));
+    written &= ABWriteFixture(directory, "moov-end.mp4", ABTestReorderedMP4(60, 256, 1, 0, 1, 300));
+
+    return written ? 0 : 1;
+}
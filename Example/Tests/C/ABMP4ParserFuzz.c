@@ -0,0 +1,109 @@
+//
+//  ABMP4ParserFuzz.c
+//  ABMediaViewTests
+//
+//  Fuzz target of ABMP4Parser. Built with -fsanitize=fuzzer it is a libFuzzer target, otherwise it has a main which runs each file it is given, or stdin, for AFL and for replaying a corpus.
+//
+
+#include "ABMP4Parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Scans the input in windows of the given length, as range requests would, and parses the moov box it finds
+static void ABFuzzProbe(const uint8_t *data, size_t size, size_t windowLength, int knownLength) {
+    ABMP4Scan scan;
+    ABMP4ScanInit(&scan, knownLength ? size : 0);
+
+    for (int windowCount = 0; windowCount < 64 && scan.nextOffset < size; windowCount++) {
+        uint64_t offset = scan.nextOffset;
+        size_t available = size - offset < windowLength ? (size_t)(size - offset) : windowLength;
+        ABMP4Status status = ABMP4ScanWindow(&scan, data + offset, available, offset);
+
+        if (status == ABMP4StatusOK) {
+
+            if (scan.moovOffset + scan.moovSize <= size) {
+                // Copied so that reads past the moov box are caught, rather than landing in the rest of the input
+                uint8_t *moov = malloc(scan.moovSize > 0 ? (size_t)scan.moovSize : 1);
+                memcpy(moov, data + scan.moovOffset, (size_t)scan.moovSize);
+
+                ABMP4Metadata metadata;
+                ABMP4ParseMoov(moov, (size_t)scan.moovSize, &metadata);
+                ABMP4MetadataDuration(&metadata);
+                ABMP4MetadataTrack(&metadata, ABMP4FourCC('v', 'i', 'd', 'e'));
+                ABMP4MetadataFree(&metadata);
+
+                free(moov);
+            }
+
+            return;
+        }
+
+        if (status != ABMP4StatusNeedData || (scan.nextOffset == offset && available == size - offset)) {
+            return;
+        }
+    }
+
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    ABFuzzProbe(data, size, size, 1);
+    ABFuzzProbe(data, size, 64, 0);
+
+    ABMP4Metadata metadata;
+    ABMP4ParseMoov(data, size, &metadata);
+    ABMP4MetadataFree(&metadata);
+
+    return 0;
+}
+
+#ifndef AB_LIBFUZZER
+
+static void ABFuzzRunFile(FILE *file, const char *name) {
+    size_t capacity = 4096;
+    size_t size = 0;
+    uint8_t *data = malloc(capacity);
+
+    for (size_t count; (count = fread(data + size, 1, capacity - size, file)) > 0;) {
+        size += count;
+
+        if (size == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+
+    // Exactly sized, so that reads past the input are caught
+    uint8_t *input = malloc(size > 0 ? size : 1);
+    memcpy(input, data, size);
+    free(data);
+
+    LLVMFuzzerTestOneInput(input, size);
+    printf("Fuzzed %s, %zu bytes\n", name, size);
+
+    free(input);
+}
+
+int main(int argc, char **argv) {
+
+    if (argc < 2) {
+        ABFuzzRunFile(stdin, "stdin");
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+
+        if (file == NULL) {
+            fprintf(stderr, "could not read %s\n", argv[i]);
+            return 1;
+        }
+
+        ABFuzzRunFile(file, argv[i]);
+        fclose(file);
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,203 @@
+//
+//  ABMP4ParserTests.c
+//  ABMediaViewTests
+//
+//  Plain C tests of ABMP4Parser, which run on any platform with the sanitizers enabled. Run with `make test`.
+//
+
+#include "ABMP4Parser.h"
+#include "ABTestMP4.h"
+#include "ABTestSupport.h"
+#include <math.h>
+#include <stdio.h>
+
+/// Scans an in-memory file in windows of the given length, as range requests would, and parses its moov box
+static ABMP4Status ABTestProbeMP4(const uint8_t *file, size_t length, size_t windowLength, int knownLength, ABMP4Metadata *metadata, unsigned *windowCount) {
+    ABMP4Scan scan;
+    ABMP4ScanInit(&scan, knownLength ? length : 0);
+    memset(metadata, 0, sizeof(*metadata));
+    *windowCount = 0;
+
+    while (scan.nextOffset < length && *windowCount < 64) {
+        uint64_t offset = scan.nextOffset;
+        size_t available = length - offset < windowLength ? (size_t)(length - offset) : windowLength;
+        ABMP4Status status = ABMP4ScanWindow(&scan, file + offset, available, offset);
+        (*windowCount)++;
+
+        if (status == ABMP4StatusOK) {
+
+            if (scan.moovOffset + scan.moovSize > length) {
+                return ABMP4StatusMalformed;
+            }
+
+            return ABMP4ParseMoov(file + scan.moovOffset, (size_t)scan.moovSize, metadata);
+        }
+
+        if (status != ABMP4StatusNeedData || (scan.nextOffset == offset && available == length - offset)) {
+            return status;
+        }
+    }
+
+    return ABMP4StatusNotFound;
+}
+
+/// Checks that the video track has a keyframe every 30 frames at 29.97fps, starting at the given time
+static void ABTestCheckKeyframes(const ABMP4Track *video, uint32_t frameCount, double startTime) {
+    ABTestAssert(video->keyframeCount == (frameCount + 29) / 30);
+
+    for (uint32_t i = 0; i < video->keyframeCount; i++) {
+        ABTestAssert(fabs(video->keyframeTimes[i] - (startTime + i * 30 * 1001 / 30000.0)) < 1e-9);
+    }
+
+}
+
+static void testReadsMoovAtStartAndEnd(void) {
+
+    for (int moovAtEnd = 0; moovAtEnd < 2; moovAtEnd++) {
+
+        for (int rotated = 0; rotated < 2; rotated++) {
+            ABTestBytes file = ABTestMP4(300, 4096, moovAtEnd, rotated);
+
+            for (int knownLength = 0; knownLength < 2; knownLength++) {
+                ABMP4Metadata metadata;
+                unsigned windowCount = 0;
+
+                ABTestAssert(ABTestProbeMP4(file.bytes, file.length, 64, knownLength, &metadata, &windowCount) == ABMP4StatusOK);
+                ABTestAssert(fabs(ABMP4MetadataDuration(&metadata) - 300 * 1001 / 30000.0) < 0.01);
+                ABTestAssert(metadata.trackCount == 2);
+
+                const ABMP4Track *video = ABMP4MetadataTrack(&metadata, ABMP4FourCC('v', 'i', 'd', 'e'));
+                const ABMP4Track *audio = ABMP4MetadataTrack(&metadata, ABMP4FourCC('s', 'o', 'u', 'n'));
+
+                ABTestAssert(video != NULL && audio != NULL);
+                ABTestAssert(video->codec == ABMP4FourCC('a', 'v', 'c', '1'));
+                ABTestAssert(audio->codec == ABMP4FourCC('m', 'p', '4', 'a'));
+                ABTestAssert(video->width == (rotated ? 720 : 1280));
+                ABTestAssert(video->height == (rotated ? 1280 : 720));
+                ABTestAssert(video->sampleCount == 300);
+                ABTestCheckKeyframes(video, 300, 0);
+                ABTestAssert(audio->keyframeTimes == NULL);
+
+                // A moov box at the end costs one more window, to step over the mdat box
+                ABTestAssert(windowCount == (moovAtEnd ? 2u : 1u));
+
+                ABMP4MetadataFree(&metadata);
+            }
+
+            free(file.bytes);
+        }
+
+    }
+
+}
+
+static void testAppliesCompositionOffsetsAndEdits(void) {
+
+    for (uint32_t emptyEditDuration = 0; emptyEditDuration <= 300; emptyEditDuration += 300) {
+        ABTestBytes file = ABTestReorderedMP4(300, 4096, 1, 0, 1, emptyEditDuration);
+        ABMP4Metadata metadata;
+        unsigned windowCount = 0;
+
+        ABTestAssert(ABTestProbeMP4(file.bytes, file.length, 64, 1, &metadata, &windowCount) == ABMP4StatusOK);
+
+        // Keyframes are delayed by two frames, which the edit list cuts, so only the empty edit moves them
+        const ABMP4Track *video = ABMP4MetadataTrack(&metadata, ABMP4FourCC('v', 'i', 'd', 'e'));
+        ABTestAssert(video != NULL);
+        ABTestCheckKeyframes(video, 300, emptyEditDuration / 600.0);
+
+        ABMP4MetadataFree(&metadata);
+        free(file.bytes);
+    }
+
+}
+
+static void testParsesFixtures(const char *directory) {
+    const char *names[2] = {"moov-start.mp4", "moov-end.mp4"};
+
+    for (int moovAtEnd = 0; moovAtEnd < 2; moovAtEnd++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", directory, names[moovAtEnd]);
+
+        ABTestBytes file = {0};
+        file.bytes = ABTestReadFile(path, &file.length);
+        ABMP4Metadata metadata;
+        unsigned windowCount = 0;
+
+        ABTestAssert(ABTestProbeMP4(file.bytes, file.length, 64, 1, &metadata, &windowCount) == ABMP4StatusOK);
+        ABTestAssert(windowCount == (moovAtEnd ? 2u : 1u));
+        ABTestAssert(fabs(ABMP4MetadataDuration(&metadata) - 60 * 1001 / 30000.0) < 0.01);
+
+        // The fixture with its moov box at the end also starts after half a second of empty edit
+        const ABMP4Track *video = ABMP4MetadataTrack(&metadata, ABMP4FourCC('v', 'i', 'd', 'e'));
+        ABTestAssert(video != NULL && video->sampleCount == 60);
+        ABTestCheckKeyframes(video, 60, moovAtEnd ? 0.5 : 0);
+
+        ABMP4MetadataFree(&metadata);
+        free(file.bytes);
+    }
+
+}
+
+static void testSurvivesCorruptFiles(void) {
+    ABTestBytes files[2] = {ABTestMP4(120, 512, 0, 0), ABTestReorderedMP4(120, 512, 1, 1, 1, 300)};
+    unsigned parsedCount = 0;
+
+    srand(7);
+
+    for (unsigned iteration = 0; iteration < 50000; iteration++) {
+        ABTestBytes *source = &files[iteration % 2];
+        size_t length = source->length;
+        uint8_t *file = malloc(length);
+        memcpy(file, source->bytes, length);
+
+        // Random bytes are overwritten, bits flipped, sizes saturated, or the file truncated
+        for (int mutation = 1 + rand() % 8; mutation > 0; mutation--) {
+            size_t position = rand() % length;
+
+            switch (rand() % 4) {
+                case 0:
+                    file[position] = (uint8_t)rand();
+                    break;
+                case 1:
+                    file[position] ^= 1 << (rand() % 8);
+                    break;
+                case 2:
+                    file[position] = (rand() % 2) ? 0xFF : 0x00;
+                    break;
+                default:
+                    length = position + 1;
+                    break;
+            }
+        }
+
+        ABMP4Metadata metadata;
+        unsigned windowCount = 0;
+
+        if (ABTestProbeMP4(file, length, 1 + rand() % 256, rand() % 2, &metadata, &windowCount) == ABMP4StatusOK) {
+            parsedCount++;
+        }
+
+        ABMP4MetadataFree(&metadata);
+
+        ABMP4ParseMoov(file, length, &metadata);
+        ABMP4MetadataFree(&metadata);
+
+        free(file);
+    }
+
+    printf("MP4 fuzz - %u of 50000 corrupted files still parsed\n", parsedCount);
+
+    free(files[0].bytes);
+    free(files[1].bytes);
+}
+
+int main(int argc, char **argv) {
+    const char *fixtures = argc > 1 ? argv[1] : "Fixtures";
+
+    ABTestRun(testReadsMoovAtStartAndEnd());
+    ABTestRun(testAppliesCompositionOffsetsAndEdits());
+    ABTestRun(testParsesFixtures(fixtures));
+    ABTestRun(testSurvivesCorruptFiles());
+
+    return ABTestFinish();
+}
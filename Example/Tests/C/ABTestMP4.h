@@ -0,0 +1,228 @@
+//
+//  ABTestMP4.h
+//  ABMediaViewTests
+//
+//  Builds synthetic MP4 files for the parser tests, which are shared by the XCTests and the plain C tests
+//
+
+#ifndef ABTestMP4_h
+#define ABTestMP4_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Growable bytes used to build synthetic MP4 files
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+} ABTestBytes;
+
+static void ABTestAppend(ABTestBytes *b, const void *bytes, size_t length) {
+    
+    if (b->length + length > b->capacity) {
+        b->capacity = (b->length + length) * 2;
+        b->bytes = realloc(b->bytes, b->capacity);
+    }
+    
+    memcpy(b->bytes + b->length, bytes, length);
+    b->length += length;
+}
+
+static void ABTestAppend32(ABTestBytes *b, uint32_t value) {
+    uint8_t bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+    ABTestAppend(b, bytes, 4);
+}
+
+static void ABTestAppendZeros(ABTestBytes *b, size_t count) {
+    
+    if (b->length + count > b->capacity) {
+        b->capacity = (b->length + count) * 2;
+        b->bytes = realloc(b->bytes, b->capacity);
+    }
+    
+    memset(b->bytes + b->length, 0, count);
+    b->length += count;
+}
+
+/// Writes a box header with a placeholder size, returning where the box begins
+static size_t ABTestBeginBox(ABTestBytes *b, const char *type) {
+    size_t start = b->length;
+    ABTestAppend32(b, 0);
+    ABTestAppend(b, type, 4);
+    return start;
+}
+
+static void ABTestEndBox(ABTestBytes *b, size_t start) {
+    uint32_t size = (uint32_t)(b->length - start);
+    uint8_t bytes[4] = {size >> 24, size >> 16, size >> 8, size};
+    memcpy(b->bytes + start, bytes, 4);
+}
+
+static void ABTestAppendTrack(ABTestBytes *b, uint32_t trackID, const char *handler, const char *codec, uint32_t timescale, uint32_t delta, uint32_t frameCount, uint32_t keyframeInterval, uint32_t width, uint32_t height, int rotated, int reordered, uint32_t emptyEditDuration) {
+    size_t trak = ABTestBeginBox(b, "trak");
+    
+    size_t tkhd = ABTestBeginBox(b, "tkhd");
+    ABTestAppend32(b, 3);
+    ABTestAppendZeros(b, 8);
+    ABTestAppend32(b, trackID);
+    ABTestAppendZeros(b, 4);
+    ABTestAppend32(b, frameCount * delta);
+    ABTestAppendZeros(b, 16);
+    uint32_t matrix[9] = {0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000};
+    
+    if (rotated) {
+        matrix[0] = 0;
+        matrix[1] = 0x10000;
+        matrix[3] = 0xFFFF0000;
+        matrix[4] = 0;
+    }
+    
+    for (int i = 0; i < 9; i++) {
+        ABTestAppend32(b, matrix[i]);
+    }
+    
+    ABTestAppend32(b, width << 16);
+    ABTestAppend32(b, height << 16);
+    ABTestEndBox(b, tkhd);
+    
+    // Frames which are reordered are delayed by two frames, which the edit list cuts back out after an optional empty edit
+    if (reordered) {
+        size_t edts = ABTestBeginBox(b, "edts");
+        size_t elst = ABTestBeginBox(b, "elst");
+        ABTestAppend32(b, 0);
+        ABTestAppend32(b, emptyEditDuration > 0 ? 2 : 1);
+        
+        if (emptyEditDuration > 0) {
+            ABTestAppend32(b, emptyEditDuration);
+            ABTestAppend32(b, 0xFFFFFFFF);
+            ABTestAppend32(b, 0x10000);
+        }
+        
+        ABTestAppend32(b, (uint32_t)((uint64_t)frameCount * delta * 600 / timescale));
+        ABTestAppend32(b, 2 * delta);
+        ABTestAppend32(b, 0x10000);
+        ABTestEndBox(b, elst);
+        ABTestEndBox(b, edts);
+    }
+    
+    size_t mdia = ABTestBeginBox(b, "mdia");
+    size_t mdhd = ABTestBeginBox(b, "mdhd");
+    ABTestAppend32(b, 0);
+    ABTestAppendZeros(b, 8);
+    ABTestAppend32(b, timescale);
+    ABTestAppend32(b, frameCount * delta);
+    ABTestAppendZeros(b, 4);
+    ABTestEndBox(b, mdhd);
+    
+    size_t hdlr = ABTestBeginBox(b, "hdlr");
+    ABTestAppendZeros(b, 8);
+    ABTestAppend(b, handler, 4);
+    ABTestAppendZeros(b, 13);
+    ABTestEndBox(b, hdlr);
+    
+    size_t minf = ABTestBeginBox(b, "minf");
+    size_t stbl = ABTestBeginBox(b, "stbl");
+    
+    size_t stsd = ABTestBeginBox(b, "stsd");
+    ABTestAppend32(b, 0);
+    ABTestAppend32(b, 1);
+    size_t entry = ABTestBeginBox(b, codec);
+    ABTestAppendZeros(b, 24);
+    uint8_t size[4] = {width >> 8, width, height >> 8, height};
+    ABTestAppend(b, size, 4);
+    ABTestAppendZeros(b, 50);
+    ABTestEndBox(b, entry);
+    ABTestEndBox(b, stsd);
+    
+    size_t stts = ABTestBeginBox(b, "stts");
+    ABTestAppend32(b, 0);
+    ABTestAppend32(b, 1);
+    ABTestAppend32(b, frameCount);
+    ABTestAppend32(b, delta);
+    ABTestEndBox(b, stts);
+    
+    if (keyframeInterval > 0) {
+        size_t stss = ABTestBeginBox(b, "stss");
+        ABTestAppend32(b, 0);
+        ABTestAppend32(b, (frameCount + keyframeInterval - 1) / keyframeInterval);
+        
+        for (uint32_t sample = 1; sample <= frameCount; sample += keyframeInterval) {
+            ABTestAppend32(b, sample);
+        }
+        
+        ABTestEndBox(b, stss);
+    }
+    
+    if (reordered) {
+        size_t ctts = ABTestBeginBox(b, "ctts");
+        ABTestAppend32(b, 0);
+        ABTestAppend32(b, frameCount);
+        
+        // Keyframes and every other frame are presented two frames after they are decoded, the frames between them one frame after
+        for (uint32_t sample = 0; sample < frameCount; sample++) {
+            ABTestAppend32(b, 1);
+            ABTestAppend32(b, (sample % 2 == 0) ? 2 * delta : delta);
+        }
+        
+        ABTestEndBox(b, ctts);
+    }
+    
+    size_t stsz = ABTestBeginBox(b, "stsz");
+    ABTestAppend32(b, 0);
+    ABTestAppend32(b, 100);
+    ABTestAppend32(b, frameCount);
+    ABTestEndBox(b, stsz);
+    
+    ABTestEndBox(b, stbl);
+    ABTestEndBox(b, minf);
+    ABTestEndBox(b, mdia);
+    ABTestEndBox(b, trak);
+}
+
+/// Builds an MP4 with a 1280x720 29.97fps video track with a keyframe every 30 frames and an audio track, with the moov box before or after the mdat box. A reordered video track has composition offsets and an edit list, as encoders write for B-frames, and starts after an empty edit of the given duration in 1/600ths of a second.
+static ABTestBytes ABTestReorderedMP4(uint32_t frameCount, uint32_t mdatLength, int moovAtEnd, int rotated, int reordered, uint32_t emptyEditDuration) {
+    ABTestBytes b = {0};
+    
+    size_t ftyp = ABTestBeginBox(&b, "ftyp");
+    ABTestAppend(&b, "isom", 4);
+    ABTestAppend32(&b, 512);
+    ABTestAppend(&b, "isomavc1", 8);
+    ABTestEndBox(&b, ftyp);
+    
+    for (int pass = 0; pass < 2; pass++) {
+        
+        if (pass == (moovAtEnd ? 1 : 0)) {
+            size_t moov = ABTestBeginBox(&b, "moov");
+            size_t mvhd = ABTestBeginBox(&b, "mvhd");
+            ABTestAppend32(&b, 0);
+            ABTestAppendZeros(&b, 8);
+            ABTestAppend32(&b, 600);
+            ABTestAppend32(&b, (uint32_t)((uint64_t)frameCount * 1001 * 600 / 30000));
+            ABTestAppendZeros(&b, 80);
+            ABTestEndBox(&b, mvhd);
+            
+            ABTestAppendTrack(&b, 1, "vide", "avc1", 30000, 1001, frameCount, 30, 1280, 720, rotated, reordered, emptyEditDuration);
+            ABTestAppendTrack(&b, 2, "soun", "mp4a", 44100, 1024, frameCount * 44100 / 30 / 1024, 0, 0, 0, 0, 0, 0);
+            ABTestEndBox(&b, moov);
+        } else {
+            // A 64-bit mdat header, as used for large files
+            ABTestAppend32(&b, 1);
+            ABTestAppend(&b, "mdat", 4);
+            ABTestAppend32(&b, 0);
+            ABTestAppend32(&b, 16 + mdatLength);
+            ABTestAppendZeros(&b, mdatLength);
+        }
+        
+    }
+    
+    return b;
+}
+
+/// Builds an MP4 with a 1280x720 29.97fps video track with a keyframe every 30 frames and an audio track, with the moov box before or after the mdat box
+static ABTestBytes ABTestMP4(uint32_t frameCount, uint32_t mdatLength, int moovAtEnd, int rotated) {
+    return ABTestReorderedMP4(frameCount, mdatLength, moovAtEnd, rotated, 0, 0);
+}
+
+#endif /* ABTestMP4_h */
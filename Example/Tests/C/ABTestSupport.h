@@ -0,0 +1,68 @@
+//
+//  ABTestSupport.h
+//  ABMediaViewTests
+//
+//  Assertions for the plain C tests, which report every failure and exit with a failing status at the end
+//
+
+#ifndef ABTestSupport_h
+#define ABTestSupport_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int ABTestFailureCount = 0;
+
+/// Reports a failed condition with its location, and carries on with the test
+#define ABTestAssert(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #condition); \
+        ABTestFailureCount++; \
+    } \
+} while (0)
+
+/// Runs a test, printing its name and whether it passed
+#define ABTestRun(test) do { \
+    int failuresBefore = ABTestFailureCount; \
+    printf("Test %s\n", #test); \
+    test; \
+    printf("Test %s %s\n", #test, ABTestFailureCount == failuresBefore ? "passed" : "failed"); \
+} while (0)
+
+/// Exit status of the tests which have run
+static int ABTestFinish(void) {
+
+    if (ABTestFailureCount > 0) {
+        fprintf(stderr, "%d assertions failed\n", ABTestFailureCount);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/// Reads a whole file, exiting when it can not be read. The bytes must be freed.
+static uint8_t *ABTestReadFile(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0) {
+        fprintf(stderr, "could not read %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    long size = ftell(file);
+    uint8_t *bytes = malloc(size > 0 ? (size_t)size : 1);
+    rewind(file);
+
+    if (size < 0 || bytes == NULL || fread(bytes, 1, (size_t)size, file) != (size_t)size) {
+        fprintf(stderr, "could not read %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(file);
+    *length = (size_t)size;
+
+    return bytes;
+}
+
+#endif /* ABTestSupport_h */
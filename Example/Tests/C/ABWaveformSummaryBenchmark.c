@@ -0,0 +1,164 @@
+//
+//  ABWaveformSummaryBenchmark.c
+//  ABMediaViewTests
+//
+//  Times ABWaveformSummary on raw PCM, as it comes out of the decoder. Run with `make benchmark`, or pass a file of
+//  raw signed 16-bit little-endian interleaved PCM, e.g. from `ffmpeg -i audio.m4a -f s16le -ac 2 -ar 44100 audio.pcm`:
+//
+//      build/waveform-benchmark audio.pcm [channels] [sample rate]
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "ABWaveformSummary.h"
+#include "ABTestSupport.h"
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+/// Runs of each measurement, of which the fastest is reported
+#define ABBenchmarkRepeats 5
+
+static double ABBenchmarkNow(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/// Reduces samples one at a time, as the baseline for the vectorized kernel. Kept out of line so that it is not vectorized into the caller.
+__attribute__((noinline)) static void ABBenchmarkScalarReduce(const float *samples, size_t count, float *min, float *max, float *sumOfSquares) {
+    float runMin = samples[0];
+    float runMax = samples[0];
+    float runSumOfSquares = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        runMin = samples[i] < runMin ? samples[i] : runMin;
+        runMax = samples[i] > runMax ? samples[i] : runMax;
+        runSumOfSquares += samples[i] * samples[i];
+    }
+
+    *min = runMin;
+    *max = runMax;
+    *sumOfSquares = runSumOfSquares;
+}
+
+/// Ten minutes of a stereo tone with noise at 44.1kHz
+static int16_t *ABBenchmarkSyntheticPCM(size_t frameCount) {
+    int16_t *frames = malloc(frameCount * 2 * sizeof(int16_t));
+    uint32_t noise = 1;
+
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        noise = noise * 1664525u + 1013904223u;
+
+        float value = 0.6f * sinf(frame * 0.05f) + 0.2f * ((int)(noise >> 16) - 32768) / 32768.0f;
+        frames[frame * 2] = (int16_t)(value * 32767);
+        frames[frame * 2 + 1] = (int16_t)(value * 30000);
+    }
+
+    return frames;
+}
+
+int main(int argc, char **argv) {
+    uint32_t channelCount = argc > 2 ? (uint32_t)atoi(argv[2]) : 2;
+    uint32_t sampleRate = argc > 3 ? (uint32_t)atoi(argv[3]) : 44100;
+    size_t length;
+    int16_t *frames;
+
+    if (channelCount == 0 || sampleRate == 0) {
+        fprintf(stderr, "usage: %s [pcm file] [channels] [sample rate]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 1) {
+        frames = (int16_t *)ABTestReadFile(argv[1], &length);
+    } else {
+        length = (size_t)10 * 60 * 44100 * 2 * sizeof(int16_t);
+        frames = ABBenchmarkSyntheticPCM(length / (2 * sizeof(int16_t)));
+    }
+
+    size_t frameCount = length / (channelCount * sizeof(int16_t));
+    double megabytes = length / (1024.0 * 1024.0);
+    double buildTime = INFINITY;
+    ABWaveformPyramid pyramid = {0};
+
+    // Frames are appended in chunks of the size a decoder hands out
+    for (int repeat = 0; repeat < ABBenchmarkRepeats; repeat++) {
+        ABWaveformPyramidFree(&pyramid);
+
+        double start = ABBenchmarkNow();
+        ABWaveformBuilder builder;
+        ABWaveformBuilderInit(&builder, 256, 4);
+
+        for (size_t position = 0; position < frameCount; position += 8192) {
+            size_t count = frameCount - position < 8192 ? frameCount - position : 8192;
+            ABWaveformBuilderAppendInt16(&builder, frames + position * channelCount, count, channelCount);
+        }
+
+        if (ABWaveformBuilderFinish(&builder, sampleRate, length, 0, &pyramid) != ABWaveformStatusOK) {
+            fprintf(stderr, "the PCM has no samples\n");
+            return EXIT_FAILURE;
+        }
+
+        buildTime = fmin(buildTime, ABBenchmarkNow() - start);
+    }
+
+    printf("Pyramid - %.1f MB of PCM (%.1f minutes) in %.2f ms, %.0f MB/s, %u levels\n", megabytes, frameCount / (double)sampleRate / 60, buildTime * 1000, megabytes / buildTime, pyramid.levelCount);
+
+    size_t encodedLength = ABWaveformEncodedLength(&pyramid);
+    uint8_t *encoded = malloc(encodedLength);
+    double start = ABBenchmarkNow();
+    ABWaveformEncode(&pyramid, encoded, encodedLength);
+    double encodeTime = ABBenchmarkNow() - start;
+
+    ABWaveformPyramid decoded;
+    start = ABBenchmarkNow();
+    ABWaveformDecode(encoded, encodedLength, &decoded);
+    double decodeTime = ABBenchmarkNow() - start;
+
+    // Drawing a track only reads a few hundred buckets, however long the audio is
+    float max[400];
+    start = ABBenchmarkNow();
+
+    for (int i = 0; i < 1000; i++) {
+        ABWaveformPyramidPeaks(&decoded, 0, frameCount, 400, NULL, max, NULL);
+    }
+
+    double peaksTime = (ABBenchmarkNow() - start) / 1000;
+
+    printf("Storage - %.2f MB, encoded in %.2f ms, decoded in %.2f ms, 400 peaks in %.1f us\n", encodedLength / (1024.0 * 1024.0), encodeTime * 1000, decodeTime * 1000, peaksTime * 1e6);
+
+    // The kernel on its own, over the finest buckets of the mixed signal
+    float *samples = malloc(frameCount * sizeof(float));
+    ABWaveformMixInt16(frames, frameCount, channelCount, samples);
+
+    double scalarTime = INFINITY;
+    double vectorTime = INFINITY;
+    float min, maximum, sumOfSquares;
+
+    for (int repeat = 0; repeat < ABBenchmarkRepeats; repeat++) {
+        start = ABBenchmarkNow();
+
+        for (size_t i = 0; i < frameCount; i += 256) {
+            ABBenchmarkScalarReduce(samples + i, frameCount - i < 256 ? frameCount - i : 256, &min, &maximum, &sumOfSquares);
+        }
+
+        scalarTime = fmin(scalarTime, ABBenchmarkNow() - start);
+        start = ABBenchmarkNow();
+
+        for (size_t i = 0; i < frameCount; i += 256) {
+            ABWaveformReduce(samples + i, frameCount - i < 256 ? frameCount - i : 256, &min, &maximum, &sumOfSquares);
+        }
+
+        vectorTime = fmin(vectorTime, ABBenchmarkNow() - start);
+    }
+
+    printf("Reduce of 256 sample buckets - scalar %.2f ms, vector %.2f ms (%.1fx)\n", scalarTime * 1000, vectorTime * 1000, scalarTime / vectorTime);
+
+    ABWaveformPyramidFree(&decoded);
+    ABWaveformPyramidFree(&pyramid);
+    free(samples);
+    free(encoded);
+    free(frames);
+
+    return EXIT_SUCCESS;
+}
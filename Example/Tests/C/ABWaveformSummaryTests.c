@@ -0,0 +1,205 @@
+//
+//  ABWaveformSummaryTests.c
+//  ABMediaViewTests
+//
+//  Plain C tests of ABWaveformSummary, which run on any platform with the sanitizers enabled. Run with `make test`.
+//
+
+#include "ABWaveformSummary.h"
+#include "ABTestSupport.h"
+#include <math.h>
+#include <string.h>
+
+static uint64_t ABTestRandomState = 88172645463325252ULL;
+
+/// Deterministic xorshift generator, so that failures reproduce on every platform
+static uint64_t ABTestRandom(void) {
+    ABTestRandomState ^= ABTestRandomState << 13;
+    ABTestRandomState ^= ABTestRandomState >> 7;
+    ABTestRandomState ^= ABTestRandomState << 17;
+    return ABTestRandomState;
+}
+
+/// Reduces samples one at a time, in double precision, as the reference for the vectorized kernel
+static void ABTestScalarReduce(const float *samples, size_t count, float *min, float *max, double *sumOfSquares) {
+    *min = samples[0];
+    *max = samples[0];
+    *sumOfSquares = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        *min = samples[i] < *min ? samples[i] : *min;
+        *max = samples[i] > *max ? samples[i] : *max;
+        *sumOfSquares += (double)samples[i] * samples[i];
+    }
+
+}
+
+static void testReduceMatchesScalar(void) {
+    float samples[600];
+
+    // Every remainder of the four lanes, at every alignment
+    for (int trial = 0; trial < 20000; trial++) {
+        size_t offset = ABTestRandom() % 8;
+        size_t count = 1 + ABTestRandom() % 500;
+
+        for (size_t i = 0; i < offset + count; i++) {
+            samples[i] = ((int)(ABTestRandom() % 65536) - 32768) / 32768.0f;
+        }
+
+        float min, max, sumOfSquares, scalarMin, scalarMax;
+        double scalarSumOfSquares;
+
+        ABWaveformReduce(samples + offset, count, &min, &max, &sumOfSquares);
+        ABTestScalarReduce(samples + offset, count, &scalarMin, &scalarMax, &scalarSumOfSquares);
+
+        ABTestAssert(min == scalarMin && max == scalarMax);
+        ABTestAssert(fabs(sumOfSquares - scalarSumOfSquares) <= 1e-4 * (scalarSumOfSquares + 1));
+    }
+
+}
+
+static void testPyramidLevelsAgree(void) {
+    size_t sampleCount = 1000003;
+    float *samples = malloc(sampleCount * sizeof(float));
+
+    for (size_t i = 0; i < sampleCount; i++) {
+        samples[i] = 0.8f * sinf(i * 0.001f) * ((float)(ABTestRandom() % 1000) / 1000.0f);
+    }
+
+    // Samples arrive in uneven chunks, as they do from a decoder
+    ABWaveformBuilder builder;
+    ABWaveformBuilderInit(&builder, 256, 4);
+
+    for (size_t position = 0; position < sampleCount;) {
+        size_t count = 1 + ABTestRandom() % 5000;
+        count = count < sampleCount - position ? count : sampleCount - position;
+
+        ABTestAssert(ABWaveformBuilderAppend(&builder, samples + position, count) == ABWaveformStatusOK);
+        position += count;
+    }
+
+    ABWaveformPyramid pyramid;
+    ABTestAssert(ABWaveformBuilderFinish(&builder, 44100, 12345, 0, &pyramid) == ABWaveformStatusOK);
+    ABTestAssert(pyramid.sampleCount == sampleCount);
+    ABTestAssert(pyramid.levels[pyramid.levelCount - 1].bucketCount == 1);
+
+    // Every bucket of every level summarizes exactly the samples it covers
+    for (uint32_t level = 0; level < pyramid.levelCount; level++) {
+        const ABWaveformLevel *summary = &pyramid.levels[level];
+        ABTestAssert(summary->bucketCount == (sampleCount + summary->samplesPerBucket - 1) / summary->samplesPerBucket);
+
+        for (uint32_t bucket = 0; bucket < summary->bucketCount; bucket += level == 0 ? 97 : 1) {
+            size_t start = (size_t)bucket * summary->samplesPerBucket;
+            size_t count = summary->samplesPerBucket < sampleCount - start ? summary->samplesPerBucket : sampleCount - start;
+            float min, max;
+            double sumOfSquares;
+
+            ABTestScalarReduce(samples + start, count, &min, &max, &sumOfSquares);
+            ABTestAssert(summary->buckets[bucket].min == min && summary->buckets[bucket].max == max);
+            ABTestAssert(fabs(summary->buckets[bucket].rms - sqrt(sumOfSquares / count)) < 1e-4);
+        }
+    }
+
+    float min[300], max[300], rms[300];
+    uint32_t level = ABWaveformPyramidPeaks(&pyramid, 0, sampleCount, 300, min, max, rms);
+    ABTestAssert(pyramid.levels[level].bucketCount >= 300);
+
+    for (int bar = 0; bar < 300; bar++) {
+        ABTestAssert(min[bar] <= max[bar]);
+    }
+
+    // A range past the end reads nothing
+    ABTestAssert(ABWaveformPyramidPeaks(&pyramid, sampleCount + 5, sampleCount + 10, 4, min, max, NULL) == 0);
+
+    ABWaveformPyramidFree(&pyramid);
+    free(samples);
+}
+
+static void testRoundTripsAndRejectsCorruption(void) {
+    size_t sampleCount = 100000;
+    float *samples = malloc(sampleCount * sizeof(float));
+
+    for (size_t i = 0; i < sampleCount; i++) {
+        samples[i] = 0.5f * sinf(i * 0.01f);
+    }
+
+    ABWaveformBuilder builder;
+    ABWaveformBuilderInit(&builder, 256, 4);
+    ABWaveformBuilderAppend(&builder, samples, sampleCount);
+
+    ABWaveformPyramid pyramid;
+    ABTestAssert(ABWaveformBuilderFinish(&builder, 22050, 12345, 1500000000123456, &pyramid) == ABWaveformStatusOK);
+
+    size_t length = ABWaveformEncodedLength(&pyramid);
+    uint8_t *bytes = malloc(length);
+    ABTestAssert(ABWaveformEncode(&pyramid, bytes, length) == length);
+    ABTestAssert(ABWaveformEncode(&pyramid, bytes, length - 1) == 0);
+
+    ABWaveformPyramid decoded;
+    ABTestAssert(ABWaveformDecode(bytes, length, &decoded) == ABWaveformStatusOK);
+    ABTestAssert(decoded.levelCount == pyramid.levelCount && decoded.sampleCount == sampleCount && decoded.sampleRate == 22050);
+    ABTestAssert(decoded.sourceLength == 12345 && decoded.sourceModificationTime == 1500000000123456);
+
+    for (uint32_t level = 0; level < pyramid.levelCount && level < decoded.levelCount; level++) {
+        ABTestAssert(memcmp(decoded.levels[level].buckets, pyramid.levels[level].buckets, pyramid.levels[level].bucketCount * sizeof(ABWaveformBucket)) == 0);
+    }
+
+    ABWaveformPyramidFree(&decoded);
+
+    // Flipped bits and truncations are caught by the checksum or the size checks
+    uint8_t *corrupted = malloc(length);
+
+    for (int trial = 0; trial < 100000; trial++) {
+        size_t corruptedLength = length;
+        memcpy(corrupted, bytes, length);
+
+        if (trial % 2 == 0) {
+            corrupted[ABTestRandom() % length] ^= 1 << (ABTestRandom() % 8);
+        } else {
+            corruptedLength = ABTestRandom() % length;
+        }
+
+        ABTestAssert(ABWaveformDecode(corrupted, corruptedLength, &decoded) != ABWaveformStatusOK);
+        ABWaveformPyramidFree(&decoded);
+    }
+
+    // A summary of the previous version is rejected, so that it is built again
+    memcpy(corrupted, bytes, length);
+    corrupted[4] = 1;
+    ABTestAssert(ABWaveformDecode(corrupted, length, &decoded) == ABWaveformStatusMalformed);
+    ABWaveformPyramidFree(&decoded);
+
+    free(corrupted);
+    free(bytes);
+    free(samples);
+    ABWaveformPyramidFree(&pyramid);
+}
+
+static void testMixesInt16Frames(void) {
+    int16_t stereo[8] = {32767, -32768, 100, 100, -200, 0, 0, 0};
+    float mixed[4];
+    ABWaveformMixInt16(stereo, 4, 2, mixed);
+
+    ABTestAssert(fabsf(mixed[0] - (-1 / 65536.0f)) < 1e-7);
+    ABTestAssert(fabsf(mixed[1] - 200 / 65536.0f) < 1e-7);
+    ABTestAssert(fabsf(mixed[2] - (-100 / 32768.0f)) < 1e-7);
+
+    int16_t surround[6] = {300, 300, 300, -3, -3, -3};
+    ABWaveformMixInt16(surround, 2, 3, mixed);
+    ABTestAssert(fabsf(mixed[0] - 300 / 32768.0f) < 1e-7);
+
+    ABWaveformBuilder builder;
+    ABWaveformPyramid pyramid;
+    ABWaveformBuilderInit(&builder, 256, 4);
+    ABTestAssert(ABWaveformBuilderFinish(&builder, 44100, 0, 0, &pyramid) == ABWaveformStatusEmpty);
+    ABWaveformPyramidFree(&pyramid);
+}
+
+int main(void) {
+    ABTestRun(testReduceMatchesScalar());
+    ABTestRun(testPyramidLevelsAgree());
+    ABTestRun(testRoundTripsAndRejectsCorruption());
+    ABTestRun(testMixesInt16Frames());
+
+    return ABTestFinish();
+}
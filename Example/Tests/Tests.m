@@ -9,9 +9,218 @@
 @import XCTest;
 #import <ABMediaView/ABCacheManager.h>
 #import <ABMediaView/ABCommons.h>
+#import <ABMediaView/ABMediaView.h>
+#import <ABMediaView/ABPlayer.h>
+#import <ABMediaView/ABPlayerPool.h>
+#import <ABMediaView/ABBufferMonitor.h>
+#import <ABMediaView/ABMediaVariant.h>
+#import <ABMediaView/ABVariantSelector.h>
+#import <ABMediaView/ABSeekCoalescer.h>
+#import <ABMediaView/ABThumbnailStrip.h>
+#import <ABMediaView/ABCompletionRegistry.h>
+#import <ABMediaView/ABMediaBufferPool.h>
+#import <ABMediaView/ABMP4Parser.h>
+#import <ABMediaView/ABVideoMetadata.h>
+#import <ABMediaView/ABAnimationClock.h>
+#import <ABMediaView/ABWaveformSummary.h>
+#import <ABMediaView/ABAudioWaveform.h>
+#import <ABMediaView/ABGestureLayout.h>
+#import <ABMediaView/ABTextMeasurementCache.h>
+#import <ABMediaView/ABLabel.h>
+#import <ABMediaView/ABLoadTrace.h>
+#import <ImageIO/ImageIO.h>
+#import <mach/mach.h>
+#import <sys/resource.h>
+#import "C/ABTestMP4.h"
+
+static NSString *const ABTestVideoURL = @"http://clips.vorwaerts-gmbh.de/VfE_html5.mp4";
+
+/// Physical memory footprint of the process, in bytes
+static uint64_t ABTestMemoryFootprint(void) {
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    
+    return info.phys_footprint;
+}
+
+/// CPU time used by the process, in seconds
+static double ABTestCPUTime(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/// Encodes a small animated GIF whose colors are unique to the index
+static NSData *ABTestGIFData(NSUInteger index, NSUInteger frameCount) {
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, CFSTR("com.compuserve.gif"), frameCount, NULL);
+    NSDictionary *frameProperties = @{(__bridge NSString *)kCGImagePropertyGIFDictionary : @{(__bridge NSString *)kCGImagePropertyGIFDelayTime : @0.1}};
+    
+    for (NSUInteger frame = 0; frame < frameCount; frame++) {
+        UIGraphicsBeginImageContextWithOptions(CGSizeMake(64, 64), YES, 1.0);
+        [[UIColor colorWithRed:(index % 10) / 10.0 green:(index / 10) / 10.0 blue:frame / (CGFloat)frameCount alpha:1.0] setFill];
+        UIRectFill(CGRectMake(0, 0, 64, 64));
+        UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+        UIGraphicsEndImageContext();
+        
+        CGImageDestinationAddImage(destination, image.CGImage, (__bridge CFDictionaryRef)frameProperties);
+    }
+    
+    CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    
+    return data;
+}
+
+/// Interleaved signed 16-bit PCM of a tone whose loudness swells and fades, with a little noise
+static int16_t *ABTestPCM(size_t frameCount, uint32_t channelCount) {
+    int16_t *frames = malloc(frameCount * channelCount * sizeof(int16_t));
+    
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        double envelope = 0.5 + 0.45 * sin(frame * 0.00002);
+        double tone = envelope * sin(frame * 0.06);
+        
+        for (uint32_t channel = 0; channel < channelCount; channel++) {
+            double noise = ((rand() % 2001) - 1000) / 100000.0;
+            frames[frame * channelCount + channel] = (int16_t)((tone + noise) * 30000);
+        }
+    }
+    
+    return frames;
+}
+
+/// Collapses double spaces and newlines by repeated replacement, as ABCommons did before normalizing in a single pass
+static NSString *ABTestReferenceTrimMultiSpace(NSString *text) {
+    
+    while ([text containsString:@"  "]) {
+        text = [text stringByReplacingOccurrencesOfString:@"  " withString:@" "];
+    }
+    
+    while ([text containsString:@"\n\n"]) {
+        text = [text stringByReplacingOccurrencesOfString:@"\n\n" withString:@"\n"];
+    }
+    
+    return text;
+}
+
+/// Trims and removes spaces through intermediate strings, as ABCommons did before normalizing in a single pass
+static NSString *ABTestReferenceRemoveSpaces(NSString *text) {
+    text = [text stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    text = ABTestReferenceTrimMultiSpace(text);
+    text = [text stringByReplacingOccurrencesOfString:@" " withString:@""];
+    
+    return [text stringByReplacingOccurrencesOfString:@"\n" withString:@""];
+}
+
+/// Splits on every character which is not a letter, as ABCommons did before normalizing in a single pass
+static NSString *ABTestReferenceRemoveSpecialCharacters(NSString *text) {
+    NSCharacterSet *notAllowedChars = [[NSCharacterSet characterSetWithCharactersInString:@"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"] invertedSet];
+    
+    return [[text componentsSeparatedByCharactersInSet:notAllowedChars] componentsJoinedByString:@""];
+}
+
+/// Scans an in-memory file in windows of the given length, as range requests would, and parses its moov box
+static ABMP4Status ABTestProbeMP4(const uint8_t *file, size_t length, size_t windowLength, BOOL knownLength, ABMP4Metadata *metadata, NSUInteger *windowCount) {
+    ABMP4Scan scan;
+    ABMP4ScanInit(&scan, knownLength ? length : 0);
+    memset(metadata, 0, sizeof(*metadata));
+    *windowCount = 0;
+    
+    while (scan.nextOffset < length && *windowCount < 64) {
+        uint64_t offset = scan.nextOffset;
+        size_t available = (size_t)MIN((uint64_t)windowLength, length - offset);
+        ABMP4Status status = ABMP4ScanWindow(&scan, file + offset, available, offset);
+        (*windowCount)++;
+        
+        if (status == ABMP4StatusOK) {
+            
+            if (scan.moovOffset + scan.moovSize > length) {
+                return ABMP4StatusMalformed;
+            }
+            
+            return ABMP4ParseMoov(file + scan.moovOffset, (size_t)scan.moovSize, metadata);
+        }
+        
+        if (status != ABMP4StatusNeedData || (scan.nextOffset == offset && available == length - offset)) {
+            return status;
+        }
+    }
+    
+    return ABMP4StatusNotFound;
+}
+
+/// Target which records what the animation clock asks of it
+@interface ABTestAnimationTarget : NSObject <ABAnimationClockTarget>
+
+@property (strong, nonatomic) UIImage *image;
+@property (nonatomic) BOOL visible;
+@property (strong, nonatomic) NSMutableArray<UIImage *> *displayedFrames;
+@property (nonatomic) NSUInteger releaseCount;
+@property (nonatomic) NSUInteger restoreCount;
+
+@end
+
+@implementation ABTestAnimationTarget
+
+- (id)init {
+    if (self = [super init]) {
+        self.displayedFrames = [[NSMutableArray alloc] init];
+        self.visible = YES;
+    }
+    return self;
+}
+
+- (UIImage *)animationClockImage {
+    return self.image;
+}
+
+- (BOOL)isVisibleForAnimationClock {
+    return self.visible;
+}
+
+- (void)animationClockDisplayFrame:(UIImage *)frame {
+    [self.displayedFrames addObject:frame];
+}
+
+- (void)animationClockReleaseFrames {
+    self.image = nil;
+    self.releaseCount++;
+}
+
+- (void)animationClockRestoreFrames {
+    self.restoreCount++;
+}
+
+@end
+
+/// Private methods of ABMediaView which the tests drive directly
+@interface ABMediaView (Testing)
+
+- (ABPlayer *)player;
+
+- (void)handleTapFromRecognizer;
+
+- (void)setFullscreen:(BOOL)fullscreen;
+
+- (NSTimer *)animateTimer;
+
+- (UIImage *)displayedImage;
+
+@end
 
 @interface Tests : XCTestCase
 
+/// Timestamp of the previous display link frame during a scripted scrub
+@property (nonatomic) CFTimeInterval lastFrameTimestamp;
+
+/// Frames dropped during a scripted scrub
+@property (nonatomic) NSUInteger droppedFrames;
+
 @end
 
 @implementation Tests
@@ -107,5 +316,1956 @@
     }];
 }
 
-@end
+- (void)testPlayerPoolReusesRecycledPlayers {
+    ABPlayerPool *pool = [ABPlayerPool sharedManager];
+    [pool drain];
+    
+    AVPlayerItem *item = [AVPlayerItem playerItemWithURL:[NSURL URLWithString:ABTestVideoURL]];
+    ABPlayer *player = [pool dequeuePlayerWithItem:item];
+    XCTAssertEqual(player.currentItem, item, "dequeued player should be loaded with the item");
+    
+    [pool recyclePlayer:player];
+    XCTAssertEqual(pool.idlePlayerCount, 1, "recycled player should be kept in the pool");
+    XCTAssertNil(player.currentItem, "recycled player should not hold on to its item");
+    
+    ABPlayer *reusedPlayer = [pool dequeuePlayerWithItem:nil];
+    XCTAssertEqual(player, reusedPlayer, "idle player should be reused");
+    XCTAssertEqual(pool.idlePlayerCount, 0, "reused player should leave the pool");
+}
+
+- (void)testPlayerPoolRecyclesPreparedPlayerOfDeallocatedOwner {
+    ABPlayerPool *pool = [ABPlayerPool sharedManager];
+    [pool drain];
+    
+    @autoreleasepool {
+        ABMediaView *mediaView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 320, 180)];
+        AVPlayerItem *item = [AVPlayerItem playerItemWithURL:[NSURL URLWithString:ABTestVideoURL]];
+        
+        [pool setPreparedPlayer:[pool dequeuePlayerWithItem:item] forOwner:mediaView];
+        XCTAssert([pool hasPreparedPlayerForOwner:mediaView]);
+    }
+    
+    // The mediaView is freed without a reset, and its player is returned to the pool without its item
+    XCTAssertEqual(pool.idlePlayerCount, 1, "prepared player of a deallocated mediaView should be recycled");
+    XCTAssertNil([pool dequeuePlayerWithItem:nil].currentItem);
+}
+
+- (NSTimeInterval)timeToFirstFrameOnQueueAdvanceWithPreroll:(BOOL)preroll {
+    ABMediaView *manager = [ABMediaView sharedManager];
+    manager.shouldPrerollQueuedMediaViews = preroll;
+    
+    ABMediaView *currentMediaView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 320, 180)];
+    [currentMediaView setVideoURL:ABTestVideoURL];
+    
+    ABMediaView *nextMediaView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 320, 180)];
+    [nextMediaView setVideoURL:ABTestVideoURL];
+    
+    [manager presentMediaView:currentMediaView animated:NO];
+    [manager queueMediaView:nextMediaView];
+    
+    // Let the current mediaView play while the next one is prepared
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:5.0]];
+    
+    [manager presentNextMediaView];
+    
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+    while (nextMediaView.timeToFirstFrame == 0 && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    
+    [nextMediaView dismissMediaViewAnimated:NO withCompletion:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    
+    return nextMediaView.timeToFirstFrame;
+}
+
+- (void)testTimeToFirstFrameOnQueueAdvance {
+    NSTimeInterval coldTime = [self timeToFirstFrameOnQueueAdvanceWithPreroll:NO];
+    NSTimeInterval prerolledTime = [self timeToFirstFrameOnQueueAdvanceWithPreroll:YES];
+    
+    NSLog(@"Time to first frame on queue advance - cold: %.3fs, prerolled: %.3fs", coldTime, prerolledTime);
+    
+    XCTAssert(coldTime > 0, "next mediaView should play without preroll");
+    XCTAssert(prerolledTime > 0, "next mediaView should play with preroll");
+    
+    [[ABMediaView sharedManager] setShouldPrerollQueuedMediaViews:YES];
+}
+
+- (void)testBufferMonitorMergesRanges {
+    ABBufferMonitor *monitor = [[ABBufferMonitor alloc] init];
+    
+    XCTAssertEqualWithAccuracy([monitor addRangeFromTime:10 toTime:20], 10, 0.0001);
+    XCTAssertEqualWithAccuracy([monitor addRangeFromTime:0 toTime:5], 5, 0.0001);
+    XCTAssertEqualWithAccuracy([monitor addRangeFromTime:30 toTime:40], 10, 0.0001);
+    XCTAssertEqual(monitor.rangeCount, 3);
+    
+    // Bridges the first two ranges, only the gap is new
+    XCTAssertEqualWithAccuracy([monitor addRangeFromTime:4 toTime:12], 5, 0.0001);
+    XCTAssertEqual(monitor.rangeCount, 2);
+    XCTAssertEqualWithAccuracy([monitor rangeAtIndex:0].start, 0, 0.0001);
+    XCTAssertEqualWithAccuracy([monitor rangeAtIndex:0].end, 20, 0.0001);
+    XCTAssertEqualWithAccuracy(monitor.totalBufferedTime, 30, 0.0001);
+    
+    XCTAssertTrue([monitor containsTime:15]);
+    XCTAssertFalse([monitor containsTime:25]);
+    XCTAssertEqualWithAccuracy([monitor bufferedAheadOfTime:15], 5, 0.0001);
+    XCTAssertEqualWithAccuracy([monitor bufferedAheadOfTime:25], 0, 0.0001);
+    XCTAssertFalse([monitor isFullyBufferedForDuration:40]);
+    
+    [monitor addRangeFromTime:20 toTime:30];
+    XCTAssertEqual(monitor.rangeCount, 1);
+    XCTAssertTrue([monitor isFullyBufferedForDuration:40]);
+    XCTAssertTrue([monitor isFullyBufferedForDuration:40.05], "tiny shortfalls from timescale rounding should count as complete");
+}
+
+- (void)testBufferMonitorPredictsStall {
+    ABBufferMonitor *monitor = [[ABBufferMonitor alloc] init];
+    monitor.smoothingFactor = 1.0;
+    
+    // Simulate a 60s video downloading at half of real time while it plays from the start, after a 5s head start
+    const NSTimeInterval duration = 60.0;
+    const double downloadRate = 0.5;
+    const NSTimeInterval step = 0.25;
+    
+    NSTimeInterval loaded = 5.0;
+    NSTimeInterval playhead = 0;
+    NSTimeInterval clock = 0;
+    NSTimeInterval predictedStall = INFINITY;
+    
+    ABBufferedRange range = {0, loaded};
+    [monitor updateWithRanges:&range count:1 atTime:clock];
+    
+    while (playhead < loaded) {
+        clock += step;
+        loaded = MIN(duration, loaded + (downloadRate * step));
+        playhead += step;
+        
+        range.end = loaded;
+        [monitor updateWithRanges:&range count:1 atTime:clock];
+        
+        if (clock == 1.0) {
+            predictedStall = clock + [monitor timeToStallFromTime:playhead duration:duration rate:1.0f];
+        }
+    }
+    
+    XCTAssertEqualWithAccuracy(monitor.throughput, downloadRate, 0.0001);
+    XCTAssertEqualWithAccuracy(predictedStall, clock, step, "predicted stall should match the simulated stall");
+    
+    // With a download faster than playback there is nothing to predict
+    ABBufferMonitor *fastMonitor = [[ABBufferMonitor alloc] init];
+    ABBufferedRange fastRange = {0, 5};
+    [fastMonitor updateWithRanges:&fastRange count:1 atTime:0];
+    fastRange.end = 10;
+    [fastMonitor updateWithRanges:&fastRange count:1 atTime:2];
+    XCTAssertTrue(isinf([fastMonitor timeToStallFromTime:1 duration:duration rate:1.0f]));
+    
+    // A stalled download decays the throughput
+    [fastMonitor advanceToTime:4];
+    XCTAssertLessThan(fastMonitor.throughput, 2.5);
+}
+
+- (void)testBufferMonitorIgnoresEvictedRangesForThroughput {
+    ABBufferMonitor *monitor = [[ABBufferMonitor alloc] init];
+    monitor.smoothingFactor = 1.0;
+    
+    ABBufferedRange ranges[2] = {{0, 10}, {30, 32}};
+    [monitor updateWithRanges:ranges count:1 atTime:0];
+    
+    // After a seek, the early range is evicted and a new one starts loading
+    [monitor updateWithRanges:&ranges[1] count:1 atTime:1];
+    XCTAssertEqualWithAccuracy(monitor.throughput, 2.0, 0.0001);
+    XCTAssertEqual(monitor.rangeCount, 1);
+    XCTAssertEqualWithAccuracy([monitor bufferedEndFromTime:30], 32, 0.0001);
+}
+
+
+- (NSArray<ABMediaVariant *> *)variantLadder {
+    return @[[ABMediaVariant variantWithURL:@"https://example.com/video_1080.mp4" bitrate:5000000 resolution:CGSizeMake(1920, 1080)],
+             [ABMediaVariant variantWithURL:@"https://example.com/video_240.mp4" bitrate:400000 resolution:CGSizeMake(426, 240)],
+             [ABMediaVariant variantWithURL:@"https://example.com/video_720.mp4" bitrate:2500000 resolution:CGSizeMake(1280, 720)],
+             [ABMediaVariant variantWithURL:@"https://example.com/video_480.mp4" bitrate:1200000 resolution:CGSizeMake(854, 480)]];
+}
+
+/// Plays through a recorded bandwidth trace (bits per second, one sample per second), selecting a variant every second. Returns the seconds spent stalled, the number of switches, and the highest and final bitrates.
+- (NSDictionary *)simulateVariantSelectionWithTrace:(NSArray<NSNumber *> *)trace viewSize:(CGSize)viewSize {
+    ABVariantSelector *selector = [[ABVariantSelector alloc] init];
+    NSArray *variants = [self variantLadder];
+    
+    const NSTimeInterval maximumBuffer = 30.0;
+    const double smoothingFactor = 0.3;
+    
+    ABMediaVariant *current = nil;
+    double bandwidthEstimate = 0;
+    NSTimeInterval buffer = 0;
+    NSTimeInterval stalled = 0;
+    NSUInteger switches = 0;
+    double maximumBitrate = 0;
+    
+    for (NSNumber *sample in trace) {
+        double bandwidth = sample.doubleValue;
+        ABMediaVariant *variant = [selector variantFromVariants:variants bandwidth:bandwidthEstimate bufferLevel:buffer viewSize:viewSize currentVariant:current];
+        
+        if (current && variant != current) {
+            switches++;
+        }
+        
+        current = variant;
+        maximumBitrate = MAX(maximumBitrate, current.bitrate);
+        
+        buffer = MIN(maximumBuffer, buffer + (bandwidth / current.bitrate));
+        
+        if (buffer >= 1.0) {
+            buffer -= 1.0;
+        } else {
+            stalled += 1.0 - buffer;
+            buffer = 0;
+        }
+        
+        bandwidthEstimate = (bandwidthEstimate == 0) ? bandwidth : (smoothingFactor * bandwidth) + ((1.0 - smoothingFactor) * bandwidthEstimate);
+    }
+    
+    return @{@"stalled" : @(stalled), @"switches" : @(switches), @"maximumBitrate" : @(maximumBitrate), @"finalBitrate" : @(current.bitrate)};
+}
+
+- (NSArray<NSNumber *> *)bandwidthTraceWithSegments:(NSArray<NSArray<NSNumber *> *> *)segments {
+    NSMutableArray *trace = [[NSMutableArray alloc] init];
+    
+    for (NSArray<NSNumber *> *segment in segments) {
+        
+        for (NSUInteger i = 0; i < segment[1].unsignedIntegerValue; i++) {
+            [trace addObject:segment[0]];
+        }
+        
+    }
+    
+    return trace;
+}
+
+- (void)testVariantSelectorFollowsBandwidthTrace {
+    CGSize fullscreen = CGSizeMake(2208, 1242);
+    
+    // Fast connection which drops to 800kbps for a minute, then recovers
+    NSArray *trace = [self bandwidthTraceWithSegments:@[@[@5000000, @60], @[@800000, @60], @[@5000000, @60]]];
+    NSDictionary *result = [self simulateVariantSelectionWithTrace:trace viewSize:fullscreen];
+    
+    XCTAssertEqualWithAccuracy([result[@"stalled"] doubleValue], 0, 0.0001, "the buffer should ride out the drop");
+    XCTAssertEqual([result[@"maximumBitrate"] doubleValue], 2500000, "only variants within the safety factor of the bandwidth should be chosen");
+    XCTAssertEqual([result[@"finalBitrate"] doubleValue], 2500000);
+    XCTAssertLessThanOrEqual([result[@"switches"] unsignedIntegerValue], 4);
+    
+    // Bandwidth which oscillates around the boundary between two variants should not cause a switch every few seconds
+    NSMutableArray *oscillating = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < 30; i++) {
+        [oscillating addObjectsFromArray:[self bandwidthTraceWithSegments:@[@[@2000000, @2], @[@4000000, @2]]]];
+    }
+    
+    result = [self simulateVariantSelectionWithTrace:oscillating viewSize:fullscreen];
+    XCTAssertEqualWithAccuracy([result[@"stalled"] doubleValue], 0, 0.0001);
+    XCTAssertLessThanOrEqual([result[@"switches"] unsignedIntegerValue], 4);
+    
+    // A very fast connection reaches the top of the ladder
+    result = [self simulateVariantSelectionWithTrace:[self bandwidthTraceWithSegments:@[@[@20000000, @30]]] viewSize:fullscreen];
+    XCTAssertEqual([result[@"finalBitrate"] doubleValue], 5000000);
+}
+
+- (void)testVariantSelectorCapsResolutionToViewSize {
+    ABVariantSelector *selector = [[ABVariantSelector alloc] init];
+    NSArray *variants = [self variantLadder];
+    
+    // Minimized mediaView at 3x scale
+    CGSize minimized = CGSizeMake(621, 349);
+    
+    XCTAssertEqual([selector resolutionCapFromVariants:variants viewSize:minimized].bitrate, 1200000);
+    XCTAssertEqual([selector resolutionCapFromVariants:variants viewSize:CGSizeMake(349, 621)].bitrate, 1200000, "rotated views should be capped the same way");
+    XCTAssertEqual([selector resolutionCapFromVariants:variants viewSize:CGSizeMake(2208, 1242)].bitrate, 5000000);
+    XCTAssertEqual([selector resolutionCapFromVariants:variants viewSize:CGSizeZero].bitrate, 5000000);
+    
+    NSDictionary *result = [self simulateVariantSelectionWithTrace:[self bandwidthTraceWithSegments:@[@[@20000000, @60]]] viewSize:minimized];
+    XCTAssertEqual([result[@"maximumBitrate"] doubleValue], 1200000, "bandwidth should not be spent on pixels the view can not show");
+    
+    // Shrinking the view switches down even with a full buffer
+    ABMediaVariant *top = [variants firstObject];
+    ABMediaVariant *selected = [selector variantFromVariants:variants bandwidth:20000000 bufferLevel:30 viewSize:minimized currentVariant:top];
+    XCTAssertEqual(selected.bitrate, 1200000);
+}
+
+
+- (void)testSeekCoalescerKeepsOnlyLatestTargetInFlight {
+    ABSeekCoalescer *coalescer = [[ABSeekCoalescer alloc] init];
+    
+    NSMutableArray *completions = [[NSMutableArray alloc] init];
+    NSMutableArray *targets = [[NSMutableArray alloc] init];
+    NSMutableArray *exactSeeks = [[NSMutableArray alloc] init];
+    
+    coalescer.seekHandler = ^(CMTime time, CMTime toleranceBefore, CMTime toleranceAfter, void (^completion)(BOOL finished)) {
+        [targets addObject:@(CMTimeGetSeconds(time))];
+        [exactSeeks addObject:@(CMTIME_COMPARE_INLINE(toleranceBefore, ==, kCMTimeZero) && CMTIME_COMPARE_INLINE(toleranceAfter, ==, kCMTimeZero))];
+        [completions addObject:completion];
+    };
+    
+    // A drag delivers many targets while the first seek is still decoding
+    for (NSUInteger i = 0; i < 50; i++) {
+        [coalescer seekToTime:i exact:NO];
+    }
+    
+    XCTAssertEqual(targets.count, 1, "only one seek should be in flight");
+    XCTAssertFalse([exactSeeks[0] boolValue], "seeks while scrubbing should be loose");
+    
+    void (^complete)(void) = ^{
+        void (^completion)(BOOL finished) = [completions lastObject];
+        completion(YES);
+    };
+    
+    complete();
+    
+    XCTAssertEqual(targets.count, 2);
+    XCTAssertEqualWithAccuracy([targets[1] doubleValue], 49, 0.01, "only the latest target should be seeked after the first");
+    XCTAssertEqual(coalescer.coalescedSeekCount, 48);
+    
+    // Letting go seeks exactly, after the loose seek in flight
+    [coalescer seekToTime:30 exact:YES];
+    XCTAssertEqual(targets.count, 2);
+    
+    complete();
+    
+    XCTAssertEqual(targets.count, 3);
+    XCTAssertEqualWithAccuracy([targets[2] doubleValue], 30, 0.01);
+    XCTAssertTrue([exactSeeks[2] boolValue]);
+    
+    complete();
+    
+    XCTAssertFalse(coalescer.isSeeking);
+    XCTAssertEqual(coalescer.requestedSeekCount, 51);
+    XCTAssertEqual(coalescer.performedSeekCount, 3);
+    
+    // Completions of seeks which were cancelled are ignored
+    [coalescer seekToTime:10 exact:NO];
+    [coalescer cancelPendingSeeks];
+    [coalescer seekToTime:20 exact:NO];
+    XCTAssertEqual(targets.count, 5);
+    
+    void (^cancelledCompletion)(BOOL finished) = completions[3];
+    cancelledCompletion(NO);
+    XCTAssertTrue(coalescer.isSeeking, "the cancelled seek should not end the seek in flight");
+}
+
+- (void)testThumbnailStripIndexesByTime {
+    ABThumbnailStrip *strip = [[ABThumbnailStrip alloc] initWithAsset:nil duration:300];
+    
+    XCTAssertEqualWithAccuracy(strip.interval, 3, 0.0001);
+    XCTAssertEqual(strip.thumbnailCount, 100);
+    XCTAssertEqual([strip indexForTime:0], 0);
+    XCTAssertEqual([strip indexForTime:4.5], 1);
+    XCTAssertEqual([strip indexForTime:299.9], 99);
+    XCTAssertEqual([strip indexForTime:1000], 99);
+    XCTAssertEqual([strip indexForTime:-5], 0);
+    XCTAssertEqualWithAccuracy([strip timeForIndex:1], 4.5, 0.0001);
+    XCTAssertNil([strip cachedThumbnailForTime:10]);
+    
+    // Short videos are not split finer than half a second
+    ABThumbnailStrip *shortStrip = [[ABThumbnailStrip alloc] initWithAsset:nil duration:10];
+    XCTAssertEqualWithAccuracy(shortStrip.interval, 0.5, 0.0001);
+    XCTAssertEqual(shortStrip.thumbnailCount, 20);
+}
+
+- (void)testThumbnailStripGeneratesLazily {
+    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:[NSURL URLWithString:ABTestVideoURL] options:nil];
+    ABThumbnailStrip *strip = [ABThumbnailStrip thumbnailStripForAsset:asset key:ABTestVideoURL];
+    
+    XCTAssertEqual(strip, [ABThumbnailStrip thumbnailStripForAsset:asset key:ABTestVideoURL], "strips should be shared by key");
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Thumbnail generated"];
+    
+    [strip thumbnailForTime:5.0 completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        XCTAssertNotNil(thumbnail);
+        XCTAssertEqual([strip indexForTime:time], [strip indexForTime:5.0]);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:20.0 handler:nil];
+    
+    XCTAssertNotNil([strip cachedThumbnailForTime:5.0]);
+    XCTAssertNil([strip cachedThumbnailForTime:strip.duration - 1.0], "thumbnails should only be generated when requested");
+}
+
+- (void)testThumbnailStripCancelsOnlyTheRequesterRequests {
+    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:[NSURL URLWithString:ABTestVideoURL] options:nil];
+    ABThumbnailStrip *strip = [[ABThumbnailStrip alloc] initWithAsset:asset duration:60];
+    
+    // Two track views scrubbing the same shared strip
+    NSObject *cancelledRequester = [[NSObject alloc] init];
+    NSObject *requester = [[NSObject alloc] init];
+    
+    __block BOOL cancelledCompleted = NO;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Thumbnail generated for the other requester"];
+    
+    [strip thumbnailForTime:10.0 requester:cancelledRequester completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        cancelledCompleted = YES;
+    }];
+    
+    [strip thumbnailForTime:40.0 requester:requester completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        XCTAssertNotNil(thumbnail);
+        XCTAssertEqual([strip indexForTime:time], [strip indexForTime:40.0]);
+        [expectation fulfill];
+    }];
+    
+    [strip cancelPendingThumbnailsForRequester:cancelledRequester];
+    
+    [self waitForExpectationsWithTimeout:20.0 handler:nil];
+    
+    XCTAssertFalse(cancelledCompleted, "the cancelled requester should not be called back");
+    XCTAssertNil([strip cachedThumbnailForTime:10.0], "the cancelled thumbnail should not be generated");
+    
+    // A requester waiting on the same thumbnail keeps it generating when the other cancels
+    __block BOOL sharedCancelledCompleted = NO;
+    XCTestExpectation *sharedExpectation = [self expectationWithDescription:@"Shared thumbnail generated"];
+    
+    [strip thumbnailForTime:20.0 requester:cancelledRequester completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        sharedCancelledCompleted = YES;
+    }];
+    
+    [strip thumbnailForTime:20.0 requester:requester completion:^(UIImage *thumbnail, NSTimeInterval time) {
+        XCTAssertNotNil(thumbnail);
+        [sharedExpectation fulfill];
+    }];
+    
+    [strip cancelPendingThumbnailsForRequester:cancelledRequester];
+    
+    [self waitForExpectationsWithTimeout:20.0 handler:nil];
+    
+    XCTAssertFalse(sharedCancelledCompleted);
+    XCTAssertNotNil([strip cachedThumbnailForTime:20.0]);
+}
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink {
+    
+    if (self.lastFrameTimestamp > 0 && displayLink.duration > 0) {
+        NSUInteger frames = (NSUInteger)round((displayLink.timestamp - self.lastFrameTimestamp) / displayLink.duration);
+        
+        if (frames > 1) {
+            self.droppedFrames += frames - 1;
+        }
+    }
+    
+    self.lastFrameTimestamp = displayLink.timestamp;
+}
+
+- (void)testScriptedScrubSeekLatency {
+    AVPlayer *player = [AVPlayer playerWithURL:[NSURL URLWithString:ABTestVideoURL]];
+    ABSeekCoalescer *coalescer = [[ABSeekCoalescer alloc] initWithPlayer:player];
+    
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+    while (player.currentItem.status != AVPlayerItemStatusReadyToPlay && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    
+    XCTAssertEqual(player.currentItem.status, AVPlayerItemStatusReadyToPlay);
+    
+    self.lastFrameTimestamp = 0;
+    self.droppedFrames = 0;
+    
+    CADisplayLink *displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(displayLinkDidFire:)];
+    [displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+    
+    // Drag from 2s to 8s over one second, one target per frame, then let go
+    const NSUInteger steps = 60;
+    
+    for (NSUInteger i = 0; i <= steps; i++) {
+        [coalescer seekToTime:2.0 + (6.0 * i / steps) exact:NO];
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.0 / 60.0]];
+    }
+    
+    [coalescer seekToTime:8.0 exact:YES];
+    
+    timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    while (coalescer.isSeeking && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    
+    [displayLink invalidate];
+    
+    NSLog(@"Scripted scrub - requested: %lu, performed: %lu, coalesced: %lu, average latency: %.3fs, max latency: %.3fs, dropped frames: %lu",
+          (unsigned long)coalescer.requestedSeekCount, (unsigned long)coalescer.performedSeekCount, (unsigned long)coalescer.coalescedSeekCount,
+          coalescer.averageSeekLatency, coalescer.maximumSeekLatency, (unsigned long)self.droppedFrames);
+    
+    XCTAssertFalse(coalescer.isSeeking);
+    XCTAssertLessThanOrEqual(coalescer.performedSeekCount, coalescer.requestedSeekCount);
+    XCTAssertEqualWithAccuracy(CMTimeGetSeconds(player.currentTime), 8.0, 0.05, "letting go should land exactly on the target");
+}
+
+
+- (void)testCompletionRegistryDeliversToLiveWaiters {
+    ABCompletionRegistry *registry = [[ABCompletionRegistry alloc] init];
+    NSString *key = @"http://yoursite.com/yourimage.jpg";
+    
+    NSObject *waiter = [[NSObject alloc] init];
+    __block NSUInteger deliveries = 0;
+    __block id deliveredObject = nil;
+    
+    [registry addWaiter:waiter forType:ImageCache key:key handler:^(id waiter, id object, NSError *error) {
+        deliveries++;
+        deliveredObject = object;
+    }];
+    
+    XCTAssertEqual([registry waiterCountForType:ImageCache key:key], 1);
+    XCTAssertEqual([registry waiterCountForType:AudioCache key:key], 0, "keys should be separate per cache type");
+    XCTAssertEqual([registry notifyType:ImageCache key:key object:@"image" error:nil], 1);
+    XCTAssertEqual(deliveries, 1);
+    XCTAssertEqualObjects(deliveredObject, @"image");
+    XCTAssertEqual([registry notifyType:ImageCache key:key object:@"image" error:nil], 0, "subscriptions should be dropped once delivered");
+    
+    // Subscribing again for the same type, as a reused view does, replaces the earlier key
+    [registry addWaiter:waiter forType:ImageCache key:key handler:^(id waiter, id object, NSError *error) {
+        XCTFail("the replaced subscription should not be notified");
+    }];
+    [registry addWaiter:waiter forType:ImageCache key:@"http://yoursite.com/other.jpg" handler:^(id waiter, id object, NSError *error) {
+        deliveries++;
+    }];
+    
+    XCTAssertEqual([registry notifyType:ImageCache key:key object:@"image" error:nil], 0);
+    XCTAssertEqual([registry notifyType:ImageCache key:@"http://yoursite.com/other.jpg" object:@"image" error:nil], 1);
+    XCTAssertEqual(deliveries, 2);
+    
+    // Deallocated waiters are dropped without being removed
+    @autoreleasepool {
+        NSObject *shortLivedWaiter = [[NSObject alloc] init];
+        [registry addWaiter:shortLivedWaiter forType:AudioCache key:key handler:^(id waiter, id object, NSError *error) {
+            XCTFail("a deallocated waiter should not be notified");
+        }];
+        shortLivedWaiter = nil;
+    }
+    
+    XCTAssertEqual([registry waiterCountForType:AudioCache key:key], 0);
+    XCTAssertEqual([registry notifyType:AudioCache key:key object:@"audio" error:nil], 0);
+}
+
+- (void)testCompletionRegistryPerformanceWithLiveViews {
+    const NSUInteger viewCount = 10000;
+    const NSUInteger keyCount = 1000;
+    
+    ABCompletionRegistry *registry = [[ABCompletionRegistry alloc] init];
+    NSMutableArray *views = [[NSMutableArray alloc] initWithCapacity:viewCount];
+    NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:keyCount];
+    
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        [keys addObject:[NSString stringWithFormat:@"http://yoursite.com/image%lu.jpg", (unsigned long)i]];
+    }
+    
+    for (NSUInteger i = 0; i < viewCount; i++) {
+        [views addObject:[[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 100, 100)]];
+    }
+    
+    __block NSUInteger delivered = 0;
+    ABCompletionHandler handler = ^(ABMediaView *mediaView, UIImage *image, NSError *error) {
+        delivered++;
+    };
+    
+    // Every view subscribes, then every key completes, as when a feed of cells loads its thumbnails
+    [self measureBlock:^{
+        delivered = 0;
+        
+        for (NSUInteger i = 0; i < viewCount; i++) {
+            [registry addWaiter:views[i] forType:ImageCache key:keys[i % keyCount] handler:handler];
+        }
+        
+        for (NSString *key in keys) {
+            [registry notifyType:ImageCache key:key object:nil error:nil];
+        }
+    }];
+    
+    XCTAssertEqual(delivered, viewCount);
+}
+
+
+/// Taps an inline mediaView whose player has been prerolled, and measures how long the fullscreen mediaView takes to play, and the peak growth in memory while it does
+- (NSDictionary *)tapToPlayWithHandoff:(BOOL)handoff {
+    UIWindow *window = [UIApplication sharedApplication].keyWindow;
+    
+    ABMediaView *inlineView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 320, 180)];
+    inlineView.shouldDisplayFullscreen = YES;
+    inlineView.shouldHandoffMedia = handoff;
+    [inlineView setVideoURL:ABTestVideoURL];
+    [window addSubview:inlineView];
+    
+    [inlineView prerollMedia];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:5.0]];
+    
+    uint64_t baseline = ABTestMemoryFootprint();
+    uint64_t peak = baseline;
+    
+    [inlineView handleTapFromRecognizer];
+    
+    ABMediaView *presentedView = nil;
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+    
+    while ((presentedView == nil || presentedView.timeToFirstFrame == 0) && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.02]];
+        
+        presentedView = [[ABMediaView sharedManager] currentMediaView];
+        peak = MAX(peak, ABTestMemoryFootprint());
+    }
+    
+    NSTimeInterval timeToPlaying = presentedView.timeToFirstFrame;
+    
+    [presentedView dismissMediaViewAnimated:NO withCompletion:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    
+    BOOL returnedPlayer = (inlineView.player != nil);
+    
+    [inlineView resetMediaInView];
+    [inlineView removeFromSuperview];
+    
+    return @{@"timeToPlaying" : @(timeToPlaying), @"peakMemory" : @(peak - baseline), @"returnedPlayer" : @(returnedPlayer)};
+}
+
+- (void)testHandoffToFullscreen {
+    NSDictionary *cloned = [self tapToPlayWithHandoff:NO];
+    NSDictionary *handedOff = [self tapToPlayWithHandoff:YES];
+    
+    NSLog(@"Tap to playing - cloned: %.3fs (+%.1fMB), handed off: %.3fs (+%.1fMB)",
+          [cloned[@"timeToPlaying"] doubleValue], [cloned[@"peakMemory"] doubleValue] / 1048576.0,
+          [handedOff[@"timeToPlaying"] doubleValue], [handedOff[@"peakMemory"] doubleValue] / 1048576.0);
+    
+    XCTAssert([cloned[@"timeToPlaying"] doubleValue] > 0, "fullscreen mediaView should play without handoff");
+    XCTAssert([handedOff[@"timeToPlaying"] doubleValue] > 0, "fullscreen mediaView should play the handed off player");
+    XCTAssertFalse([cloned[@"returnedPlayer"] boolValue]);
+    XCTAssertTrue([handedOff[@"returnedPlayer"] boolValue], "the player should move back to the inline mediaView on dismissal");
+    
+    // Playback is started inline and moved away from the start, so that a handoff which reloads or rewinds the item is caught
+    UIWindow *window = [UIApplication sharedApplication].keyWindow;
+    ABMediaView *inlineView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 320, 180)];
+    inlineView.shouldDisplayFullscreen = NO;
+    inlineView.shouldHandoffMedia = YES;
+    [inlineView setVideoURL:ABTestVideoURL];
+    [window addSubview:inlineView];
+    
+    [inlineView handleTapFromRecognizer];
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+    
+    while (inlineView.timeToFirstFrame == 0 && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.02]];
+    }
+    
+    XCTAssert(inlineView.timeToFirstFrame > 0, "inline mediaView should play");
+    
+    __block BOOL seeked = NO;
+    [inlineView.player pause];
+    [inlineView.player seekToTime:CMTimeMakeWithSeconds(5, 600) toleranceBefore:kCMTimeZero toleranceAfter:kCMTimeZero completionHandler:^(BOOL finished) {
+        seeked = finished;
+    }];
+    
+    timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    
+    while (!seeked && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.02]];
+    }
+    
+    XCTAssertTrue(seeked);
+    
+    AVPlayerItem *inlineItem = inlineView.player.currentItem;
+    NSTimeInterval inlineTime = CMTimeGetSeconds(inlineView.player.currentTime);
+    XCTAssertEqualWithAccuracy(inlineTime, 5, 0.1);
+    
+    inlineView.shouldDisplayFullscreen = YES;
+    [inlineView handleTapFromRecognizer];
+    
+    ABMediaView *presentedView = nil;
+    timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    
+    while ((presentedView == nil || presentedView.player == nil) && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.02]];
+        presentedView = [[ABMediaView sharedManager] currentMediaView];
+    }
+    
+    // The fullscreen mediaView continues the same item from the same time, and the inline mediaView stops loading it
+    XCTAssertEqual(presentedView.player.currentItem, inlineItem, "the handed off player should keep its item");
+    XCTAssertEqualWithAccuracy(CMTimeGetSeconds(presentedView.player.currentTime), inlineTime, 0.1, "the handed off player should keep its playhead");
+    XCTAssertNil(inlineView.player);
+    XCTAssertFalse(inlineView.isLoadingVideo, "the inline mediaView should not show loading for a player it gave away");
+    XCTAssertFalse(inlineView.animateTimer.isValid);
+    
+    seeked = NO;
+    [presentedView.player pause];
+    [presentedView.player seekToTime:CMTimeMakeWithSeconds(8, 600) toleranceBefore:kCMTimeZero toleranceAfter:kCMTimeZero completionHandler:^(BOOL finished) {
+        seeked = finished;
+    }];
+    
+    timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    
+    while (!seeked && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.02]];
+    }
+    
+    XCTAssertTrue(seeked);
+    
+    AVPlayerItem *presentedItem = presentedView.player.currentItem;
+    NSTimeInterval presentedTime = CMTimeGetSeconds(presentedView.player.currentTime);
+    
+    [presentedView dismissMediaViewAnimated:NO withCompletion:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    
+    // Returning the player keeps the item and the playhead reached while fullscreen
+    XCTAssertEqual(presentedItem, inlineItem);
+    XCTAssertEqual(inlineView.player.currentItem, presentedItem, "the returned player should keep its item");
+    XCTAssertEqualWithAccuracy(CMTimeGetSeconds(inlineView.player.currentTime), presentedTime, 0.1, "the returned player should keep its playhead");
+    XCTAssertNil(presentedView.player);
+    
+    [inlineView resetMediaInView];
+    [inlineView removeFromSuperview];
+}
+
+
+- (void)testMediaBuffersScaleWithAssets {
+    ABMediaBufferPool *pool = [ABMediaBufferPool sharedManager];
+    NSUInteger baselineBufferCount = pool.bufferCount;
+    NSUInteger baselineByteCount = pool.residentByteCount;
+    uint64_t baselineFootprint = ABTestMemoryFootprint();
+    
+    NSUInteger assetCount = 50;
+    NSUInteger viewCount = 500;
+    NSMutableArray<NSData *> *assets = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < assetCount; i++) {
+        [assets addObject:ABTestGIFData(i, 4)];
+    }
+    
+    uint64_t footprint = 0;
+    NSUInteger naiveByteCount = 0;
+    NSUInteger uniqueByteCount = 0;
+    
+    @autoreleasepool {
+        NSMutableArray<ABMediaView *> *views = [[NSMutableArray alloc] init];
+        
+        for (NSUInteger i = 0; i < viewCount; i++) {
+            ABMediaView *mediaView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 64, 64)];
+            
+            // Every view is given its own copy of the bytes, as it would be when each cell downloads them
+            NSData *asset = assets[i % assetCount];
+            [mediaView setGifData:[NSData dataWithBytes:asset.bytes length:asset.length]];
+            [views addObject:mediaView];
+        }
+        
+        NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+        
+        while ([timeout timeIntervalSinceNow] > 0 && [views indexOfObjectPassingTest:^BOOL(ABMediaView *obj, NSUInteger idx, BOOL *stop) {
+            return [ABCommons isNull:obj.gifCache];
+        }] != NSNotFound) {
+            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+        }
+        
+        footprint = ABTestMemoryFootprint();
+        
+        for (NSUInteger i = 0; i < viewCount; i++) {
+            ABMediaBuffer *buffer = [pool bufferForData:assets[i % assetCount]];
+            
+            XCTAssertNotNil(views[i].gifCache);
+            XCTAssertEqual(views[i].gifCache, buffer.image, "views showing the same asset should share its decoded frames");
+            XCTAssertEqual(views[i].gifData, buffer.data, "views showing the same asset should share its bytes");
+            
+            naiveByteCount += buffer.byteCount;
+            
+            if (i < assetCount) {
+                uniqueByteCount += buffer.byteCount;
+            }
+        }
+        
+        XCTAssertEqual(pool.bufferCount - baselineBufferCount, assetCount);
+        XCTAssertEqual(pool.residentByteCount - baselineByteCount, uniqueByteCount);
+        
+        [views removeAllObjects];
+    }
+    
+    NSLog(@"Media buffers - %lu views over %lu assets: %.2fMB resident (%.2fMB if held per view), footprint +%.2fMB",
+          (unsigned long)viewCount, (unsigned long)assetCount, uniqueByteCount / 1048576.0, naiveByteCount / 1048576.0,
+          (double)(footprint - MIN(footprint, baselineFootprint)) / 1048576.0);
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    XCTAssertEqual(pool.bufferCount, baselineBufferCount, "buffers should be freed with their last holder");
+    XCTAssertEqual(pool.residentByteCount, baselineByteCount);
+    
+    // Images in the cache are held as buffers, and read back as the same image
+    UIImage *image = [UIImage animatedImageWithAnimatedGIFData:assets[0]];
+    [ABCacheManager setCache:GIFCache object:image forKey:@"buffer-test"];
+    
+    XCTAssertEqual([ABCacheManager getCache:GIFCache objectForKey:@"buffer-test"], image);
+    XCTAssertEqual([[ABCacheManager sharedManager] getBuffer:GIFCache forKey:@"buffer-test"].byteCount, [ABMediaBuffer decodedByteCountOfImage:image]);
+    
+    [[ABCacheManager sharedManager] removeCache:GIFCache forKey:@"buffer-test"];
+}
+
+
+- (void)testMP4ParserReadsMoovAtStartAndEnd {
+    
+    for (int moovAtEnd = 0; moovAtEnd < 2; moovAtEnd++) {
+        
+        for (int rotated = 0; rotated < 2; rotated++) {
+            ABTestBytes file = ABTestMP4(300, 4096, moovAtEnd, rotated);
+            
+            for (int knownLength = 0; knownLength < 2; knownLength++) {
+                ABMP4Metadata metadata;
+                NSUInteger windowCount = 0;
+                
+                XCTAssertEqual(ABTestProbeMP4(file.bytes, file.length, 64, knownLength, &metadata, &windowCount), ABMP4StatusOK);
+                XCTAssertEqualWithAccuracy(ABMP4MetadataDuration(&metadata), 300 * 1001 / 30000.0, 0.01);
+                XCTAssertEqual(metadata.trackCount, 2);
+                
+                const ABMP4Track *video = ABMP4MetadataTrack(&metadata, ABMP4FourCC('v', 'i', 'd', 'e'));
+                const ABMP4Track *audio = ABMP4MetadataTrack(&metadata, ABMP4FourCC('s', 'o', 'u', 'n'));
+                
+                XCTAssert(video != NULL && audio != NULL);
+                XCTAssertEqual(video->codec, ABMP4FourCC('a', 'v', 'c', '1'));
+                XCTAssertEqual(audio->codec, ABMP4FourCC('m', 'p', '4', 'a'));
+                XCTAssertEqual(video->width, rotated ? 720 : 1280, "rotated tracks should report their displayed size");
+                XCTAssertEqual(video->height, rotated ? 1280 : 720);
+                XCTAssertEqual(video->sampleCount, 300);
+                XCTAssertEqual(video->keyframeCount, 10);
+                
+                for (uint32_t i = 0; i < video->keyframeCount; i++) {
+                    XCTAssertEqualWithAccuracy(video->keyframeTimes[i], i * 30 * 1001 / 30000.0, 1e-9);
+                }
+                
+                XCTAssert(audio->keyframeTimes == NULL, "tracks without a sync sample table have no keyframe table");
+                
+                // A moov box at the end costs one more window, to step over the mdat box
+                XCTAssertEqual(windowCount, moovAtEnd ? 2 : 1);
+                
+                ABMP4MetadataFree(&metadata);
+            }
+            
+            free(file.bytes);
+        }
+        
+    }
+    
+}
+
+- (void)testMP4ParserAppliesCompositionOffsetsAndEdits {
+    
+    for (uint32_t emptyEditDuration = 0; emptyEditDuration <= 300; emptyEditDuration += 300) {
+        ABTestBytes file = ABTestReorderedMP4(300, 4096, 1, 0, 1, emptyEditDuration);
+        ABMP4Metadata metadata;
+        NSUInteger windowCount = 0;
+        
+        XCTAssertEqual(ABTestProbeMP4(file.bytes, file.length, 64, YES, &metadata, &windowCount), ABMP4StatusOK);
+        
+        // Keyframes are delayed by two frames, which the edit list cuts, so only the empty edit moves them
+        const ABMP4Track *video = ABMP4MetadataTrack(&metadata, ABMP4FourCC('v', 'i', 'd', 'e'));
+        XCTAssert(video != NULL);
+        XCTAssertEqual(video->keyframeCount, 10);
+        
+        for (uint32_t i = 0; i < video->keyframeCount; i++) {
+            XCTAssertEqualWithAccuracy(video->keyframeTimes[i], emptyEditDuration / 600.0 + i * 30 * 1001 / 30000.0, 1e-9, "keyframes should be in presentation time");
+        }
+        
+        ABMP4MetadataFree(&metadata);
+        free(file.bytes);
+    }
+    
+}
+
+- (void)testMP4ParserSurvivesCorruptFiles {
+    ABTestBytes files[2] = {ABTestMP4(120, 512, 0, 0), ABTestReorderedMP4(120, 512, 1, 1, 1, 300)};
+    NSUInteger parsedCount = 0;
+    
+    srand(7);
+    
+    for (NSUInteger iteration = 0; iteration < 50000; iteration++) {
+        ABTestBytes *source = &files[iteration % 2];
+        size_t length = source->length;
+        uint8_t *file = malloc(length);
+        memcpy(file, source->bytes, length);
+        
+        // Random bytes are overwritten, bits flipped, sizes saturated, or the file truncated
+        for (int mutation = 1 + rand() % 8; mutation > 0; mutation--) {
+            size_t position = rand() % length;
+            
+            switch (rand() % 4) {
+                case 0:
+                    file[position] = (uint8_t)rand();
+                    break;
+                case 1:
+                    file[position] ^= 1 << (rand() % 8);
+                    break;
+                case 2:
+                    file[position] = (rand() % 2) ? 0xFF : 0x00;
+                    break;
+                default:
+                    length = position + 1;
+                    break;
+            }
+        }
+        
+        ABMP4Metadata metadata;
+        NSUInteger windowCount = 0;
+        
+        if (ABTestProbeMP4(file, length, 1 + rand() % 256, rand() % 2, &metadata, &windowCount) == ABMP4StatusOK) {
+            parsedCount++;
+        }
+        
+        ABMP4MetadataFree(&metadata);
+        
+        ABMP4ParseMoov(file, length, &metadata);
+        ABMP4MetadataFree(&metadata);
+        
+        free(file);
+    }
+    
+    NSLog(@"MP4 fuzz - %lu of 50000 corrupted files still parsed", (unsigned long)parsedCount);
+    
+    free(files[0].bytes);
+    free(files[1].bytes);
+}
+
+- (void)testVideoMetadataProbesOnlyTheMoovBox {
+    ABTestBytes file = ABTestMP4(900, 4 * 1024 * 1024, 1, 0);
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ABMediaViewProbe.mp4"];
+    [[NSData dataWithBytesNoCopy:file.bytes length:file.length freeWhenDone:YES] writeToFile:path atomically:YES];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"probe"];
+    __block ABVideoMetadata *probed = nil;
+    
+    [ABVideoMetadata probeURL:[NSURL fileURLWithPath:path] completion:^(ABVideoMetadata *metadata, NSError *error) {
+        probed = metadata;
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+    
+    XCTAssertNotNil(probed);
+    XCTAssertEqualWithAccuracy(probed.duration, 900 * 1001 / 30000.0, 0.01);
+    XCTAssertTrue(CGSizeEqualToSize(probed.naturalSize, CGSizeMake(1280, 720)));
+    XCTAssertEqualObjects(probed.videoCodec, @"avc1");
+    XCTAssertEqualObjects(probed.audioCodec, @"mp4a");
+    XCTAssertEqualObjects(probed.majorBrand, @"isom");
+    XCTAssertEqual(probed.keyframeTimes.count, 30);
+    XCTAssert(probed.bytesRead < 256 * 1024, "only the box headers and the moov box should be read");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testScrubbingSnapsToKeyframes {
+    NSMutableArray *keyframeTimes = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < 10; i++) {
+        [keyframeTimes addObject:@(i * 2.0)];
+    }
+    
+    ABSeekCoalescer *coalescer = [[ABSeekCoalescer alloc] init];
+    coalescer.keyframeTimes = keyframeTimes;
+    
+    NSMutableArray *seekedTimes = [[NSMutableArray alloc] init];
+    coalescer.seekHandler = ^(CMTime time, CMTime toleranceBefore, CMTime toleranceAfter, void (^completion)(BOOL finished)) {
+        [seekedTimes addObject:@(CMTimeGetSeconds(time))];
+        completion(YES);
+    };
+    
+    // A slow scrub across the first 6 seconds, in 50ms steps
+    for (NSTimeInterval time = 0; time < 6.0; time += 0.05) {
+        [coalescer seekToTime:time exact:NO];
+    }
+    
+    XCTAssertEqualObjects(seekedTimes, (@[@0, @2, @4, @6]), "a loose seek should only be performed when the nearest keyframe changes");
+    
+    [coalescer seekToTime:5.5 exact:YES];
+    
+    XCTAssertEqualWithAccuracy([seekedTimes.lastObject doubleValue], 5.5, 0.01, "exact seeks should not snap");
+}
+
+- (void)testAnimationClockSkipsLateFrames {
+    ABAnimationClock *clock = [[ABAnimationClock alloc] init];
+    NSMutableArray<UIImage *> *frames = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < 8; i++) {
+        UIGraphicsBeginImageContextWithOptions(CGSizeMake(4, 4), YES, 1.0);
+        [[UIColor colorWithWhite:i / 8.0 alpha:1.0] setFill];
+        UIRectFill(CGRectMake(0, 0, 4, 4));
+        [frames addObject:UIGraphicsGetImageFromCurrentImageContext()];
+        UIGraphicsEndImageContext();
+    }
+    
+    // Eight frames of 0.125 seconds, so that every tick time below is exact
+    ABTestAnimationTarget *target = [[ABTestAnimationTarget alloc] init];
+    target.image = [UIImage animatedImageWithImages:frames duration:1.0];
+    
+    ABTestAnimationTarget *hiddenTarget = [[ABTestAnimationTarget alloc] init];
+    hiddenTarget.image = target.image;
+    hiddenTarget.visible = NO;
+    
+    [clock addTarget:target];
+    [clock addTarget:hiddenTarget];
+    XCTAssertEqual(clock.targetCount, 2);
+    
+    [clock tickAtTime:100.0];
+    [clock tickAtTime:100.0625];
+    [clock tickAtTime:100.125];
+    
+    NSArray *expected = @[frames[0], frames[1]];
+    XCTAssertEqualObjects(target.displayedFrames, expected);
+    XCTAssertEqual(clock.skippedFrameCount, 0);
+    
+    // A late tick jumps straight to the frame which is due
+    [clock tickAtTime:100.5625];
+    XCTAssertEqual(target.displayedFrames.lastObject, frames[4]);
+    XCTAssertEqual(target.displayedFrames.count, 3);
+    XCTAssertEqual(clock.skippedFrameCount, 2);
+    
+    [clock tickAtTime:101.0625];
+    XCTAssertEqual(target.displayedFrames.lastObject, frames[0], "the animation should loop");
+    XCTAssertEqual(clock.skippedFrameCount, 5);
+    
+    XCTAssertEqual(hiddenTarget.displayedFrames.count, 0, "targets which are not visible should not be advanced");
+    XCTAssertEqual(clock.visibleTargetCount, 1);
+    
+    // A target which becomes visible shows the frame which is due, without counting the frames it missed
+    hiddenTarget.visible = YES;
+    [clock tickAtTime:101.375];
+    XCTAssertEqual(hiddenTarget.displayedFrames.count, 1);
+    XCTAssertEqual(clock.skippedFrameCount, 7);
+    XCTAssertEqual(clock.tickCount, 6);
+    
+    // Only paused targets give up their frames, and get them back once they are visible
+    hiddenTarget.visible = NO;
+    [clock releasePausedFrames];
+    
+    XCTAssertEqual(target.releaseCount, 0);
+    XCTAssertEqual(hiddenTarget.releaseCount, 1);
+    XCTAssertNil(hiddenTarget.image);
+    
+    hiddenTarget.visible = YES;
+    [clock tickAtTime:101.5];
+    XCTAssertEqual(hiddenTarget.restoreCount, 1);
+    
+    [clock removeTarget:target];
+    [clock removeTarget:hiddenTarget];
+    XCTAssertEqual(clock.targetCount, 0);
+    
+    // Frames repeated to hold them for their delay are only shown once
+    ABTestAnimationTarget *heldTarget = [[ABTestAnimationTarget alloc] init];
+    heldTarget.image = [UIImage animatedImageWithImages:@[frames[0], frames[0], frames[1]] duration:0.375];
+    [clock addTarget:heldTarget];
+    [clock resetStatistics];
+    
+    [clock tickAtTime:200.0];
+    [clock tickAtTime:200.125];
+    [clock tickAtTime:200.25];
+    
+    expected = @[frames[0], frames[1]];
+    XCTAssertEqualObjects(heldTarget.displayedFrames, expected);
+    XCTAssertEqual(clock.displayedFrameCount, 2);
+    XCTAssertEqual(clock.skippedFrameCount, 0);
+    
+    [clock removeTarget:heldTarget];
+}
+
+- (void)testAnimationClockWithGIFFeed {
+    NSUInteger cellCount = 50;
+    CGFloat cellHeight = 120.0f;
+    ABAnimationClock *clock = [ABAnimationClock sharedManager];
+    ABMediaBufferPool *pool = [ABMediaBufferPool sharedManager];
+    
+    UIWindow *window = [[UIWindow alloc] initWithFrame:[UIScreen mainScreen].bounds];
+    UIScrollView *feed = [[UIScrollView alloc] initWithFrame:window.bounds];
+    feed.contentSize = CGSizeMake(window.bounds.size.width, cellCount * cellHeight);
+    [window addSubview:feed];
+    window.hidden = NO;
+    
+    NSMutableArray<NSData *> *assets = [[NSMutableArray alloc] init];
+    NSMutableArray<ABMediaView *> *cells = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < cellCount; i++) {
+        [assets addObject:ABTestGIFData(i, 8)];
+        
+        ABMediaView *mediaView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, i * cellHeight, window.bounds.size.width, cellHeight)];
+        [feed addSubview:mediaView];
+        [cells addObject:mediaView];
+    }
+    
+    // Measures the feed for a few seconds, scrolling a screen down halfway through
+    NSDictionary *(^measureFeed)(void) = ^{
+        [clock resetStatistics];
+        [feed setContentOffset:CGPointZero];
+        
+        double cpuStart = ABTestCPUTime();
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.5]];
+        [feed setContentOffset:CGPointMake(0, window.bounds.size.height)];
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.5]];
+        
+        return @{@"cpu" : @(ABTestCPUTime() - cpuStart),
+                 @"frames" : @(clock.displayedFrameCount),
+                 @"skipped" : @(clock.skippedFrameCount),
+                 @"tick" : @(clock.tickDuration),
+                 @"footprint" : @(ABTestMemoryFootprint())};
+    };
+    
+    void (^loadFeed)(void) = ^{
+        
+        for (NSUInteger i = 0; i < cellCount; i++) {
+            [cells[i] resetMediaInView];
+            [cells[i] setGifData:assets[i]];
+        }
+        
+        NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+        
+        while ([timeout timeIntervalSinceNow] > 0 && [cells indexOfObjectPassingTest:^BOOL(ABMediaView *obj, NSUInteger idx, BOOL *stop) {
+            return [ABCommons isNull:obj.gifCache];
+        }] != NSNotFound) {
+            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+        }
+    };
+    
+    // Every GIF animating on its own, as UIKit does it
+    [[ABMediaView sharedManager] setShouldUseSharedAnimationClock:NO];
+    loadFeed();
+    NSDictionary *unpaced = measureFeed();
+    
+    // Every GIF paced by the shared clock
+    [[ABMediaView sharedManager] setShouldUseSharedAnimationClock:YES];
+    loadFeed();
+    NSDictionary *paced = measureFeed();
+    
+    XCTAssertEqual(clock.targetCount, cellCount);
+    XCTAssert(clock.visibleTargetCount > 0 && clock.visibleTargetCount < cellCount, "only the cells on screen should be advanced");
+    XCTAssert([paced[@"frames"] unsignedIntegerValue] > 0);
+    
+    // Cells which never came on screen are still on their first frame, while their image is still the animated image which was set
+    ABMediaView *offscreenCell = cells.lastObject;
+    XCTAssertEqual(offscreenCell.displayedImage, offscreenCell.animatedImage.images.firstObject);
+    XCTAssertEqual(offscreenCell.image, offscreenCell.animatedImage, "image should return the animated image, not the frame on screen");
+    XCTAssertEqual(offscreenCell.image, offscreenCell.gifCache);
+    
+    // Memory pressure releases the frames of the paused cells, but not of the cells on screen
+    NSUInteger residentBytes = pool.residentByteCount;
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    NSUInteger releasedBytes = residentBytes - MIN(residentBytes, pool.residentByteCount);
+    
+    XCTAssertNil(offscreenCell.animatedImage);
+    XCTAssertNotNil(offscreenCell.displayedImage, "the frame on screen should be kept");
+    XCTAssertNotNil(cells[(NSUInteger)(window.bounds.size.height / cellHeight) + 1].animatedImage);
+    XCTAssert(releasedBytes > 0);
+    
+    // Scrolling a released cell back on screen decodes its frames again
+    [feed setContentOffset:CGPointMake(0, feed.contentSize.height - window.bounds.size.height)];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    XCTAssertNotNil(offscreenCell.animatedImage);
+    
+    // Compositing itself happens out of process, so the frames handed to Core Animation are logged as its workload
+    NSLog(@"Animation clock - %lu GIF cells: unpaced %.3fs CPU, footprint %.2fMB; paced %.3fs CPU (%.3fs in ticks), %@ frames shown, %@ skipped, footprint %.2fMB; memory warning released %.2fMB",
+          (unsigned long)cellCount, [unpaced[@"cpu"] doubleValue], [unpaced[@"footprint"] doubleValue] / 1048576.0,
+          [paced[@"cpu"] doubleValue], [paced[@"tick"] doubleValue], paced[@"frames"], paced[@"skipped"],
+          [paced[@"footprint"] doubleValue] / 1048576.0, releasedBytes / 1048576.0);
+    
+    for (ABMediaView *mediaView in cells) {
+        [mediaView resetMediaInView];
+    }
+    
+    window.hidden = YES;
+}
+
+
+- (void)testWaveformReduceMatchesScalar {
+    float samples[520];
+    
+    srand(11);
+    
+    // Runs of every length and alignment, so that the four-lane loop and its remainder are both checked
+    for (NSUInteger iteration = 0; iteration < 20000; iteration++) {
+        size_t offset = rand() % 8;
+        size_t count = 1 + rand() % 512;
+        
+        for (size_t i = 0; i < offset + count; i++) {
+            samples[i] = ((rand() % 65536) - 32768) / 32768.0f;
+        }
+        
+        float min, max, sumOfSquares;
+        ABWaveformReduce(samples + offset, count, &min, &max, &sumOfSquares);
+        
+        float expectedMin = samples[offset];
+        float expectedMax = samples[offset];
+        double expectedSumOfSquares = 0;
+        
+        for (size_t i = offset; i < offset + count; i++) {
+            expectedMin = MIN(expectedMin, samples[i]);
+            expectedMax = MAX(expectedMax, samples[i]);
+            expectedSumOfSquares += (double)samples[i] * samples[i];
+        }
+        
+        XCTAssertEqual(min, expectedMin);
+        XCTAssertEqual(max, expectedMax);
+        XCTAssertEqualWithAccuracy(sumOfSquares, expectedSumOfSquares, 1e-4 * (expectedSumOfSquares + 1));
+    }
+    
+}
+
+- (void)testWaveformPyramidLevelsAgree {
+    size_t frameCount = 1000003;
+    int16_t *frames = ABTestPCM(frameCount, 2);
+    float *samples = malloc(frameCount * sizeof(float));
+    ABWaveformMixInt16(frames, frameCount, 2, samples);
+    
+    // Samples arrive in uneven chunks, as they do from a decoder
+    ABWaveformBuilder builder;
+    ABWaveformBuilderInit(&builder, 256, 4);
+    
+    for (size_t position = 0; position < frameCount;) {
+        size_t count = MIN(frameCount - position, (size_t)(1 + rand() % 5000));
+        XCTAssertEqual(ABWaveformBuilderAppendInt16(&builder, frames + position * 2, count, 2), ABWaveformStatusOK);
+        position += count;
+    }
+    
+    ABWaveformPyramid pyramid;
+    XCTAssertEqual(ABWaveformBuilderFinish(&builder, 44100, 4 * frameCount, 0, &pyramid), ABWaveformStatusOK);
+    XCTAssertEqual(pyramid.sampleCount, frameCount);
+    XCTAssertEqual(pyramid.levels[pyramid.levelCount - 1].bucketCount, 1);
+    
+    // Every bucket of every level summarizes exactly the samples it covers
+    for (uint32_t level = 0; level < pyramid.levelCount; level++) {
+        const ABWaveformLevel *summary = &pyramid.levels[level];
+        XCTAssertEqual(summary->bucketCount, (frameCount + summary->samplesPerBucket - 1) / summary->samplesPerBucket);
+        
+        for (uint32_t bucket = 0; bucket < summary->bucketCount; bucket += (level == 0) ? 97 : 1) {
+            size_t start = (size_t)bucket * summary->samplesPerBucket;
+            size_t count = MIN((size_t)summary->samplesPerBucket, frameCount - start);
+            float min, max, sumOfSquares;
+            ABWaveformReduce(samples + start, count, &min, &max, &sumOfSquares);
+            
+            XCTAssertEqual(summary->buckets[bucket].min, min);
+            XCTAssertEqual(summary->buckets[bucket].max, max);
+            XCTAssertEqualWithAccuracy(summary->buckets[bucket].rms, sqrtf(sumOfSquares / count), 1e-4);
+        }
+    }
+    
+    // Peaks for a track are read from a coarse level, which still has a bucket for every bar
+    float min[300], max[300];
+    uint32_t level = ABWaveformPyramidPeaks(&pyramid, 0, frameCount, 300, min, max, NULL);
+    XCTAssertGreaterThan(level, 0);
+    XCTAssertGreaterThanOrEqual(pyramid.levels[level].bucketCount, 300);
+    
+    for (int bar = 0; bar < 300; bar++) {
+        XCTAssertLessThanOrEqual(min[bar], max[bar]);
+    }
+    
+    ABWaveformPyramidFree(&pyramid);
+    free(samples);
+    free(frames);
+}
+
+- (void)testWaveformSummaryRoundTripsAndRejectsCorruption {
+    size_t frameCount = 200000;
+    int16_t *frames = ABTestPCM(frameCount, 1);
+    
+    ABWaveformBuilder builder;
+    ABWaveformBuilderInit(&builder, 256, 4);
+    ABWaveformBuilderAppendInt16(&builder, frames, frameCount, 1);
+    
+    ABWaveformPyramid pyramid;
+    XCTAssertEqual(ABWaveformBuilderFinish(&builder, 22050, 12345, 1500000000123456, &pyramid), ABWaveformStatusOK);
+    
+    size_t length = ABWaveformEncodedLength(&pyramid);
+    uint8_t *bytes = malloc(length);
+    XCTAssertEqual(ABWaveformEncode(&pyramid, bytes, length), length);
+    XCTAssertEqual(ABWaveformEncode(&pyramid, bytes, length - 1), 0);
+    
+    ABWaveformPyramid decoded;
+    XCTAssertEqual(ABWaveformDecode(bytes, length, &decoded), ABWaveformStatusOK);
+    XCTAssertEqual(decoded.sampleRate, 22050);
+    XCTAssertEqual(decoded.sampleCount, frameCount);
+    XCTAssertEqual(decoded.sourceLength, 12345);
+    XCTAssertEqual(decoded.sourceModificationTime, 1500000000123456);
+    XCTAssertEqual(decoded.levelCount, pyramid.levelCount);
+    
+    for (uint32_t level = 0; level < pyramid.levelCount; level++) {
+        XCTAssertEqual(memcmp(decoded.levels[level].buckets, pyramid.levels[level].buckets, pyramid.levels[level].bucketCount * sizeof(ABWaveformBucket)), 0);
+    }
+    
+    ABWaveformPyramidFree(&decoded);
+    
+    // Any flipped bit or truncation is caught by the checksum or the sizes, rather than drawn
+    uint8_t *corrupted = malloc(length);
+    srand(13);
+    
+    for (NSUInteger iteration = 0; iteration < 50000; iteration++) {
+        memcpy(corrupted, bytes, length);
+        size_t corruptedLength = length;
+        
+        if (iteration % 2) {
+            corrupted[rand() % length] ^= 1 << (rand() % 8);
+        } else {
+            corruptedLength = rand() % length;
+        }
+        
+        XCTAssertNotEqual(ABWaveformDecode(corrupted, corruptedLength, &decoded), ABWaveformStatusOK);
+        ABWaveformPyramidFree(&decoded);
+    }
+    
+    // The Objective-C wrapper reads the same format
+    NSData *data = [NSData dataWithBytes:bytes length:length];
+    ABAudioWaveform *waveform = [ABAudioWaveform waveformWithSummaryData:data fileURL:[NSURL fileURLWithPath:@"/tmp/audio.m4a"]];
+    XCTAssertNotNil(waveform);
+    XCTAssertEqualWithAccuracy(waveform.duration, frameCount / 22050.0, 1e-9);
+    XCTAssertEqualObjects(waveform.summaryData, data);
+    XCTAssertEqualObjects([ABAudioWaveform summaryURLForFileURL:waveform.fileURL].lastPathComponent, @"audio.m4a.abwaveform");
+    XCTAssertNil([ABAudioWaveform waveformWithSummaryData:[data subdataWithRange:NSMakeRange(0, length / 2)] fileURL:waveform.fileURL]);
+    
+    free(corrupted);
+    free(bytes);
+    ABWaveformPyramidFree(&pyramid);
+    free(frames);
+}
+
+- (void)testAudioWaveformRebuildsReplacedFile {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ABMediaViewWaveform.wav"];
+    NSURL *fileURL = [NSURL fileURLWithPath:path];
+    size_t frameCount = 22050;
+    
+    [[NSFileManager defaultManager] removeItemAtURL:[ABAudioWaveform summaryURLForFileURL:fileURL] error:nil];
+    
+    // One second of mono 16-bit WAV, first loud and then silent, so that both files have the same length
+    for (int silent = 0; silent < 2; silent++) {
+        int16_t *frames = ABTestPCM(frameCount, 1);
+        
+        if (silent) {
+            memset(frames, 0, frameCount * sizeof(int16_t));
+        }
+        
+        // PCM format, 1 channel at 22050Hz, 2 bytes per frame of 16 bits
+        uint32_t dataLength = (uint32_t)(frameCount * sizeof(int16_t));
+        uint32_t riffLength = CFSwapInt32HostToLittle(36 + dataLength);
+        uint32_t format[4] = {CFSwapInt32HostToLittle(16), CFSwapInt32HostToLittle(1 | (1 << 16)), CFSwapInt32HostToLittle(22050), CFSwapInt32HostToLittle(22050 * 2)};
+        uint32_t frameLayout = CFSwapInt32HostToLittle(2 | (16 << 16));
+        uint32_t littleDataLength = CFSwapInt32HostToLittle(dataLength);
+        
+        NSMutableData *file = [NSMutableData dataWithBytes:"RIFF" length:4];
+        [file appendBytes:&riffLength length:4];
+        [file appendBytes:"WAVEfmt " length:8];
+        [file appendBytes:format length:sizeof(format)];
+        [file appendBytes:&frameLayout length:4];
+        [file appendBytes:"data" length:4];
+        [file appendBytes:&littleDataLength length:4];
+        [file appendBytes:frames length:dataLength];
+        XCTAssert([file writeToURL:fileURL atomically:YES]);
+        free(frames);
+        
+        // The replaced file is given a later modification date, as a file downloaded again would have
+        NSDate *modificationDate = [NSDate dateWithTimeIntervalSinceNow:silent ? 0 : -60];
+        [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate : modificationDate} ofItemAtPath:path error:nil];
+        
+        NSError *error = nil;
+        ABAudioWaveform *waveform = [ABAudioWaveform waveformForFileURL:fileURL error:&error];
+        XCTAssertNotNil(waveform, @"%@", error);
+        
+        float max = 0;
+        [waveform getPeaksFromTime:0 toTime:waveform.duration count:1 min:NULL max:&max rms:NULL];
+        
+        if (silent) {
+            XCTAssertEqual(max, 0, "a summary of a replaced file of the same length should not be reused");
+        } else {
+            XCTAssertGreaterThan(max, 0.1);
+        }
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtURL:[ABAudioWaveform summaryURLForFileURL:fileURL] error:nil];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testWaveformCacheHoldsWaveformsFromInit {
+    ABCacheManager *cache = [[ABCacheManager alloc] init];
+    NSObject *waveform = [[NSObject alloc] init];
+    
+    // Waveforms are cached as soon as the manager exists, so summaries are not read again on every request
+    [cache setCache:WaveformCache object:waveform forKey:@"waveform-test"];
+    XCTAssertEqual([cache getCache:WaveformCache objectForKey:@"waveform-test"], waveform);
+    
+    [cache removeCache:WaveformCache forKey:@"waveform-test"];
+    XCTAssertNil([cache getCache:WaveformCache objectForKey:@"waveform-test"]);
+}
 
+- (void)testWaveformSummaryPerformance {
+    // Ten minutes of stereo audio at 44.1kHz, as it comes out of the decoder
+    size_t frameCount = 10 * 60 * 44100;
+    int16_t *frames = ABTestPCM(frameCount, 2);
+    double megabytes = frameCount * 2 * sizeof(int16_t) / (1024.0 * 1024.0);
+    
+    CFTimeInterval start = CACurrentMediaTime();
+    ABWaveformBuilder builder;
+    ABWaveformBuilderInit(&builder, 256, 4);
+    
+    for (size_t position = 0; position < frameCount; position += 8192) {
+        ABWaveformBuilderAppendInt16(&builder, frames + position * 2, MIN((size_t)8192, frameCount - position), 2);
+    }
+    
+    ABWaveformPyramid pyramid;
+    XCTAssertEqual(ABWaveformBuilderFinish(&builder, 44100, 0, 0, &pyramid), ABWaveformStatusOK);
+    CFTimeInterval buildTime = CACurrentMediaTime() - start;
+    
+    size_t length = ABWaveformEncodedLength(&pyramid);
+    uint8_t *bytes = malloc(length);
+    
+    start = CACurrentMediaTime();
+    ABWaveformEncode(&pyramid, bytes, length);
+    CFTimeInterval encodeTime = CACurrentMediaTime() - start;
+    
+    ABWaveformPyramid decoded;
+    start = CACurrentMediaTime();
+    XCTAssertEqual(ABWaveformDecode(bytes, length, &decoded), ABWaveformStatusOK);
+    CFTimeInterval decodeTime = CACurrentMediaTime() - start;
+    
+    // Drawing a track only reads a few hundred buckets, however long the audio is
+    float max[400];
+    start = CACurrentMediaTime();
+    
+    for (int i = 0; i < 1000; i++) {
+        ABWaveformPyramidPeaks(&decoded, 0, frameCount, 400, NULL, max, NULL);
+    }
+    
+    CFTimeInterval peaksTime = (CACurrentMediaTime() - start) / 1000;
+    
+    NSLog(@"Waveform summary - %.1f MB of PCM in %.1f ms (%.0f MB/s), %u levels, %.2f MB stored, encoded in %.1f ms, decoded in %.1f ms, 400 peaks in %.1f us", megabytes, buildTime * 1000, megabytes / buildTime, pyramid.levelCount, length / (1024.0 * 1024.0), encodeTime * 1000, decodeTime * 1000, peaksTime * 1e6);
+    
+    ABWaveformPyramidFree(&decoded);
+    ABWaveformPyramidFree(&pyramid);
+    free(bytes);
+    free(frames);
+}
+
+
+/// Metrics of a portrait iPhone screen with a status bar, minimizing to half its width at 16:9
+- (ABGestureLayoutMetrics)portraitGestureMetrics {
+    ABGestureLayoutMetrics metrics;
+    metrics.screenSize = CGSizeMake(375, 667);
+    metrics.isLandscape = NO;
+    metrics.topBuffer = 20;
+    metrics.bottomBuffer = 44;
+    metrics.minimizedWidthRatio = 0.5f;
+    metrics.minimizedAspectRatio = 9.0f / 16.0f;
+    
+    return metrics;
+}
+
+- (void)testGestureLayoutMatchesPanGeometry {
+    ABGestureLayout *layout = [[ABGestureLayout alloc] initWithMetrics:[self portraitGestureMetrics]];
+    CGFloat width = 375, height = 667;
+    CGFloat minWidth = width * 0.5f, minHeight = minWidth * 9.0f / 16.0f;
+    CGFloat maxOffset = height - (minHeight + 12.0f + 44);
+    
+    XCTAssertEqualWithAccuracy(layout.maxViewOffset, maxOffset, 1e-4);
+    XCTAssert(CGRectEqualToRect(layout.minimizedFrame, CGRectMake(width - minWidth - 12.0f, maxOffset, minWidth, minHeight)));
+    
+    // Every offset of the drag, including past either end, matches shrinking the frame towards the bottom right corner
+    for (CGFloat offset = -200; offset < height + 200; offset += 3.7f) {
+        ABGestureLayoutState state = [layout minimizingStateAtOffset:offset];
+        CGFloat progress = MAX(0, MIN(1, offset / maxOffset));
+        CGFloat expectedWidth = width - progress * (width - minWidth);
+        CGFloat expectedHeight = height - progress * (height - minHeight);
+        
+        XCTAssertEqualWithAccuracy(state.progress, progress, 1e-4);
+        XCTAssertEqualWithAccuracy(state.offset, progress * maxOffset, 1e-3);
+        XCTAssertEqualWithAccuracy(state.frame.origin.x, width - expectedWidth - progress * 12.0f, 1e-3);
+        XCTAssertEqualWithAccuracy(state.frame.origin.y, progress * maxOffset, 1e-3);
+        XCTAssertEqualWithAccuracy(state.frame.size.width, expectedWidth, 1e-3);
+        XCTAssertEqualWithAccuracy(state.frame.size.height, expectedHeight, 1e-3);
+        XCTAssertEqualWithAccuracy(state.borderAlpha, progress, 1e-4);
+        XCTAssertEqualWithAccuracy(state.overlayAlpha, 1 - progress, 1e-4);
+    }
+    
+    XCTAssert(CGRectEqualToRect([layout minimizingStateAtOffset:maxOffset + 1].frame, layout.minimizedFrame));
+    XCTAssert(CGRectEqualToRect([layout minimizingStateAtOffset:-1].frame, layout.fullscreenFrame));
+    
+    // A minimized mediaView fades as it is dragged right, and leaves the screen once it has faded
+    CGFloat startX = width - minWidth - 12.0f;
+    
+    for (CGFloat originX = startX - 50; originX < width + 50; originX += 1.3f) {
+        ABGestureLayoutState state = [layout dismissingStateAtOriginX:originX];
+        CGFloat ratio = (originX - startX) / (minWidth - 12.0f);
+        
+        XCTAssertEqualWithAccuracy(state.frame.origin.y, maxOffset, 1e-3);
+        XCTAssertEqualWithAccuracy(state.frame.size.width, minWidth, 1e-3);
+        
+        if (ratio >= 1) {
+            XCTAssertEqual(state.frame.origin.x, width);
+            XCTAssertEqual(state.alpha, 0);
+        } else if (ratio < 0) {
+            XCTAssertEqualWithAccuracy(state.frame.origin.x, startX, 1e-3);
+            XCTAssertEqual(state.alpha, 1);
+        } else {
+            XCTAssertEqualWithAccuracy(state.frame.origin.x, originX, 1e-3);
+            XCTAssertEqualWithAccuracy(state.alpha, 1 - ratio, 1e-4);
+        }
+    }
+    
+    // Swiping to dismiss slides the fullscreen frame down without shrinking it
+    for (CGFloat offset = -100; offset < height + 100; offset += 5.1f) {
+        ABGestureLayoutState state = [layout swipeDismissingStateAtOffset:offset];
+        CGFloat progress = MAX(0, MIN(1, offset / height));
+        
+        XCTAssertEqualWithAccuracy(state.progress, progress, 1e-4);
+        XCTAssertEqualWithAccuracy(state.frame.origin.y, progress * height, 1e-3);
+        XCTAssertEqual(state.frame.size.width, width);
+        XCTAssertEqual(state.frame.size.height, height);
+    }
+    
+}
+
+- (void)testGestureLayoutOverlayMetrics {
+    ABGestureLayoutMetrics metrics = [self portraitGestureMetrics];
+    ABGestureLayout *portrait = [[ABGestureLayout alloc] initWithMetrics:metrics];
+    
+    XCTAssertEqual([portrait titleTopOffsetWithDetails:YES], 28.0f);
+    XCTAssertEqual([portrait titleTopOffsetWithDetails:NO], 36.0f);
+    XCTAssertEqual(portrait.detailsTopOffset, 46.0f);
+    XCTAssertEqual(portrait.topOverlayHeight, 70.0f);
+    XCTAssert(CGPointEqualToPoint(portrait.closeButtonOrigin, CGPointMake(0, 20)));
+    XCTAssertEqualWithAccuracy([portrait playIndicatorSizeForViewSize:CGSizeMake(375, 667)], 60.0f, 1e-4);
+    
+    // The status bar is hidden in landscape, so the top buffer is dropped, and the play indicator follows the height of the view
+    metrics.isLandscape = YES;
+    metrics.screenSize = CGSizeMake(667, 375);
+    ABGestureLayout *landscape = [[ABGestureLayout alloc] initWithMetrics:metrics];
+    
+    XCTAssertEqual(landscape.superviewWidth, portrait.superviewWidth, "the short side of the screen is used in either orientation");
+    XCTAssertEqual([landscape titleTopOffsetWithDetails:YES], 8.0f);
+    XCTAssertEqual(landscape.topOverlayHeight, 50.0f);
+    XCTAssert(CGPointEqualToPoint(landscape.closeButtonOrigin, CGPointZero));
+    XCTAssertEqualWithAccuracy([landscape playIndicatorSizeForViewSize:CGSizeMake(667, 375)], 60.0f, 1e-4);
+    
+    // A layout is only rebuilt when a metric changes
+    XCTAssertTrue(ABGestureLayoutMetricsEqual(portrait.metrics, [self portraitGestureMetrics]));
+    XCTAssertFalse(ABGestureLayoutMetricsEqual(portrait.metrics, landscape.metrics));
+    
+    metrics = [self portraitGestureMetrics];
+    metrics.bottomBuffer = 0;
+    XCTAssertFalse(ABGestureLayoutMetricsEqual(portrait.metrics, metrics));
+}
+
+- (void)testGestureLayoutPerEventCost {
+    ABGestureLayout *layout = [[ABGestureLayout alloc] initWithMetrics:[self portraitGestureMetrics]];
+    NSUInteger eventCount = 1000000;
+    CGFloat checksum = 0;
+    
+    // Interpolating the precomputed layout
+    CFTimeInterval start = CACurrentMediaTime();
+    
+    for (NSUInteger event = 0; event < eventCount; event++) {
+        ABGestureLayoutState state = [layout minimizingStateAtOffset:(event % 700)];
+        checksum += state.frame.size.width;
+    }
+    
+    CFTimeInterval layoutTime = (CACurrentMediaTime() - start) / eventCount;
+    
+    // Querying the screen and orientation and recomputing the minimized size on every event, as the gestures did before
+    start = CACurrentMediaTime();
+    
+    for (NSUInteger event = 0; event < eventCount; event++) {
+        CGRect screenRect = [[UIScreen mainScreen] bounds];
+        CGFloat width = MIN(screenRect.size.width, screenRect.size.height);
+        CGFloat height = MAX(screenRect.size.width, screenRect.size.height);
+        CGFloat minWidth = width * 0.5f;
+        CGFloat minHeight = minWidth * 9.0f / 16.0f;
+        CGFloat maxOffset = height - (minHeight + 12.0f + 44);
+        CGFloat progress = MAX(0, MIN(1, (event % 700) / maxOffset));
+        
+        if ([ABCommons isLandscape]) {
+            progress = 0;
+        }
+        
+        checksum += width - progress * (width - minWidth);
+    }
+    
+    CFTimeInterval recomputedTime = (CACurrentMediaTime() - start) / eventCount;
+    
+    // Applying each state to a fullscreen mediaView with a single layout pass
+    ABMediaView *mediaView = [[ABMediaView alloc] initWithFrame:layout.fullscreenFrame];
+    [mediaView setFullscreen:YES];
+    [mediaView setTitle:@"Title" withDetails:@"Details"];
+    [mediaView layoutIfNeeded];
+    
+    NSUInteger panCount = 2000;
+    start = CACurrentMediaTime();
+    
+    for (NSUInteger event = 0; event < panCount; event++) {
+        ABGestureLayoutState state = [layout minimizingStateAtOffset:(event % 700)];
+        
+        [UIView performWithoutAnimation:^{
+            mediaView.frame = state.frame;
+            [mediaView layoutIfNeeded];
+        }];
+    }
+    
+    CFTimeInterval panTime = (CACurrentMediaTime() - start) / panCount;
+    
+    XCTAssertGreaterThan(checksum, 0);
+    XCTAssertLessThan(layoutTime, recomputedTime, "interpolating should cost less than querying the screen");
+    
+    NSLog(@"Gesture layout - %.0f ns per event interpolated, %.0f ns recomputed from the screen, %.1f us per pan event with layout", layoutTime * 1e9, recomputedTime * 1e9, panTime * 1e6);
+}
+
+
+- (void)testTextNormalizationMatchesReference {
+    // Letters, punctuation, ASCII and Unicode whitespace, and an emoji made of a surrogate pair
+    NSArray<NSString *> *pieces = @[@" ", @" ", @"\n", @"\n", @"\t", @"\r", @"\u00A0", @"\u2028", @"a", @"Z", @"é", @"#", @"7", @"😀"];
+    srand(17);
+    
+    for (NSUInteger iteration = 0; iteration < 20000; iteration++) {
+        NSMutableString *text = [NSMutableString string];
+        
+        for (int i = rand() % 24; i > 0; i--) {
+            [text appendString:pieces[rand() % pieces.count]];
+        }
+        
+        NSString *trimmed = [text stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        
+        XCTAssertEqualObjects([ABCommons trimWhiteSpace:text], trimmed);
+        XCTAssertEqualObjects([ABCommons trimMultiSpace:text], ABTestReferenceTrimMultiSpace(text));
+        XCTAssertEqualObjects([ABCommons trimWhiteAndMultiSpace:text], ABTestReferenceTrimMultiSpace(trimmed));
+        XCTAssertEqualObjects([ABCommons removeSpaces:text], ABTestReferenceRemoveSpaces(text));
+        XCTAssertEqualObjects([ABCommons removeSpecialCharacters:text], ABTestReferenceRemoveSpecialCharacters(text));
+        XCTAssertEqual([ABCommons isValidEntry:text], ABTestReferenceRemoveSpaces(text).length > 0);
+    }
+    
+    XCTAssertNil([ABCommons trimWhiteAndMultiSpace:nil]);
+    XCTAssertFalse([ABCommons isValidEntry:nil]);
+    
+    // Clean titles are returned as they are, rather than copied
+    NSString *clean = @"Big Buck Bunny";
+    XCTAssertEqual([ABCommons trimWhiteAndMultiSpace:clean], clean);
+}
+
+- (void)testTextNormalizationPerformance {
+    NSMutableArray<NSString *> *corpus = [@[@"Big Buck Bunny",
+                                            @"  Sintel — the official trailer  ",
+                                            @"Tears of Steel\n\nBlender Foundation",
+                                            @"🔥🔥 Best plays of the week 🔥🔥",
+                                            @"Live from   the  studio:\n  Episode 12",
+                                            @"Cómo hacer pan en casa (receta fácil)",
+                                            @"#throwback #summer  #2017",
+                                            @"Q&A — your questions answered!!!",
+                                            @"\n\n\n   ",
+                                            @"Morning run\t|\t5km\t|\tPB"] mutableCopy];
+    
+    // User generated titles with pathological whitespace, where repeated replacement goes quadratic
+    NSMutableString *spaced = [NSMutableString string];
+    NSMutableString *broken = [NSMutableString string];
+    NSMutableString *mixed = [NSMutableString string];
+    
+    for (NSUInteger i = 0; i < 2000; i++) {
+        [spaced appendString:@"word                "];
+        [broken appendString:@"line\n\n\n\n\n\n\n\n"];
+        [mixed appendString:@"  \n \n  \n"];
+    }
+    
+    [corpus addObjectsFromArray:@[spaced, broken, mixed]];
+    
+    NSUInteger rounds = 20;
+    NSUInteger totalLength = 0;
+    CFTimeInterval start = CACurrentMediaTime();
+    
+    for (NSUInteger round = 0; round < rounds; round++) {
+        
+        for (NSString *title in corpus) {
+            totalLength += ABTestReferenceTrimMultiSpace([title stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]]).length;
+            totalLength += ABTestReferenceRemoveSpaces(title).length;
+        }
+        
+    }
+    
+    CFTimeInterval referenceTime = CACurrentMediaTime() - start;
+    NSUInteger normalizedLength = 0;
+    start = CACurrentMediaTime();
+    
+    for (NSUInteger round = 0; round < rounds; round++) {
+        
+        for (NSString *title in corpus) {
+            normalizedLength += [ABCommons trimWhiteAndMultiSpace:title].length;
+            normalizedLength += [ABCommons removeSpaces:title].length;
+        }
+        
+    }
+    
+    CFTimeInterval normalizedTime = CACurrentMediaTime() - start;
+    
+    XCTAssertEqual(normalizedLength, totalLength);
+    XCTAssertLessThan(normalizedTime, referenceTime);
+    
+    NSLog(@"Text normalization - %lu titles x %lu rounds in %.2f ms, %.2f ms by repeated replacement (%.1fx)", (unsigned long)corpus.count, (unsigned long)rounds, normalizedTime * 1000, referenceTime * 1000, referenceTime / normalizedTime);
+}
+
+- (void)testTextMeasurementCacheSharesSizes {
+    ABTextMeasurementCache *cache = [ABTextMeasurementCache sharedManager];
+    [cache resetCache];
+    
+    UIFont *font = [UIFont systemFontOfSize:14.0f];
+    NSString *title = @"Tears of Steel — Blender Foundation";
+    
+    ABLabel *label = [[ABLabel alloc] initWithFrame:CGRectMake(0, 0, 200, 18)];
+    label.font = font;
+    label.text = title;
+    
+    ABLabel *otherLabel = [[ABLabel alloc] initWithFrame:CGRectMake(0, 0, 300, 18)];
+    otherLabel.font = font;
+    otherLabel.text = title;
+    
+    CGSize size = label.intrinsicContentSize;
+    CGRect bounds = [title boundingRectWithSize:CGSizeMake(CGFLOAT_MAX, CGFLOAT_MAX) options:0 attributes:@{NSFontAttributeName : font} context:nil];
+    
+    XCTAssertEqual(size.width, ceil(bounds.size.width));
+    XCTAssertEqual(size.height, ceil(bounds.size.height));
+    XCTAssertEqual(cache.missCount, 1);
+    
+    // Another view showing the same title is measured from the cache, whatever its width
+    XCTAssert(CGSizeEqualToSize(otherLabel.intrinsicContentSize, size));
+    XCTAssert(CGSizeEqualToSize([otherLabel sizeThatFits:CGSizeMake(80, 100)], size), @"A single line is not wrapped");
+    XCTAssertEqual(cache.missCount, 1);
+    XCTAssertEqual(cache.hitCount, 2);
+    
+    // Wrapped text is measured per width, and limited to its number of lines
+    otherLabel.numberOfLines = 2;
+    CGSize wrapped = [otherLabel sizeThatFits:CGSizeMake(80, CGFLOAT_MAX)];
+    XCTAssertLessThanOrEqual(wrapped.width, 80);
+    XCTAssertEqualWithAccuracy(wrapped.height, ceil(font.lineHeight * 2), 1);
+    XCTAssertEqual(cache.missCount, 2);
+    
+    // Attributed text is left to UILabel
+    otherLabel.attributedText = [[NSAttributedString alloc] initWithString:title attributes:@{NSFontAttributeName : font}];
+    [otherLabel sizeThatFits:CGSizeMake(80, CGFLOAT_MAX)];
+    XCTAssertEqual(cache.missCount, 2);
+    
+    XCTAssert(CGSizeEqualToSize([cache sizeOfText:@"" font:font width:100 numberOfLines:1], CGSizeZero));
+    
+    // Measuring the overlay titles on every layout pass
+    NSUInteger passes = 10000;
+    CFTimeInterval start = CACurrentMediaTime();
+    
+    for (NSUInteger pass = 0; pass < passes; pass++) {
+        [title boundingRectWithSize:CGSizeMake(CGFLOAT_MAX, CGFLOAT_MAX) options:0 attributes:@{NSFontAttributeName : font} context:nil];
+    }
+    
+    CFTimeInterval measuredTime = (CACurrentMediaTime() - start) / passes;
+    start = CACurrentMediaTime();
+    
+    for (NSUInteger pass = 0; pass < passes; pass++) {
+        [label intrinsicContentSize];
+    }
+    
+    CFTimeInterval cachedTime = (CACurrentMediaTime() - start) / passes;
+    
+    XCTAssertLessThan(cachedTime, measuredTime);
+    
+    NSLog(@"Text measurement - %.2f us measured, %.2f us from the cache", measuredTime * 1e6, cachedTime * 1e6);
+    
+    [cache resetCache];
+}
+
+
+- (ABLoadTraceStageSummary *)summaryForStage:(ABLoadTraceStage)stage {
+    
+    for (ABLoadTraceStageSummary *summary in [ABLoadTrace stageSummaries]) {
+        
+        if (summary.stage == stage) {
+            return summary;
+        }
+        
+    }
+    
+    return nil;
+}
+
+- (void)testLoadTraceReportsStagePercentiles {
+    [ABLoadTrace reset];
+    
+    uint64_t start = ABLoadTraceNow();
+    uint64_t millisecond = NSEC_PER_MSEC;
+    
+    for (uint64_t i = 1; i <= 100; i++) {
+        uint64_t load = ABLoadTraceNewLoad();
+        
+        ABLoadTraceRecord(load, ABLoadTraceStageLoad, ABLoadTracePhaseBegin, start);
+        ABLoadTraceRecord(load, ABLoadTraceStageLoad, ABLoadTracePhaseEnd, start + i * millisecond);
+        
+        // A stage which runs twice in a load is matched first in, first out
+        ABLoadTraceRecord(load, ABLoadTraceStageMainQueueHop, ABLoadTracePhaseBegin, start);
+        ABLoadTraceRecord(load, ABLoadTraceStageMainQueueHop, ABLoadTracePhaseEnd, start + 1 * millisecond);
+        ABLoadTraceRecord(load, ABLoadTraceStageMainQueueHop, ABLoadTracePhaseBegin, start + 10 * millisecond);
+        ABLoadTraceRecord(load, ABLoadTraceStageMainQueueHop, ABLoadTracePhaseEnd, start + 13 * millisecond);
+    }
+    
+    uint64_t abandonedLoad = ABLoadTraceNewLoad();
+    ABLoadTraceRecord(abandonedLoad, ABLoadTraceStageLoad, ABLoadTracePhaseBegin, start);
+    ABLoadTraceRecord(abandonedLoad, ABLoadTraceStageLoad, ABLoadTracePhaseCancel, start + 5000 * millisecond);
+    
+    // Ends without a beginning, and loads which are not traced, are left out
+    ABLoadTraceRecord(ABLoadTraceNewLoad(), ABLoadTraceStageFileWrite, ABLoadTracePhaseEnd, start);
+    ABLoadTraceRecord(0, ABLoadTraceStageFileWrite, ABLoadTracePhaseBegin, start);
+    ABLoadTraceRecord(0, ABLoadTraceStageFileWrite, ABLoadTracePhaseEnd, start + millisecond);
+    
+    ABLoadTraceStageSummary *load = [self summaryForStage:ABLoadTraceStageLoad];
+    XCTAssertEqual(load.count, 100);
+    XCTAssertEqual(load.cancelledCount, 1);
+    XCTAssertEqualWithAccuracy(load.p50, 0.050, 1e-9);
+    XCTAssertEqualWithAccuracy(load.p95, 0.095, 1e-9);
+    XCTAssertEqualWithAccuracy(load.max, 0.100, 1e-9);
+    
+    ABLoadTraceStageSummary *hop = [self summaryForStage:ABLoadTraceStageMainQueueHop];
+    XCTAssertEqual(hop.count, 200);
+    XCTAssertEqualWithAccuracy(hop.p50, 0.001, 1e-9);
+    XCTAssertEqualWithAccuracy(hop.p95, 0.003, 1e-9);
+    
+    XCTAssertNil([self summaryForStage:ABLoadTraceStageFileWrite]);
+    XCTAssert([[ABLoadTrace report] containsString:@"mainQueueHop"]);
+    
+    [ABLoadTrace reset];
+    XCTAssertEqual([ABLoadTrace stageSummaries].count, 0);
+}
+
+- (void)testLoadTraceExportsChromeTrace {
+    [ABLoadTrace reset];
+    
+    uint64_t load = ABLoadTraceNewLoad();
+    ABLoadTraceBegin(load, ABLoadTraceStageDetectURL);
+    ABLoadTraceBegin(load, ABLoadTraceStageLoad);
+    
+    // Stages end on whichever thread their work finishes on
+    XCTestExpectation *expectation = [self expectationWithDescription:@"ended in the background"];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        ABLoadTraceEnd(load, ABLoadTraceStageDetectURL);
+        ABLoadTraceCancel(load, ABLoadTraceStageLoad);
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+    
+    NSDictionary *trace = [NSJSONSerialization JSONObjectWithData:[ABLoadTrace chromeTraceData] options:0 error:nil];
+    NSArray<NSDictionary *> *events = trace[@"traceEvents"];
+    NSMutableArray<NSDictionary *> *detectEvents = [NSMutableArray array];
+    NSDictionary *cancelEvent = nil;
+    BOOL namesMainThread = NO;
+    
+    for (NSDictionary *event in events) {
+        
+        if ([event[@"ph"] isEqualToString:@"M"]) {
+            namesMainThread = [event[@"args"][@"name"] isEqualToString:@"Main Thread"];
+        } else if ([event[@"name"] isEqualToString:@"detectURL"]) {
+            [detectEvents addObject:event];
+        } else if ([event[@"name"] isEqualToString:@"load"] && [event[@"ph"] isEqualToString:@"e"]) {
+            cancelEvent = event;
+        }
+        
+    }
+    
+    XCTAssertTrue(namesMainThread);
+    XCTAssertEqual(detectEvents.count, 2);
+    XCTAssertEqualObjects(detectEvents[0][@"ph"], @"b");
+    XCTAssertEqualObjects(detectEvents[1][@"ph"], @"e");
+    XCTAssertEqualObjects(detectEvents[0][@"id"], detectEvents[1][@"id"]);
+    XCTAssertNotEqualObjects(detectEvents[0][@"tid"], detectEvents[1][@"tid"]);
+    XCTAssertEqualObjects(detectEvents[0][@"args"][@"load"], @(load));
+    XCTAssertGreaterThanOrEqual([detectEvents[1][@"ts"] doubleValue], [detectEvents[0][@"ts"] doubleValue]);
+    XCTAssertEqualObjects(cancelEvent[@"args"][@"cancelled"], @YES);
+    
+    [ABLoadTrace reset];
+}
+
+- (void)testLoadTraceRecordsConcurrentlyWithoutTearing {
+    [ABLoadTrace reset];
+    
+    NSUInteger threadCount = 4;
+    NSUInteger pairsPerThread = 20000;
+    __block BOOL finished = NO;
+    
+    // Every stage recorded lasts exactly one microsecond, so a torn event would show up as another duration
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+            
+            for (NSUInteger i = 0; i < pairsPerThread; i++) {
+                uint64_t load = ABLoadTraceNewLoad();
+                uint64_t timestamp = ABLoadTraceNow();
+                
+                ABLoadTraceRecord(load, ABLoadTraceStageDownload, ABLoadTracePhaseBegin, timestamp);
+                ABLoadTraceRecord(load, ABLoadTraceStageDownload, ABLoadTracePhaseEnd, timestamp + NSEC_PER_USEC);
+            }
+            
+        });
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            finished = YES;
+        });
+    });
+    
+    NSUInteger snapshots = 0;
+    
+    while (!finished) {
+        ABLoadTraceStageSummary *download = [self summaryForStage:ABLoadTraceStageDownload];
+        
+        if (download.count > 0) {
+            XCTAssertEqualWithAccuracy(download.max, 1e-6, 1e-12);
+            XCTAssertEqualWithAccuracy(download.p50, 1e-6, 1e-12);
+        }
+        
+        snapshots++;
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.001]];
+    }
+    
+    // Each thread keeps only its latest events, all of which are intact once it stops writing
+    ABLoadTraceStageSummary *download = [self summaryForStage:ABLoadTraceStageDownload];
+    XCTAssertGreaterThan(download.count, 0);
+    XCTAssertLessThanOrEqual(download.count, threadCount * ABLoadTraceBufferCapacity / 2);
+    XCTAssertEqualWithAccuracy(download.max, 1e-6, 1e-12);
+    
+    // Cost of recording on the hot path, and of a load which is not traced
+    NSUInteger iterations = 1000000;
+    uint64_t load = ABLoadTraceNewLoad();
+    CFTimeInterval begin = CACurrentMediaTime();
+    
+    for (NSUInteger i = 0; i < iterations; i++) {
+        ABLoadTraceBegin(load, ABLoadTraceStageFirstTick);
+    }
+    
+    CFTimeInterval tracedTime = (CACurrentMediaTime() - begin) / iterations;
+    begin = CACurrentMediaTime();
+    
+    for (NSUInteger i = 0; i < iterations; i++) {
+        ABLoadTraceBegin(0, ABLoadTraceStageFirstTick);
+    }
+    
+    CFTimeInterval untracedTime = (CACurrentMediaTime() - begin) / iterations;
+    
+    NSLog(@"Load trace - %lu snapshots while recording, %.1f ns per event, %.1f ns per untraced event", (unsigned long)snapshots, tracedTime * 1e9, untracedTime * 1e9);
+    
+    [ABLoadTrace reset];
+}
+
+- (void)testLoadTraceOfVideoPresentation {
+    [ABLoadTrace reset];
+    [[ABMediaView sharedManager] setShouldTraceMediaLoads:YES];
+    
+    ABMediaView *mediaView = [[ABMediaView alloc] initWithFrame:CGRectMake(0, 0, 320, 180)];
+    [mediaView setVideoURL:ABTestVideoURL];
+    
+    [[ABMediaView sharedManager] presentMediaView:mediaView animated:NO];
+    
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:20.0];
+    while (mediaView.timeToFirstFrame == 0 && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    
+    [mediaView dismissMediaViewAnimated:NO withCompletion:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    
+    XCTAssert(mediaView.timeToFirstFrame > 0, "mediaView should play its video");
+    
+    ABLoadTraceStageSummary *load = [self summaryForStage:ABLoadTraceStageLoad];
+    XCTAssertEqual(load.count, 1);
+    XCTAssertGreaterThanOrEqual(load.max, mediaView.timeToFirstFrame);
+    XCTAssertEqual([self summaryForStage:ABLoadTraceStageFirstTick].count, 1);
+    XCTAssertNotNil([self summaryForStage:ABLoadTraceStageItemStatus]);
+    
+    NSString *tracePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ABMediaViewLoadTrace.json"];
+    [[ABLoadTrace chromeTraceData] writeToFile:tracePath atomically:YES];
+    
+    NSLog(@"Load trace written to %@\n%@", tracePath, [ABLoadTrace report]);
+    
+    [[ABMediaView sharedManager] setShouldTraceMediaLoads:NO];
+    [ABLoadTrace reset];
+}
+
+@end